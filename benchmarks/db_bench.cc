@@ -4,22 +4,28 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstdio>
 #include <cstdlib>
+#include <string>
+#include <vector>
 
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/persistent_cache.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
+#include "table/merger.h"
 #include "util/crc32c.h"
 #include "util/histogram.h"
 #include "util/mutexlock.h"
 #include "util/random.h"
 #include "util/testutil.h"
+#include "util/xxh3.h"
 
 // Comma-separated list of operations to run in the specified order
 //   Actual benchmarks:
@@ -35,14 +41,22 @@
 //      readrandom    -- read N times in random order
 //      readmissing   -- read N missing keys in random order
 //      readhot       -- read N times in random order from 1% section of DB
+//      readwhilescanning -- 1 scanner repeatedly iterates over the whole DB
+//                       while N threads do random reads
 //      seekrandom    -- N random seeks
 //      seekordered   -- N ordered seeks
 //      open          -- cost of opening a DB
 //      crc32c        -- repeated crc32c of 4K of data
+//      xxh3          -- repeated xxh3 of 4K of data
+//      mergereadseq  -- N Next() calls on a merging iterator over 4, 8, 16
+//                       and 64 in-memory children; reports compares/key
+//      mergeseekrandom -- N random seeks on a merging iterator over 4, 8,
+//                       16 and 64 in-memory children; reports compares/key
 //   Meta operations:
 //      compact     -- Compact the entire DB
 //      stats       -- Print DB stats
 //      sstables    -- Print sstable info
+//      cachestats  -- Print per-shard block cache stats
 //      heapprofile -- Dump a heap profile (if supported by this port)
 static const char* FLAGS_benchmarks =
     "fillseq,"
@@ -59,6 +73,7 @@ static const char* FLAGS_benchmarks =
     "readreverse,"
     "fill100K,"
     "crc32c,"
+    "xxh3,"
     "snappycomp,"
     "snappyuncomp,"
     "zstdcomp,"
@@ -98,10 +113,40 @@ static int FLAGS_max_file_size = 0;
 // (initialized to default value by "main")
 static int FLAGS_block_size = 0;
 
+// If true, give data blocks a hash index for point lookups
+static bool FLAGS_data_block_hash_index = false;
+
+// If true, store restart key prefixes in data blocks for seeks
+static bool FLAGS_data_block_restart_prefixes = false;
+
+// If true, write plain tables instead of block-based tables
+static bool FLAGS_plain_table = false;
+
+// If non-zero, store values of at least this many bytes in blob files
+static int FLAGS_min_blob_size = 0;
+
+// If true, checksum the blocks of new tables with xxh3 instead of crc32c
+static bool FLAGS_xxh3_checksum = false;
+
 // Number of bytes to use as a cache of uncompressed data.
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// Number of bytes to use as a cache of compressed blocks; negative means
+// no such cache.
+static int FLAGS_compressed_cache_size = -1;
+
+// Number of bytes to use as a cache of rows found by point lookups;
+// negative means no such cache.
+static int FLAGS_row_cache_size = -1;
+
+// If true, the cache of uncompressed data uses CLOCK instead of LRU eviction.
+static bool FLAGS_clock_cache = false;
+
+// Log2 of the number of shards of the LRU cache of uncompressed data.
+// Negative means use default settings.
+static int FLAGS_cache_shard_bits = -1;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
@@ -109,6 +154,12 @@ static int FLAGS_open_files = 0;
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// If true, build one bloom filter per table instead of one per 2KB of data.
+static bool FLAGS_full_filter = false;
+
+// If true, use a bloom filter that probes a single cache line per key.
+static bool FLAGS_cache_local_bloom = false;
+
 // Common key prefix length.
 static int FLAGS_key_prefix = 0;
 
@@ -123,9 +174,22 @@ static bool FLAGS_reuse_logs = false;
 // If true, use compression.
 static bool FLAGS_compression = true;
 
+// If true, writers of a group commit insert into the memtable in parallel.
+static bool FLAGS_allow_concurrent_memtable_write = false;
+
+// If true, overlap the log write of one group commit with the memtable
+// insert of the previous one.
+static bool FLAGS_enable_pipelined_write = false;
+
 // Use the db with the following name.
 static const char* FLAGS_db = nullptr;
 
+// If non-null, keep a persistent cache of table blocks in this directory.
+static const char* FLAGS_persistent_cache_path = nullptr;
+
+// Number of megabytes the persistent cache may use.
+static int FLAGS_persistent_cache_mb = 1024;
+
 // ZSTD compression level to try out
 static int FLAGS_zstd_compression_level = 1;
 
@@ -161,6 +225,34 @@ class CountComparator : public Comparator {
   const Comparator* const wrapped_;
 };
 
+// An iterator over a sorted vector of keys, whose own positioning does
+// not go through a Comparator.
+class SortedKeysIterator : public Iterator {
+ public:
+  explicit SortedKeysIterator(const std::vector<std::string>* keys)
+      : keys_(keys), index_(keys->size()) {}
+
+  bool Valid() const override { return index_ < keys_->size(); }
+  void SeekToFirst() override { index_ = 0; }
+  void SeekToLast() override {
+    index_ = keys_->empty() ? 0 : keys_->size() - 1;
+  }
+  void Seek(const Slice& target) override {
+    index_ = std::lower_bound(keys_->begin(), keys_->end(),
+                              target.ToString()) -
+             keys_->begin();
+  }
+  void Next() override { index_++; }
+  void Prev() override { index_ = (index_ == 0) ? keys_->size() : index_ - 1; }
+  Slice key() const override { return (*keys_)[index_]; }
+  Slice value() const override { return Slice(); }
+  Status status() const override { return Status::OK(); }
+
+ private:
+  const std::vector<std::string>* const keys_;
+  size_t index_;
+};
+
 // Helper for quickly generating random data.
 class RandomGenerator {
  private:
@@ -428,6 +520,9 @@ void Uncompress(
 class Benchmark {
  private:
   Cache* cache_;
+  Cache* compressed_cache_;
+  Cache* row_cache_;
+  PersistentCache* persistent_cache_;
   const FilterPolicy* filter_policy_;
   DB* db_;
   int num_;
@@ -438,6 +533,7 @@ class Benchmark {
   int heap_counter_;
   CountComparator count_comparator_;
   int total_thread_count_;
+  int merge_children_;
 
   void PrintHeader() {
     const int kKeySize = 16 + FLAGS_key_prefix;
@@ -519,10 +615,23 @@ class Benchmark {
 
  public:
   Benchmark()
-      : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
-        filter_policy_(FLAGS_bloom_bits >= 0
-                           ? NewBloomFilterPolicy(FLAGS_bloom_bits)
-                           : nullptr),
+      : cache_(FLAGS_cache_size < 0 ? nullptr
+               : FLAGS_clock_cache  ? NewClockCache(FLAGS_cache_size)
+                                    : NewLRUCache(FLAGS_cache_size, 0.5,
+                                                  FLAGS_cache_shard_bits)),
+        compressed_cache_(FLAGS_compressed_cache_size >= 0
+                              ? NewLRUCache(FLAGS_compressed_cache_size)
+                              : nullptr),
+        row_cache_(FLAGS_row_cache_size >= 0
+                       ? NewLRUCache(FLAGS_row_cache_size)
+                       : nullptr),
+        persistent_cache_(nullptr),
+        filter_policy_(FLAGS_bloom_bits < 0 ? nullptr
+                       : FLAGS_cache_local_bloom
+                           ? NewCacheLocalBloomFilterPolicy(FLAGS_bloom_bits,
+                                                            FLAGS_full_filter)
+                           : NewBloomFilterPolicy(FLAGS_bloom_bits,
+                                                  FLAGS_full_filter)),
         db_(nullptr),
         num_(FLAGS_num),
         value_size_(FLAGS_value_size),
@@ -530,7 +639,8 @@ class Benchmark {
         reads_(FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads),
         heap_counter_(0),
         count_comparator_(BytewiseComparator()),
-        total_thread_count_(0) {
+        total_thread_count_(0),
+        merge_children_(0) {
     std::vector<std::string> files;
     g_env->GetChildren(FLAGS_db, &files);
     for (size_t i = 0; i < files.size(); i++) {
@@ -541,10 +651,24 @@ class Benchmark {
     if (!FLAGS_use_existing_db) {
       DestroyDB(FLAGS_db, Options());
     }
+    if (FLAGS_persistent_cache_path != nullptr) {
+      Status s = NewFilePersistentCache(
+          g_env, FLAGS_persistent_cache_path,
+          static_cast<uint64_t>(FLAGS_persistent_cache_mb) << 20,
+          &persistent_cache_);
+      if (!s.ok()) {
+        std::fprintf(stderr, "persistent cache error: %s\n",
+                     s.ToString().c_str());
+        std::exit(1);
+      }
+    }
   }
 
   ~Benchmark() {
     delete db_;
+    delete persistent_cache_;
+    delete compressed_cache_;
+    delete row_cache_;
     delete cache_;
     delete filter_policy_;
   }
@@ -627,10 +751,15 @@ class Benchmark {
       } else if (name == Slice("readwhilewriting")) {
         num_threads++;  // Add extra thread for writing
         method = &Benchmark::ReadWhileWriting;
+      } else if (name == Slice("readwhilescanning")) {
+        num_threads++;  // Add extra thread for scanning
+        method = &Benchmark::ReadWhileScanning;
       } else if (name == Slice("compact")) {
         method = &Benchmark::Compact;
       } else if (name == Slice("crc32c")) {
         method = &Benchmark::Crc32c;
+      } else if (name == Slice("xxh3")) {
+        method = &Benchmark::Xxh3;
       } else if (name == Slice("snappycomp")) {
         method = &Benchmark::SnappyCompress;
       } else if (name == Slice("snappyuncomp")) {
@@ -639,12 +768,24 @@ class Benchmark {
         method = &Benchmark::ZstdCompress;
       } else if (name == Slice("zstduncomp")) {
         method = &Benchmark::ZstdUncompress;
+      } else if (name == Slice("mergereadseq") ||
+                 name == Slice("mergeseekrandom")) {
+        // One run for each number of children
+        for (int children : {4, 8, 16, 64}) {
+          merge_children_ = children;
+          RunBenchmark(1, name.ToString() + "/" + std::to_string(children),
+                       name == Slice("mergereadseq")
+                           ? &Benchmark::MergeReadSequential
+                           : &Benchmark::MergeSeekRandom);
+        }
       } else if (name == Slice("heapprofile")) {
         HeapProfile();
       } else if (name == Slice("stats")) {
         PrintStats("leveldb.stats");
       } else if (name == Slice("sstables")) {
         PrintStats("leveldb.sstables");
+      } else if (name == Slice("cachestats")) {
+        PrintStats("leveldb.block-cache-stats");
       } else {
         if (!name.empty()) {  // No error message for empty name
           std::fprintf(stderr, "unknown benchmark '%s'\n",
@@ -772,6 +913,75 @@ class Benchmark {
     thread->stats.AddMessage(label);
   }
 
+  void Xxh3(ThreadState* thread) {
+    // Hash about 500MB of data total
+    const int size = 4096;
+    const char* label = "(4K per op)";
+    std::string data(size, 'x');
+    int64_t bytes = 0;
+    uint64_t hash = 0;
+    while (bytes < 500 * 1048576) {
+      hash = xxh3::Value(data.data(), size);
+      thread->stats.FinishedSingleOp();
+      bytes += size;
+    }
+    // Print so result is not dead
+    std::fprintf(stderr, "... hash=0x%llx\r",
+                 static_cast<unsigned long long>(hash));
+
+    thread->stats.AddBytes(bytes);
+    thread->stats.AddMessage(label);
+  }
+
+  void MergeReadSequential(ThreadState* thread) { MergeBench(thread, false); }
+
+  void MergeSeekRandom(ThreadState* thread) { MergeBench(thread, true); }
+
+  // Merges num_ keys spread at random over merge_children_ sorted
+  // children, and counts the comparisons the merging iterator makes.
+  void MergeBench(ThreadState* thread, bool seek) {
+    std::vector<std::vector<std::string>> keys(merge_children_);
+    for (int i = 0; i < num_; i++) {
+      char key[100];
+      std::snprintf(key, sizeof(key), "%016d", i);
+      keys[thread->rand.Uniform(merge_children_)].push_back(key);
+    }
+    std::vector<Iterator*> children;
+    for (int i = 0; i < merge_children_; i++) {
+      children.push_back(new SortedKeysIterator(&keys[i]));
+    }
+    CountComparator cmp(BytewiseComparator());
+    Iterator* iter = NewMergingIterator(&cmp, &children[0], merge_children_);
+
+    // Leave out the time taken to set up the children
+    thread->stats.Start();
+    int found = 0;
+    int64_t ops = 0;
+    if (seek) {
+      for (int i = 0; i < reads_; i++) {
+        char key[100];
+        std::snprintf(key, sizeof(key), "%016d", thread->rand.Uniform(num_));
+        iter->Seek(key);
+        if (iter->Valid()) found++;
+        thread->stats.FinishedSingleOp();
+        ops++;
+      }
+    } else {
+      for (iter->SeekToFirst(); ops < reads_ && iter->Valid(); iter->Next()) {
+        found++;
+        thread->stats.FinishedSingleOp();
+        ops++;
+      }
+    }
+    delete iter;
+
+    char msg[100];
+    std::snprintf(msg, sizeof(msg), "(%d of %d found, %.2f compares/key)",
+                  found, static_cast<int>(ops),
+                  ops > 0 ? static_cast<double>(cmp.comparisons()) / ops : 0.0);
+    thread->stats.AddMessage(msg);
+  }
+
   void SnappyCompress(ThreadState* thread) {
     Compress(thread, "snappy", &port::Snappy_Compress);
   }
@@ -805,15 +1015,27 @@ class Benchmark {
     options.env = g_env;
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
+    options.block_cache_compressed = compressed_cache_;
+    options.row_cache = row_cache_;
+    options.persistent_cache = persistent_cache_;
     options.write_buffer_size = FLAGS_write_buffer_size;
     options.max_file_size = FLAGS_max_file_size;
     options.block_size = FLAGS_block_size;
+    options.data_block_hash_index = FLAGS_data_block_hash_index;
+    options.data_block_restart_prefixes = FLAGS_data_block_restart_prefixes;
+    options.table_format =
+        FLAGS_plain_table ? leveldb::kPlainTable : leveldb::kBlockBasedTable;
+    options.min_blob_size = FLAGS_min_blob_size;
+    options.checksum = FLAGS_xxh3_checksum ? leveldb::kXXH3 : leveldb::kCRC32c;
     if (FLAGS_comparisons) {
       options.comparator = &count_comparator_;
     }
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
     options.reuse_logs = FLAGS_reuse_logs;
+    options.allow_concurrent_memtable_write =
+        FLAGS_allow_concurrent_memtable_write;
+    options.enable_pipelined_write = FLAGS_enable_pipelined_write;
     options.compression =
         FLAGS_compression ? kSnappyCompression : kNoCompression;
     Status s = DB::Open(options, FLAGS_db, &db_);
@@ -1028,6 +1250,32 @@ class Benchmark {
     }
   }
 
+  void ReadWhileScanning(ThreadState* thread) {
+    if (thread->tid > 0) {
+      ReadRandom(thread);
+    } else {
+      // Special thread that keeps scanning the whole DB, filling the block
+      // cache, until other threads are done.
+      ReadOptions options;
+      bool done = false;
+      while (!done) {
+        Iterator* iter = db_->NewIterator(options);
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+          MutexLock l(&thread->shared->mu);
+          if (thread->shared->num_done + 1 >= thread->shared->num_initialized) {
+            // Other threads have finished
+            done = true;
+            break;
+          }
+        }
+        delete iter;
+      }
+
+      // Do not count any of the preceding work/delay in stats.
+      thread->stats.Start();
+    }
+  }
+
   void Compact(ThreadState* thread) { db_->CompactRange(nullptr, nullptr); }
 
   void PrintStats(const char* key) {
@@ -1093,6 +1341,14 @@ int main(int argc, char** argv) {
     } else if (sscanf(argv[i], "--compression=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_compression = n;
+    } else if (sscanf(argv[i], "--allow_concurrent_memtable_write=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_allow_concurrent_memtable_write = n;
+    } else if (sscanf(argv[i], "--enable_pipelined_write=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_enable_pipelined_write = n;
     } else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
       FLAGS_num = n;
     } else if (sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1) {
@@ -1107,16 +1363,52 @@ int main(int argc, char** argv) {
       FLAGS_max_file_size = n;
     } else if (sscanf(argv[i], "--block_size=%d%c", &n, &junk) == 1) {
       FLAGS_block_size = n;
+    } else if (sscanf(argv[i], "--data_block_hash_index=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_data_block_hash_index = n;
+    } else if (sscanf(argv[i], "--data_block_restart_prefixes=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_data_block_restart_prefixes = n;
+    } else if (sscanf(argv[i], "--plain_table=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_plain_table = n;
+    } else if (sscanf(argv[i], "--min_blob_size=%d%c", &n, &junk) == 1) {
+      FLAGS_min_blob_size = n;
+    } else if (sscanf(argv[i], "--xxh3_checksum=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_xxh3_checksum = n;
     } else if (sscanf(argv[i], "--key_prefix=%d%c", &n, &junk) == 1) {
       FLAGS_key_prefix = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--compressed_cache_size=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_compressed_cache_size = n;
+    } else if (sscanf(argv[i], "--row_cache_size=%d%c", &n, &junk) == 1) {
+      FLAGS_row_cache_size = n;
+    } else if (sscanf(argv[i], "--clock_cache=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_clock_cache = n;
+    } else if (sscanf(argv[i], "--cache_shard_bits=%d%c", &n, &junk) == 1) {
+      FLAGS_cache_shard_bits = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--full_filter=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_full_filter = n;
+    } else if (sscanf(argv[i], "--cache_local_bloom=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_cache_local_bloom = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
+    } else if (strncmp(argv[i], "--persistent_cache_path=", 24) == 0) {
+      FLAGS_persistent_cache_path = argv[i] + 24;
+    } else if (sscanf(argv[i], "--persistent_cache_mb=%d%c", &n, &junk) == 1) {
+      FLAGS_persistent_cache_mb = n;
     } else {
       std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
       std::exit(1);
@@ -0,0 +1,73 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+Status BlobIndex::DecodeFrom(Slice input) {
+  if (GetVarint64(&input, &file_number) && GetVarint64(&input, &offset) &&
+      GetVarint64(&input, &size) && input.empty()) {
+    return Status::OK();
+  }
+  return Status::Corruption("bad blob index");
+}
+
+BlobFileBuilder::BlobFileBuilder(WritableFile* file, uint64_t file_number)
+    : file_(file), file_number_(file_number), offset_(0), num_entries_(0) {}
+
+void BlobFileBuilder::Add(const Slice& value, BlobIndex* index) {
+  index->file_number = file_number_;
+  index->offset = offset_;
+  index->size = value.size();
+  if (!status_.ok()) return;
+
+  char header[kBlobRecordHeaderSize];
+  EncodeFixed32(header, crc32c::Mask(crc32c::Value(value.data(),
+                                                   value.size())));
+  status_ = file_->Append(Slice(header, sizeof(header)));
+  if (status_.ok()) {
+    status_ = file_->Append(value);
+  }
+  if (status_.ok()) {
+    offset_ += index->RecordSize();
+    num_entries_++;
+  }
+}
+
+Status ReadBlob(RandomAccessFile* file, const BlobIndex& index,
+                bool verify_checksum, std::string* value) {
+  const size_t n = static_cast<size_t>(index.RecordSize());
+  char* buf = new char[n];
+  Slice contents;
+  Status s = file->Read(index.offset, n, &contents, buf);
+  if (s.ok() && contents.size() != n) {
+    s = Status::Corruption("truncated blob read");
+  }
+  if (s.ok() && verify_checksum) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(contents.data()));
+    if (crc32c::Value(contents.data() + kBlobRecordHeaderSize,
+                      contents.size() - kBlobRecordHeaderSize) != crc) {
+      s = Status::Corruption("blob checksum mismatch");
+    }
+  }
+  if (s.ok()) {
+    value->assign(contents.data() + kBlobRecordHeaderSize,
+                  contents.size() - kBlobRecordHeaderSize);
+  }
+  delete[] buf;
+  return s;
+}
+
+}  // namespace leveldb
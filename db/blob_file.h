@@ -0,0 +1,81 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Blob files (Options::min_blob_size) hold values that are too large to
+// be worth rewriting in every compaction.  A blob file is a sequence of
+// records, one per value:
+//
+//    crc: fixed32        masked crc32c of value
+//    value: uint8[n]
+//
+// The table entry of such a value has type kTypeBlobIndex, and its value
+// is the encoded BlobIndex of the record.  Blob files are never modified.
+// The MANIFEST records the size of each blob file and how many of its
+// bytes belong to entries that compactions have dropped; compactions copy
+// the live records out of files that are mostly garbage, and files whose
+// records are all garbage are deleted.
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class RandomAccessFile;
+class WritableFile;
+
+static const size_t kBlobRecordHeaderSize = 4;
+
+struct BlobIndex {
+  uint64_t file_number;
+  uint64_t offset;  // Of the record
+  uint64_t size;    // Of the value
+
+  // Bytes the record takes up in its file.
+  uint64_t RecordSize() const { return kBlobRecordHeaderSize + size; }
+
+  void EncodeTo(std::string* dst) const;
+  Status DecodeFrom(Slice input);
+};
+
+class BlobFileBuilder {
+ public:
+  // Appends records to "file", which is blob file "file_number".  Does
+  // not close the file.
+  BlobFileBuilder(WritableFile* file, uint64_t file_number);
+
+  BlobFileBuilder(const BlobFileBuilder&) = delete;
+  BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+  // Appends a record for "value", and stores its index in *index.
+  void Add(const Slice& value, BlobIndex* index);
+
+  Status status() const { return status_; }
+
+  // Number of records added so far.
+  uint64_t NumEntries() const { return num_entries_; }
+
+  // Size of the file generated so far.
+  uint64_t FileSize() const { return offset_; }
+
+ private:
+  WritableFile* const file_;
+  const uint64_t file_number_;
+  Status status_;
+  uint64_t offset_;
+  uint64_t num_entries_;
+};
+
+// Reads the value of the record at "index" from "file" into *value.
+Status ReadBlob(RandomAccessFile* file, const BlobIndex& index,
+                bool verify_checksum, std::string* value);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
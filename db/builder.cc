@@ -4,6 +4,7 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
 #include "db/table_cache.h"
@@ -15,12 +16,21 @@
 namespace leveldb {
 
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter, FileMetaData* meta,
+                  BlobFileMetaData* blob) {
   Status s;
   meta->file_size = 0;
   iter->SeekToFirst();
 
   std::string fname = TableFileName(dbname, meta->number);
+  std::string blob_fname = BlobFileName(dbname, meta->number);
+  WritableFile* blob_file = nullptr;
+  BlobFileBuilder* blob_builder = nullptr;
+  if (blob != nullptr) {
+    blob->number = meta->number;
+    blob->total_bytes = 0;
+    blob->garbage_bytes = 0;
+  }
   if (iter->Valid()) {
     WritableFile* file;
     s = env->NewWritableFile(fname, &file);
@@ -29,18 +39,66 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     }
 
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
+    std::string blob_key, blob_value;
+    bool first = true;
     Slice key;
     for (; iter->Valid(); iter->Next()) {
       key = iter->key();
-      builder->Add(key, iter->value());
+      Slice value = iter->value();
+      ParsedInternalKey ikey;
+      if (blob != nullptr && options.min_blob_size > 0 &&
+          value.size() >= options.min_blob_size &&
+          ParseInternalKey(key, &ikey) && ikey.type == kTypeValue) {
+        if (blob_builder == nullptr) {
+          s = env->NewWritableFile(blob_fname, &blob_file);
+          if (!s.ok()) {
+            break;
+          }
+          blob_builder = new BlobFileBuilder(blob_file, meta->number);
+        }
+        BlobIndex index;
+        blob_builder->Add(value, &index);
+        ikey.type = kTypeBlobIndex;
+        blob_key.clear();
+        AppendInternalKey(&blob_key, ikey);
+        blob_value.clear();
+        index.EncodeTo(&blob_value);
+        key = blob_key;
+        value = blob_value;
+      }
+      if (first) {
+        meta->smallest.DecodeFrom(key);
+        first = false;
+      }
+      builder->Add(key, value);
     }
     if (!key.empty()) {
       meta->largest.DecodeFrom(key);
     }
 
+    // Finish the blob file first: the table refers to it
+    if (blob_builder != nullptr) {
+      if (s.ok()) {
+        s = blob_builder->status();
+      }
+      if (s.ok()) {
+        blob->total_bytes = blob_builder->FileSize();
+        s = blob_file->Sync();
+      }
+      if (s.ok()) {
+        s = blob_file->Close();
+      }
+      delete blob_builder;
+      delete blob_file;
+    }
+    if (!s.ok()) {
+      builder->Abandon();
+    }
+
     // Finish and check for builder errors
-    s = builder->Finish();
+    if (s.ok()) {
+      s = builder->Finish();
+    }
     if (s.ok()) {
       meta->file_size = builder->FileSize();
       assert(meta->file_size > 0);
@@ -60,7 +118,7 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     if (s.ok()) {
       // Verify that the table is usable
       Iterator* it = table_cache->NewIterator(ReadOptions(), meta->number,
-                                              meta->file_size);
+                                              meta->file_size, -1);
       s = it->status();
       delete it;
     }
@@ -75,6 +133,10 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     // Keep it
   } else {
     env->RemoveFile(fname);
+    if (blob_builder != nullptr) {
+      env->RemoveFile(blob_fname);
+      blob->total_bytes = 0;
+    }
   }
   return s;
 }
@@ -11,6 +11,7 @@ namespace leveldb {
 
 struct Options;
 struct FileMetaData;
+struct BlobFileMetaData;
 
 class Env;
 class Iterator;
@@ -22,8 +23,14 @@ class VersionEdit;
 // *meta will be filled with metadata about the generated table.
 // If no data is present in *iter, meta->file_size will be set to
 // zero, and no Table file will be produced.
+//
+// If "blob" is non-null and options.min_blob_size is non-zero, values of
+// at least that size are written to the blob file with the same number as
+// the table, and *blob describes it; blob->total_bytes is zero if no blob
+// file was produced.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter, FileMetaData* meta,
+                  BlobFileMetaData* blob = nullptr);
 
 }  // namespace leveldb
 
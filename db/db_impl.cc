@@ -8,10 +8,12 @@
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -22,6 +24,8 @@
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
+#include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/status.h"
@@ -42,12 +46,26 @@ const int kNumNonTableCacheFiles = 10;
 // Information kept for every waiting writer
 struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu)
-      : batch(nullptr), sync(false), done(false), cv(mu) {}
+      : batch(nullptr),
+        sync(false),
+        done(false),
+        leader(nullptr),
+        pending_inserts(0),
+        last_sequence(0),
+        cv(mu) {}
 
   Status status;
   WriteBatch* batch;
   bool sync;
   bool done;
+  // Set by the group leader when this writer should insert its own batch
+  // into the memtable (Options::allow_concurrent_memtable_write).
+  Writer* leader;
+  // Number of group members the leader is still waiting on
+  int pending_inserts;
+  // Last sequence number of the group this writer leads, once logged
+  // (Options::enable_pipelined_write)
+  SequenceNumber last_sequence;
   port::CondVar cv;
 };
 
@@ -56,6 +74,7 @@ struct DBImpl::CompactionState {
   struct Output {
     uint64_t number;
     uint64_t file_size;
+    uint64_t blob_file_size;  // Of the blob file with the same number
     InternalKey smallest, largest;
   };
 
@@ -64,8 +83,12 @@ struct DBImpl::CompactionState {
   explicit CompactionState(Compaction* c)
       : compaction(c),
         smallest_snapshot(0),
+        begin(nullptr),
+        end(nullptr),
         outfile(nullptr),
         builder(nullptr),
+        blob_outfile(nullptr),
+        blob_builder(nullptr),
         total_bytes(0) {}
 
   Compaction* const compaction;
@@ -76,15 +99,45 @@ struct DBImpl::CompactionState {
   // we can drop all entries for the same key with sequence numbers < S.
   SequenceNumber smallest_snapshot;
 
+  // User key range [*begin,*end) produced by this state.  A null bound
+  // means that the range is open on that side.  Subcompactions split the
+  // key range of a compaction among several states.
+  const std::string* begin;
+  const std::string* end;
+  Compaction::Cursor cursor;
+
   std::vector<Output> outputs;
 
   // State kept for output being generated
   WritableFile* outfile;
   TableBuilder* builder;
+  WritableFile* blob_outfile;
+  BlobFileBuilder* blob_builder;
+
+  // Blob files whose live values are copied to the output
+  std::set<uint64_t> blob_files_to_collect;
+
+  // Bytes of blob file records that are garbage once the output is
+  // installed, by blob file number
+  std::map<uint64_t, uint64_t> blob_garbage;
+
+  // Storage for entries rewritten by CompactBlobValue()
+  std::string blob_key;
+  std::string blob_value;
+  std::string blob_scratch;
 
   uint64_t total_bytes;
 };
 
+// A key range of a compaction that is merged on a thread of its own.
+struct DBImpl::Subcompaction {
+  DBImpl* db;
+  CompactionState* state;
+  Iterator* input;
+  Status status;
+  bool done;  // Protected by db->mutex_
+};
+
 // Fix user-supplied options to be reasonable
 template <class T, class V>
 static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
@@ -99,9 +152,15 @@ Options SanitizeOptions(const std::string& dbname,
   result.comparator = icmp;
   result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
   ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
+  ClipToRange(&result.max_background_compactions, 1, 64);
+  ClipToRange(&result.max_subcompactions, 1, 64);
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  if (icmp->user_comparator() != BytewiseComparator()) {
+    // Restart key prefixes are ordered bytewise
+    result.data_block_restart_prefixes = false;
+  }
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -123,10 +182,28 @@ static int TableCacheSize(const Options& sanitized_options) {
   return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 }
 
+// Returns the options to build a table written to "level" with, which
+// hold the compression settings of that level.
+static Options TableOptionsForLevel(const Options& options, int level,
+                                    bool bottommost) {
+  Options result = options;
+  const std::vector<CompressionType>& per_level = options.compression_per_level;
+  if (!per_level.empty()) {
+    result.compression =
+        per_level[std::min(static_cast<size_t>(level), per_level.size() - 1)];
+  }
+  if (bottommost && options.bottommost_zstd_compression_level != 0) {
+    result.compression = kZstdCompression;
+    result.zstd_compression_level = options.bottommost_zstd_compression_level;
+  }
+  return result;
+}
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
-      internal_filter_policy_(raw_options.filter_policy),
+      internal_filter_policy_(raw_options.filter_policy,
+                              raw_options.prefix_extractor),
       options_(SanitizeOptions(dbname, &internal_comparator_,
                                &internal_filter_policy_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
@@ -138,13 +215,15 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       background_work_finished_signal_(&mutex_),
       mem_(nullptr),
       imm_(nullptr),
-      has_imm_(false),
       logfile_(nullptr),
       logfile_number_(0),
       log_(nullptr),
       seed_(0),
       tmp_batch_(new WriteBatch),
-      background_compaction_scheduled_(false),
+      background_flush_scheduled_(false),
+      background_compactions_scheduled_(0),
+      manifest_write_in_progress_(false),
+      flush_output_pending_(false),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
                                &internal_comparator_)) {}
@@ -153,9 +232,10 @@ DBImpl::~DBImpl() {
   // Wait for background work to finish.
   mutex_.Lock();
   shutting_down_.store(true, std::memory_order_release);
-  while (background_compaction_scheduled_) {
+  while (background_flush_scheduled_ || background_compactions_scheduled_ > 0) {
     background_work_finished_signal_.Wait();
   }
+  assert(queued_compactions_.empty());
   mutex_.Unlock();
 
   if (db_lock_ != nullptr) {
@@ -234,6 +314,8 @@ void DBImpl::RemoveObsoleteFiles() {
   // Make a set of all of the live files
   std::set<uint64_t> live = pending_outputs_;
   versions_->AddLiveFiles(&live);
+  std::set<uint64_t> live_blobs = pending_outputs_;
+  versions_->AddLiveBlobFiles(&live_blobs);
 
   std::vector<std::string> filenames;
   env_->GetChildren(dbname_, &filenames);  // Ignoring errors on purpose
@@ -256,6 +338,9 @@ void DBImpl::RemoveObsoleteFiles() {
         case kTableFile:
           keep = (live.find(number) != live.end());
           break;
+        case kBlobFile:
+          keep = (live_blobs.find(number) != live_blobs.end());
+          break;
         case kTempFile:
           // Any temp files that are currently being written to must
           // be recorded in pending_outputs_, which is inserted into "live"
@@ -272,6 +357,8 @@ void DBImpl::RemoveObsoleteFiles() {
         files_to_delete.push_back(std::move(filename));
         if (type == kTableFile) {
           table_cache_->Evict(number);
+        } else if (type == kBlobFile) {
+          table_cache_->EvictBlob(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n", static_cast<int>(type),
             static_cast<unsigned long long>(number));
@@ -455,7 +542,9 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
       compactions++;
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      uint64_t file_number;
+      status = WriteLevel0Table(mem, edit, nullptr, &file_number);
+      pending_outputs_.erase(file_number);
       mem->Unref();
       mem = nullptr;
       if (!status.ok()) {
@@ -477,7 +566,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (env_->GetFileSize(fname, &lfile_size).ok() &&
         env_->NewAppendableFile(fname, &logfile_).ok()) {
       Log(options_.info_log, "Reusing old log %s \n", fname.c_str());
-      log_ = new log::Writer(logfile_, lfile_size);
+      log_ = new log::Writer(logfile_, lfile_size, options_.checksum);
       logfile_number_ = log_number;
       if (mem != nullptr) {
         mem_ = mem;
@@ -494,7 +583,9 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     // mem did not get reused; compact it.
     if (status.ok()) {
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      uint64_t file_number;
+      status = WriteLevel0Table(mem, edit, nullptr, &file_number);
+      pending_outputs_.erase(file_number);
     }
     mem->Unref();
   }
@@ -502,123 +593,155 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   return status;
 }
 
-/*ҪڽڴMemTableд뵽 Level0SSTļ*/
+/*要用于将内存表（MemTable）的数据写入到 Level0的SST文件中*/
 /*
-* metaļԪݣͨmemĵ浽sstļ
-* editݿ汾ĸģ¼ļӺɾϢ
-* baseǰݿ汾οѾڵݺļϢ
+* meta文件元数据，通过mem的迭代器保存到sst文件中
+* edit描述数据库版本的更改，记录新文件的添加和删除等信息
+* base当前数据库版本，参考已经存在的数据和文件信息
 */
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-                                Version* base) {
-  mutex_.AssertHeld(); // ȷ
-  const uint64_t start_micros = env_->NowMicros(); // ¼ʼʱ
-  FileMetaData meta; // ļԪ
+                                Version* base, uint64_t* file_number) {
+  mutex_.AssertHeld(); // 确保有锁
+  const uint64_t start_micros = env_->NowMicros(); // 记录开始时间
+  FileMetaData meta; // 创建文件元数据
   meta.number = versions_->NewFileNumber();
+  *file_number = meta.number;
   pending_outputs_.insert(meta.number);
-  Iterator* iter = mem->NewIterator(); // ڴ
+  BlobFileMetaData blob;
+  Iterator* iter = mem->NewIterator(); // 创建迭代器遍历内存表
   Log(options_.info_log, "Level-0 table #%llu: started",
-      (unsigned long long)meta.number); // ¼־
+      (unsigned long long)meta.number); // 记录日志
 
   Status s;
-  { // 
-    mutex_.Unlock();  // ʲômetaʲô
+  { // 加锁建构表
+    mutex_.Unlock();  // （理清表中有什么，meta中有什么）
     /*
-    BuildTable ʵʵд̡
-    еݣд뵽SSTļС
-    ָݿĿ¼дļļmeta.numberɡ
+    BuildTable 函数负责实际的写入过程。
+    它将遍历迭代器中的数据，并写入到新SST文件中。
+    会在指定数据库目录中创建新文件，文件名基于meta.number生成。
     */
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_,
+                   TableOptionsForLevel(options_, 0, /*bottommost=*/false),
+                   table_cache_, iter, &meta, &blob);
     mutex_.Lock();
   }
-  // ־¼ɾ 
+  // 日志记录和删除迭代器 
   Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
       (unsigned long long)meta.number, (unsigned long long)meta.file_size,
       s.ToString().c_str());
   delete iter;
-  pending_outputs_.erase(meta.number); // pending_outputsʲôã
-  // Ҫڸڽедͬһʱ̶ͬһļжд
-  // ֹɵƻ
+  // meta.number stays in pending_outputs_ until the caller has installed
+  // *edit, since RemoveObsoleteFiles() may run on another thread meanwhile.
+  // 这个pending_outputs什么作用？
+  // 主要用于跟踪正在进行的写入操作，避免同一时刻对同一个文件进行多次写入
+  // 防止并发造成的数据破坏
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
-  int level = 0; // 񹹽ɹļС0
+  int level = 0; // 表格构建成功，文件大小大于0
   if (s.ok() && meta.file_size > 0) {
     const Slice min_user_key = meta.smallest.user_key();
     const Slice max_user_key = meta.largest.user_key();
     if (base != nullptr) {
-      // ûѡд㼶
-      level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
+      // 根据用户键选择写入层级
+      // Compactions on other threads may have installed newer versions
+      // while the table was being built, so place it against the current
+      // one, and keep it out of key ranges that compactions in progress
+      // are writing into.
+      level = versions_->current()->PickLevelForMemTableOutput(min_user_key,
+                                                               max_user_key);
+      while (level > 0 &&
+             versions_->RangeBeingCompacted(level, min_user_key, max_user_key)) {
+        level--;
+      }
+      flush_output_pending_ = (level > 0);
+    }
+    if (level == 0 && options_.pin_l0_filter_and_index_blocks_in_cache) {
+      // BuildTable() opened the table before its level was known, so
+      // have it reopened on next use with its meta blocks pinned.
+      table_cache_->Evict(meta.number);
     }
-    // ļϢӵ汾༭
+    // 将文件信息添加到版本编辑中
     edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
                   meta.largest);
+    if (blob.total_bytes > 0) {
+      edit->AddBlobFile(blob.number, blob.total_bytes);
+    }
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
-  stats.bytes_written = meta.file_size;
+  stats.bytes_written = meta.file_size + blob.total_bytes;
   stats_[level].Add(stats);
   return s;
 }
 
-/*immΪSSTableͬʱӵleveldbİ汾ƺļ*/
+/*将imm变为SSTable，同时添加到leveldb的版本控制和文件管理。*/
 void DBImpl::CompactMemTable() {
-  mutex_.AssertHeld(); // ڼⲢ⣨ƣ
+  mutex_.AssertHeld(); // 操作期间有锁，避免并发问题（并发控制）
   assert(imm_ != nullptr);
 
   // Save the contents of the memtable as a new Table
-  VersionEdit edit; // 汾༭ڴ
+  VersionEdit edit; // 版本编辑（内存管理）
   Version* base = versions_->current(); 
-  base->Ref(); // ð汾
-  Status s = WriteLevel0Table(imm_, &edit, base); // immдlevel0°汾Ϣ
+  base->Ref(); // 引用版本
+  uint64_t file_number;
+  Status s = WriteLevel0Table(imm_, &edit, base, &file_number); // 将imm写入level0，更新版本信息
   base->Unref();
-  // дɹڹرݿ⣬¼󷵻
+  // 如果写入成功并且正在关闭数据库，记录错误返回
   if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
     s = Status::IOError("Deleting DB during memtable compaction");
   }
-  // ûд󣬸°汾Ϣ
+  // 如果没有错误，更新版本信息（错误管理）
   // Replace immutable memtable with the generated Table
   if (s.ok()) {
     edit.SetPrevLogNumber(0);
     edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
-    s = versions_->LogAndApply(&edit, &mutex_);
+    s = LogAndApply(&edit);
   }
-  // ռ䣬ļŻ
+  pending_outputs_.erase(file_number);
+  flush_output_pending_ = false;
+  // 清理空间，清理错误文件（性能优化）
   if (s.ok()) {
     // Commit to the new state
     imm_->Unref();
     imm_ = nullptr;
-    has_imm_.store(false, std::memory_order_release);
     RemoveObsoleteFiles();
   } else {
     RecordBackgroundError(s);
   }
 }
 
-/*leveldbеķΧѹ*/
+/*处理leveldb中的范围压缩*/
 void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
   int max_level_with_files = 1;
   {
     MutexLock l(&mutex_);
-    Version* base = versions_->current(); // ȡǰ汾
+    Version* base = versions_->current(); // 获取当前版本
     for (int level = 1; level < config::kNumLevels; level++) {
       if (base->OverlapInLevel(level, begin, end)) {
-        max_level_with_files = level; // ص߲㼶
+        max_level_with_files = level; // 查找有重叠的最高层级
       }
     }
+    // Only compactions find out which blob file records are garbage, and
+    // collect blob files, so push the last level down as well.
+    if (versions_->HasBlobFiles() &&
+        max_level_with_files + 1 < config::kNumLevels) {
+      max_level_with_files++;
+    }
   }
   TEST_CompactMemTable();  // TODO(sanjay): Skip if memtable does not overlap
   for (int level = 0; level < max_level_with_files; level++) {
-    TEST_CompactRange(level, begin, end); // ÿ㼶зΧѹ
-    // ָΧsstļϲݿ洢ṹ
+    TEST_CompactRange(level, begin, end); // 对每个层级进行范围压缩
+    // 将指定范围的sst文件合并，更新数据库存储结构
   }
 }
 
-/*TEST_CompactRange ֶѹḶ́
-ѹΧѹ񡢴״̬*/
+/*TEST_CompactRange 函数负责管理手动压缩的过程，
+包括设置压缩范围、调度压缩任务、处理并发情况和清理状态*/
 void DBImpl::TEST_CompactRange(int level, const Slice* begin,
                                const Slice* end) {
-  assert(level >= 0); // ֤㼶ǷϷ
+  assert(level >= 0); // 参数验证，看层级是否合法
   assert(level + 1 < config::kNumLevels);
 
   InternalKey begin_storage, end_storage;
@@ -626,7 +749,7 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,
   ManualCompaction manual;
   manual.level = level;
   manual.done = false;
-  if (begin == nullptr) { // ÿʼͽ
+  if (begin == nullptr) { // 设置开始键和结束键
     manual.begin = nullptr;
   } else {
     begin_storage = InternalKey(*begin, kMaxSequenceNumber, kValueTypeForSeek);
@@ -639,7 +762,7 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,
     manual.end = &end_storage;
   }
 
-  MutexLock l(&mutex_); // ȡѹ
+  MutexLock l(&mutex_); // 获取锁，调度压缩
   while (!manual.done && !shutting_down_.load(std::memory_order_acquire) &&
          bg_error_.ok()) {
     if (manual_compaction_ == nullptr) {  // Idle
@@ -649,12 +772,12 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,
       background_work_finished_signal_.Wait();
     }
   }
-  // Finish current background compaction in the case where ѹ
+  // Finish current background compaction in the case where 压缩完成
   // `background_work_finished_signal_` was signalled due to an error.
-  while (background_compaction_scheduled_) {
+  while (background_compactions_scheduled_ > 0) {
     background_work_finished_signal_.Wait();
   }
-  // ȡֶѹ
+  // 取消手动压缩
   if (manual_compaction_ == &manual) {
     // Cancel my manual compaction since we aborted early for some reason.
     manual_compaction_ = nullptr;
@@ -685,78 +808,140 @@ void DBImpl::RecordBackgroundError(const Status& s) {
   }
 }
 
-/*ǷԿʼѹ*/
+Status DBImpl::LogAndApply(VersionEdit* edit) {
+  mutex_.AssertHeld();
+  while (manifest_write_in_progress_) {
+    background_work_finished_signal_.Wait();
+  }
+  manifest_write_in_progress_ = true;
+  Status s = versions_->LogAndApply(edit, &mutex_);
+  manifest_write_in_progress_ = false;
+  background_work_finished_signal_.SignalAll();
+  return s;
+}
+
+/*是否可以开始调度压缩*/
 void DBImpl::MaybeScheduleCompaction() {
   mutex_.AssertHeld();
-  // Ƿк̨ѹ񱻵ȣоͲ
-  if (background_compaction_scheduled_) {
-    // Already scheduled 
-  } else if (shutting_down_.load(std::memory_order_acquire)) {
+  if (shutting_down_.load(std::memory_order_acquire)) {
     // DB is being deleted; no more background compactions
-    // DBڹرʱܵκѹ
+    // DB正在关闭时，不能调度任何压缩任务
+    return;
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
-    // дʱܽκѹ
-  } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
-             !versions_->NeedsCompaction()) {
-    // No work to be done
-    // ûκδѹ򲻵ѹ
-  } else {
-    // ˸ֲҪĲǱʱԵѹ
-    background_compaction_scheduled_ = true;
+    // 有错误时，不能进行任何压缩任务
+    return;
+  }
+
+  // Memtable flushes have a slot of their own, and run at high priority
+  // in the Env, so that a full memtable never waits behind a long level
+  // compaction.
+  if (imm_ != nullptr && !background_flush_scheduled_) {
+    background_flush_scheduled_ = true;
+    env_->ScheduleHighPriority(&DBImpl::BGFlushWork, this);
+  }
+
+  if (manual_compaction_ != nullptr) {
+    // A manual compaction runs by itself once the automatic compactions
+    // in progress have drained.
+    if (background_compactions_scheduled_ == 0) {
+      background_compactions_scheduled_++;
+      env_->Schedule(&DBImpl::BGWork, this);
+    }
+    return;
+  }
+
+  // Compactions are picked here rather than by the background job so
+  // that a job is only scheduled when there is work that does not
+  // conflict with the compactions already in progress.
+  while (background_compactions_scheduled_ <
+             options_.max_background_compactions &&
+         !flush_output_pending_) {
+    Compaction* c = versions_->PickCompaction();
+    if (c == nullptr) {
+      // No work to be done
+      // 没有任何待处理的压缩，则不调度压缩
+      break;
+    }
+    queued_compactions_.push_back(c);
+    background_compactions_scheduled_++;
     env_->Schedule(&DBImpl::BGWork, this);
   }
 }
 
-/*dbͨתDBImplȻBackGroundCallӿڣ͵Ⱥ̨*/
+/*将db通过类型转换程DBImpl，然后调用BackGroundCall接口，启动和调度后台处理任务。*/
 void DBImpl::BGWork(void* db) {
   reinterpret_cast<DBImpl*>(db)->BackgroundCall();
 }
 
-/*levelDBĺ̨*/
+void DBImpl::BGFlushWork(void* db) {
+  reinterpret_cast<DBImpl*>(db)->BackgroundFlushCall();
+}
+
+/*处理levelDB的后台任务*/
 void DBImpl::BackgroundCall() {
-  MutexLock l(&mutex_); // ֤̰߳ȫ
-  assert(background_compaction_scheduled_); // ȷ̨񱻵
+  MutexLock l(&mutex_); // 创建互斥锁，保证线程安全。
+  assert(background_compactions_scheduled_ > 0); // 确保后台有任务被调度
+  Compaction* c = nullptr;
+  if (!queued_compactions_.empty()) {
+    c = queued_compactions_.front();
+    queued_compactions_.pop_front();
+  }
   if (shutting_down_.load(std::memory_order_acquire)) {
     // No more background work when shutting down.
-    // ݿڹرʱִκκ̨رչмݵ
+    // 数据库正在关闭时不执行任何后台工作，避免关闭过程中继续处理数据导致数据损坏
+    delete c;
   } else if (!bg_error_.ok()) {
     // No more background work after a background error.
-    // ų̨
+    // 排除后台错误
+    delete c;
   } else {
-    // ִкϲlevelDBеŻʵĲ㼶
-    // ֻҪϲ̾ͻ᲻ϱ
-    // ״αŻ洢صļ
-    BackgroundCompaction();
+    // 执行合并操作，将levelDB中的数据整理并优化到适当的层级
+    // 只要满足条件触发合并，这个过程就会不断被调用
+    // 首次遍历，优化存储，减少重叠文件和荣誉数据
+    BackgroundCompaction(c);
   }
 
-  // õװãʾɣظִͬһϲ
-  background_compaction_scheduled_ = false;
+  // 重置调度装置，表示任务完成，避免重复执行同一个合并任务
+  background_compactions_scheduled_--;
 
   // Previous compaction may have produced too many files in a level,
   // so reschedule another compaction if needed.
-  MaybeScheduleCompaction(); // ǷҪµȺϲsstableļ
-  background_work_finished_signal_.SignalAll(); // ѵȴ̣߳Դٽµĺϲ
+  MaybeScheduleCompaction(); // 检查是否需要重新调度合并，对sstable文件数量进行评估
+  background_work_finished_signal_.SignalAll(); // 唤醒等待线程，可以促进触发新的合并
 }
 
-/*leveldbĺĲ֣˺ϲѡִк״̬*/
-void DBImpl::BackgroundCompaction() {
-  mutex_.AssertHeld();
-
-  if (imm_ != nullptr) { // δϲimmutable memetable
+void DBImpl::BackgroundFlushCall() {
+  MutexLock l(&mutex_);
+  assert(background_flush_scheduled_);
+  if (shutting_down_.load(std::memory_order_acquire)) {
+    // No more background work when shutting down.
+  } else if (!bg_error_.ok()) {
+    // No more background work after a background error.
+  } else if (imm_ != nullptr) {
     CompactMemTable();
-    return;
   }
 
-  Compaction* c;
-  bool is_manual = (manual_compaction_ != nullptr); // δϲ munual compaction
+  background_flush_scheduled_ = false;
+
+  // The flush may have pushed level-0 over its compaction trigger.
+  MaybeScheduleCompaction();
+  background_work_finished_signal_.SignalAll();
+}
+
+/*leveldb的核心部分，涵盖了合并的选择，执行和状态管理*/
+void DBImpl::BackgroundCompaction(Compaction* c) {
+  mutex_.AssertHeld();
+
+  // 处理尚未合并的 munual compaction
+  bool is_manual = (c == nullptr && manual_compaction_ != nullptr);
   InternalKey manual_end;
   if (is_manual) {
-    // ֶϲ
+    // 手动合并
     ManualCompaction* m = manual_compaction_;
-    c = versions_->CompactRange(m->level, m->begin, m->end); // ȡϲΧ
+    c = versions_->CompactRange(m->level, m->begin, m->end); // 获取合并范围
     m->done = (c == nullptr);
-    if (c != nullptr) { //ֶϲ״̬¼־
+    if (c != nullptr) { //更新手动合并状态记录日志
       manual_end = c->input(0, c->num_input_files(0) - 1)->largest;
     }
     Log(options_.info_log,
@@ -764,25 +949,22 @@ void DBImpl::BackgroundCompaction() {
         m->level, (m->begin ? m->begin->DebugString().c_str() : "(begin)"),
         (m->end ? m->end->DebugString().c_str() : "(end)"),
         (m->done ? "(end)" : manual_end.DebugString().c_str()));
-  } else {
-    // ԶϲԶѡϲΧ
-    c = versions_->PickCompaction();
   }
 
-  // cٴμҪԭΪȷϲԺȷԡ
-  // һκϲҪǴѡSSTableļִкϲ
-  // ڶĿȷϺϲ
+  // 对c进行再次检查的主要原因是为了确保合并操作的完整性和正确性。
+  // 第一次合并主要是处理选择出来的SSTable文件，执行合并操作。
+  // 第二次目的是确认合并结果
   Status status;
   if (c == nullptr) {
-    // Nothing to do ûкϲļ
+    // Nothing to do 没有合并文件
   } else if (!is_manual && c->IsTrivialMove()) {
-    // Move file to next level ƶļһ㣬¼־
+    // Move file to next level 移动文件到下一层，记录日志
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->RemoveFile(c->level(), f->number);
     c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
                        f->largest);
-    status = versions_->LogAndApply(c->edit(), &mutex_);
+    status = LogAndApply(c->edit());
     if (!status.ok()) {
       RecordBackgroundError(status);
     }
@@ -792,7 +974,7 @@ void DBImpl::BackgroundCompaction() {
         static_cast<unsigned long long>(f->file_size),
         status.ToString().c_str(), versions_->LevelSummary(&tmp));
   } else {
-    // Զϲ
+    // 自动合并请求
     CompactionState* compact = new CompactionState(c);
     status = DoCompactionWork(compact);
     if (!status.ok()) {
@@ -804,7 +986,7 @@ void DBImpl::BackgroundCompaction() {
   }
   delete c;
 
-  // ״̬
+  // 错误处理，状态更新
   if (status.ok()) {
     // Done
   } else if (shutting_down_.load(std::memory_order_acquire)) {
@@ -838,6 +1020,8 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     assert(compact->outfile == nullptr);
   }
   delete compact->outfile;
+  delete compact->blob_builder;
+  delete compact->blob_outfile;
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
@@ -855,6 +1039,7 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
     pending_outputs_.insert(file_number);
     CompactionState::Output out;
     out.number = file_number;
+    out.blob_file_size = 0;
     out.smallest.Clear();
     out.largest.Clear();
     compact->outputs.push_back(out);
@@ -865,7 +1050,10 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   std::string fname = TableFileName(dbname_, file_number);
   Status s = env_->NewWritableFile(fname, &compact->outfile);
   if (s.ok()) {
-    compact->builder = new TableBuilder(options_, compact->outfile);
+    const Compaction* c = compact->compaction;
+    compact->builder = new TableBuilder(
+        TableOptionsForLevel(options_, c->level() + 1, c->IsBottommostLevel()),
+        compact->outfile);
   }
   return s;
 }
@@ -881,6 +1069,25 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 
   // Check for iterator errors
   Status s = input->status();
+  if (compact->blob_builder != nullptr) {
+    // Finish the blob file first: the table refers to it
+    if (s.ok()) {
+      s = compact->blob_builder->status();
+    }
+    const uint64_t blob_bytes = compact->blob_builder->FileSize();
+    compact->current_output()->blob_file_size = blob_bytes;
+    compact->total_bytes += blob_bytes;
+    delete compact->blob_builder;
+    compact->blob_builder = nullptr;
+    if (s.ok()) {
+      s = compact->blob_outfile->Sync();
+    }
+    if (s.ok()) {
+      s = compact->blob_outfile->Close();
+    }
+    delete compact->blob_outfile;
+    compact->blob_outfile = nullptr;
+  }
   const uint64_t current_entries = compact->builder->NumEntries();
   if (s.ok()) {
     s = compact->builder->Finish();
@@ -905,8 +1112,9 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 
   if (s.ok() && current_entries > 0) {
     // Verify that the table is usable
-    Iterator* iter =
-        table_cache_->NewIterator(ReadOptions(), output_number, current_bytes);
+    Iterator* iter = table_cache_->NewIterator(
+        ReadOptions(), output_number, current_bytes,
+        compact->compaction->level() + 1);
     s = iter->status();
     delete iter;
     if (s.ok()) {
@@ -919,6 +1127,58 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   return s;
 }
 
+Status DBImpl::CompactBlobValue(CompactionState* compact,
+                                const ParsedInternalKey& ikey, Slice* key,
+                                Slice* value) {
+  Slice contents;
+  if (ikey.type == kTypeBlobIndex) {
+    if (compact->blob_files_to_collect.empty()) {
+      return Status::OK();
+    }
+    BlobIndex index;
+    Status s = index.DecodeFrom(*value);
+    if (!s.ok() ||
+        compact->blob_files_to_collect.count(index.file_number) == 0) {
+      return s;
+    }
+    ReadOptions options;
+    options.verify_checksums = options_.paranoid_checks;
+    s = table_cache_->GetBlob(options, *value, &compact->blob_scratch);
+    if (!s.ok()) {
+      return s;
+    }
+    compact->blob_garbage[index.file_number] += index.RecordSize();
+    contents = compact->blob_scratch;
+  } else if (ikey.type == kTypeValue && options_.min_blob_size > 0 &&
+             value->size() >= options_.min_blob_size) {
+    contents = *value;
+  } else {
+    return Status::OK();
+  }
+
+  // Write the value to the blob file of the current output
+  if (compact->blob_builder == nullptr) {
+    const uint64_t number = compact->current_output()->number;
+    Status s = env_->NewWritableFile(BlobFileName(dbname_, number),
+                                     &compact->blob_outfile);
+    if (!s.ok()) {
+      return s;
+    }
+    compact->blob_builder = new BlobFileBuilder(compact->blob_outfile, number);
+  }
+  BlobIndex index;
+  compact->blob_builder->Add(contents, &index);
+  compact->blob_key.clear();
+  AppendInternalKey(&compact->blob_key,
+                    ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                      kTypeBlobIndex));
+  compact->blob_value.clear();
+  index.EncodeTo(&compact->blob_value);
+  *key = compact->blob_key;
+  *value = compact->blob_value;
+  return compact->blob_builder->status();
+}
+
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
   Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
@@ -933,15 +1193,22 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
                                          out.smallest, out.largest);
+    if (out.blob_file_size > 0) {
+      compact->compaction->edit()->AddBlobFile(out.number,
+                                               out.blob_file_size);
+    }
   }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  for (const auto& garbage_kvp : compact->blob_garbage) {
+    compact->compaction->edit()->AddBlobGarbage(garbage_kvp.first,
+                                                garbage_kvp.second);
+  }
+  return LogAndApply(compact->compaction->edit());
 }
 
-/*ִоѹжȡֵԣϲݣдļ°汾Ϣ*/
+/*执行具体的压缩工作，从输入迭代器中读取键值对，合并数据，写入输出文件，更新版本信息*/
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
-  const uint64_t start_micros = env_->NowMicros();// ʼʼʱ
-  int64_t imm_micros = 0;  // Micros spent doing imm_ compactions
-  // ¼־
+  const uint64_t start_micros = env_->NowMicros();// 初始化开始时间
+  // 记录日志
   Log(options_.info_log, "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0), compact->compaction->level(),
       compact->compaction->num_input_files(1),
@@ -950,42 +1217,127 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
   assert(compact->builder == nullptr);
   assert(compact->outfile == nullptr);
-  if (snapshots_.empty()) {// ÿ
+  if (snapshots_.empty()) {// 设置快照
     compact->smallest_snapshot = versions_->LastSequence();
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
   }
-  // Ϊǰ汾һڱѹļֵ
+  versions_->GetBlobFilesToCollect(&compact->blob_files_to_collect);
+  // Split large compactions into key ranges that are merged in parallel.
+  // The first range is processed on this thread.
+  std::vector<std::string> boundaries;
+  compact->compaction->GetSubcompactionBoundaries(options_.max_subcompactions,
+                                                  &boundaries);
+  std::vector<Subcompaction> subcompactions(boundaries.size());
+  for (size_t i = 0; i < subcompactions.size(); i++) {
+    Subcompaction* sub = &subcompactions[i];
+    sub->db = this;
+    sub->state = new CompactionState(compact->compaction);
+    sub->state->smallest_snapshot = compact->smallest_snapshot;
+    sub->state->blob_files_to_collect = compact->blob_files_to_collect;
+    sub->state->begin = &boundaries[i];
+    sub->state->end =
+        (i + 1 < boundaries.size()) ? &boundaries[i + 1] : nullptr;
+    sub->input = versions_->MakeInputIterator(compact->compaction);
+    sub->done = false;
+  }
+  if (!boundaries.empty()) {
+    compact->end = &boundaries[0];
+    Log(options_.info_log, "Compacting in %d subcompactions",
+        static_cast<int>(subcompactions.size() + 1));
+  }
+  // 为当前版本创建一个迭代器，用于遍历待压缩的键值对
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
 
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
-  input->SeekToFirst(); // ǷЧ
+  for (Subcompaction& sub : subcompactions) {
+    env_->StartThread(&DBImpl::BGSubcompactionWork, &sub);
+  }
+  Status status = DoSubcompactionWork(compact, input);
+
+  mutex_.Lock();
+  for (Subcompaction& sub : subcompactions) {
+    while (!sub.done) {
+      background_work_finished_signal_.Wait();
+    }
+    if (status.ok()) {
+      status = sub.status;
+    }
+    // The outputs of all ranges are installed by "compact", in key order.
+    compact->outputs.insert(compact->outputs.end(), sub.state->outputs.begin(),
+                            sub.state->outputs.end());
+    compact->total_bytes += sub.state->total_bytes;
+    for (const auto& garbage_kvp : sub.state->blob_garbage) {
+      compact->blob_garbage[garbage_kvp.first] += garbage_kvp.second;
+    }
+    sub.state->outputs.clear();
+    CleanupCompaction(sub.state);
+  }
+
+  /*统计信息：包括压缩时间，字节读取，写入统计*/
+  CompactionStats stats;
+  stats.micros = env_->NowMicros() - start_micros;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+    }
+  }
+  for (size_t i = 0; i < compact->outputs.size(); i++) {
+    stats.bytes_written +=
+        compact->outputs[i].file_size + compact->outputs[i].blob_file_size;
+  }
+
+  stats_[compact->compaction->level() + 1].Add(stats);
+  /*安装压缩结果：更新版本控制，记录错误*/
+  if (status.ok()) {
+    status = InstallCompactionResults(compact);
+  }
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+  }
+  /*记录日志*/
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log, "compacted to: %s", versions_->LevelSummary(&tmp));
+  return status;
+}
+
+void DBImpl::BGSubcompactionWork(void* arg) {
+  Subcompaction* sub = reinterpret_cast<Subcompaction*>(arg);
+  Status s = sub->db->DoSubcompactionWork(sub->state, sub->input);
+  MutexLock l(&sub->db->mutex_);
+  sub->status = s;
+  sub->done = true;
+  sub->db->background_work_finished_signal_.SignalAll();
+}
+
+Status DBImpl::DoSubcompactionWork(CompactionState* compact, Iterator* input) {
+  if (compact->begin != nullptr) {
+    InternalKey start(*compact->begin, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+  } else {
+    input->SeekToFirst(); // 检查迭代器是否有效
+  }
   Status status;
   ParsedInternalKey ikey;
+  bool valid_key;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
-  /*ֵԣѹЩֵԱЩҪ*/
+  /*遍历处理键值对，根据压缩的需求决定哪些键值对保留，哪些需要抛弃*/
   while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
-    // Prioritize immutable compaction workȴimm
-    if (has_imm_.load(std::memory_order_relaxed)) {
-      const uint64_t imm_start = env_->NowMicros();
-      mutex_.Lock();
-      if (imm_ != nullptr) {
-        CompactMemTable(); // ѹɱڴ,ѹͷڴ棬˽֪ͨ
-        // Wake up MakeRoomForWrite() if necessary.immΪո񣬻غ
-        background_work_finished_signal_.SignalAll();
-      }
-      mutex_.Unlock();
-      imm_micros += (env_->NowMicros() - imm_start); // ¼ɱڴѵʱ
+    // Immutable memtables are flushed by their own background job
+    // (see BackgroundFlushCall()), so they never wait for this loop.
+    Slice key = input->key();// 通过迭代器获取当前键
+    if (compact->end != nullptr && key.size() >= 8 &&
+        user_comparator()->Compare(ExtractUserKey(key), *compact->end) >= 0) {
+      // The rest of the input belongs to the next subcompaction
+      break;
     }
-
-    Slice key = input->key();// ͨȡǰ
-    // ѹ޲ҹЧ
-    if (compact->compaction->ShouldStopBefore(key) &&
-        compact->builder != nullptr) { // ֹͣʱд
+    // 压缩操作到达上限并且构建器有效
+    if (compact->compaction->ShouldStopBefore(key, &compact->cursor) &&
+        compact->builder != nullptr) { // 到达停止条件时完成写入
       status = FinishCompactionOutputFile(compact, input);
       if (!status.ok()) {
         break;
@@ -993,32 +1345,34 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     }
 
     // Handle key/value, add to state, etc.
-    bool drop = false;  // ƴʱǷӦöǰļ
-    // ǰȡûк
-    if (!ParseInternalKey(key, &ikey)) {
-      // Do not hide error keys ʧܣر
+    bool drop = false;  // 控制处理键时是否应该丢弃当前的键
+    // 解析当前键，获取用户键和序列号
+    valid_key = ParseInternalKey(key, &ikey);
+    if (!valid_key) {
+      // Do not hide error keys 解析失败，重置相关变量
       current_user_key.clear();
       has_current_user_key = false;
       last_sequence_for_key = kMaxSequenceNumber;
-    } else { // ɹļ
+    } else { // 处理解析成功的键
       if (!has_current_user_key ||
           user_comparator()->Compare(ikey.user_key, Slice(current_user_key)) !=
-              0) { // ǰһγֱ֣Ӹر
+              0) { // 当前键第一次出现，直接更新相关变量
         // First occurrence of this user key
         current_user_key.assign(ikey.user_key.data(), ikey.user_key.size());
         has_current_user_key = true;
         last_sequence_for_key = kMaxSequenceNumber;
       }
 
-      // ǰµĸ
-      // üĲԿЧ
+      // 当前键被更新的覆盖
+      // 该键的操作对快照无效
       if (last_sequence_for_key <= compact->smallest_snapshot) {
         // Hidden by an newer entry for same user key
         drop = true;  // (A)
-        // ɾļʱ
+        // 被删除的键过时
       } else if (ikey.type == kTypeDeletion &&
                  ikey.sequence <= compact->smallest_snapshot &&
-                 compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+                 compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                                        &compact->cursor)) {
         // For this user key:
         // (1) there is no data in higher levels
         // (2) data in lower levels will have larger sequence numbers
@@ -1037,12 +1391,21 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         "%d smallest_snapshot: %d",
         ikey.user_key.ToString().c_str(),
         (int)ikey.sequence, ikey.type, kTypeValue, drop,
-        compact->compaction->IsBaseLevelForKey(ikey.user_key),
+        compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                               &compact->cursor),
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
-    if (!drop) { // 
-      /*ļļСֵӵǰļ*/
+    if (drop && valid_key && ikey.type == kTypeBlobIndex) {
+      // The record the entry refers to becomes garbage
+      BlobIndex index;
+      if (index.DecodeFrom(input->value()).ok()) {
+        compact->blob_garbage[index.file_number] += index.RecordSize();
+      }
+    }
+
+    if (!drop) { // 继续处理
+      /*打开输出文件，更新输出文件最小最大键，将键值对添加到当前输出文件*/
       // Open output file if necessary
       if (compact->builder == nullptr) {
         status = OpenCompactionOutputFile(compact);
@@ -1050,14 +1413,21 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
           break;
         }
       }
-      // ΪһĿСֵ
+      Slice value = input->value();
+      if (valid_key) {
+        status = CompactBlobValue(compact, ikey, &key, &value);
+        if (!status.ok()) {
+          break;
+        }
+      }
+      // 如果为第一个条目，设置最小值
       if (compact->builder->NumEntries() == 0) {
         compact->current_output()->smallest.DecodeFrom(key);
-      } // µǰĿ
+      } // 更新当前条目的最大键
       compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value()); // Ӽֵ
+      compact->builder->Add(key, value); // 添加键值对
 
-      // Close output file if it is big enough رļ
+      // Close output file if it is big enough 关闭输出文件
       if (compact->builder->FileSize() >=
           compact->compaction->MaxOutputFileSize()) {
         status = FinishCompactionOutputFile(compact, input);
@@ -1069,7 +1439,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
     input->Next();
   }
-  /**/
+  /*处理完成情况*/
   if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
     status = Status::IOError("Deleting DB during compaction");
   }
@@ -1080,31 +1450,6 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     status = input->status();
   }
   delete input;
-  input = nullptr;
-  /*ͳϢѹʱ䣬ֽڶȡдͳ*/
-  CompactionStats stats;
-  stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
-    }
-  }
-  for (size_t i = 0; i < compact->outputs.size(); i++) {
-    stats.bytes_written += compact->outputs[i].file_size;
-  }
-
-  mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
-  /*װѹ°汾ƣ¼*/
-  if (status.ok()) {
-    status = InstallCompactionResults(compact);
-  }
-  if (!status.ok()) {
-    RecordBackgroundError(status);
-  }
-  /*¼־*/
-  VersionSet::LevelSummaryStorage tmp;
-  Log(options_.info_log, "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
 }
 
@@ -1170,21 +1515,21 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
   return versions_->MaxNextLevelOverlappingBytes();
 }
 
-/* Ҫڴݿлȡֵָ */
+/* 主要用于从数据库中获取指定键的值 */
 Status DBImpl::Get(const ReadOptions& options, const Slice& key, std::string* value) {
   Status s;
-  MutexLock l(&mutex_); // 
-  SequenceNumber snapshot; // ΪʲôҪҿյкţΪҪȷȡʱݲᱻдı䣬ʵһԶȡ
+  MutexLock l(&mutex_); // 加锁保护
+  SequenceNumber snapshot; // 为什么要找快照的序列号？因为要确立读取操作时数据不会被其它写操作改变，实现一致性读取
   if (options.snapshot != nullptr) {
-    snapshot = // ȷϿ
+    snapshot = // 确认快照
         static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
   } else {
     snapshot = versions_->LastSequence();
   }
 
-  MemTable* mem = mem_; // ȡǰڴͲɱڴ
+  MemTable* mem = mem_; // 获取当前的内存表和不可变内存表
   MemTable* imm = imm_;
-  Version* current = versions_->current(); // ǰ汾
+  Version* current = versions_->current(); // 当前版本的引用
   mem->Ref();
   if (imm != nullptr) imm->Ref();
   current->Ref();
@@ -1198,18 +1543,18 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key, std::string* va
     // First look in the memtable, then in the immutable memtable (if any).
     LookupKey lkey(key, snapshot);
     if (mem->Get(lkey, value, &s)) {
-      // Done ڵǰڴ
+      // Done 先在当前内存表找
     } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done ڲɱڴ
+      // Done 再在不可变内存表中找
     } else {
-      // ڵǰ汾SSTableļв
+      // 最后在当前版本的SSTable文件中查找
       s = current->Get(options, lkey, value, &stats);
       have_stat_update = true;
     }
     mutex_.Lock();
   }
 
-  // ʱͳϢMaybeScheduleCompactionǷҪѹ
+  // 如果查找时更新了统计信息，调用MaybeScheduleCompaction决定是否需要进行压缩
   if (have_stat_update && current->UpdateStats(stats)) {
     MaybeScheduleCompaction();
   }
@@ -1219,11 +1564,89 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key, std::string* va
   return s;
 }
 
+void DBImpl::MultiGet(const ReadOptions& options,
+                      const std::vector<Slice>& keys,
+                      std::vector<std::string>* values,
+                      std::vector<Status>* statuses) {
+  const size_t n = keys.size();
+  values->resize(n);
+  statuses->assign(n, Status());
+
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != nullptr) imm->Ref();
+  current->Ref();
+
+  bool have_stat_update = false;
+  Version::GetStats stats;
+
+  // Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+    // Look the keys up in sorted order, so that keys stored in the same
+    // table and data block are looked up together.
+    const Comparator* ucmp = user_comparator();
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return ucmp->Compare(keys[a], keys[b]) < 0;
+    });
+
+    std::vector<LookupKey*> lkeys;
+    std::vector<Version::GetRequest> requests;
+    lkeys.reserve(n);
+    for (size_t i : order) {
+      LookupKey* lkey = new LookupKey(keys[i], snapshot);
+      lkeys.push_back(lkey);
+      std::string* value = &(*values)[i];
+      Status* s = &(*statuses)[i];
+      if (mem->Get(*lkey, value, s)) {
+        // Done
+      } else if (imm != nullptr && imm->Get(*lkey, value, s)) {
+        // Done
+      } else {
+        requests.push_back(Version::GetRequest{lkey, value, s, false});
+      }
+    }
+    if (!requests.empty()) {
+      current->MultiGet(options, requests.data(),
+                        static_cast<int>(requests.size()), &stats);
+      have_stat_update = true;
+    }
+    for (LookupKey* lkey : lkeys) {
+      delete lkey;
+    }
+    mutex_.Lock();
+  }
+
+  if (have_stat_update && current->UpdateStats(stats)) {
+    MaybeScheduleCompaction();
+  }
+  mem->Unref();
+  if (imm != nullptr) imm->Unref();
+  current->Unref();
+}
+
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
   Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
-  return NewDBIterator(this, user_comparator(), iter,
+  const SliceTransform* prefix_extractor =
+      options.prefix_same_as_start ? options_.prefix_extractor : nullptr;
+  return NewDBIterator(this, options, user_comparator(), prefix_extractor, iter,
                        (options.snapshot != nullptr
                             ? static_cast<const SnapshotImpl*>(options.snapshot)
                                   ->sequence_number()
@@ -1238,6 +1661,11 @@ void DBImpl::RecordReadSample(Slice key) {
   }
 }
 
+Status DBImpl::GetBlob(const ReadOptions& options, const Slice& blob_index,
+                       std::string* value) {
+  return table_cache_->GetBlob(options, blob_index, value);
+}
+
 const Snapshot* DBImpl::GetSnapshot() {
   MutexLock l(&mutex_);
   return snapshots_.New(versions_->LastSequence());
@@ -1257,32 +1685,72 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
   return DB::Delete(options, key);
 }
 
-/*д*/
+/*批量写*/
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   Writer w(&mutex_);
-  w.batch = updates;  // д
-  w.sync = options.sync; // ͬ־
-  w.done = false; // ״̬
+  w.batch = updates;  // 写入批次
+  w.sync = options.sync; // 同步标志
+  w.done = false; // 完成状态
 
   MutexLock l(&mutex_);
   writers_.push_back(&w);
-  /* ǰδɲҲǶеĵһʱֻ̭  */
-  while (!w.done && &w != writers_.front()) {
-    w.cv.Wait(); // ȴź
+  /* 当前请求未完成并且不是队列的第一个时只能淘汰  */
+  // With pipelined writes, a logged group leaves writers_ before it is
+  // done, so the queue may be empty here.
+  while (!w.done && (writers_.empty() || &w != writers_.front())) {
+    if (w.leader != nullptr) {
+      // Our group has been logged; add our part of it to the memtable
+      // alongside the other members, then report back to the leader.
+      Writer* leader = w.leader;
+      MemTable* mem = mem_;
+      w.leader = nullptr;
+      mutex_.Unlock();
+      Status s = WriteBatchInternal::InsertInto(w.batch, mem, true);
+      mutex_.Lock();
+      w.status = s;
+      if (--leader->pending_inserts == 0) {
+        leader->cv.Signal();
+      }
+    } else {
+      w.cv.Wait(); // 等待信号量解锁
+    }
   }
   if (w.done) {
     return w.status;
   }
 
-  // May temporarily unlock and wait.
-  /*MakeRoomForWriteݵǰMemTableʹѡǷ񴥷Minor Compaction
-  ǰupdatesΪգΪManual CompactionǿƴMinor CompactionĲ*/
-  Status status = MakeRoomForWrite(updates == nullptr); // ȡռ
-  uint64_t last_sequence = versions_->LastSequence(); // ȡǰк
+  // May temporarily unlock and wait.、
+  /*MakeRoomForWrite方法会根据当前MemTable的使用率来选择是否触发Minor Compaction
+  （如果当前updates为空，则为Manual Compaction用来强制触发Minor Compaction的操作）。*/
+  Status status = MakeRoomForWrite(updates == nullptr); // 获取空间
+  uint64_t last_sequence = versions_->LastSequence(); // 获取当前序列号
+  if (!memtable_writers_.empty()) {
+    // Groups that have been logged but not yet published come first
+    last_sequence = memtable_writers_.back()->last_sequence;
+  }
   Writer* last_writer = &w; 
   if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
     WriteBatch* write_batch = BuildBatchGroup(&last_writer);
     WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
+
+    // With concurrent memtable writes, every member of the group inserts
+    // its own batch, so each batch needs its own starting sequence.  The
+    // pipelined path does the same, since it gives up tmp_batch_ to the
+    // next group before applying this one.
+    const bool pipelined = options_.enable_pipelined_write;
+    std::vector<Writer*> members;
+    if ((options_.allow_concurrent_memtable_write || pipelined) &&
+        last_writer != &w) {
+      SequenceNumber seq = last_sequence + 1;
+      for (Writer* member : writers_) {
+        if (member->batch != nullptr) {
+          WriteBatchInternal::SetSequence(member->batch, seq);
+          seq += WriteBatchInternal::Count(member->batch);
+          if (member != &w) members.push_back(member);
+        }
+        if (member == last_writer) break;
+      }
+    }
     last_sequence += WriteBatchInternal::Count(write_batch);
 
     // Add to log and apply to memtable.  We can release the lock
@@ -1290,19 +1758,19 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     // and protects against concurrent loggers and concurrent writes
     // into mem_.
     {
-        // 
+        // 处理队列
       mutex_.Unlock();
-      /*ͷwrite̸߳ݴwriteoptionsеsyncжǷҪȴWALͬȶ洢*/
+      /*释放锁，write线程根据传入的writeoptions中的sync判断是否需要等待WAL同步道稳定存储*/
       status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
       bool sync_error = false;
       if (status.ok() && options.sync) {
-        status = logfile_->Sync(); // ͬ
+        status = logfile_->Sync(); // 保持同步
         if (!status.ok()) {
           sync_error = true;
         }
       }
-      if (status.ok()) {
-          // 뵽mem
+      if (status.ok() && members.empty() && !pipelined) {
+          // 将其插入到mem中
         status = WriteBatchInternal::InsertInto(write_batch, mem_);
       }
       mutex_.Lock();
@@ -1314,11 +1782,18 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
       }
     }
     if (write_batch == tmp_batch_) tmp_batch_->Clear();
+    if (pipelined) {
+      return FinishPipelinedWrite(&w, last_writer, members, status,
+                                  last_sequence);
+    }
+    if (status.ok() && !members.empty()) {
+      status = InsertGroupConcurrently(&w, members);
+    }
 
     versions_->SetLastSequence(last_sequence);
   }
 
-  // ɺdoneֶΪtrue
+  // 完成后置done字段为true
   while (true) {
     Writer* ready = writers_.front();
     writers_.pop_front();
@@ -1338,6 +1813,96 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   return status;
 }
 
+// Has every writer in "members" insert its own batch into mem_ while
+// "leader" inserts its batch, and waits for all of them to finish.
+// REQUIRES: mutex_ is held
+// REQUIRES: the group has been appended to the log
+Status DBImpl::InsertGroupConcurrently(Writer* leader,
+                                       const std::vector<Writer*>& members) {
+  mutex_.AssertHeld();
+  leader->pending_inserts = static_cast<int>(members.size());
+  for (Writer* member : members) {
+    member->leader = leader;
+    member->cv.Signal();
+  }
+
+  MemTable* mem = mem_;
+  mutex_.Unlock();
+  Status status = WriteBatchInternal::InsertInto(leader->batch, mem, true);
+  mutex_.Lock();
+  while (leader->pending_inserts > 0) {
+    leader->cv.Wait();
+  }
+
+  for (Writer* member : members) {
+    if (status.ok()) status = member->status;
+  }
+  return status;
+}
+
+// Second half of a pipelined write: releases the writer queue so that the
+// next group can be logged, then applies the group led by "leader" to the
+// memtable once all groups logged before it have been published.
+// REQUIRES: mutex_ is held
+// REQUIRES: the group has been appended to the log (or failed to be)
+Status DBImpl::FinishPipelinedWrite(Writer* leader, Writer* last_writer,
+                                    const std::vector<Writer*>& members,
+                                    Status status,
+                                    SequenceNumber last_sequence) {
+  mutex_.AssertHeld();
+  leader->last_sequence = last_sequence;
+  memtable_writers_.push_back(leader);
+
+  // Take the group off the writer queue and let the next leader in
+  std::vector<Writer*> group;
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    group.push_back(ready);
+    if (ready == last_writer) break;
+  }
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+
+  while (memtable_writers_.front() != leader) {
+    leader->cv.Wait();
+  }
+  if (status.ok()) {
+    if (options_.allow_concurrent_memtable_write && !members.empty()) {
+      status = InsertGroupConcurrently(leader, members);
+    } else {
+      // mem_ cannot be switched while this group is in memtable_writers_
+      MemTable* mem = mem_;
+      mutex_.Unlock();
+      status = WriteBatchInternal::InsertInto(leader->batch, mem);
+      for (size_t i = 0; i < members.size() && status.ok(); i++) {
+        status = WriteBatchInternal::InsertInto(members[i]->batch, mem);
+      }
+      mutex_.Lock();
+    }
+  }
+  versions_->SetLastSequence(last_sequence);
+
+  memtable_writers_.pop_front();
+  if (!memtable_writers_.empty()) {
+    memtable_writers_.front()->cv.Signal();
+  } else if (!writers_.empty()) {
+    // The queue head may be waiting in MakeRoomForWrite() to switch
+    // memtables.
+    writers_.front()->cv.Signal();
+  }
+
+  for (Writer* ready : group) {
+    if (ready != leader) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+  }
+  return status;
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
 WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
@@ -1390,7 +1955,7 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
 
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
-// дʱ㹻ĿռԴµд
+// 写入时，有足够的空间和资源处理新的写入请求
 Status DBImpl::MakeRoomForWrite(bool force) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
@@ -1398,7 +1963,7 @@ Status DBImpl::MakeRoomForWrite(bool force) {
   Status s;
   while (true) {
     if (!bg_error_.ok()) {
-      // Yield previous error ̨
+      // Yield previous error 检查后台错误
       s = bg_error_;
       break;
     } else if (allow_delay && versions_->NumLevelFiles(0) >=
@@ -1409,27 +1974,31 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // individual write by 1ms to reduce latency variance.  Also,
       // this delay hands over some CPU to the compaction thread in
       // case it is sharing the same core as the writer.
-      // level0ļӽޣʼдʩӳ٣ټֲѹֳʱ
+      // 如果level0文件数量接近上限，开始对写入操作施加延迟，减少坚持波动给压缩现成留出时间
       mutex_.Unlock();
       env_->SleepForMicroseconds(1000);
       allow_delay = false;  // Do not delay a single write more than once
       mutex_.Lock();
-    } else if (!force && // ǰڴ㹻Ŀռ䣬д
+    } else if (!force && // 当前内存表有足够的空间，允许继续写入
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
       break;
     } else if (imm_ != nullptr) {
       // We have filled up the current memtable, but the previous
       // one is still being compacted, so we wait.
-      // ǰڴ֮ǰڴѹȴ
+      // 当前内存表已满，并且之前的内存表正在压缩，函数会等待
       Log(options_.info_log, "Current memtable full; waiting...\n");
       background_work_finished_signal_.Wait();
+    } else if (!memtable_writers_.empty()) {
+      // Pipelined groups written to the current log are still being
+      // applied to mem_; switch memtables only once they are done.
+      writers_.front()->cv.Wait();
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
-      // There are too many level-0 files. ̫level0ļȴ
+      // There are too many level-0 files. 有太多的level0文件，等待
       Log(options_.info_log, "Too many L0 files; waiting...\n");
       background_work_finished_signal_.Wait();
     } else {
-      // лµڴѹ״̬
+      // 切换到新的内存表，触发压缩，更新状态
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
       uint64_t new_log_number = versions_->NewFileNumber();
@@ -1458,9 +2027,8 @@ Status DBImpl::MakeRoomForWrite(bool force) {
 
       logfile_ = lfile;
       logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
+      log_ = new log::Writer(lfile, options_.checksum);
       imm_ = mem_;
-      has_imm_.store(true, std::memory_order_release);
       mem_ = new MemTable(internal_comparator_);
       mem_->Ref();
       force = false;  // Do not force another compaction if have room
@@ -1514,6 +2082,29 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "block-cache-stats") {
+    std::vector<Cache::ShardStats> shards;
+    options_.block_cache->GetShardStats(&shards);
+    char buf[200];
+    std::snprintf(buf, sizeof(buf),
+                  "Shard       Hits     Misses    Inserts  Evictions"
+                  "  Usage(KB) Pinned(KB)\n"
+                  "--------------------------------------------------"
+                  "----------------------\n");
+    value->append(buf);
+    for (size_t i = 0; i < shards.size(); i++) {
+      const Cache::ShardStats& st = shards[i];
+      std::snprintf(buf, sizeof(buf),
+                    "%5d %10llu %10llu %10llu %10llu %10.0f %10.0f\n",
+                    static_cast<int>(i),
+                    static_cast<unsigned long long>(st.hits),
+                    static_cast<unsigned long long>(st.misses),
+                    static_cast<unsigned long long>(st.inserts),
+                    static_cast<unsigned long long>(st.evictions),
+                    st.usage / 1024.0, st.pinned_usage / 1024.0);
+      value->append(buf);
+    }
+    return true;
   } else if (in == "approximate-memory-usage") {
     size_t total_usage = options_.block_cache->TotalCharge();
     if (mem_) {
@@ -1564,6 +2155,26 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+void DB::MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                  std::vector<std::string>* values,
+                  std::vector<Status>* statuses) {
+  // Read all keys from one snapshot, like the DBImpl implementation does.
+  ReadOptions read_options = options;
+  const Snapshot* snapshot = nullptr;
+  if (read_options.snapshot == nullptr) {
+    snapshot = GetSnapshot();
+    read_options.snapshot = snapshot;
+  }
+  values->resize(keys.size());
+  statuses->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    (*statuses)[i] = Get(read_options, keys[i], &(*values)[i]);
+  }
+  if (snapshot != nullptr) {
+    ReleaseSnapshot(snapshot);
+  }
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1585,7 +2196,7 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
       edit.SetLogNumber(new_log_number);
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
-      impl->log_ = new log::Writer(lfile);
+      impl->log_ = new log::Writer(lfile, impl->options_.checksum);
       impl->mem_ = new MemTable(impl->internal_comparator_);
       impl->mem_->Ref();
     }
@@ -9,6 +9,7 @@
 #include <deque>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/log_writer.h"
@@ -20,6 +21,7 @@
 
 namespace leveldb {
 
+class Compaction;
 class MemTable;
 class TableCache;
 class Version;
@@ -42,6 +44,9 @@ class DBImpl : public DB {
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
+  void MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                std::vector<std::string>* values,
+                std::vector<Status>* statuses) override;
   Iterator* NewIterator(const ReadOptions&) override;
   const Snapshot* GetSnapshot() override;
   void ReleaseSnapshot(const Snapshot* snapshot) override;
@@ -71,9 +76,15 @@ class DBImpl : public DB {
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Reads the value that the encoded BlobIndex "blob_index" refers to into
+  // *value.  "value" may alias "blob_index".
+  Status GetBlob(const ReadOptions& options, const Slice& blob_index,
+                 std::string* value);
+
  private:
   friend class DB;
   struct CompactionState;
+  struct Subcompaction;
   struct Writer;
 
   // Information for a manual compaction
@@ -127,27 +138,58 @@ class DBImpl : public DB {
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
+  // Writes the contents of "mem" to a new table and records it in *edit.
+  // The table's number is stored in *file_number and stays in
+  // pending_outputs_ until the caller erases it after installing *edit.
+  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base,
+                          uint64_t* file_number)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  Status FinishPipelinedWrite(Writer* leader, Writer* last_writer,
+                              const std::vector<Writer*>& members,
+                              Status status, SequenceNumber last_sequence)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  Status InsertGroupConcurrently(Writer* leader,
+                                 const std::vector<Writer*>& members)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   void RecordBackgroundError(const Status& s);
 
+  // Apply *edit to the current version.  Waits for any other thread
+  // that is in the middle of writing the MANIFEST, since concurrent
+  // background jobs may not overlap their VersionSet::LogAndApply() calls.
+  Status LogAndApply(VersionEdit* edit) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
+  static void BGFlushWork(void* db);
   void BackgroundCall();
-  void BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void BackgroundFlushCall();
+  // Runs "c", or the pending manual compaction if "c" is null.  Takes
+  // ownership of "c".
+  void BackgroundCompaction(Compaction* c) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void CleanupCompaction(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Merges the entries of "input" that fall into the key range of
+  // *compact into its output files.  Takes ownership of "input".
+  Status DoSubcompactionWork(CompactionState* compact, Iterator* input)
+      LOCKS_EXCLUDED(mutex_);
+  static void BGSubcompactionWork(void* arg);
 
   Status OpenCompactionOutputFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  // Moves the value of a kept entry to the blob file of the current output
+  // if it is large, or lives in a blob file being collected, and rewrites
+  // *key and *value to refer to it.
+  Status CompactBlobValue(CompactionState* compact,
+                          const ParsedInternalKey& ikey, Slice* key,
+                          Slice* value);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -176,7 +218,6 @@ class DBImpl : public DB {
   port::CondVar background_work_finished_signal_ GUARDED_BY(mutex_);
   MemTable* mem_;
   MemTable* imm_ GUARDED_BY(mutex_);  // Memtable being compacted
-  std::atomic<bool> has_imm_;         // So bg thread can detect non-null imm_
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
@@ -184,6 +225,9 @@ class DBImpl : public DB {
 
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
+  // Leaders of pipelined groups that have been logged but not yet
+  // published, in log order (Options::enable_pipelined_write)
+  std::deque<Writer*> memtable_writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
   SnapshotList snapshots_ GUARDED_BY(mutex_);
@@ -192,8 +236,24 @@ class DBImpl : public DB {
   // part of ongoing compactions.
   std::set<uint64_t> pending_outputs_ GUARDED_BY(mutex_);
 
-  // Has a background compaction been scheduled or is running?
-  bool background_compaction_scheduled_ GUARDED_BY(mutex_);
+  // Has a background memtable flush been scheduled or is running?
+  bool background_flush_scheduled_ GUARDED_BY(mutex_);
+
+  // Number of background level compactions scheduled or running.  At
+  // most options_.max_background_compactions.
+  int background_compactions_scheduled_ GUARDED_BY(mutex_);
+
+  // Compactions picked for scheduled background jobs that have not
+  // started yet.  Each scheduled automatic compaction job pops one.
+  std::deque<Compaction*> queued_compactions_ GUARDED_BY(mutex_);
+
+  // Is some thread writing to the MANIFEST in LogAndApply()?
+  bool manifest_write_in_progress_ GUARDED_BY(mutex_);
+
+  // Has a memtable flush placed its table above level-0 without having
+  // installed it yet?  No new compactions are picked meanwhile, since
+  // they could not see that table.
+  bool flush_output_pending_ GUARDED_BY(mutex_);
 
   ManualCompaction* manual_compaction_ GUARDED_BY(mutex_);
 
@@ -45,14 +45,20 @@ class DBIter : public Iterator {
   //     just before all entries whose user key == this->key().
   enum Direction { kForward, kReverse };
 
-  DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+  DBIter(DBImpl* db, const ReadOptions& options, const Comparator* cmp,
+         const SliceTransform* prefix_extractor, Iterator* iter,
+         SequenceNumber s, uint32_t seed)
       : db_(db),
+        options_(options),
         user_comparator_(cmp),
+        prefix_extractor_(prefix_extractor),
         iter_(iter),
         sequence_(s),
         direction_(kForward),
         valid_(false),
+        prefix_bounded_(false),
+        blob_index_(false),
+        blob_value_valid_(false),
         rnd_(seed),
         bytes_until_read_sampling_(RandomCompactionPeriod()) {}
 
@@ -67,7 +73,20 @@ class DBIter : public Iterator {
   }
   Slice value() const override {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    Slice raw = (direction_ == kForward) ? iter_->value() : saved_value_;
+    if (!blob_index_) {
+      return raw;
+    }
+    // Read from the blob file on first use
+    if (!blob_value_valid_) {
+      Status s = db_->GetBlob(options_, raw, &blob_value_);
+      if (!s.ok()) {
+        if (status_.ok()) status_ = s;
+        blob_value_.clear();
+      }
+      blob_value_valid_ = true;
+    }
+    return blob_value_;
   }
   Status status() const override {
     if (status_.ok()) {
@@ -88,10 +107,23 @@ class DBIter : public Iterator {
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
 
+  // Returns true if "user_key" is past the prefix that bounds the iterator.
+  inline bool OutOfPrefix(const Slice& user_key) const {
+    return prefix_bounded_ &&
+           (!prefix_extractor_->InDomain(user_key) ||
+            prefix_extractor_->Transform(user_key) != Slice(prefix_));
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
 
+  // Notes the type of the entry that yields this->value().
+  inline void SetValueType(ValueType type) {
+    blob_index_ = (type == kTypeBlobIndex);
+    blob_value_valid_ = false;
+  }
+
   inline void ClearSavedValue() {
     if (saved_value_.capacity() > 1048576) {
       std::string empty;
@@ -107,14 +139,21 @@ class DBIter : public Iterator {
   }
 
   DBImpl* db_;
+  const ReadOptions options_;
   const Comparator* const user_comparator_;
+  const SliceTransform* const prefix_extractor_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
-  Status status_;
+  mutable Status status_;  // Also set by value(), for blob read errors
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
   Direction direction_;
   bool valid_;
+  bool prefix_bounded_;  // Only keys with prefix prefix_ are yielded
+  std::string prefix_;
+  bool blob_index_;  // The raw value is a BlobIndex
+  mutable bool blob_value_valid_;
+  mutable std::string blob_value_;  // Read through the raw BlobIndex
   Random rnd_;
   size_t bytes_until_read_sampling_;
 };
@@ -181,6 +220,9 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   do {
     ParsedInternalKey ikey;
     if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+      if (OutOfPrefix(ikey.user_key)) {
+        break;
+      }
       switch (ikey.type) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
@@ -189,12 +231,14 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           skipping = true;
           break;
         case kTypeValue:
+        case kTypeBlobIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
           } else {
             valid_ = true;
             saved_key_.clear();
+            SetValueType(ikey.type);
             return;
           }
           break;
@@ -241,6 +285,10 @@ void DBIter::FindPrevUserEntry() {
     do {
       ParsedInternalKey ikey;
       if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+        if (OutOfPrefix(ikey.user_key)) {
+          // iter_ is already before all entries for saved_key_
+          break;
+        }
         if ((value_type != kTypeDeletion) &&
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
           // We encountered a non-deleted value in entries for previous keys,
@@ -272,12 +320,19 @@ void DBIter::FindPrevUserEntry() {
     direction_ = kForward;
   } else {
     valid_ = true;
+    SetValueType(value_type);
   }
 }
 
 void DBIter::Seek(const Slice& target) {
   direction_ = kForward;
   ClearSavedValue();
+  prefix_bounded_ =
+      prefix_extractor_ != nullptr && prefix_extractor_->InDomain(target);
+  if (prefix_bounded_) {
+    Slice prefix = prefix_extractor_->Transform(target);
+    prefix_.assign(prefix.data(), prefix.size());
+  }
   saved_key_.clear();
   AppendInternalKey(&saved_key_,
                     ParsedInternalKey(target, sequence_, kValueTypeForSeek));
@@ -292,6 +347,7 @@ void DBIter::Seek(const Slice& target) {
 void DBIter::SeekToFirst() {
   direction_ = kForward;
   ClearSavedValue();
+  prefix_bounded_ = false;
   iter_->SeekToFirst();
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -303,16 +359,20 @@ void DBIter::SeekToFirst() {
 void DBIter::SeekToLast() {
   direction_ = kReverse;
   ClearSavedValue();
+  prefix_bounded_ = false;
   iter_->SeekToLast();
   FindPrevUserEntry();
 }
 
 }  // anonymous namespace
 
-Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
+Iterator* NewDBIterator(DBImpl* db, const ReadOptions& options,
+                        const Comparator* user_key_comparator,
+                        const SliceTransform* prefix_extractor,
                         Iterator* internal_iter, SequenceNumber sequence,
                         uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+  return new DBIter(db, options, user_key_comparator, prefix_extractor,
+                    internal_iter, sequence, seed);
 }
 
 }  // namespace leveldb
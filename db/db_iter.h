@@ -16,8 +16,13 @@ class DBImpl;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
-Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
+// into appropriate user keys.  Values kept in blob files are read with
+// "options".  If "prefix_extractor" is non-null, the iterator stops at
+// keys whose prefix differs from that of the last Seek() target (see
+// ReadOptions::prefix_same_as_start).
+Iterator* NewDBIterator(DBImpl* db, const ReadOptions& options,
+                        const Comparator* user_key_comparator,
+                        const SliceTransform* prefix_extractor,
                         Iterator* internal_iter, SequenceNumber sequence,
                         uint32_t seed);
 
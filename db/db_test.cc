@@ -4,18 +4,26 @@
 
 #include "leveldb/db.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cinttypes>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
 
 #include "gtest/gtest.h"
 #include "db/db_impl.h"
 #include "db/filename.h"
+#include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/persistent_cache.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -140,6 +148,16 @@ class SpecialEnv : public EnvWrapper {
 
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
+  AtomicCounter random_read_bytes_counter_;
+
+  // Copy random reads into the caller's buffer while this is true, so that
+  // blocks read from memory-mapped tables can be cached.
+  bool copy_random_reads_;
+
+  // Reads of tables numbered at most this block while it is non-zero.
+  // table_reads_delayed_ is set once one of them is blocked.
+  std::atomic<uint64_t> delay_table_reads_up_to_;
+  std::atomic<bool> table_reads_delayed_;
 
   explicit SpecialEnv(Env* base)
       : EnvWrapper(base),
@@ -150,7 +168,10 @@ class SpecialEnv : public EnvWrapper {
         manifest_sync_error_(false),
         manifest_write_error_(false),
         log_file_close_(false),
-        count_random_reads_(false) {}
+        count_random_reads_(false),
+        copy_random_reads_(false),
+        delay_table_reads_up_to_(0),
+        table_reads_delayed_(false) {}
 
   Status NewWritableFile(const std::string& f, WritableFile** r) {
     class DataFile : public WritableFile {
@@ -237,21 +258,73 @@ class SpecialEnv : public EnvWrapper {
      private:
       RandomAccessFile* target_;
       AtomicCounter* counter_;
+      AtomicCounter* bytes_counter_;
 
      public:
-      CountingFile(RandomAccessFile* target, AtomicCounter* counter)
-          : target_(target), counter_(counter) {}
+      CountingFile(RandomAccessFile* target, AtomicCounter* counter,
+                   AtomicCounter* bytes_counter)
+          : target_(target), counter_(counter), bytes_counter_(bytes_counter) {}
       ~CountingFile() override { delete target_; }
       Status Read(uint64_t offset, size_t n, Slice* result,
                   char* scratch) const override {
         counter_->Increment();
+        bytes_counter_->IncrementBy(static_cast<int>(n));
+        return target_->Read(offset, n, result, scratch);
+      }
+    };
+
+    class CopyingFile : public RandomAccessFile {
+     private:
+      RandomAccessFile* target_;
+
+     public:
+      explicit CopyingFile(RandomAccessFile* target) : target_(target) {}
+      ~CopyingFile() override { delete target_; }
+      Status Read(uint64_t offset, size_t n, Slice* result,
+                  char* scratch) const override {
+        Status s = target_->Read(offset, n, result, scratch);
+        if (s.ok() && result->data() != scratch) {
+          std::memcpy(scratch, result->data(), result->size());
+          *result = Slice(scratch, result->size());
+        }
+        return s;
+      }
+    };
+
+    class DelayedFile : public RandomAccessFile {
+     private:
+      SpecialEnv* env_;
+      RandomAccessFile* target_;
+      uint64_t number_;
+
+     public:
+      DelayedFile(SpecialEnv* env, RandomAccessFile* target, uint64_t number)
+          : env_(env), target_(target), number_(number) {}
+      ~DelayedFile() override { delete target_; }
+      Status Read(uint64_t offset, size_t n, Slice* result,
+                  char* scratch) const override {
+        while (number_ <=
+               env_->delay_table_reads_up_to_.load(std::memory_order_acquire)) {
+          env_->table_reads_delayed_.store(true, std::memory_order_release);
+          DelayMilliseconds(10);
+        }
         return target_->Read(offset, n, result, scratch);
       }
     };
 
     Status s = target()->NewRandomAccessFile(f, r);
+    uint64_t number;
+    FileType type;
+    if (s.ok() && ParseFileName(f.substr(f.rfind('/') + 1), &number, &type) &&
+        type == kTableFile) {
+      *r = new DelayedFile(this, *r, number);
+    }
     if (s.ok() && count_random_reads_) {
-      *r = new CountingFile(*r, &random_read_counter_);
+      *r = new CountingFile(*r, &random_read_counter_,
+                            &random_read_bytes_counter_);
+    }
+    if (s.ok() && copy_random_reads_) {
+      *r = new CopyingFile(*r);
     }
     return s;
   }
@@ -306,12 +379,38 @@ class DBTest : public testing::Test {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kConcurrentMemTableWrite:
+        options.allow_concurrent_memtable_write = true;
+        break;
+      case kPipelinedWrite:
+        options.enable_pipelined_write = true;
+        break;
+      case kDataBlockHashIndex:
+        options.data_block_hash_index = true;
+        break;
+      case kDataBlockRestartPrefixes:
+        options.data_block_restart_prefixes = true;
+        break;
+      case kXXH3Checksum:
+        options.checksum = kXXH3;
+        options.paranoid_checks = true;
+        break;
+      case kPlainTableFormat:
+        options.table_format = kPlainTable;
+        break;
+      case kBlobFiles:
+        options.min_blob_size = 10;
+        break;
       default:
         break;
     }
     return options;
   }
 
+  // True if large values are kept in blob files, which the approximate
+  // sizes of key ranges do not account for.
+  bool UsesBlobFiles() const { return option_config_ == kBlobFiles; }
+
   DBImpl* dbfull() { return reinterpret_cast<DBImpl*>(db_); }
 
   void Reopen(Options* options = nullptr) {
@@ -420,6 +519,13 @@ class DBTest : public testing::Test {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeBlobIndex: {
+              std::string value;
+              Status s = dbfull()->GetBlob(ReadOptions(), iter->value(),
+                                           &value);
+              result += s.ok() ? value : s.ToString();
+              break;
+            }
           }
         }
         iter->Next();
@@ -542,6 +648,21 @@ class DBTest : public testing::Test {
     return false;
   }
 
+  // Returns the numbers of the blob files in the DB directory.
+  std::set<uint64_t> BlobFiles() {
+    std::vector<std::string> filenames;
+    EXPECT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+    uint64_t number;
+    FileType type;
+    std::set<uint64_t> result;
+    for (size_t i = 0; i < filenames.size(); i++) {
+      if (ParseFileName(filenames[i], &number, &type) && type == kBlobFile) {
+        result.insert(number);
+      }
+    }
+    return result;
+  }
+
   // Returns number of files renamed.
   int RenameLDBToSST() {
     std::vector<std::string> filenames;
@@ -562,7 +683,20 @@ class DBTest : public testing::Test {
 
  private:
   // Sequence of option configurations to try
-  enum OptionConfig { kDefault, kReuse, kFilter, kUncompressed, kEnd };
+  enum OptionConfig {
+    kDefault,
+    kReuse,
+    kFilter,
+    kUncompressed,
+    kConcurrentMemTableWrite,
+    kPipelinedWrite,
+    kDataBlockHashIndex,
+    kDataBlockRestartPrefixes,
+    kXXH3Checksum,
+    kPlainTableFormat,
+    kBlobFiles,
+    kEnd
+  };
 
   const FilterPolicy* filter_policy_;
   int option_config_;
@@ -1079,6 +1213,199 @@ static std::string Key(int i) {
   return std::string(buf);
 }
 
+TEST_F(DBTest, MultiGet) {
+  do {
+    // Spread the keys over deeper levels, level-0 and the memtable.
+    const int kNumKeys = 300;
+    for (int i = 0; i < kNumKeys; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), "v1." + Key(i)));
+    }
+    dbfull()->CompactRange(nullptr, nullptr);
+    for (int i = 0; i < kNumKeys; i += 3) {
+      ASSERT_LEVELDB_OK(Put(Key(i), "v2." + Key(i)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    const Snapshot* snapshot = db_->GetSnapshot();
+    for (int i = 0; i < kNumKeys; i += 5) {
+      ASSERT_LEVELDB_OK(Delete(Key(i)));
+    }
+    for (int i = 0; i < kNumKeys; i += 7) {
+      ASSERT_LEVELDB_OK(Put(Key(i), "v3." + Key(i)));
+    }
+
+    // Unsorted keys, with duplicates and keys that were never written.
+    std::vector<std::string> key_strings;
+    Random rnd(301);
+    for (int i = 0; i < 2 * kNumKeys; i++) {
+      key_strings.push_back(Key(rnd.Uniform(kNumKeys + 20)));
+    }
+    std::vector<Slice> keys(key_strings.begin(), key_strings.end());
+
+    for (const Snapshot* s : {static_cast<const Snapshot*>(nullptr),
+                              snapshot}) {
+      ReadOptions options;
+      options.snapshot = s;
+      std::vector<std::string> values;
+      std::vector<Status> statuses;
+      db_->MultiGet(options, keys, &values, &statuses);
+      ASSERT_EQ(keys.size(), values.size());
+      ASSERT_EQ(keys.size(), statuses.size());
+      for (size_t i = 0; i < keys.size(); i++) {
+        std::string result;
+        if (statuses[i].IsNotFound()) {
+          result = "NOT_FOUND";
+        } else if (!statuses[i].ok()) {
+          result = statuses[i].ToString();
+        } else {
+          result = values[i];
+        }
+        ASSERT_EQ(Get(key_strings[i], s), result) << key_strings[i];
+      }
+    }
+    db_->ReleaseSnapshot(snapshot);
+  } while (ChangeOptions());
+}
+
+static std::string BlobValue(int i, char c) {
+  return Key(i) + std::string(2000, c);
+}
+
+TEST_F(DBTest, BlobFiles) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.min_blob_size = 1000;
+  DestroyAndReopen(&options);
+
+  const int kNumKeys = 100;
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), BlobValue(i, 'a')));
+    ASSERT_LEVELDB_OK(Put(Key(i) + "small", "v" + Key(i)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const std::set<uint64_t> first_blob_files = BlobFiles();
+  ASSERT_EQ(1, first_blob_files.size());
+
+  // Large values come back through Get(), iterators and MultiGet().
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(BlobValue(i, 'a'), Get(Key(i)));
+    ASSERT_EQ("v" + Key(i), Get(Key(i) + "small"));
+  }
+  std::string expected;
+  for (int i = 0; i < kNumKeys; i++) {
+    expected += "(" + Key(i) + "->" + BlobValue(i, 'a') + ")";
+    expected += "(" + Key(i) + "small->v" + Key(i) + ")";
+  }
+  ASSERT_EQ(expected, Contents());
+  std::vector<std::string> key_strings = {Key(3), Key(3) + "small", "none"};
+  std::vector<Slice> keys(key_strings.begin(), key_strings.end());
+  std::vector<std::string> values;
+  std::vector<Status> statuses;
+  db_->MultiGet(ReadOptions(), keys, &values, &statuses);
+  ASSERT_LEVELDB_OK(statuses[0]);
+  ASSERT_EQ(BlobValue(3, 'a'), values[0]);
+  ASSERT_LEVELDB_OK(statuses[1]);
+  ASSERT_EQ("v" + Key(3), values[1]);
+  ASSERT_TRUE(statuses[2].IsNotFound());
+
+  Reopen(&options);
+  ASSERT_EQ(first_blob_files, BlobFiles());
+  ASSERT_EQ(BlobValue(7, 'a'), Get(Key(7)));
+
+  // Overwriting every large value makes the first blob file garbage, so
+  // compactions delete it; a snapshot keeps it until released.
+  const Snapshot* snapshot = db_->GetSnapshot();
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), BlobValue(i, 'b')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(BlobValue(9, 'a'), Get(Key(9), snapshot));
+  ASSERT_EQ(1, BlobFiles().count(*first_blob_files.begin()));
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, BlobFiles().count(*first_blob_files.begin()));
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(BlobValue(i, 'b'), Get(Key(i)));
+  }
+
+  Reopen(&options);
+  ASSERT_EQ(BlobValue(11, 'b'), Get(Key(11)));
+}
+
+TEST_F(DBTest, BlobGarbageCollection) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.min_blob_size = 1000;
+  options.blob_garbage_collection_ratio = 0.5;
+  DestroyAndReopen(&options);
+
+  const int kNumKeys = 100;
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), BlobValue(i, 'a')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const std::set<uint64_t> first_blob_files = BlobFiles();
+  ASSERT_EQ(1, first_blob_files.size());
+
+  // Overwrite most values: the compactions that drop the old ones make
+  // the first blob file mostly garbage, and later compactions copy the
+  // values that are still live out of it.
+  for (int i = 0; i < kNumKeys; i++) {
+    if (i % 4 != 0) {
+      ASSERT_LEVELDB_OK(Put(Key(i), BlobValue(i, 'b')));
+    }
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->CompactRange(nullptr, nullptr);
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, BlobFiles().count(*first_blob_files.begin()));
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(BlobValue(i, i % 4 != 0 ? 'b' : 'a'), Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, BlobGarbageSurvivesRepair) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.min_blob_size = 1000;
+  options.blob_garbage_collection_ratio = 1.0;  // Only whole files go
+  DestroyAndReopen(&options);
+
+  const int kNumKeys = 100;
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), BlobValue(i, 'a')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const std::set<uint64_t> first_blob_files = BlobFiles();
+  ASSERT_EQ(1, first_blob_files.size());
+
+  // Most records of the first blob file become garbage before the repair
+  for (int i = 0; i < kNumKeys; i++) {
+    if (i % 4 != 0) {
+      ASSERT_LEVELDB_OK(Put(Key(i), BlobValue(i, 'b')));
+    }
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->CompactRange(nullptr, nullptr);
+  Close();
+  ASSERT_LEVELDB_OK(RepairDB(dbname_, options));
+  Reopen(&options);
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(BlobValue(i, i % 4 != 0 ? 'b' : 'a'), Get(Key(i)));
+  }
+
+  // and the rest after it, which must still free the file
+  for (int i = 0; i < kNumKeys; i += 4) {
+    ASSERT_LEVELDB_OK(Put(Key(i), BlobValue(i, 'c')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, BlobFiles().count(*first_blob_files.begin()));
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(BlobValue(i, i % 4 != 0 ? 'b' : 'c'), Get(Key(i)));
+  }
+}
+
 TEST_F(DBTest, MinorCompactionsHappen) {
   Options options = CurrentOptions();
   options.write_buffer_size = 10000;
@@ -1225,6 +1552,7 @@ static bool Between(uint64_t val, uint64_t low, uint64_t high) {
 
 TEST_F(DBTest, ApproximateSizes) {
   do {
+    if (UsesBlobFiles()) continue;
     Options options = CurrentOptions();
     options.write_buffer_size = 100000000;  // Large write buffer
     options.compression = kNoCompression;
@@ -1284,6 +1612,7 @@ TEST_F(DBTest, ApproximateSizes) {
 
 TEST_F(DBTest, ApproximateSizes_MixOfSmallAndLarge) {
   do {
+    if (UsesBlobFiles()) continue;
     Options options = CurrentOptions();
     options.compression = kNoCompression;
     Reopen();
@@ -1393,7 +1722,9 @@ TEST_F(DBTest, HiddenValuesAreRemoved) {
     ASSERT_GT(NumTableFilesAtLevel(0), 0);
 
     ASSERT_EQ(big, Get("foo", snapshot));
-    ASSERT_TRUE(Between(Size("", "pastfoo"), 50000, 60000));
+    if (!UsesBlobFiles()) {
+      ASSERT_TRUE(Between(Size("", "pastfoo"), 50000, 60000));
+    }
     db_->ReleaseSnapshot(snapshot);
     ASSERT_EQ(AllEntriesFor("foo"), "[ tiny, " + big + " ]");
     Slice x("x");
@@ -1977,130 +2308,1037 @@ TEST_F(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
-TEST_F(DBTest, LogCloseError) {
-  // Regression test for bug where we could ignore log file
-  // Close() error when switching to a new log file.
-  const int kValueSize = 20000;
-  const int kWriteCount = 10;
-  const int kWriteBufferSize = (kValueSize * kWriteCount) / 2;
+TEST_F(DBTest, PrefixExtractor) {
+  std::unique_ptr<const SliceTransform> fixed(NewFixedPrefixTransform(3));
+  ASSERT_TRUE(fixed->InDomain("abc"));
+  ASSERT_EQ("abc", fixed->Transform("abcd").ToString());
+  ASSERT_FALSE(fixed->InDomain("ab"));
+  std::unique_ptr<const SliceTransform> delimited(
+      NewDelimitedPrefixTransform('/', 2));
+  ASSERT_EQ("t1/e2/", delimited->Transform("t1/e2/3").ToString());
+  ASSERT_EQ("t1/e2/", delimited->Transform("t1/e2/").ToString());
+  ASSERT_FALSE(delimited->InDomain("t1/e2"));
+  ASSERT_NE(std::string(fixed->Name()), delimited->Name());
 
+  env_->count_random_reads_ = true;
   Options options = CurrentOptions();
   options.env = env_;
-  options.write_buffer_size = kWriteBufferSize;  // Small write buffer
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10, /*use_full_filter=*/true);
+  options.prefix_extractor = delimited.get();
   Reopen(&options);
-  env_->log_file_close_.store(true, std::memory_order_release);
 
-  std::string value(kValueSize, 'x');
-  Status s;
-  for (int i = 0; i < kWriteCount && s.ok(); i++) {
-    s = Put(Key(i), value);
+  // Three overlapping tables with keys "t<i>/e<j>/<ts>", none of
+  // which has entity 5.
+  auto key = [](int t, int e, int ts) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "t%d/e%d/%d", t, e, ts);
+    return std::string(buf);
+  };
+  for (int ts = 0; ts < 3; ts++) {
+    for (int t = 0; t < 10; t++) {
+      for (int e = 0; e < 10; e++) {
+        if (e != 5) {
+          ASSERT_LEVELDB_OK(Put(key(t, e, ts), "v"));
+        }
+      }
+    }
+    dbfull()->TEST_CompactMemTable();
   }
-  ASSERT_TRUE(!s.ok()) << "succeeded even after log file Close failure";
-
-  // Future writes should also fail after an earlier error.
-  s = Put("hello", "world");
-  ASSERT_TRUE(!s.ok()) << "write succeeded after log file Close failure";
+  ASSERT_EQ(3, TotalTableFiles());
 
-  env_->log_file_close_.store(false, std::memory_order_release);
-}
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
 
-// Multi-threaded test:
-namespace {
+  ReadOptions read_options;
+  read_options.prefix_same_as_start = true;
+  Iterator* iter = db_->NewIterator(read_options);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    // Open every table
+  }
 
-static const int kNumThreads = 4;
-static const int kTestSeconds = 10;
-static const int kNumKeys = 1000;
+  // The iterator only yields keys with the prefix of the seek target.
+  iter->Seek("t3/e2/");
+  std::string result;
+  for (; iter->Valid(); iter->Next()) {
+    result += iter->key().ToString() + " ";
+  }
+  ASSERT_EQ("t3/e2/0 t3/e2/1 t3/e2/2 ", result);
+  iter->Seek("t3/e2/1");
+  ASSERT_TRUE(iter->Valid());
+  iter->Prev();
+  ASSERT_EQ("t3/e2/0", IterStatus(iter).substr(0, 7));
+  iter->Prev();
+  ASSERT_FALSE(iter->Valid());
 
-struct MTState {
-  DBTest* test;
-  std::atomic<bool> stop;
-  std::atomic<int> counter[kNumThreads];
-  std::atomic<bool> thread_done[kNumThreads];
-};
+  delete iter;
 
-struct MTThread {
-  MTState* state;
-  int id;
-};
+  // Seeks to missing prefixes read no table at all, while without the
+  // bound every table is searched.
+  env_->random_read_counter_.Reset();
+  for (int t = 0; t < 10; t++) {
+    iter = db_->NewIterator(read_options);
+    iter->Seek(key(t, 5, 0).substr(0, 6));
+    ASSERT_FALSE(iter->Valid());
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+  }
+  int reads = env_->random_read_counter_.Read();
+  std::fprintf(stderr, "10 missing prefixes => %d reads\n", reads);
+  ASSERT_EQ(0, reads);
+  env_->random_read_counter_.Reset();
+  for (int t = 0; t < 10; t++) {
+    iter = db_->NewIterator(ReadOptions());
+    iter->Seek(key(t, 5, 0).substr(0, 6));
+    ASSERT_EQ(key(t, 6, 0), iter->key().ToString());
+    delete iter;
+  }
+  ASSERT_GE(env_->random_read_counter_.Read(), 3 * 10);
 
-static void MTThreadBody(void* arg) {
-  MTThread* t = reinterpret_cast<MTThread*>(arg);
-  int id = t->id;
-  DB* db = t->state->test->db_;
-  int counter = 0;
-  std::fprintf(stderr, "... starting thread %d\n", id);
-  Random rnd(1000 + id);
-  std::string value;
-  char valbuf[1500];
-  while (!t->state->stop.load(std::memory_order_acquire)) {
-    t->state->counter[id].store(counter, std::memory_order_release);
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
 
-    int key = rnd.Uniform(kNumKeys);
-    char keybuf[20];
-    std::snprintf(keybuf, sizeof(keybuf), "%016d", key);
+TEST_F(DBTest, PrefixExtractorAcrossLevelFiles) {
+  std::unique_ptr<const SliceTransform> delimited(
+      NewDelimitedPrefixTransform('/', 2));
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10, /*use_full_filter=*/true);
+  options.prefix_extractor = delimited.get();
+  options.compression = kNoCompression;
+  Reopen(&options);
 
-    if (rnd.OneIn(2)) {
-      // Write values of the form <key, my id, counter>.
-      // We add some padding for force compactions.
-      std::snprintf(valbuf, sizeof(valbuf), "%d.%d.%-1000d", key, id,
-                    static_cast<int>(counter));
-      ASSERT_LEVELDB_OK(db->Put(WriteOptions(), Slice(keybuf), Slice(valbuf)));
-    } else {
-      // Read a value and verify that it matches the pattern written above.
-      Status s = db->Get(ReadOptions(), Slice(keybuf), &value);
-      if (s.IsNotFound()) {
-        // Key has not yet been written
-      } else {
-        // Check that the writer thread counter is >= the counter in the value
-        ASSERT_LEVELDB_OK(s);
-        int k, w, c;
-        ASSERT_EQ(3, sscanf(value.c_str(), "%d.%d.%d", &k, &w, &c)) << value;
-        ASSERT_EQ(k, key);
-        ASSERT_GE(w, 0);
-        ASSERT_LT(w, kNumThreads);
-        ASSERT_LE(c, t->state->counter[w].load(std::memory_order_acquire));
+  // Keys "t<i>/e<j>/<ts>" with no entity 5, written twice so that
+  // compactions split them into several files out of level-0
+  auto key = [](int t, int e, int ts) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "t%d/e%d/%02d", t, e, ts);
+    return std::string(buf);
+  };
+  for (int round = 0; round < 2; round++) {
+    for (int t = 0; t < 10; t++) {
+      for (int e = 0; e < 10; e++) {
+        for (int ts = 0; ts < 20; ts++) {
+          if (e != 5) {
+            ASSERT_LEVELDB_OK(Put(key(t, e, ts), std::string(4000, 'v')));
+          }
+        }
       }
     }
-    counter++;
+    dbfull()->TEST_CompactMemTable();
   }
-  t->state->thread_done[id].store(true, std::memory_order_release);
-  std::fprintf(stderr, "... stopping thread %d after %d ops\n", id, counter);
-}
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  ASSERT_GE(TotalTableFiles(), 3);
 
-}  // namespace
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
 
-TEST_F(DBTest, MultiThreaded) {
-  do {
-    // Initialize state
-    MTState mt;
-    mt.test = this;
-    mt.stop.store(false, std::memory_order_release);
-    for (int id = 0; id < kNumThreads; id++) {
-      mt.counter[id].store(false, std::memory_order_release);
-      mt.thread_done[id].store(false, std::memory_order_release);
+  // Prefixes that span files still come back whole
+  ReadOptions read_options;
+  read_options.prefix_same_as_start = true;
+  for (int t = 0; t < 10; t++) {
+    for (int e = 0; e < 10; e++) {
+      Iterator* iter = db_->NewIterator(read_options);
+      int count = 0;
+      for (iter->Seek(key(t, e, 0).substr(0, 6)); iter->Valid();
+           iter->Next()) {
+        ASSERT_EQ(key(t, e, count), iter->key().ToString());
+        count++;
+      }
+      ASSERT_LEVELDB_OK(iter->status());
+      delete iter;
+      ASSERT_EQ(e != 5 ? 20 : 0, count);
     }
+  }
 
-    // Start threads
-    MTThread thread[kNumThreads];
-    for (int id = 0; id < kNumThreads; id++) {
-      thread[id].state = &mt;
-      thread[id].id = id;
-      env_->StartThread(MTThreadBody, &thread[id]);
-    }
+  // A seek to a missing prefix stops at the file that would hold it,
+  // rather than reading the first block of the file after it
+  env_->random_read_counter_.Reset();
+  for (int t = 0; t < 10; t++) {
+    Iterator* iter = db_->NewIterator(read_options);
+    iter->Seek(key(t, 5, 0).substr(0, 6));
+    ASSERT_FALSE(iter->Valid());
+    ASSERT_LEVELDB_OK(iter->status());
+    delete iter;
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
 
-    // Let them run for a while
-    DelayMilliseconds(kTestSeconds * 1000);
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
 
-    // Stop the threads and wait for them to finish
-    mt.stop.store(true, std::memory_order_release);
-    for (int id = 0; id < kNumThreads; id++) {
-      while (!mt.thread_done[id].load(std::memory_order_acquire)) {
+TEST_F(DBTest, PersistentCache) {
+  env_->count_random_reads_ = true;
+  std::string cache_path;
+  ASSERT_LEVELDB_OK(Env::Default()->GetTestDirectory(&cache_path));
+  cache_path += "/db_test_persistent_cache";
+  std::vector<std::string> stale;
+  Env::Default()->GetChildren(cache_path, &stale);
+  for (const std::string& f : stale) {
+    Env::Default()->RemoveFile(cache_path + "/" + f);
+  }
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  // The cache's own files are not counted, since they bypass env_
+  ASSERT_LEVELDB_OK(NewFilePersistentCache(Env::Default(), cache_path,
+                                           16 << 20,
+                                           &options.persistent_cache));
+  Reopen(&options);
+
+  const int N = 1000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  // Each block is read from the table once
+  ASSERT_GT(env_->random_read_counter_.Read(), 0);
+  ASSERT_LT(env_->random_read_counter_.Read(), N);
+
+  // and is then in the persistent cache
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // and stays there across a restart.  Only the footer, which identifies
+  // the table, is read from the table when it is opened again.
+  Close();
+  delete options.persistent_cache;
+  ASSERT_LEVELDB_OK(NewFilePersistentCache(Env::Default(), cache_path,
+                                           16 << 20,
+                                           &options.persistent_cache));
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  ASSERT_EQ(1, env_->random_read_counter_.Read());
+
+  Close();
+  delete options.persistent_cache;
+  delete options.block_cache;
+}
+
+// A PersistentCache in memory that records the size of every insert.
+class RecordingPersistentCache : public PersistentCache {
+ public:
+  Status Insert(const Slice& key, const Slice& data) override {
+    insert_sizes.push_back(data.size());
+    entries_[key.ToString()] = data.ToString();
+    return Status::OK();
+  }
+  Status Lookup(const Slice& key, std::string* data) override {
+    auto it = entries_.find(key.ToString());
+    if (it == entries_.end()) {
+      return Status::NotFound(key);
+    }
+    *data = it->second;
+    return Status::OK();
+  }
+
+  std::vector<size_t> insert_sizes;
+
+ private:
+  std::map<std::string, std::string> entries_;
+};
+
+TEST_F(DBTest, PersistentCacheSkipsScansThatDoNotFillCache) {
+  RecordingPersistentCache cache;
+  Options options = CurrentOptions();
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.persistent_cache = &cache;
+  Reopen(&options);
+
+  const int N = 2000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(100, 'v')));
+  }
+  dbfull()->TEST_CompactMemTable();
+  const size_t opened = cache.insert_sizes.size();
+
+  // Compactions and bulk scans leave the cache alone
+  ReadOptions read_options;
+  read_options.fill_cache = false;
+  Iterator* iter = db_->NewIterator(read_options);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) count++;
+  ASSERT_EQ(N, count);
+  delete iter;
+  ASSERT_EQ(opened, cache.insert_sizes.size());
+
+  // Other scans add the blocks they read, but never whole readahead
+  // windows
+  read_options.fill_cache = true;
+  iter = db_->NewIterator(read_options);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+  }
+  delete iter;
+  ASSERT_GT(cache.insert_sizes.size(), opened + 10);
+  for (size_t size : cache.insert_sizes) {
+    ASSERT_LT(size, 2 * options.block_size);
+  }
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST_F(DBTest, CompressedBlockCache) {
+  std::string compressed;
+  if (!port::Zstd_Compress(1, "aaaaaaaaaaaaaaaa", 16, &compressed)) {
+    GTEST_SKIP() << "zstd compression is not supported";
+  }
+  env_->count_random_reads_ = true;
+  env_->copy_random_reads_ = true;  // Memory-mapped blocks are not cached
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.compression = kZstdCompression;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.block_cache_compressed = NewLRUCache(1 << 20);
+  Reopen(&options);
+
+  const int N = 1000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  ASSERT_GT(env_->random_read_counter_.Read(), 0);
+  ASSERT_LT(env_->random_read_counter_.Read(), N);
+
+  // The cache holds the blocks compressed, in less memory than the keys
+  // and values they contain
+  const size_t charge = options.block_cache_compressed->TotalCharge();
+  ASSERT_GT(charge, 0);
+  ASSERT_LT(charge, N * 2 * Key(0).size());
+
+  // and every block is now served from it
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // Uncompressed blocks are not added
+  Close();
+  delete options.block_cache_compressed;
+  options.block_cache_compressed = NewLRUCache(1 << 20);
+  options.compression = kNoCompression;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  ASSERT_EQ(0, options.block_cache_compressed->TotalCharge());
+
+  Close();
+  delete options.block_cache_compressed;
+  delete options.block_cache;
+}
+
+TEST_F(DBTest, CompressionPerLevel) {
+  std::string compressed;
+  if (!port::Lz4_Compress("aaaaaaaaaaaaaaaa", 16, &compressed)) {
+    GTEST_SKIP() << "lz4 compression is not supported";
+  }
+  Options options = CurrentOptions();
+  options.compression_per_level = {kNoCompression, kNoCompression,
+                                   kNoCompression, kLZ4Compression};
+  Reopen(&options);
+
+  const int N = 1000;
+  Random rnd(301);
+  std::vector<std::string> values(N);
+  for (int i = 0; i < N; i++) {
+    test::CompressibleString(&rnd, 0.25, 1000, &values[i]);
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  const uint64_t uncompressed_size = Size(Key(0), Key(N));
+  ASSERT_GE(uncompressed_size, N * 1000);
+
+  // Level 3 is compressed
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("0,0,0,1", FilesPerLevel());
+  ASSERT_LT(Size(Key(0), Key(N)), uncompressed_size / 2);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+
+  if (port::Zstd_Compress(1, "aaaaaaaaaaaaaaaa", 16, &compressed)) {
+    // As is the bottommost level, with zstd instead
+    options.bottommost_zstd_compression_level = 19;
+    Reopen(&options);
+    for (int i = 0; i < N; i += 2) {
+      ASSERT_LEVELDB_OK(Put(Key(i), values[N - 1 - i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("0,0,1,1", FilesPerLevel());
+    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+    ASSERT_EQ("0,0,0,1", FilesPerLevel());
+    ASSERT_LT(Size(Key(0), Key(N)), uncompressed_size / 2);
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ(i % 2 == 0 ? values[N - 1 - i] : values[i], Get(Key(i)));
+    }
+  }
+}
+
+TEST_F(DBTest, ZstdDictionary) {
+  std::string compressed;
+  if (!port::Zstd_Compress(1, "aaaaaaaaaaaaaaaa", 16, &compressed)) {
+    GTEST_SKIP() << "zstd compression is not supported";
+  }
+  // Small values that only compress well together
+  const int N = 4000;
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < N; i++) {
+    char buf[200];
+    std::snprintf(buf, sizeof(buf),
+                  "{\"id\":%d,\"name\":\"user%u\",\"email\":\"user%u@"
+                  "example.com\",\"active\":%s,\"score\":%u}",
+                  i, rnd.Uniform(100000), rnd.Uniform(100000),
+                  rnd.OneIn(2) ? "true" : "false", rnd.Uniform(1000));
+    values.push_back(buf);
+  }
+
+  const FilterPolicy* filter_policy = NewBloomFilterPolicy(10);
+  uint64_t sizes[2];
+  for (int with_dictionary = 0; with_dictionary < 2; with_dictionary++) {
+    Options options = CurrentOptions();
+    options.compression = kZstdCompression;
+    options.block_size = 1024;
+    options.zstd_max_dictionary_size = with_dictionary ? 4096 : 0;
+    options.zstd_dictionary_training_bytes = 64 * 1024;
+    // Filter keys of buffered blocks are added once they are written
+    options.filter_policy = filter_policy;
+    options.create_if_missing = true;
+    DestroyAndReopen(&options);
+    for (int i = 0; i < N; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    sizes[with_dictionary] = Size(Key(0), Key(N));
+
+    // The dictionary is read back along with the table
+    Reopen(&options);
+    for (int i = 0; i < N; i++) {
+      ASSERT_EQ(values[i], Get(Key(i)));
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_EQ(values[count], iter->value().ToString());
+      count++;
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    ASSERT_EQ(N, count);
+    delete iter;
+  }
+  ASSERT_LT(sizes[1], sizes[0] * 85 / 100);
+
+  Close();
+  delete filter_policy;
+}
+
+TEST_F(DBTest, RowCache) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.row_cache = NewLRUCache(1 << 20);
+  Reopen(&options);
+
+  const int N = 1000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  // Keep an older version of one key in the same table as the newer one
+  ASSERT_LEVELDB_OK(Put("hot", "v1"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Put("hot", "v2"));
+  dbfull()->TEST_CompactMemTable();
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  ASSERT_EQ("v2", Get("hot"));
+  ASSERT_GT(options.row_cache->TotalCharge(), 0);
+
+  // Point lookups are now served from the row cache, at any snapshot
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  ASSERT_EQ("v2", Get("hot"));
+  ASSERT_EQ("v1", Get("hot", snapshot));
+  ASSERT_EQ("NOT_FOUND", Get("cold"));
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // Newer writes are not hidden by the cached rows
+  ASSERT_LEVELDB_OK(Put("hot", "v3"));
+  ASSERT_LEVELDB_OK(Delete(Key(0)));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("v3", Get("hot"));
+  ASSERT_EQ("v1", Get("hot", snapshot));
+  ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+
+  db_->ReleaseSnapshot(snapshot);
+  Close();
+  delete options.row_cache;
+  delete options.block_cache;
+}
+
+TEST_F(DBTest, IteratorReadahead) {
+  env_->count_random_reads_ = true;
+  env_->copy_random_reads_ = true;  // Memory-mapped files are not read ahead
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.compression = kNoCompression;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  Reopen(&options);
+
+  const int N = 2000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(100, 'x')));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  auto scan = [&](const ReadOptions& read_options) {
+    env_->random_read_counter_.Reset();
+    Iterator* iter = db_->NewIterator(read_options);
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    EXPECT_LEVELDB_OK(iter->status());
+    delete iter;
+    EXPECT_EQ(N, count);
+    return env_->random_read_counter_.Read();
+  };
+
+  // One read per block
+  ReadOptions read_options;
+  read_options.readahead_size = 0;
+  const int block_reads = scan(read_options);
+  ASSERT_GT(block_reads, 50);
+
+  // Reads grow while the scan stays sequential
+  read_options.readahead_size = 64 * 1024;
+  ASSERT_LT(scan(read_options), block_reads / 4);
+
+  // but the first read, even at the start of the file, is not read ahead
+  env_->random_read_bytes_counter_.Reset();
+  Iterator* iter = db_->NewIterator(read_options);
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  delete iter;
+  ASSERT_LT(env_->random_read_bytes_counter_.Read(), 2 * options.block_size);
+
+  // Bulk scans read ahead fully once they turn sequential
+  read_options.readahead_size = 1 << 20;
+  read_options.fill_cache = false;
+  ASSERT_LE(scan(read_options), 2);
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST_F(DBTest, FullFilter) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.index_partition_size = 1;  // Every index lookup reads the file
+  Reopen(&options);
+
+  // Tables with per-block filters, read with a full filter policy below
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+
+  const FilterPolicy* block_policy = options.filter_policy;
+  options.filter_policy = NewBloomFilterPolicy(10, true);
+  Reopen(&options);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+
+  // Rewrite the tables with full filters
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + ".new"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  Compact("a", "z");
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ((i % 100 == 0) ? Key(i) + ".new" : Key(i), Get(Key(i)));
+  }
+
+  // Missing keys are turned away before the index is searched
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  int reads = env_->random_read_counter_.Read();
+  std::fprintf(stderr, "%d missing => %d reads\n", N, reads);
+  ASSERT_LE(reads, 3 * N / 100);
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete block_policy;
+  delete options.filter_policy;
+}
+
+TEST_F(DBTest, CacheIndexAndFilterBlocks) {
+  env_->copy_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.block_cache = NewLRUCache(1 << 20);
+  options.cache_index_and_filter_blocks = true;
+  options.create_if_missing = true;
+
+  for (bool pin : {false, true}) {
+    options.pin_l0_filter_and_index_blocks_in_cache = pin;
+    DestroyAndReopen(&options);
+
+    // Each flush overlaps the previous one, so the last one stays in
+    // level 0.
+    for (int round = 0; round < 3; round++) {
+      for (int i = 0; i < 100; i++) {
+        ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + std::to_string(round)));
+      }
+      dbfull()->TEST_CompactMemTable();
+    }
+    ASSERT_EQ(1, NumTableFilesAtLevel(0));
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(Key(i) + "2", Get(Key(i)));
+    }
+    ASSERT_GT(options.block_cache->TotalCharge(), 0);
+
+    // Dropping every unused entry leaves only the pinned blocks behind
+    options.block_cache->Prune();
+    if (pin) {
+      ASSERT_GT(options.block_cache->TotalCharge(), 0);
+    } else {
+      ASSERT_EQ(0, options.block_cache->TotalCharge());
+    }
+
+    // Evicted index and filter blocks are read back in
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(Key(i) + "2", Get(Key(i)));
+      ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+    }
+  }
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST_F(DBTest, GetBlockCacheStats) {
+  env_->copy_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(1 << 20, 0.5, 2);
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(Key(i), Get(Key(i)));
+    }
+  }
+
+  std::vector<Cache::ShardStats> shards;
+  options.block_cache->GetShardStats(&shards);
+  ASSERT_EQ(4, shards.size());
+  uint64_t hits = 0, inserts = 0;
+  size_t usage = 0;
+  for (const Cache::ShardStats& st : shards) {
+    hits += st.hits;
+    inserts += st.inserts;
+    usage += st.usage;
+    ASSERT_EQ(0, st.pinned_usage);
+  }
+  ASSERT_GT(inserts, 0);
+  ASSERT_GT(hits, 100);
+  ASSERT_EQ(options.block_cache->TotalCharge(), usage);
+
+  // A header and one line per shard
+  std::string val;
+  ASSERT_TRUE(db_->GetProperty("leveldb.block-cache-stats", &val));
+  ASSERT_EQ(6, std::count(val.begin(), val.end(), '\n'));
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST(TableCacheTest, Sharded) {
+  // Sized in entries, as DBImpl sizes it for the default max_open_files
+  Options options;
+  TableCache table_cache(testing::TempDir() + "table_cache_test", options,
+                         990);
+  std::vector<Cache::ShardStats> shards;
+  table_cache.GetShardStats(&shards);
+  ASSERT_EQ(16, shards.size());
+}
+
+TEST_F(DBTest, PartitionedIndex) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.index_partition_size = 1;  // One index entry per partition
+  Reopen(&options);
+
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + ".new"));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ((i % 100 == 0) ? Key(i) + ".new" : Key(i), Get(Key(i)));
+  }
+
+  // A lookup reads one index partition from each of the two tables.  The
+  // filters, which must line up with data blocks that were shifted by the
+  // partitions written between them, keep the data blocks from being read.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  int reads = env_->random_read_counter_.Read();
+  std::fprintf(stderr, "%d missing => %d reads\n", N, reads);
+  ASSERT_LE(reads, 2 * N + 3 * N / 100);
+
+  // Iteration goes through the three-level iterator
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) count++;
+  ASSERT_EQ(N, count);
+  iter->Seek(Key(N / 2));
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(Key(N / 2), iter->key().ToString());
+  delete iter;
+
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  Close();
+  delete options.filter_policy;
+}
+
+TEST_F(DBTest, LogCloseError) {
+  // Regression test for bug where we could ignore log file
+  // Close() error when switching to a new log file.
+  const int kValueSize = 20000;
+  const int kWriteCount = 10;
+  const int kWriteBufferSize = (kValueSize * kWriteCount) / 2;
+
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = kWriteBufferSize;  // Small write buffer
+  Reopen(&options);
+  env_->log_file_close_.store(true, std::memory_order_release);
+
+  std::string value(kValueSize, 'x');
+  Status s;
+  for (int i = 0; i < kWriteCount && s.ok(); i++) {
+    s = Put(Key(i), value);
+  }
+  ASSERT_TRUE(!s.ok()) << "succeeded even after log file Close failure";
+
+  // Future writes should also fail after an earlier error.
+  s = Put("hello", "world");
+  ASSERT_TRUE(!s.ok()) << "write succeeded after log file Close failure";
+
+  env_->log_file_close_.store(false, std::memory_order_release);
+}
+
+// Multi-threaded test:
+namespace {
+
+static const int kNumThreads = 4;
+static const int kTestSeconds = 10;
+static const int kNumKeys = 1000;
+
+struct MTState {
+  DBTest* test;
+  std::atomic<bool> stop;
+  std::atomic<int> counter[kNumThreads];
+  std::atomic<bool> thread_done[kNumThreads];
+};
+
+struct MTThread {
+  MTState* state;
+  int id;
+};
+
+static void MTThreadBody(void* arg) {
+  MTThread* t = reinterpret_cast<MTThread*>(arg);
+  int id = t->id;
+  DB* db = t->state->test->db_;
+  int counter = 0;
+  std::fprintf(stderr, "... starting thread %d\n", id);
+  Random rnd(1000 + id);
+  std::string value;
+  char valbuf[1500];
+  while (!t->state->stop.load(std::memory_order_acquire)) {
+    t->state->counter[id].store(counter, std::memory_order_release);
+
+    int key = rnd.Uniform(kNumKeys);
+    char keybuf[20];
+    std::snprintf(keybuf, sizeof(keybuf), "%016d", key);
+
+    if (rnd.OneIn(2)) {
+      // Write values of the form <key, my id, counter>.
+      // We add some padding for force compactions.
+      std::snprintf(valbuf, sizeof(valbuf), "%d.%d.%-1000d", key, id,
+                    static_cast<int>(counter));
+      ASSERT_LEVELDB_OK(db->Put(WriteOptions(), Slice(keybuf), Slice(valbuf)));
+    } else {
+      // Read a value and verify that it matches the pattern written above.
+      Status s = db->Get(ReadOptions(), Slice(keybuf), &value);
+      if (s.IsNotFound()) {
+        // Key has not yet been written
+      } else {
+        // Check that the writer thread counter is >= the counter in the value
+        ASSERT_LEVELDB_OK(s);
+        int k, w, c;
+        ASSERT_EQ(3, sscanf(value.c_str(), "%d.%d.%d", &k, &w, &c)) << value;
+        ASSERT_EQ(k, key);
+        ASSERT_GE(w, 0);
+        ASSERT_LT(w, kNumThreads);
+        ASSERT_LE(c, t->state->counter[w].load(std::memory_order_acquire));
+      }
+    }
+    counter++;
+  }
+  t->state->thread_done[id].store(true, std::memory_order_release);
+  std::fprintf(stderr, "... stopping thread %d after %d ops\n", id, counter);
+}
+
+}  // namespace
+
+TEST_F(DBTest, MultiThreaded) {
+  do {
+    // Initialize state
+    MTState mt;
+    mt.test = this;
+    mt.stop.store(false, std::memory_order_release);
+    for (int id = 0; id < kNumThreads; id++) {
+      mt.counter[id].store(false, std::memory_order_release);
+      mt.thread_done[id].store(false, std::memory_order_release);
+    }
+
+    // Start threads
+    MTThread thread[kNumThreads];
+    for (int id = 0; id < kNumThreads; id++) {
+      thread[id].state = &mt;
+      thread[id].id = id;
+      env_->StartThread(MTThreadBody, &thread[id]);
+    }
+
+    // Let them run for a while
+    DelayMilliseconds(kTestSeconds * 1000);
+
+    // Stop the threads and wait for them to finish
+    mt.stop.store(true, std::memory_order_release);
+    for (int id = 0; id < kNumThreads; id++) {
+      while (!mt.thread_done[id].load(std::memory_order_acquire)) {
         DelayMilliseconds(100);
       }
     }
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, ParallelCompactions) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.max_background_compactions = 4;
+  options.compression = kNoCompression;
+  Reopen(&options);
+
+  // Overwrite a random key space several times so that level-0 keeps
+  // filling up while compactions at several levels are in progress.
+  const int kNumKeys = 20000;
+  std::vector<int> latest(kNumKeys, -1);
+  Random rnd(301);
+  for (int i = 0; i < 6 * kNumKeys; i++) {
+    const int k = rnd.Uniform(kNumKeys);
+    latest[k] = i;
+    ASSERT_LEVELDB_OK(Put(Key(k), Key(i) + std::string(100, 'v')));
+  }
+
+  for (int k = 0; k < kNumKeys; k++) {
+    if (latest[k] < 0) {
+      ASSERT_EQ("NOT_FOUND", Get(Key(k)));
+    } else {
+      ASSERT_EQ(Key(latest[k]) + std::string(100, 'v'), Get(Key(k)));
+    }
+  }
+
+  // The same contents must survive a full manual compaction and reopen.
+  dbfull()->CompactRange(nullptr, nullptr);
+  Reopen(&options);
+  int count = 0;
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+  ASSERT_EQ(count, std::count_if(latest.begin(), latest.end(),
+                                 [](int i) { return i >= 0; }));
+  ASSERT_GT(TotalTableFiles(), 1);
+}
+
+TEST_F(DBTest, FlushDuringCompaction) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+
+  // Two overlapping tables for a manual compaction to merge
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), std::string(100, 'a' + round)));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+
+  // Block the compaction while it reads its inputs
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  uint64_t number;
+  FileType type;
+  uint64_t last_table = 0;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type) && type == kTableFile) {
+      last_table = std::max(last_table, number);
+    }
+  }
+  env_->delay_table_reads_up_to_.store(last_table, std::memory_order_release);
+  std::atomic<bool> compacted(false);
+  struct CompactionThread {
+    DBImpl* db;
+    std::atomic<bool>* done;
+    static void Run(void* arg) {
+      CompactionThread* t = reinterpret_cast<CompactionThread*>(arg);
+      t->db->CompactRange(nullptr, nullptr);
+      t->done->store(true, std::memory_order_release);
+    }
+  } thread = {dbfull(), &compacted};
+  env_->StartThread(&CompactionThread::Run, &thread);
+  while (!env_->table_reads_delayed_.load(std::memory_order_acquire)) {
+    DelayMilliseconds(10);
+  }
+
+  // A memtable filled meanwhile is still flushed
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(100, 'c')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_FALSE(compacted.load(std::memory_order_acquire));
+
+  env_->delay_table_reads_up_to_.store(0, std::memory_order_release);
+  while (!compacted.load(std::memory_order_acquire)) {
+    DelayMilliseconds(10);
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(std::string(100, 'c'), Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, Subcompactions) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.max_subcompactions = 4;
+  options.compression = kNoCompression;
+  Reopen(&options);
+
+  // Several rounds of overwrites and deletions, so that the same user
+  // keys show up in many input files of the compactions below.
+  const int kNumKeys = 5000;
+  const Snapshot* snapshot = nullptr;
+  for (int round = 0; round < 4; round++) {
+    for (int k = 0; k < kNumKeys; k++) {
+      if (round == 3 && k % 3 == 0) {
+        ASSERT_LEVELDB_OK(Delete(Key(k)));
+      } else {
+        ASSERT_LEVELDB_OK(
+            Put(Key(k), Key(round) + std::string(100, 'a' + round)));
+      }
+    }
+    if (round == 1) {
+      snapshot = db_->GetSnapshot();
+    }
+  }
+
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  for (int k = 0; k < kNumKeys; k++) {
+    if (k % 3 == 0) {
+      ASSERT_EQ("NOT_FOUND", Get(Key(k)));
+    } else {
+      ASSERT_EQ(Key(3) + std::string(100, 'd'), Get(Key(k)));
+    }
+    ASSERT_EQ(Key(1) + std::string(100, 'b'), Get(Key(k), snapshot));
+  }
+  db_->ReleaseSnapshot(snapshot);
+
+  // Deleted keys are gone for good after another full compaction.
+  dbfull()->CompactRange(nullptr, nullptr);
+  Reopen(&options);
+  int count = 0;
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+  ASSERT_EQ(kNumKeys - (kNumKeys + 2) / 3, count);
+}
+
 namespace {
 typedef std::map<std::string, std::string> KVMap;
 }
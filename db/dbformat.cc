@@ -6,6 +6,7 @@
 
 #include <cstdio>
 #include <sstream>
+#include <vector>
 
 #include "port/port.h"
 #include "util/coding.h"
@@ -96,18 +97,60 @@ void InternalKeyComparator::FindShortSuccessor(std::string* key) const {
   }
 }
 
-const char* InternalFilterPolicy::Name() const { return user_policy_->Name(); }
+InternalFilterPolicy::InternalFilterPolicy(
+    const FilterPolicy* p, const SliceTransform* prefix_extractor)
+    : user_policy_(p), prefix_extractor_(prefix_extractor) {
+  if (p != nullptr) {
+    name_ = p->Name();
+    if (prefix_extractor != nullptr) {
+      name_.append("+");
+      name_.append(prefix_extractor->Name());
+    }
+  }
+}
+
+const char* InternalFilterPolicy::Name() const { return name_.c_str(); }
 
 void InternalFilterPolicy::CreateFilter(const Slice* keys, int n,
                                         std::string* dst) const {
   // We rely on the fact that the code in table.cc does not mind us
   // adjusting keys[].
+  // Versions of the same user key are adjacent, so suppress them; this
+  // matters most for full filters, which cover every key of a table.
   Slice* mkey = const_cast<Slice*>(keys);
+  int unique = 0;
   for (int i = 0; i < n; i++) {
-    mkey[i] = ExtractUserKey(keys[i]);
-    // TODO(sanjay): Suppress dups?
+    Slice user_key = ExtractUserKey(keys[i]);
+    if (unique == 0 || user_key != mkey[unique - 1]) {
+      mkey[unique++] = user_key;
+    }
+  }
+  if (prefix_extractor_ == nullptr) {
+    user_policy_->CreateFilter(keys, unique, dst);
+    return;
+  }
+
+  // Put each distinct prefix before the first key that has it, which
+  // keeps the keys in order.
+  std::vector<Slice> with_prefixes;
+  with_prefixes.reserve(2 * unique);
+  Slice last_prefix;
+  bool has_last_prefix = false;
+  for (int i = 0; i < unique; i++) {
+    if (prefix_extractor_->InDomain(mkey[i])) {
+      Slice prefix = prefix_extractor_->Transform(mkey[i]);
+      if (!has_last_prefix || prefix != last_prefix) {
+        if (prefix != mkey[i]) {
+          with_prefixes.push_back(prefix);
+        }
+        last_prefix = prefix;
+        has_last_prefix = true;
+      }
+    }
+    with_prefixes.push_back(mkey[i]);
   }
-  user_policy_->CreateFilter(keys, n, dst);
+  user_policy_->CreateFilter(with_prefixes.data(),
+                             static_cast<int>(with_prefixes.size()), dst);
 }
 
 bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const {
@@ -13,6 +13,7 @@
 #include "leveldb/db.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/slice.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table_builder.h"
 #include "util/coding.h"
 #include "util/logging.h"
@@ -51,14 +52,17 @@ class InternalKey;
 // Value types encoded as the last component of internal keys.
 // DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
 // data structures.
-enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1 };
+//
+// kTypeBlobIndex entries hold a BlobIndex (see db/blob_file.h) that
+// refers to their value in a blob file.  Only tables hold them.
+enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1, kTypeBlobIndex = 0x2 };
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
 // sequence number (since we sort sequence numbers in decreasing order
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeBlobIndex;
 
 typedef uint64_t SequenceNumber;
 
@@ -120,12 +124,18 @@ class InternalKeyComparator : public Comparator {
 class InternalFilterPolicy : public FilterPolicy {
  private:
   const FilterPolicy* const user_policy_;
+  const SliceTransform* const prefix_extractor_;
+  std::string name_;
 
  public:
-  explicit InternalFilterPolicy(const FilterPolicy* p) : user_policy_(p) {}
+  // If "prefix_extractor" is non-null, filters also hold the prefixes of
+  // the user keys, and are named after both the policy and the transform.
+  InternalFilterPolicy(const FilterPolicy* p,
+                       const SliceTransform* prefix_extractor);
   const char* Name() const override;
   void CreateFilter(const Slice* keys, int n, std::string* dst) const override;
   bool KeyMayMatch(const Slice& key, const Slice& filter) const override;
+  bool UseFullFilter() const override { return user_policy_->UseFullFilter(); }
 };
 
 // Modules in this directory should keep internal keys wrapped inside
@@ -177,7 +187,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
   result->sequence = num >> 8;
   result->type = static_cast<ValueType>(c);
   result->user_key = Slice(internal_key.data(), n - 8);
-  return (c <= static_cast<uint8_t>(kTypeValue));
+  return (c <= static_cast<uint8_t>(kTypeBlobIndex));
 }
 
 // A helper class useful for DBImpl::Get()
@@ -8,6 +8,8 @@
 #ifndef STORAGE_LEVELDB_DB_LOG_FORMAT_H_
 #define STORAGE_LEVELDB_DB_LOG_FORMAT_H_
 
+#include <cstdint>
+
 namespace leveldb {
 namespace log {
 
@@ -24,6 +26,12 @@ enum RecordType {
 };
 static const int kMaxRecordType = kLastType;
 
+// Records checksummed with kXXH3 have this bit set in their type byte.
+// Their checksum is the low 32 bits of the XXH3 of the payload, with the
+// type byte folded in by multiplying it with kRecordXXH3TypeMultiplier.
+static const int kRecordXXH3Flag = 0x80;
+static const uint32_t kRecordXXH3TypeMultiplier = 0x6b9083d9u;
+
 static const int kBlockSize = 32768;
 
 // Header is checksum (4 bytes), length (2 bytes), type (1 byte).
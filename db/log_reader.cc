@@ -9,6 +9,7 @@
 #include "leveldb/env.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/xxh3.h"
 
 namespace leveldb {
 namespace log {
@@ -217,7 +218,7 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     const char* header = buffer_.data();
     const uint32_t a = static_cast<uint32_t>(header[4]) & 0xff;
     const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
-    const unsigned int type = header[6];
+    const unsigned int type = static_cast<unsigned char>(header[6]);
     const uint32_t length = a | (b << 8);
     if (kHeaderSize + length > buffer_.size()) {
       size_t drop_size = buffer_.size();
@@ -242,9 +243,17 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
 
     // Check crc
     if (checksum_) {
-      uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
-      uint32_t actual_crc = crc32c::Value(header + 6, 1 + length);
-      if (actual_crc != expected_crc) {
+      bool matches;
+      if (type & kRecordXXH3Flag) {
+        matches = DecodeFixed32(header) ==
+                  (static_cast<uint32_t>(
+                       xxh3::Value(header + kHeaderSize, length)) ^
+                   (type * kRecordXXH3TypeMultiplier));
+      } else {
+        matches = crc32c::Unmask(DecodeFixed32(header)) ==
+                  crc32c::Value(header + 6, 1 + length);
+      }
+      if (!matches) {
         // Drop the rest of the buffer since "length" itself may have
         // been corrupted and if we trust it, we could find some
         // fragment of a real log record that just happens to look
@@ -266,7 +275,7 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     }
 
     *result = Slice(header + kHeaderSize, length);
-    return type;
+    return type & ~kRecordXXH3Flag;
   }
 }
 
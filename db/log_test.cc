@@ -49,9 +49,9 @@ class LogTest : public testing::Test {
     delete reader_;
   }
 
-  void ReopenForAppend() {
+  void ReopenForAppend(ChecksumType checksum = kCRC32c) {
     delete writer_;
-    writer_ = new Writer(&dest_, dest_.contents_.size());
+    writer_ = new Writer(&dest_, dest_.contents_.size(), checksum);
   }
 
   void Write(const std::string& msg) {
@@ -79,6 +79,10 @@ class LogTest : public testing::Test {
     dest_.contents_[offset] += delta;
   }
 
+  unsigned char ByteAt(int offset) const {
+    return static_cast<unsigned char>(dest_.contents_[offset]);
+  }
+
   void SetByte(int offset, char new_byte) {
     dest_.contents_[offset] = new_byte;
   }
@@ -361,6 +365,40 @@ TEST_F(LogTest, RandomRead) {
   ASSERT_EQ("EOF", Read());
 }
 
+TEST_F(LogTest, XXH3ReadWrite) {
+  ReopenForAppend(kXXH3);
+  Write("foo");
+  Write(BigString("medium", 50000));
+  Write("");
+  Write(BigString("large", 100000));
+  // The type byte of XXH3 records is flagged
+  ASSERT_EQ(kFullType | kRecordXXH3Flag, ByteAt(6));
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ(BigString("medium", 50000), Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ(BigString("large", 100000), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, MixedChecksums) {
+  // A log reused by a DB whose checksum option changed holds both kinds
+  Write("crc1");
+  ReopenForAppend(kXXH3);
+  Write("xxh3");
+  Write(BigString("xxh3-large", 70000));
+  ReopenForAppend(kCRC32c);
+  Write(BigString("crc-large", 70000));
+  Write("crc2");
+  ASSERT_EQ("crc1", Read());
+  ASSERT_EQ("xxh3", Read());
+  ASSERT_EQ(BigString("xxh3-large", 70000), Read());
+  ASSERT_EQ(BigString("crc-large", 70000), Read());
+  ASSERT_EQ("crc2", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
 // Tests of all the error paths in log_reader.cc follow:
 
 TEST_F(LogTest, ReadError) {
@@ -417,6 +455,25 @@ TEST_F(LogTest, ChecksumMismatch) {
   ASSERT_EQ("OK", MatchError("checksum mismatch"));
 }
 
+TEST_F(LogTest, XXH3ChecksumMismatch) {
+  ReopenForAppend(kXXH3);
+  Write("foo");
+  IncrementByte(kHeaderSize, 1);
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(kHeaderSize + 3, DroppedBytes());
+  ASSERT_EQ("OK", MatchError("checksum mismatch"));
+}
+
+TEST_F(LogTest, XXH3FlagCleared) {
+  // An XXH3 record whose flag is lost must not verify as crc32c
+  ReopenForAppend(kXXH3);
+  Write("foo");
+  SetByte(6, kFullType);
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(kHeaderSize + 3, DroppedBytes());
+  ASSERT_EQ("OK", MatchError("checksum mismatch"));
+}
+
 TEST_F(LogTest, UnexpectedMiddleType) {
   Write("foo");
   SetByte(6, kMiddleType);
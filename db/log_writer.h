@@ -8,6 +8,7 @@
 #include <cstdint>
 
 #include "db/log_format.h"
+#include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
@@ -17,18 +18,20 @@ class WritableFile;
 
 namespace log {
 
-	/*ṩЧļ¼д*/
+	/*提供高效的记录写入机制*/
 class Writer {
  public:
   // Create a writer that will append data to "*dest".
   // "*dest" must be initially empty.
   // "*dest" must remain live while this Writer is in use.
-  explicit Writer(WritableFile* dest);
+  // Records are checksummed with "checksum".
+  explicit Writer(WritableFile* dest, ChecksumType checksum = kCRC32c);
 
   // Create a writer that will append data to "*dest".
   // "*dest" must have initial length "dest_length".
   // "*dest" must remain live while this Writer is in use.
-  Writer(WritableFile* dest, uint64_t dest_length);
+  Writer(WritableFile* dest, uint64_t dest_length,
+         ChecksumType checksum = kCRC32c);
 
   Writer(const Writer&) = delete;
   Writer& operator=(const Writer&) = delete;
@@ -38,15 +41,16 @@ class Writer {
   Status AddRecord(const Slice& slice);
 
  private:
-	 // ִݵд룬ʹ¼͡
+	 // 进行执行数据的物理写入，包括计算和处理记录类型。
   Status EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
 
-  WritableFile* dest_; // Ŀļָ룬дļ
-  int block_offset_;  // Current offset in blockеƫ
+  WritableFile* dest_; // 目标文件的指针，数据写入这个文件
+  int block_offset_;  // Current offset in block块中的偏移量
+  const ChecksumType checksum_;
 
   // crc32c values for all supported record types.  These are
   // pre-computed to reduce the overhead of computing the crc of the
-  // record type stored in the header.ԤCRC32ֵ
+  // record type stored in the header.预计算的CRC32值
   uint32_t type_crc_[kMaxRecordType + 1];
 };
 
@@ -12,7 +12,7 @@
 namespace leveldb {
 
 static Slice GetLengthPrefixedSlice(const char* data) {
-    // ȡǰ׺еĳȣȻƶָ
+    // 取出前缀中的长度，然后移动指针
   uint32_t len;
   const char* p = data;
   p = GetVarint32Ptr(p, p + 5, &len);  // +5: we assume "p" is not corrupted
@@ -37,7 +37,7 @@ int MemTable::KeyComparator::operator()(const char* aptr,
 // Encode a suitable internal key target for "target" and return it.
 // Uses *scratch as scratch space, and the returned pointer will point
 // into this scratch space.
-// stringṩ˸߲εڴֶڴĸԱǱڵĴ
+// string提供了更高层次的内存管理，避免了手动管理内存的复杂性被潜在的错误
 static const char* EncodeKey(std::string* scratch, const Slice& target) {
   scratch->clear();
   PutVarint32(scratch, target.size());
@@ -75,22 +75,25 @@ class MemTableIterator : public Iterator {
 
 Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
 
-void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
-                   const Slice& value) {
+// Number of bytes needed to encode an entry for key and value.
+static size_t EncodedEntryLength(const Slice& key, const Slice& value) {
+  size_t internal_key_size = key.size() + 8;
+  return VarintLength(internal_key_size) + internal_key_size +
+         VarintLength(value.size()) + value.size();
+}
+
+static void EncodeEntry(char* buf, SequenceNumber s, ValueType type,
+                        const Slice& key, const Slice& value) {
   // Format of an entry is concatenation of:
   //  key_size     : varint32 of internal_key.size()
   //  key bytes    : char[internal_key.size()]
   //  tag          : uint64((sequence << 8) | type)
   //  value_size   : varint32 of value.size()
   //  value bytes  : char[value.size()]
-    // keyķװ
+    // 按照key的封装规则增加数据
   size_t key_size = key.size();
   size_t val_size = value.size();
   size_t internal_key_size = key_size + 8;
-  const size_t encoded_len = VarintLength(internal_key_size) +
-                             internal_key_size + VarintLength(val_size) +
-                             val_size;
-  char* buf = arena_.Allocate(encoded_len);
 
   char* p = EncodeVarint32(buf, internal_key_size);
   std::memcpy(p, key.data(), key_size);
@@ -101,10 +104,23 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
 
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
-  assert(p + val_size == buf + encoded_len);
+  assert(p + val_size == buf + EncodedEntryLength(key, value));
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
+                   const Slice& value) {
+  char* buf = arena_.Allocate(EncodedEntryLength(key, value));
+  EncodeEntry(buf, s, type, key, value);
   table_.Insert(buf);
 }
 
+void MemTable::AddConcurrently(SequenceNumber s, ValueType type,
+                               const Slice& key, const Slice& value) {
+  char* buf = arena_.AllocateConcurrently(EncodedEntryLength(key, value));
+  EncodeEntry(buf, s, type, key, value);
+  table_.InsertConcurrently(buf);
+}
+
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
@@ -121,25 +137,31 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
     // all entries with overly large sequence numbers.
     const char* entry = iter.key();
     uint32_t key_length;
-    // ĳ
+    // 解析键的长度
     const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
     if (comparator_.comparator.user_comparator()->Compare(
-        // ƥuserkey
-        // ҵĿ
+        // 匹配userkey
+        // 找到条目
             Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
       // Correct user key
       const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
       switch (static_cast<ValueType>(tag & 0xff)) {
         case kTypeValue: {
-         // Чֵ
+         // 有效，插入值
           Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
           value->assign(v.data(), v.size());
           return true;
         }
-        // Чδҵ
+        // 无效，未找到
         case kTypeDeletion:
           *s = Status::NotFound(Slice());
           return true;
+        // Values move to blob files only when tables are built, so
+        // memtables never hold blob indexes
+        case kTypeBlobIndex:
+          assert(false);
+          *s = Status::Corruption("blob index in memtable");
+          return true;
       }
     }
   }
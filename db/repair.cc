@@ -24,6 +24,9 @@
 //   Store per-table metadata (smallest, largest, largest-seq#, ...)
 //   in the table's meta section to speed up ScanTable.
 
+#include <map>
+
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
@@ -48,7 +51,7 @@ class Repairer {
       : dbname_(dbname),
         env_(options.env),
         icmp_(options.comparator),
-        ipolicy_(options.filter_policy),
+        ipolicy_(options.filter_policy, options.prefix_extractor),
         options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, options)),
         owns_info_log_(options_.info_log != options.info_log),
         owns_cache_(options_.block_cache != options.block_cache),
@@ -68,16 +71,16 @@ class Repairer {
   }
 
   Status Run() {
-    /*ݿĿ¼еļ
-    * ļȡļź
-    * ļļmanifest
-    * ־ͱļ洢logstable_number
+    /*查找数据库目录中的文件
+    * 解析文件名，提取文件编号和类型
+    * 对于描述符文件，文件名存入manifest
+    * 对于日志和表文件，存储在logs和table_number中
     */
     Status status = FindFiles(); 
     if (status.ok()) {
-      ConvertLogFilesToTables(); // ־ļתɱļ
-      ExtractMetaData(); // ȡÿļԪ(key)ԼݿԪ(seq)
-      status = WriteDescriptor(); // һµmanifestļɨݿԪݽм¼
+      ConvertLogFilesToTables(); // 将日志文件转换成表文件
+      ExtractMetaData(); // 获取每个文件的元数据(key)以及最终数据库的元数据(seq)
+      status = WriteDescriptor(); // 创建一个新的manifest文件，将扫描的数据库元数据进行记录
     }
     if (status.ok()) {
       unsigned long long bytes = 0;
@@ -98,6 +101,8 @@ class Repairer {
   struct TableInfo {
     FileMetaData meta;
     SequenceNumber max_sequence;
+    // Bytes of records in each blob file that the table refers to
+    std::map<uint64_t, uint64_t> blob_bytes;
   };
 
   Status FindFiles() {
@@ -124,6 +129,8 @@ class Repairer {
             logs_.push_back(number);
           } else if (type == kTableFile) {
             table_numbers_.push_back(number);
+          } else if (type == kBlobFile) {
+            blob_numbers_.push_back(number);
           } else {
             // Ignore other files
           }
@@ -234,7 +241,7 @@ class Repairer {
     // on checksum verification.
     ReadOptions r;
     r.verify_checksums = options_.paranoid_checks;
-    return table_cache_->NewIterator(r, meta.number, meta.file_size);
+    return table_cache_->NewIterator(r, meta.number, meta.file_size, -1);
   }
 
   void ScanTable(uint64_t number) {
@@ -281,6 +288,12 @@ class Repairer {
       if (parsed.sequence > t.max_sequence) {
         t.max_sequence = parsed.sequence;
       }
+      if (parsed.type == kTypeBlobIndex) {
+        BlobIndex index;
+        if (index.DecodeFrom(iter->value()).ok()) {
+          t.blob_bytes[index.file_number] += index.RecordSize();
+        }
+      }
     }
     if (!iter->status().ok()) {
       status = iter->status();
@@ -377,6 +390,32 @@ class Repairer {
                     t.meta.largest);
     }
 
+    // The records of a blob file that no table refers to any more are
+    // garbage.  Files without live records are left out, and deleted as
+    // obsolete once the DB is opened.
+    std::map<uint64_t, uint64_t> live_blob_bytes;
+    for (const TableInfo& t : tables_) {
+      for (const auto& kvp : t.blob_bytes) {
+        live_blob_bytes[kvp.first] += kvp.second;
+      }
+    }
+    for (size_t i = 0; i < blob_numbers_.size(); i++) {
+      const uint64_t number = blob_numbers_[i];
+      uint64_t file_size;
+      if (!env_->GetFileSize(BlobFileName(dbname_, number), &file_size).ok() ||
+          file_size == 0) {
+        continue;
+      }
+      const uint64_t live = live_blob_bytes[number];
+      if (live == 0) {
+        continue;
+      }
+      edit_.AddBlobFile(number, file_size);
+      if (live < file_size) {
+        edit_.AddBlobGarbage(number, file_size - live);
+      }
+    }
+
     // std::fprintf(stderr,
     //              "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
     {
@@ -442,6 +481,7 @@ class Repairer {
 
   std::vector<std::string> manifests_;
   std::vector<uint64_t> table_numbers_;
+  std::vector<uint64_t> blob_numbers_;
   std::vector<uint64_t> logs_;
   std::vector<TableInfo> tables_;
   uint64_t next_file_number_;
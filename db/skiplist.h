@@ -8,7 +8,9 @@
 // Thread safety
 // -------------
 //
-// Writes require external synchronization, most likely a mutex.
+// Writes require external synchronization, most likely a mutex.  The
+// exception is InsertConcurrently(), which any number of threads may call
+// at once as long as no thread is calling Insert() at the same time.
 // Reads require a guarantee that the SkipList will not be destroyed
 // while the read is in progress.  Apart from that, reads progress
 // without any internal locking or synchronization.
@@ -30,6 +32,8 @@
 #include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <functional>
+#include <thread>
 
 #include "util/arena.h"
 #include "util/random.h"
@@ -45,18 +49,25 @@ class SkipList {
   // Create a new SkipList object that will use "cmp" for comparing keys,
   // and will allocate memory using "*arena".  Objects allocated in the arena
   // must remain allocated for the lifetime of the skiplist object.
-  // ձȽڴ
+  // 接收比较器和内存池
   explicit SkipList(Comparator cmp, Arena* arena);
 
-  // ֹ͹
+  // 禁止拷贝和构造
   SkipList(const SkipList&) = delete;
   SkipList& operator=(const SkipList&) = delete;
 
-  // Insert key into the list. 
+  // Insert key into the list. 插入
   // REQUIRES: nothing that compares equal to key is currently in the list.
   void Insert(const Key& key);
 
-  // 
+  // Like Insert(), but safe to call from several threads at once.  New
+  // nodes are linked in with compare-and-swap on the next pointers and
+  // allocated with Arena::AllocateAlignedConcurrently().
+  // REQUIRES: nothing that compares equal to key is in the list, or is
+  // being inserted by another thread.
+  void InsertConcurrently(const Key& key);
+
+  // 查找
   // Returns true iff an entry that compares equal to key is in the list.
   bool Contains(const Key& key) const;
 
@@ -106,8 +117,8 @@ class SkipList {
     return max_height_.load(std::memory_order_relaxed);
   }
 
-  Node* NewNode(const Key& key, int height);
-  int RandomHeight();
+  Node* NewNode(const Key& key, int height, bool concurrent);
+  int RandomHeight(Random* rnd);
   bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
   // Return true if key is greater than the data stored in "n"
@@ -120,6 +131,12 @@ class SkipList {
   // node at "level" for every level in [0..max_height_-1].
   Node* FindGreaterOrEqual(const Key& key, Node** prev) const;
 
+  // Starting from *prev, which must come before key, advance along
+  // "level" to the last node before key.  Stores that node in *prev and
+  // its successor at "level" in *next.
+  void FindSpliceForLevel(const Key& key, int level, Node** prev,
+                          Node** next) const;
+
   // Return the latest node with a key < key.
   // Return head_ if there is no such node.
   Node* FindLessThan(const Key& key) const;
@@ -132,10 +149,10 @@ class SkipList {
   Comparator const compare_;
   Arena* const arena_;  // Arena used for allocations of nodes
 
-  Node* const head_; // 
+  Node* const head_; // 链表
 
-  // Modified only by Insert().  Read racily by readers, but stale
-  // values are ok.
+  // Modified only by Insert() and InsertConcurrently().  Read racily by
+  // readers, but stale values are ok.
   std::atomic<int> max_height_;  // Height of the entire list
 
   // Read/written only by Insert().
@@ -151,7 +168,7 @@ struct SkipList<Key, Comparator>::Node {
 
   // Accessors/mutators for links.  Wrapped in methods so we can
   // add the appropriate barriers as necessary.
-  // һ
+  // 适用于数据一致性
   Node* Next(int n) {
     assert(n >= 0);
     // Use an 'acquire load' so that we observe a fully initialized
@@ -166,7 +183,7 @@ struct SkipList<Key, Comparator>::Node {
   }
 
   // No-barrier variants that can be safely used in a few locations.
-  // ֤˳򣬱Դ
+  // 不保证其它操作顺序，保护共享资源，适用于性能优先
   Node* NoBarrier_Next(int n) {
     assert(n >= 0);
     return next_[n].load(std::memory_order_relaxed);
@@ -176,17 +193,28 @@ struct SkipList<Key, Comparator>::Node {
     next_[n].store(x, std::memory_order_relaxed);
   }
 
+  // Replace the "n"th link with "x" if it still points to "expected".
+  // Like SetNext(), publishes the contents of "x" to readers.
+  bool CASNext(int n, Node* expected, Node* x) {
+    assert(n >= 0);
+    return next_[n].compare_exchange_strong(expected, x,
+                                            std::memory_order_release);
+  }
+
  private:
-     // ԭӴ洢һָ
+     // 原子存储下一个结点的指针
   // Array of length equal to the node height.  next_[0] is lowest level link.
   std::atomic<Node*> next_[1];
 };
 
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNode(
-    const Key& key, int height) {
-  char* const node_memory = arena_->AllocateAligned(
-      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
+    const Key& key, int height, bool concurrent) {
+  const size_t bytes =
+      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
+  char* const node_memory = concurrent
+                                ? arena_->AllocateAlignedConcurrently(bytes)
+                                : arena_->AllocateAligned(bytes);
   return new (node_memory) Node(key);
 }
 
@@ -243,16 +271,16 @@ inline void SkipList<Key, Comparator>::Iterator::SeekToLast() {
 }
 
 /*
-Ĳߣ
-Ӷ֤ƽڶ
-ͬʱЧؿڴʹ
+利用了随机性来调整跳表的层高，
+从而保证跳表的平均查找性能在对数级别，
+同时又能有效地控制内存使用
 */
 template <typename Key, class Comparator>
-int SkipList<Key, Comparator>::RandomHeight() {
+int SkipList<Key, Comparator>::RandomHeight(Random* rnd) {
   // Increase height with probability 1 in kBranching
   static const unsigned int kBranching = 4;
   int height = 1;
-  while (height < kMaxHeight && rnd_.OneIn(kBranching)) {
+  while (height < kMaxHeight && rnd->OneIn(kBranching)) {
     height++;
   }
   assert(height > 0);
@@ -289,6 +317,23 @@ SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key,
   }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::FindSpliceForLevel(const Key& key, int level,
+                                                   Node** prev,
+                                                   Node** next) const {
+  Node* x = *prev;
+  while (true) {
+    Node* after = x->Next(level);
+    if (KeyIsAfterNode(key, after)) {
+      x = after;
+    } else {
+      *prev = x;
+      *next = after;
+      return;
+    }
+  }
+}
+
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node*
 SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
@@ -334,7 +379,7 @@ template <typename Key, class Comparator>
 SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
     : compare_(cmp),
       arena_(arena),
-      head_(NewNode(0 /* any key will do */, kMaxHeight)),
+      head_(NewNode(0 /* any key will do */, kMaxHeight, false)),
       max_height_(1),
       rnd_(0xdeadbeef) {
   for (int i = 0; i < kMaxHeight; i++) {
@@ -352,7 +397,7 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
   // Our data structure does not allow duplicate insertion
   assert(x == nullptr || !Equal(key, x->key));
 
-  int height = RandomHeight();
+  int height = RandomHeight(&rnd_);
   if (height > GetMaxHeight()) {
     for (int i = GetMaxHeight(); i < height; i++) {
       prev[i] = head_;
@@ -367,7 +412,7 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
     max_height_.store(height, std::memory_order_relaxed);
   }
 
-  x = NewNode(key, height);
+  x = NewNode(key, height, false);
   for (int i = 0; i < height; i++) {
     // NoBarrier_SetNext() suffices since we will add a barrier when
     // we publish a pointer to "x" in prev[i].
@@ -376,6 +421,53 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
   }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertConcurrently(const Key& key) {
+  // rnd_ belongs to Insert(), so every inserting thread draws heights
+  // from its own generator.
+  static thread_local Random rnd(static_cast<uint32_t>(
+      std::hash<std::thread::id>()(std::this_thread::get_id())));
+  const int height = RandomHeight(&rnd);
+
+  // Raise max_height_ first, so that the search below covers every level
+  // the new node will be linked into.  As in Insert(), readers that see
+  // the new height before the node is linked just drop down a level.
+  int max_height = GetMaxHeight();
+  while (height > max_height &&
+         !max_height_.compare_exchange_weak(max_height, height,
+                                            std::memory_order_relaxed)) {
+  }
+  max_height = GetMaxHeight();
+
+  Node* prev[kMaxHeight];
+  Node* next[kMaxHeight];
+  Node* x = head_;
+  for (int i = max_height - 1; i >= 0; i--) {
+    prev[i] = x;
+    FindSpliceForLevel(key, i, &prev[i], &next[i]);
+    x = prev[i];
+  }
+
+  // Our data structure does not allow duplicate insertion
+  assert(next[0] == nullptr || !Equal(key, next[0]->key));
+
+  // Link the node in from the bottom up, so that a reader that reaches
+  // it at some level can always continue on the levels below.  If
+  // another thread linked a node between prev[i] and next[i] first, the
+  // CAS fails and we search again from prev[i], which still comes
+  // before key.
+  x = NewNode(key, height, true);
+  for (int i = 0; i < height; i++) {
+    while (true) {
+      x->NoBarrier_SetNext(i, next[i]);
+      if (prev[i]->CASNext(i, next[i], x)) {
+        break;
+      }
+      FindSpliceForLevel(key, i, &prev[i], &next[i]);
+    }
+  }
+}
+
 template <typename Key, class Comparator>
 bool SkipList<Key, Comparator>::Contains(const Key& key) const {
   Node* x = FindGreaterOrEqual(key, nullptr);
@@ -365,4 +365,60 @@ TEST(SkipTest, Concurrent3) { RunConcurrent(3); }
 TEST(SkipTest, Concurrent4) { RunConcurrent(4); }
 TEST(SkipTest, Concurrent5) { RunConcurrent(5); }
 
+// Several threads call InsertConcurrently() on disjoint keys at once.
+static const int kInsertThreads = 4;
+static const int kInsertsPerThread = 20000;
+
+struct InsertState {
+  SkipList<Key, Comparator>* list;
+  std::atomic<int> done;
+};
+
+struct InsertThread {
+  InsertState* state;
+  int id;
+};
+
+// Inserts every kInsertThreads-th key, starting at the thread's id.
+static void ConcurrentInserter(void* arg) {
+  InsertThread* t = reinterpret_cast<InsertThread*>(arg);
+  for (int i = 0; i < kInsertsPerThread; i++) {
+    t->state->list->InsertConcurrently(static_cast<Key>(i) * kInsertThreads +
+                                       t->id);
+  }
+  t->state->done.fetch_add(1, std::memory_order_release);
+}
+
+TEST(SkipTest, ConcurrentInsert) {
+  Arena arena;
+  Comparator cmp;
+  SkipList<Key, Comparator> list(cmp, &arena);
+  InsertState state;
+  state.list = &list;
+  state.done.store(0, std::memory_order_release);
+  InsertThread threads[kInsertThreads];
+  for (int i = 0; i < kInsertThreads; i++) {
+    threads[i].state = &state;
+    threads[i].id = i;
+    Env::Default()->StartThread(ConcurrentInserter, &threads[i]);
+  }
+  while (state.done.load(std::memory_order_acquire) < kInsertThreads) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+
+  // Every key is present, once, in order.
+  const Key total = kInsertThreads * kInsertsPerThread;
+  SkipList<Key, Comparator>::Iterator iter(&list);
+  iter.SeekToFirst();
+  for (Key k = 0; k < total; k++) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+  for (Key k = 0; k < total; k += 97) {
+    ASSERT_TRUE(list.Contains(k));
+  }
+}
+
 }  // namespace leveldb
@@ -4,16 +4,21 @@
 
 #include "db/table_cache.h"
 
+#include <cassert>
+
+#include "db/blob_file.h"
 #include "db/filename.h"
 #include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table.h"
 #include "util/coding.h"
 
 namespace leveldb {
 
 struct TableAndFile {
-  RandomAccessFile* file; // sstableĸʽ־û洢ϡ
-  Table* table; // Ϊһݽṹװsstableص߼ȡң
+  RandomAccessFile* file; // 将数据以sstable的格式持久化存储到磁盘上。
+  Table* table; // 作为一个数据结构，封装了与sstable相关的逻辑，比如读取，查找，迭代等
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
@@ -23,61 +28,197 @@ static void DeleteEntry(const Slice& key, void* value) {
   delete tf;
 }
 
+static void DeleteBlobFile(const Slice& key, void* value) {
+  delete reinterpret_cast<RandomAccessFile*>(value);
+}
+
+// Cache key of a blob file: its number, then a byte that table keys lack.
+static Slice BlobFileKey(uint64_t file_number, char* buf) {
+  EncodeFixed64(buf, file_number);
+  buf[8] = 'b';
+  return Slice(buf, 9);
+}
+
+static void DeleteRow(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+// Row cache entries hold every entry of a user key in one table, newest
+// first, as a sequence of length-prefixed internal keys and values.
+// Calls (*handle_result) for the first entry at or after internal key "k",
+// which is the entry a seek in the table would find.  When there is none,
+// the seek would land on another user key, which callers ignore.
+static void GetFromRow(const Comparator* icmp, const Slice& row,
+                       const Slice& k, void* arg,
+                       void (*handle_result)(void*, const Slice&,
+                                             const Slice&)) {
+  Slice input = row;
+  Slice ikey, value;
+  while (GetLengthPrefixedSlice(&input, &ikey) &&
+         GetLengthPrefixedSlice(&input, &value)) {
+    if (icmp->Compare(ikey, k) >= 0) {
+      (*handle_result)(arg, ikey, value);
+      return;
+    }
+  }
+}
+
+// Wraps the handle_result callback of TableCache::Get, to learn whether
+// the table holds the key that was looked up.
+struct RowSaver {
+  const Comparator* ucmp;
+  Slice user_key;
+  bool found;
+  void* arg;
+  void (*handle_result)(void*, const Slice&, const Slice&);
+};
+
+static void SaveRow(void* arg, const Slice& ikey, const Slice& v) {
+  RowSaver* saver = reinterpret_cast<RowSaver*>(arg);
+  saver->found = ikey.size() >= 8 &&
+                 saver->ucmp->Compare(ExtractUserKey(ikey),
+                                      saver->user_key) == 0;
+  (*saver->handle_result)(saver->arg, ikey, v);
+}
+
 static void UnrefEntry(void* arg1, void* arg2) {
   Cache* cache = reinterpret_cast<Cache*>(arg1);
   Cache::Handle* h = reinterpret_cast<Cache::Handle*>(arg2);
   cache->Release(h);
 }
 
+// The iterator of a table for ReadOptions::prefix_same_as_start.  A seek
+// to a key whose prefix the filter of the table rules out leaves it
+// invalid without reading any block of the table.
+class PrefixFilterIterator : public Iterator {
+ public:
+  PrefixFilterIterator(Iterator* iter, const Table* table,
+                       const SliceTransform* prefix_extractor)
+      : iter_(iter),
+        table_(table),
+        prefix_extractor_(prefix_extractor),
+        filtered_(false) {}
+
+  PrefixFilterIterator(const PrefixFilterIterator&) = delete;
+  PrefixFilterIterator& operator=(const PrefixFilterIterator&) = delete;
+
+  ~PrefixFilterIterator() override { delete iter_; }
+
+  bool Valid() const override { return !filtered_ && iter_->Valid(); }
+  void Seek(const Slice& target) override {
+    Slice user_key = ExtractUserKey(target);
+    if (prefix_extractor_->InDomain(user_key)) {
+      InternalKey prefix(prefix_extractor_->Transform(user_key),
+                         kMaxSequenceNumber, kValueTypeForSeek);
+      if (!table_->KeyMayMatch(prefix.Encode())) {
+        filtered_ = true;
+        return;
+      }
+    }
+    filtered_ = false;
+    iter_->Seek(target);
+  }
+  void SeekToFirst() override {
+    filtered_ = false;
+    iter_->SeekToFirst();
+  }
+  void SeekToLast() override {
+    filtered_ = false;
+    iter_->SeekToLast();
+  }
+  void Next() override {
+    assert(Valid());
+    iter_->Next();
+  }
+  void Prev() override {
+    assert(Valid());
+    iter_->Prev();
+  }
+  Slice key() const override {
+    assert(Valid());
+    return iter_->key();
+  }
+  Slice value() const override {
+    assert(Valid());
+    return iter_->value();
+  }
+  Status status() const override { return iter_->status(); }
+
+ private:
+  Iterator* const iter_;
+  const Table* const table_;
+  const SliceTransform* const prefix_extractor_;
+  bool filtered_;  // The last seek was ruled out by the filter
+};
+
+// Tables are charged one entry each, far below the capacity at which
+// NewLRUCache() would shard on its own, yet every table lookup of every
+// read goes through this cache.
+static const int kTableCacheNumShardBits = 4;
+
 TableCache::TableCache(const std::string& dbname, const Options& options,
                        int entries)
     : env_(options.env),
       dbname_(dbname),
       options_(options),
-      cache_(NewLRUCache(entries)) {}
+      cache_(NewLRUCache(entries, 0.0, kTableCacheNumShardBits)),
+      row_cache_id_(options.row_cache != nullptr ? options.row_cache->NewId()
+                                                 : 0) {}
 
 TableCache::~TableCache() { 
     delete cache_; 
 }
 
 /*
-* ʵ˲sstableĹ
-* вʧܣ
-* ᶯ̬ļͬʱ뻺
-* շ״̬
+* 实现了查找sstable的功能
+* 缓存中查找如果失败，
+* 会动态打开文件创建表对象，同时插入缓存
+* 最终返回状态
 */
 Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
-                             Cache::Handle** handle) {
-  // ʼ
+                             int level, Cache::Handle** handle) {
+  // 初始化
   Status s;
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
   Slice key(buf, sizeof(buf));
 
-  // 
+  // 查找
   *handle = cache_->Lookup(key);
-  if (*handle == nullptr) { // 黺ļв
-    std::string fname = TableFileName(dbname_, file_number); // ļ
-    RandomAccessFile* file = nullptr; // ʼָ
+  if (*handle == nullptr) { // 检查缓存结果，从文件中查找
+    std::string fname = TableFileName(dbname_, file_number); // 构造文件名
+    RandomAccessFile* file = nullptr; // 初始化指针
     Table* table = nullptr;
 
     s = env_->NewRandomAccessFile(fname, &file);
-    if (!s.ok()) { // ļʧܵĴ
+    if (!s.ok()) { // 打开文件失败的错误处理
       std::string old_fname = SSTTableFileName(dbname_, file_number);
       if (env_->NewRandomAccessFile(old_fname, &file).ok()) {
         s = Status::OK();
       }
     }
+    // Table::Open() adds a checksum of the footer, since file numbers
+    // repeat when a database is destroyed and created again
+    std::string persistent_cache_key_prefix;
+    if (options_.persistent_cache != nullptr) {
+      PutFixed64(&persistent_cache_key_prefix, file_number);
+      PutFixed64(&persistent_cache_key_prefix, file_size);
+    }
     if (s.ok()) {
-      s = Table::Open(options_, file, file_size, &table);
+      s = Table::Open(options_, file, file_size, persistent_cache_key_prefix,
+                      &table);
+    }
+    if (s.ok() && level == 0 &&
+        options_.pin_l0_filter_and_index_blocks_in_cache) {
+      table->PinMetaBlocks();
     }
 
-    if (!s.ok()) { // 
+    if (!s.ok()) { // 错误处理
       assert(table == nullptr);
       delete file;
       // We do not cache error results so that if the error is transient,
       // or somebody repairs the file, we recover automatically.
-    } else { // ¶뻺
+    } else { // 创建新对象插入缓存
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
       tf->table = table;
@@ -88,64 +229,188 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 }
 
 /*
-* һµĵָsstable
-* ͨһȡ
-* ɹעڴ棬ȷʱͷԴ
+* 创建一个新的迭代器，遍历指定的sstable
+* 通过查找缓存获取表对象
+* 创建成功后会注册清理操作管理内存，确保迭代器被销毁时释放资源。
 */
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number, uint64_t file_size,
-                                  Table** tableptr) {
+                                  int level, Table** tableptr) {
   if (tableptr != nullptr) {
     *tableptr = nullptr;
   }
-  // ָsstable
+  // 查找指定的sstable
   Cache::Handle* handle = nullptr;
-  Status s = FindTable(file_number, file_size, &handle);
+  Status s = FindTable(file_number, file_size, level, &handle);
   if (!s.ok()) {
     return NewErrorIterator(s);
   }
 
-  // ӻлȡtableandfileͨתȡڲtableָ
+  // 从缓存句柄中获取tableandfile对象，通过类型转换获取内部的table指针
   Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-  // ȡ
+  // 获取迭代器
   Iterator* result = table->NewIterator(options);
-  // עắ
+  // 清理注册函数
   result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  if (options.prefix_same_as_start && options_.prefix_extractor != nullptr &&
+      options_.filter_policy != nullptr) {
+    result = new PrefixFilterIterator(result, table, options_.prefix_extractor);
+  }
   if (tableptr != nullptr) {
     *tableptr = table;
   }
   return result;
 }
 
-/*ӻлȡֵָ*/
+/*从缓存中获取指定键的值*/
 /*
-* TableCache  Get ܹͬʱѯ㻺档
-* ȣҵһ㻺棨Ԫݣȡ SSTable Ϣ
-* ϢڣŻʹЩϢѯڶ㻺棨BlockCache
-* ȡʵʵݿ顣
+* TableCache 的 Get 方法能够同时查询这两层缓存。
+* 首先，它会查找第一层缓存（元数据），获取所需的 SSTable 信息。
+* 如果该信息存在，接着会使用这些信息查询第二层缓存（BlockCache），
+* 获取实际的数据块。
 */
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
-                       uint64_t file_size, const Slice& k, void* arg,
+                       uint64_t file_size, int level, const Slice& k,
+                       void* arg,
                        void (*handle_result)(void*, const Slice&,
                                              const Slice&)) {
+  std::string row_key;
+  if (options_.row_cache != nullptr) {
+    RowCacheKey(file_number, ExtractUserKey(k), &row_key);
+    Cache::Handle* row_handle = options_.row_cache->Lookup(row_key);
+    if (row_handle != nullptr) {
+      GetFromRow(options_.comparator,
+                 *reinterpret_cast<std::string*>(
+                     options_.row_cache->Value(row_handle)),
+                 k, arg, handle_result);
+      options_.row_cache->Release(row_handle);
+      return Status::OK();
+    }
+  }
+
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, level, &handle);
+  if (s.ok() && options_.row_cache != nullptr) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    RowSaver saver;
+    saver.ucmp =
+        static_cast<const InternalKeyComparator*>(options_.comparator)
+            ->user_comparator();
+    saver.user_key = ExtractUserKey(k);
+    saver.found = false;
+    saver.arg = arg;
+    saver.handle_result = handle_result;
+    s = t->InternalGet(options, k, &saver, &SaveRow);
+    if (s.ok() && saver.found && options.fill_cache) {
+      FillRowCache(options, t, row_key, saver.user_key);
+    }
+    cache_->Release(handle);
+  } else if (s.ok()) {
+    // 查找成功时，从缓存句柄中获取TableAndFile对象，通过类型转换获取内部的table指针
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    s = t->InternalGet(options, k, arg, handle_result); // 获取键值对，同时调用回调函数
+    cache_->Release(handle); // 释放缓存句柄，减少引用计数
+  }
+  return s;
+}
+
+Status TableCache::MultiGet(const ReadOptions& options, uint64_t file_number,
+                            uint64_t file_size, int level, int n,
+                            const Slice* keys,
+                            void* const* args,
+                            void (*handle_result)(void*, const Slice&,
+                                                  const Slice&)) {
   Cache::Handle* handle = nullptr;
-  Status s = FindTable(file_number, file_size, &handle);
+  Status s = FindTable(file_number, file_size, level, &handle);
   if (s.ok()) {
-    // ҳɹʱӻлȡTableAndFileͨתȡڲtableָ
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, handle_result); // ȡֵԣͬʱûص
-    cache_->Release(handle); // ͷŻü
+    s = t->InternalMultiGet(options, n, keys, args, handle_result);
+    cache_->Release(handle);
   }
   return s;
 }
 
-/*ָsstable*/
+void TableCache::RowCacheKey(uint64_t file_number, const Slice& user_key,
+                             std::string* key) const {
+  key->clear();
+  PutFixed64(key, row_cache_id_);
+  PutFixed64(key, file_number);
+  key->append(user_key.data(), user_key.size());
+}
+
+void TableCache::FillRowCache(const ReadOptions& options, Table* t,
+                              const Slice& row_key, const Slice& user_key) {
+  const Comparator* ucmp =
+      static_cast<const InternalKeyComparator*>(options_.comparator)
+          ->user_comparator();
+  // The entry just found is usually the only one, and its block is the
+  // one the iterator reads
+  std::string* row = new std::string;
+  Iterator* iter = t->NewIterator(options);
+  InternalKey start(user_key, kMaxSequenceNumber, kValueTypeForSeek);
+  for (iter->Seek(start.Encode());
+       iter->Valid() && iter->key().size() >= 8 &&
+       ucmp->Compare(ExtractUserKey(iter->key()), user_key) == 0;
+       iter->Next()) {
+    PutLengthPrefixedSlice(row, iter->key());
+    PutLengthPrefixedSlice(row, iter->value());
+  }
+  const bool ok = iter->status().ok();
+  delete iter;
+  if (!ok || row->empty()) {
+    delete row;
+    return;
+  }
+  options_.row_cache->Release(options_.row_cache->Insert(
+      row_key, row, row_key.size() + row->size(), &DeleteRow));
+}
+
+/*驱逐指定的sstable*/
 void TableCache::Evict(uint64_t file_number) {
-  // ַ飬Ϊļű
+  // 创建字符数组，为文件编号编码
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
-  // ӻɾ
+  // 从缓存中删除
   cache_->Erase(Slice(buf, sizeof(buf)));
 }
 
+Status TableCache::FindBlobFile(uint64_t file_number,
+                                Cache::Handle** handle) {
+  char buf[9];
+  Slice key = BlobFileKey(file_number, buf);
+  *handle = cache_->Lookup(key);
+  if (*handle != nullptr) {
+    return Status::OK();
+  }
+  RandomAccessFile* file = nullptr;
+  Status s = env_->NewRandomAccessFile(BlobFileName(dbname_, file_number),
+                                       &file);
+  if (s.ok()) {
+    *handle = cache_->Insert(key, file, 1, &DeleteBlobFile);
+  }
+  return s;
+}
+
+Status TableCache::GetBlob(const ReadOptions& options,
+                           const Slice& blob_index, std::string* value) {
+  BlobIndex index;
+  Status s = index.DecodeFrom(blob_index);
+  Cache::Handle* handle = nullptr;
+  if (s.ok()) {
+    s = FindBlobFile(index.file_number, &handle);
+  }
+  if (s.ok()) {
+    RandomAccessFile* file =
+        reinterpret_cast<RandomAccessFile*>(cache_->Value(handle));
+    s = ReadBlob(file, index, options.verify_checksums, value);
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+void TableCache::EvictBlob(uint64_t file_number) {
+  char buf[9];
+  cache_->Erase(BlobFileKey(file_number, buf));
+}
+
 }  // namespace leveldb
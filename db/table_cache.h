@@ -9,6 +9,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "leveldb/cache.h"
@@ -21,46 +22,87 @@ class Env;
 
 class TableCache {
  public:
-  // dbnameѡĿ
+  // dbname，配置选项，最大条目
   TableCache(const std::string& dbname, const Options& options, int entries);
 
-  // ദͳһԴɵڴ
+  // 避免多处引用统一资源造成的内存管理问题
   TableCache(const TableCache&) = delete;
   TableCache& operator=(const TableCache&) = delete;
 
-  // 
+  // 析构函数
   ~TableCache();
 
   // Return an iterator for the specified file number (the corresponding
-  // file length must be exactly "file_size" bytes).  If "tableptr" is
+  // file length must be exactly "file_size" bytes).  "level" is the level
+  // of the file in the current version, or -1 if it is not known; the
+  // index and filter blocks of level-0 files may be pinned in the block
+  // cache (see Options::pin_l0_filter_and_index_blocks_in_cache).
+  // If "tableptr" is
   // non-null, also sets "*tableptr" to point to the Table object
   // underlying the returned iterator, or to nullptr if no Table object
   // underlies the returned iterator.  The returned "*tableptr" object is owned
   // by the cache and should not be deleted, and is valid for as long as the
   // returned iterator is live.
-  // ΪָļŴһ
+  // 为指定的文件号创建一个迭代器
   Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
-                        uint64_t file_size, Table** tableptr = nullptr);
+                        uint64_t file_size, int level,
+                        Table** tableptr = nullptr);
 
   // If a seek to internal key "k" in specified file finds an entry,
-  // call (*handle_result)(arg, found_key, found_value).
-  // Ҽֵԣص
+  // call (*handle_result)(arg, found_key, found_value).  Goes through
+  // Options::row_cache if it is set.
+  // 查找键值对，回调函数
   Status Get(const ReadOptions& options, uint64_t file_number,
-             uint64_t file_size, const Slice& k, void* arg,
+             uint64_t file_size, int level, const Slice& k, void* arg,
              void (*handle_result)(void*, const Slice&, const Slice&));
 
-  // ָļŵĿ
+  // Like Get() for each of the n internal keys keys[0..n-1], which must
+  // be sorted.  Calls (*handle_result)(args[i], found_key, found_value)
+  // for the entry found for keys[i].  The table is looked up in the
+  // cache only once, and each data block is read only once.
+  Status MultiGet(const ReadOptions& options, uint64_t file_number,
+                  uint64_t file_size, int level, int n, const Slice* keys,
+                  void* const* args,
+                  void (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Stores in *value the value in a blob file that the encoded BlobIndex
+  // "blob_index" refers to.  *value may hold "blob_index".
+  Status GetBlob(const ReadOptions& options, const Slice& blob_index,
+                 std::string* value);
+
+  // 驱逐指定文件编号的条目
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
+  // Evict any entry for the specified blob file number
+  void EvictBlob(uint64_t file_number);
+
+  // Stores the counters of each shard of the cache of open files in *stats.
+  void GetShardStats(std::vector<Cache::ShardStats>* stats) const {
+    cache_->GetShardStats(stats);
+  }
+
  private:
-  // ͨfilenameҵsstableļfilesize֤߻Ĳңhandle**ڷҵĻ
-  Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  // 通过filename找到sstable文件，filesize可以用于验证或者缓存的查找，handle**用于返回找到的缓存项
+  Status FindTable(uint64_t file_number, uint64_t file_size, int level,
+                   Cache::Handle**);
+
+  // Blob files share the cache with tables, under keys of their own.
+  Status FindBlobFile(uint64_t file_number, Cache::Handle**);
+
+  // Stores in *key the row cache key of "user_key" in the file.
+  void RowCacheKey(uint64_t file_number, const Slice& user_key,
+                   std::string* key) const;
+
+  // Adds to the row cache the entries "t" holds for "user_key".
+  void FillRowCache(const ReadOptions& options, Table* t,
+                    const Slice& row_key, const Slice& user_key);
 
-  Env* const env_; // ָ򻷾ָ
-  const std::string dbname_; // 洢ݿƻ·
-  const Options& options_; // leveldbѡ
-  Cache* cache_; // ָ򻺴ָ
+  Env* const env_; // 指向环境对象的指针
+  const std::string dbname_; // 存储数据库的名称或路径
+  const Options& options_; // 对于leveldb的配置选项的引用
+  Cache* cache_; // 指向缓存对象的指针
+  const uint64_t row_cache_id_;  // Separates our rows from other DBs'
 };
 
 }  // namespace leveldb
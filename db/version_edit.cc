@@ -21,7 +21,9 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  kNewBlobFile = 10,
+  kBlobGarbage = 11
 };
 
 void VersionEdit::Clear() {
@@ -38,6 +40,8 @@ void VersionEdit::Clear() {
   compact_pointers_.clear();
   deleted_files_.clear();
   new_files_.clear();
+  new_blob_files_.clear();
+  blob_garbage_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -83,6 +87,18 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
   }
+
+  for (size_t i = 0; i < new_blob_files_.size(); i++) {
+    PutVarint32(dst, kNewBlobFile);
+    PutVarint64(dst, new_blob_files_[i].first);   // file number
+    PutVarint64(dst, new_blob_files_[i].second);  // total bytes
+  }
+
+  for (const auto& garbage_kvp : blob_garbage_) {
+    PutVarint32(dst, kBlobGarbage);
+    PutVarint64(dst, garbage_kvp.first);   // file number
+    PutVarint64(dst, garbage_kvp.second);  // garbage bytes
+  }
 }
 
 static bool GetInternalKey(Slice* input, InternalKey* dst) {
@@ -113,6 +129,7 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
   // Temporary storage for parsing
   int level;
   uint64_t number;
+  uint64_t bytes;
   FileMetaData f;
   Slice str;
   InternalKey key;
@@ -187,6 +204,22 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kNewBlobFile:
+        if (GetVarint64(&input, &number) && GetVarint64(&input, &bytes)) {
+          new_blob_files_.push_back(std::make_pair(number, bytes));
+        } else {
+          msg = "new-blob-file entry";
+        }
+        break;
+
+      case kBlobGarbage:
+        if (GetVarint64(&input, &number) && GetVarint64(&input, &bytes)) {
+          blob_garbage_[number] += bytes;
+        } else {
+          msg = "blob garbage";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -252,6 +285,18 @@ std::string VersionEdit::DebugString() const {
     r.append(" .. ");
     r.append(f.largest.DebugString());
   }
+  for (size_t i = 0; i < new_blob_files_.size(); i++) {
+    r.append("\n  AddBlobFile: ");
+    AppendNumberTo(&r, new_blob_files_[i].first);
+    r.append(" ");
+    AppendNumberTo(&r, new_blob_files_[i].second);
+  }
+  for (const auto& garbage_kvp : blob_garbage_) {
+    r.append("\n  BlobGarbage: ");
+    AppendNumberTo(&r, garbage_kvp.first);
+    r.append(" ");
+    AppendNumberTo(&r, garbage_kvp.second);
+  }
   r.append("\n}\n");
   return r;
 }
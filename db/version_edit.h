@@ -5,6 +5,7 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 #define STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 
+#include <map>
 #include <set>
 #include <utility>
 #include <vector>
@@ -15,25 +16,37 @@ namespace leveldb {
 
 class VersionSet;
 
-/*ļԪݣ洢ÿsstļԪ*/
+/*文件元数据，存储每个sst文件的元数据*/
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0), allowed_seeks(1 << 30), file_size(0), being_compacted(false) {}
 
-  int refs; // ü
-  int allowed_seeks;  // Seeks allowed until compaction ״seek compaction
-  uint64_t number; // ļΨһ
+  int refs; // 引用计数
+  int allowed_seeks;  // Seeks allowed until compaction 容易触发seek compaction
+  uint64_t number; // 文件的唯一编号
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table 
   InternalKey largest;   // Largest internal key served by table
+  bool being_compacted;  // Input of a compaction that is in progress
 };
 
-/*¼汾ı仯Ϣ*/
+// A blob file (see db/blob_file.h) and how many of its bytes belong to
+// values that no table refers to any more.
+struct BlobFileMetaData {
+  BlobFileMetaData() : number(0), total_bytes(0), garbage_bytes(0) {}
+
+  uint64_t number;
+  uint64_t total_bytes;
+  uint64_t garbage_bytes;
+};
+
+/*记录版本的变化信息*/
 class VersionEdit {
  public:
   VersionEdit() { Clear(); }
   ~VersionEdit() = default;
   void Clear();
-  // Ϣ
+  // 设置信息
   void SetComparatorName(const Slice& name) {
     has_comparator_ = true;
     comparator_ = name.ToString();
@@ -57,7 +70,7 @@ class VersionEdit {
   void SetCompactPointer(int level, const InternalKey& key) {
     compact_pointers_.push_back(std::make_pair(level, key));
   }
-  // ɾļ
+  // 添加删除文件
   // Add the specified file at the specified number.
   // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
   // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
@@ -74,7 +87,15 @@ class VersionEdit {
   void RemoveFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
   }
-  // 
+  // Add blob file "file", which holds "total_bytes" of records.
+  void AddBlobFile(uint64_t file, uint64_t total_bytes) {
+    new_blob_files_.push_back(std::make_pair(file, total_bytes));
+  }
+  // Record that "bytes" more bytes of blob file "file" are garbage.
+  void AddBlobGarbage(uint64_t file, uint64_t bytes) {
+    blob_garbage_[file] += bytes;
+  }
+  // 编码解码
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(const Slice& src);
 
@@ -85,20 +106,22 @@ class VersionEdit {
 
   typedef std::set<std::pair<int, uint64_t>> DeletedFileSet;
 
-  std::string comparator_; //Ƚ
-  uint64_t log_number_; // ־
+  std::string comparator_; //比较器名称
+  uint64_t log_number_; // 日志编号
   uint64_t prev_log_number_;
   uint64_t next_file_number_;
-  SequenceNumber last_sequence_; // һк
+  SequenceNumber last_sequence_; // 最后一个序列号
   bool has_comparator_;
   bool has_log_number_;
   bool has_prev_log_number_;
   bool has_next_file_number_;
   bool has_last_sequence_;
 
-  std::vector<std::pair<int, InternalKey>> compact_pointers_; // 洢ѹָ
-  DeletedFileSet deleted_files_; // ɾļڰ汾ʱ
-  std::vector<std::pair<int, FileMetaData>> new_files_; // 洢ӵļϢ
+  std::vector<std::pair<int, InternalKey>> compact_pointers_; // 存储压缩指针
+  DeletedFileSet deleted_files_; // 跟踪已删除的文件，便于版本更新时管理
+  std::vector<std::pair<int, FileMetaData>> new_files_; // 存储新添加的文件信息
+  std::vector<std::pair<uint64_t, uint64_t>> new_blob_files_;  // number, size
+  std::map<uint64_t, uint64_t> blob_garbage_;  // number -> garbage bytes
 };
 
 }  // namespace leveldb
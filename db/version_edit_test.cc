@@ -38,4 +38,25 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, EncodeDecodeBlobFiles) {
+  static const uint64_t kBig = 1ull << 50;
+
+  VersionEdit edit;
+  for (int i = 0; i < 4; i++) {
+    TestEncodeDecode(edit);
+    edit.AddBlobFile(kBig + 300 + i, kBig + 400 + i);
+    edit.AddBlobGarbage(kBig + 500 + i, 100 + i);
+  }
+  edit.AddBlobGarbage(kBig + 500, 7);
+  TestEncodeDecode(edit);
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_TRUE(parsed.DecodeFrom(encoded).ok());
+  ASSERT_NE(parsed.DebugString().find("BlobGarbage: " +
+                                      std::to_string(kBig + 500) + " 107"),
+            std::string::npos);
+}
+
 }  // namespace leveldb
@@ -13,6 +13,7 @@
 #include "db/memtable.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table_builder.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
@@ -160,23 +161,53 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
 // is the largest key that occurs in the file, and value() is an
 // 16-byte value containing the file number and file size, both
 // encoded using EncodeFixed64.
+//
+// If "prefix_extractor" is non-null (ReadOptions::prefix_same_as_start),
+// moving forward after a Seek() stops at the first file that starts
+// past the prefix of the seek target, rather than yielding files that
+// cannot hold a key with that prefix.
 class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
-                       const std::vector<FileMetaData*>* flist)
-      : icmp_(icmp), flist_(flist), index_(flist->size()) {  // Marks as invalid
+                       const std::vector<FileMetaData*>* flist,
+                       const SliceTransform* prefix_extractor)
+      : icmp_(icmp),
+        flist_(flist),
+        prefix_extractor_(prefix_extractor),
+        prefix_bounded_(false),
+        index_(flist->size()) {  // Marks as invalid
   }
   bool Valid() const override { return index_ < flist_->size(); }
   void Seek(const Slice& target) override {
     index_ = FindFile(icmp_, *flist_, target);
+    Slice user_key = ExtractUserKey(target);
+    prefix_bounded_ =
+        prefix_extractor_ != nullptr && prefix_extractor_->InDomain(user_key);
+    if (prefix_bounded_) {
+      Slice prefix = prefix_extractor_->Transform(user_key);
+      prefix_.assign(prefix.data(), prefix.size());
+    }
+  }
+  void SeekToFirst() override {
+    index_ = 0;
+    prefix_bounded_ = false;
   }
-  void SeekToFirst() override { index_ = 0; }
   void SeekToLast() override {
     index_ = flist_->empty() ? 0 : flist_->size() - 1;
+    prefix_bounded_ = false;
   }
   void Next() override {
     assert(Valid());
     index_++;
+    // Files past the seek target start after it, so one that does not
+    // start with its prefix starts past every key with that prefix
+    if (prefix_bounded_ && Valid()) {
+      Slice smallest = (*flist_)[index_]->smallest.user_key();
+      if (!prefix_extractor_->InDomain(smallest) ||
+          prefix_extractor_->Transform(smallest) != Slice(prefix_)) {
+        index_ = flist_->size();  // Marks as invalid
+      }
+    }
   }
   void Prev() override {
     assert(Valid());
@@ -201,6 +232,9 @@ class Version::LevelFileNumIterator : public Iterator {
  private:
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
+  const SliceTransform* const prefix_extractor_;
+  bool prefix_bounded_;  // By the prefix of the last Seek() target
+  std::string prefix_;
   uint32_t index_;
 
   // Backing store for value().  Holds the file number and size.
@@ -214,16 +248,20 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
     return NewErrorIterator(
         Status::Corruption("FileReader invoked with unexpected value"));
   } else {
+    // Only used for levels > 0, whose meta blocks are never pinned
     return cache->NewIterator(options, DecodeFixed64(file_value.data()),
-                              DecodeFixed64(file_value.data() + 8));
+                              DecodeFixed64(file_value.data() + 8), -1);
   }
 }
 
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
+  const SliceTransform* prefix_extractor =
+      options.prefix_same_as_start ? vset_->options_->prefix_extractor
+                                   : nullptr;
   return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-      vset_->table_cache_, options);
+      new LevelFileNumIterator(vset_->icmp_, &files_[level], prefix_extractor),
+      &GetFileIterator, vset_->table_cache_, options);
 }
 
 void Version::AddIterators(const ReadOptions& options,
@@ -231,7 +269,7 @@ void Version::AddIterators(const ReadOptions& options,
   // Merge all level zero files together since they may overlap
   for (size_t i = 0; i < files_[0].size(); i++) {
     iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
+        options, files_[0][i]->number, files_[0][i]->file_size, 0));
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
@@ -257,6 +295,7 @@ struct Saver {
   const Comparator* ucmp;
   Slice user_key;
   std::string* value;
+  bool blob_index;  // *value is the BlobIndex of the value
 };
 }  // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -266,9 +305,10 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+      s->state = (parsed_key.type == kTypeDeletion) ? kDeleted : kFound;
       if (s->state == kFound) {
         s->value->assign(v.data(), v.size());
+        s->blob_index = (parsed_key.type == kTypeBlobIndex);
       }
     }
   }
@@ -278,8 +318,8 @@ static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
 }
 
-/*汾еļûڲصļͨصЩļ
-ֲͨķʽȷļȵͬʱҲ©еصļ*/
+/*遍历版本中的文件，查找与给定的用户键和内部键重叠的文件，并通过回调函数处理这些文件。
+通过分层的方式，确保在最新文件优先的同时，也不遗漏其他层中的重叠文件。*/
 void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
                                  bool (*func)(void*, int, FileMetaData*)) {
   const Comparator* ucmp = vset_->icmp_.user_comparator();
@@ -323,7 +363,7 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
   }
 }
 
-/*Stateṹmatchڰ汾ϵļвָļסҹ̺ļͳϢ״̬*/
+/*利用State结构体和match函数在版本集合的文件中查找指定的键，记住查找过程和文件访问统计信息，并更新状态*/
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
                     std::string* value, GetStats* stats) {
   stats->seek_file = nullptr;
@@ -343,10 +383,10 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 
     static bool Match(void* arg, int level, FileMetaData* f) {
       State* state = reinterpret_cast<State*>(arg);
-      // ûҵļʱ¼ǰļͲ㼶
+      // 没有找到文件时，记录当前文件和层级
       if (state->stats->seek_file == nullptr &&
           state->last_file_read != nullptr) {
-        // ǷļѾʹ
+        // 检查是否有文件已经被访问过
         // We have had more than one seek for this read.  Charge the 1st file.
         state->stats->seek_file = state->last_file_read;
         state->stats->seek_file_level = state->last_file_read_level;
@@ -355,23 +395,27 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
       state->last_file_read = f;
       state->last_file_read_level = level;
 
-      // ʹtablecacheӻлȡ
-      state->s = state->vset->table_cache_->Get(*state->options, f->number,
-                                                f->file_size, state->ikey,
-                                                &state->saver, SaveValue);
+      // 使用tablecache从缓存中获取数据
+      state->s = state->vset->table_cache_->Get(
+          *state->options, f->number, f->file_size, level, state->ikey,
+          &state->saver, SaveValue);
       if (!state->s.ok()) {
         state->found = true;
         return false;
       }
       switch (state->saver.state) {
-        case kNotFound: // ļ
+        case kNotFound: // 继续找其它文件
           return true;  // Keep searching in other files
-        case kFound: // ҵ״̬
+        case kFound: // 找到键更新状态返回
           state->found = true;
+          if (state->saver.blob_index) {
+            state->s = state->vset->table_cache_->GetBlob(
+                *state->options, *state->saver.value, state->saver.value);
+          }
           return false;
-        case kDeleted: // أɾ
+        case kDeleted: // 返回，键已删除
           return false;
-        case kCorrupt: // ¼״̬
+        case kCorrupt: // 记录错误状态返回
           state->s =
               Status::Corruption("corrupted key for ", state->saver.user_key);
           state->found = true;
@@ -398,18 +442,154 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
   state.saver.ucmp = vset_->icmp_.user_comparator();
   state.saver.user_key = k.user_key();
   state.saver.value = value;
+  state.saver.blob_index = false;
 
   /* 
-     ˸lookupkeysstableͬʱmatchжǷҪҵinternalkey
-     seekͻmatchsstableûиkeyңҵkeyʱfalse
-     Match¼һseek missSSTableDBImpl::GetὫSSTableallowed_seeks1
-     MaybeScheduleCompactionǷҪSeek Compaction 
+     逐层遍历覆盖了给定的lookupkey的sstable，同时调用match判断是否有我们想要查找的internalkey，
+     即如果发生了seek就会调用match。如果sstable中没有该key，则会继续查找，当找到了key时返回false
+     Match还会记录第一次seek miss的SSTable。DBImpl::Get会将SSTable的allowed_seeks减1，
+     MaybeScheduleCompaction检查是否需要触发Seek Compaction。 
   */
   ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
   return state.found ? state.s : Status::NotFound(Slice());
 }
 
+void Version::MultiGet(const ReadOptions& options, GetRequest* requests, int n,
+                       GetStats* stats) {
+  stats->seek_file = nullptr;
+  stats->seek_file_level = -1;
+
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  std::vector<FileMetaData*> last_file_read(n, nullptr);
+  std::vector<int> last_file_read_level(n, -1);
+
+  // Looks up requests[batch[0..]] in "f" and marks the ones it resolves.
+  std::vector<int> batch;
+  std::vector<Slice> ikeys;
+  std::vector<Saver> savers;
+  std::vector<void*> args;
+  auto lookup = [&](int level, FileMetaData* f) {
+    ikeys.clear();
+    savers.resize(batch.size());
+    args.clear();
+    for (size_t i = 0; i < batch.size(); i++) {
+      const int r = batch[i];
+      if (stats->seek_file == nullptr && last_file_read[r] != nullptr) {
+        // We have had more than one seek for this read.  Charge the 1st file.
+        stats->seek_file = last_file_read[r];
+        stats->seek_file_level = last_file_read_level[r];
+      }
+      last_file_read[r] = f;
+      last_file_read_level[r] = level;
+
+      ikeys.push_back(requests[r].key->internal_key());
+      savers[i].state = kNotFound;
+      savers[i].ucmp = ucmp;
+      savers[i].user_key = requests[r].key->user_key();
+      savers[i].value = requests[r].value;
+      savers[i].blob_index = false;
+      args.push_back(&savers[i]);
+    }
+    Status s = vset_->table_cache_->MultiGet(
+        options, f->number, f->file_size, level,
+        static_cast<int>(batch.size()),
+        ikeys.data(), args.data(), SaveValue);
+    for (size_t i = 0; i < batch.size(); i++) {
+      GetRequest* req = &requests[batch[i]];
+      if (!s.ok()) {
+        *req->status = s;
+        req->done = true;
+        continue;
+      }
+      switch (savers[i].state) {
+        case kNotFound:
+          break;  // Keep searching in other files
+        case kFound:
+          *req->status = Status::OK();
+          if (savers[i].blob_index) {
+            *req->status =
+                vset_->table_cache_->GetBlob(options, *req->value, req->value);
+          }
+          req->done = true;
+          break;
+        case kDeleted:
+          *req->status = Status::NotFound(Slice());
+          req->done = true;
+          break;
+        case kCorrupt:
+          *req->status =
+              Status::Corruption("corrupted key for ", savers[i].user_key);
+          req->done = true;
+          break;
+      }
+    }
+  };
+
+  // Search level-0 in order from newest to oldest, each file with all of
+  // the requests in its range.
+  std::vector<FileMetaData*> tmp(files_[0]);
+  std::sort(tmp.begin(), tmp.end(), NewestFirst);
+  for (FileMetaData* f : tmp) {
+    batch.clear();
+    for (int r = 0; r < n; r++) {
+      const Slice user_key = requests[r].key->user_key();
+      if (!requests[r].done &&
+          ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+          ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+        batch.push_back(r);
+      }
+    }
+    if (!batch.empty()) {
+      lookup(0, f);
+    }
+  }
+
+  // Search other levels.  The requests are sorted, so the ones that fall
+  // into the same file are next to each other.
+  for (int level = 1; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = files_[level];
+    if (files.empty()) continue;
+
+    FileMetaData* f = nullptr;
+    batch.clear();
+    for (int r = 0; r < n; r++) {
+      if (requests[r].done) continue;
+      if (f == nullptr ||
+          vset_->icmp_.Compare(requests[r].key->internal_key(),
+                               f->largest.Encode()) > 0) {
+        // Moving on to the next file
+        if (!batch.empty()) {
+          lookup(level, f);
+          batch.clear();
+        }
+        uint32_t index =
+            FindFile(vset_->icmp_, files, requests[r].key->internal_key());
+        if (index == files.size()) {
+          break;  // All remaining requests are past the last file
+        }
+        f = files[index];
+      }
+      if (ucmp->Compare(requests[r].key->user_key(), f->smallest.user_key()) >=
+          0) {
+        batch.push_back(r);
+      } else {
+        // All of "f" is past any data for this user key
+      }
+    }
+    if (!batch.empty()) {
+      lookup(level, f);
+    }
+  }
+
+  for (int r = 0; r < n; r++) {
+    if (!requests[r].done) {
+      *requests[r].status = Status::NotFound(Slice());
+      requests[r].done = true;
+    }
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
   if (f != nullptr) {
@@ -478,26 +658,26 @@ bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
                                smallest_user_key, largest_user_key);
 }
 
-/*ȷmemtableӦôĸ㼶*/
+/*确立memtable输出的数据应该存放哪个层级*/
 int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                         const Slice& largest_user_key) {
   int level = 0;
-  // level0ǷmemtableļصûУ²
-  // ûص²Ϊȷ㼶֮䶼ûصٶmajorĵã
-  // صԸⰴ汾ĲͬݣͬһļĶû䣬ļֲ
-  // major֮صŻ㼶ṹ
+  // 看level0是否与memtable输出的键有重叠，如果没有，继续向下查找
+  // 没有重叠向下查找是为了确保多个层级之间都没有重叠，减少对于major的调用，提升性能
+  // 存在重叠的愿意按：多版本的不同数据，同一个文件的多个用户间，文件分布不均等
+  // major就是拿来处理层与层之间的重叠，进而定期优化清理层级结构。
   if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
     // Push to next level if there is no overlap in next level,
     // and the #bytes overlapping in the level after that are limited.
     InternalKey start(smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
     InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
     std::vector<FileMetaData*> overlaps;
-    // ѭֱﵽڴѹ㼶
+    // 循环遍历，直到达到最大内存压缩层级
     while (level < config::kMaxMemCompactLevel) {
       if (OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
-        break; // صʱֵ㼶˳
+        break; // 有重叠时保持当层级退出
       }
-      // صֵʱ׵⣬㼶
+      // 如下面两层的重叠字数超过最大值时，容易导致性能问题，层级不能上升
       if (level + 2 < config::kNumLevels) {
         // Check that file does not overlap too many grandparent bytes.
         GetOverlappingInputs(level + 2, &start, &limit, &overlaps);
@@ -610,10 +790,12 @@ class VersionSet::Builder {
   VersionSet* vset_;
   Version* base_;
   LevelState levels_[config::kNumLevels];
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
-  Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+  Builder(VersionSet* vset, Version* base)
+      : vset_(vset), base_(base), blob_files_(base->blob_files_) {
     base_->Ref();
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
@@ -684,6 +866,20 @@ class VersionSet::Builder {
       levels_[level].deleted_files.erase(f->number);
       levels_[level].added_files->insert(f);
     }
+
+    // Add new blob files, then account for garbage.  Garbage in files
+    // we do not know about (e.g. after a repair) is ignored.
+    for (size_t i = 0; i < edit->new_blob_files_.size(); i++) {
+      BlobFileMetaData& b = blob_files_[edit->new_blob_files_[i].first];
+      b.number = edit->new_blob_files_[i].first;
+      b.total_bytes = edit->new_blob_files_[i].second;
+    }
+    for (const auto& garbage_kvp : edit->blob_garbage_) {
+      auto it = blob_files_.find(garbage_kvp.first);
+      if (it != blob_files_.end()) {
+        it->second.garbage_bytes += garbage_kvp.second;
+      }
+    }
   }
 
   // Save the current state in *v.
@@ -730,6 +926,13 @@ class VersionSet::Builder {
       }
 #endif
     }
+
+    // Blob files with no live records left are dropped.
+    for (const auto& blob_kvp : blob_files_) {
+      if (blob_kvp.second.garbage_bytes < blob_kvp.second.total_bytes) {
+        v->blob_files_.insert(blob_kvp);
+      }
+    }
   }
 
   void MaybeAddFile(Version* v, int level, FileMetaData* f) {
@@ -823,11 +1026,11 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     // No reason to unlock *mu here since we only hit this path in the
     // first call to LogAndApply (when opening the database).
     assert(descriptor_file_ == nullptr);
-    // ־Ϊʱµļдļ
+    // 日志为空时，生成新的描述符文件名，创建可写文件
     new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
     s = env_->NewWritableFile(new_manifest_file, &descriptor_file_);
     if (s.ok()) {
-    // Ϊµ־д䣬ͬʱǰ汾д־
+    // 将其作为新的日志写入其，同时将当前版本快照写入日志
       descriptor_log_ = new log::Writer(descriptor_file_);
       s = WriteSnapshot(descriptor_log_);
     }
@@ -841,8 +1044,8 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     if (s.ok()) {
       std::string record;
       edit->EncodeTo(&record);
-      s = descriptor_log_->AddRecord(record); //ʹ descriptor_log_ ü¼ӵMANIFEST־С
-      if (s.ok()) { // ̣ͬȷд־û
+      s = descriptor_log_->AddRecord(record); //使用 descriptor_log_ 将该记录添加到MANIFEST日志中。
+      if (s.ok()) { // 同步到磁盘，确保写入持久化
         s = descriptor_file_->Sync();
       }
       if (!s.ok()) {
@@ -853,7 +1056,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     // If we just created a new descriptor file, install it by writing a
     // new CURRENT file that points to it.
     if (s.ok() && !new_manifest_file.empty()) {
-    // currentļָ´ļ
+    // 更新current文件，指向新创建的描述符文件
       s = SetCurrentFile(env_, dbname_, manifest_file_number_);
     }
 
@@ -1076,6 +1279,7 @@ void VersionSet::Finalize(Version* v) {
       score =
           static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
     }
+    v->level_score_[level] = score;
 
     if (score > best_score) {
       best_level = level;
@@ -1112,6 +1316,15 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     }
   }
 
+  // Save blob files
+  for (const auto& blob_kvp : current_->blob_files_) {
+    const BlobFileMetaData& b = blob_kvp.second;
+    edit.AddBlobFile(b.number, b.total_bytes);
+    if (b.garbage_bytes > 0) {
+      edit.AddBlobGarbage(b.number, b.garbage_bytes);
+    }
+  }
+
   std::string record;
   edit.EncodeTo(&record);
   return log->AddRecord(record);
@@ -1156,7 +1369,8 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
         // approximate offset of "ikey" within the table.
         Table* tableptr;
         Iterator* iter = table_cache_->NewIterator(
-            ReadOptions(), files[i]->number, files[i]->file_size, &tableptr);
+            ReadOptions(), files[i]->number, files[i]->file_size, level,
+            &tableptr);
         if (tableptr != nullptr) {
           result += tableptr->ApproximateOffsetOf(ikey.Encode());
         }
@@ -1179,6 +1393,25 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
   }
 }
 
+void VersionSet::AddLiveBlobFiles(std::set<uint64_t>* live) {
+  for (Version* v = dummy_versions_.next_; v != &dummy_versions_;
+       v = v->next_) {
+    for (const auto& blob_kvp : v->blob_files_) {
+      live->insert(blob_kvp.first);
+    }
+  }
+}
+
+void VersionSet::GetBlobFilesToCollect(std::set<uint64_t>* files) {
+  for (const auto& blob_kvp : current_->blob_files_) {
+    const BlobFileMetaData& b = blob_kvp.second;
+    if (b.garbage_bytes >=
+        options_->blob_garbage_collection_ratio * b.total_bytes) {
+      files->insert(b.number);
+    }
+  }
+}
+
 int64_t VersionSet::NumLevelBytes(int level) const {
   assert(level >= 0);
   assert(level < config::kNumLevels);
@@ -1241,6 +1474,7 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   ReadOptions options;
   options.verify_checksums = options_->paranoid_checks;
   options.fill_cache = false;
+  options.readahead_size = options_->compaction_readahead_size;
 
   // Level-0 files have to be merged together.  For other levels,
   // we will make a concatenating iterator per level.
@@ -1254,12 +1488,13 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
           list[num++] = table_cache_->NewIterator(options, files[i]->number,
-                                                  files[i]->file_size);
+                                                  files[i]->file_size, 0);
         }
       } else {
         // Create concatenating iterator for the files from this level
         list[num++] = NewTwoLevelIterator(
-            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
+            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which],
+                                              nullptr),
             &GetFileIterator, table_cache_, options);
       }
     }
@@ -1271,40 +1506,76 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
 }
 
 Compaction* VersionSet::PickCompaction() {
-  Compaction* c;
-  int level;
-
   // We prefer compactions triggered by too much data in a level over
-  // the compactions triggered by seeks.
-  const bool size_compaction = (current_->compaction_score_ >= 1);
-  const bool seek_compaction = (current_->file_to_compact_ != nullptr);
-  if (size_compaction) {
-    level = current_->compaction_level_;
-    assert(level >= 0);
-    assert(level + 1 < config::kNumLevels);
-    c = new Compaction(options_, level);
-
-    // Pick the first file that comes after compact_pointer_[level]
-    for (size_t i = 0; i < current_->files_[level].size(); i++) {
-      FileMetaData* f = current_->files_[level][i];
-      if (compact_pointer_[level].empty() ||
-          icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
-        c->inputs_[0].push_back(f);
-        break;
-      }
+  // the compactions triggered by seeks.  Levels are tried from the most
+  // to the least urgent one, so that other levels can make progress
+  // while the most urgent one is busy with compactions in progress.
+  int levels[config::kNumLevels - 1];
+  int num_levels = 0;
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    if (current_->level_score_[level] >= 1) {
+      levels[num_levels++] = level;
     }
-    if (c->inputs_[0].empty()) {
-      // Wrap-around to the beginning of the key space
-      c->inputs_[0].push_back(current_->files_[level][0]);
+  }
+  const Version* v = current_;
+  std::stable_sort(levels, levels + num_levels, [v](int a, int b) {
+    return v->level_score_[a] > v->level_score_[b];
+  });
+  for (int i = 0; i < num_levels; i++) {
+    Compaction* c = PickSizeCompaction(levels[i]);
+    if (c != nullptr) {
+      return c;
     }
-  } else if (seek_compaction) {
-    level = current_->file_to_compact_level_;
-    c = new Compaction(options_, level);
-    c->inputs_[0].push_back(current_->file_to_compact_);
-  } else {
+  }
+
+  FileMetaData* f = current_->file_to_compact_;
+  if (f != nullptr && !f->being_compacted) {
+    Compaction* c = new Compaction(options_, current_->file_to_compact_level_);
+    c->inputs_[0].push_back(f);
+    return FinishPickCompaction(c);
+  }
+  return nullptr;
+}
+
+Compaction* VersionSet::PickSizeCompaction(int level) {
+  assert(level >= 0);
+  assert(level + 1 < config::kNumLevels);
+  const std::vector<FileMetaData*>& files = current_->files_[level];
+  if (files.empty()) {
     return nullptr;
   }
 
+  // Pick the first file that comes after compact_pointer_[level],
+  // wrapping around to the beginning of the key space.  Files that
+  // would clash with a compaction in progress are skipped.
+  size_t start = 0;
+  if (!compact_pointer_[level].empty()) {
+    while (start < files.size() &&
+           icmp_.Compare(files[start]->largest.Encode(),
+                         compact_pointer_[level]) <= 0) {
+      start++;
+    }
+    if (start == files.size()) {
+      start = 0;
+    }
+  }
+  for (size_t i = 0; i < files.size(); i++) {
+    FileMetaData* f = files[(start + i) % files.size()];
+    if (f->being_compacted) {
+      continue;
+    }
+    Compaction* c = new Compaction(options_, level);
+    c->inputs_[0].push_back(f);
+    c = FinishPickCompaction(c);
+    if (c != nullptr) {
+      return c;
+    }
+  }
+  return nullptr;
+}
+
+Compaction* VersionSet::FinishPickCompaction(Compaction* c) {
+  const int level = c->level();
   c->input_version_ = current_;
   c->input_version_->Ref();
 
@@ -1321,9 +1592,91 @@ Compaction* VersionSet::PickCompaction() {
 
   SetupOtherInputs(c);
 
+  if (ConflictsWithCompactionsInProgress(c)) {
+    delete c;
+    return nullptr;
+  }
+
+  // Update the place where we will do the next compaction for this level.
+  // We update this immediately instead of waiting for the VersionEdit
+  // to be applied so that if the compaction fails, we will try a different
+  // key range next time.
+  InternalKey smallest, largest;
+  GetRange(c->inputs_[0], &smallest, &largest);
+  compact_pointer_[level] = largest.Encode().ToString();
+  c->edit_.SetCompactPointer(level, largest);
+
+  RegisterCompaction(c);
   return c;
 }
 
+bool VersionSet::ConflictsWithCompactionsInProgress(const Compaction* c) {
+  for (int which = 0; which < 2; which++) {
+    for (FileMetaData* f : c->inputs_[which]) {
+      if (f->being_compacted) {
+        return true;
+      }
+    }
+  }
+  if (compactions_in_progress_.empty()) {
+    return false;
+  }
+
+  // Two compactions may also not write overlapping key ranges into the
+  // same level, or write into a key range that the other one is reading.
+  // Output files only span the key range of their inputs, so it is
+  // enough to keep the input ranges of compactions that share a level
+  // apart.
+  InternalKey smallest, largest;
+  GetRange2(c->inputs_[0], c->inputs_[1], &smallest, &largest);
+  for (const Compaction* r : compactions_in_progress_) {
+    if (r->level() + 1 < c->level() || c->level() + 1 < r->level()) {
+      continue;
+    }
+    if (r->OverlapsUserRange(icmp_.user_comparator(), smallest.user_key(),
+                             largest.user_key())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool VersionSet::RangeBeingCompacted(int level, const Slice& smallest_user_key,
+                                     const Slice& largest_user_key) const {
+  for (const Compaction* r : compactions_in_progress_) {
+    if ((r->level() == level || r->level() + 1 == level) &&
+        r->OverlapsUserRange(icmp_.user_comparator(), smallest_user_key,
+                             largest_user_key)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void VersionSet::RegisterCompaction(Compaction* c) {
+  assert(c->vset_ == nullptr);
+  GetRange2(c->inputs_[0], c->inputs_[1], &c->smallest_, &c->largest_);
+  for (int which = 0; which < 2; which++) {
+    for (FileMetaData* f : c->inputs_[which]) {
+      assert(!f->being_compacted);
+      f->being_compacted = true;
+    }
+  }
+  c->vset_ = this;
+  compactions_in_progress_.push_back(c);
+}
+
+void VersionSet::UnregisterCompaction(Compaction* c) {
+  for (int which = 0; which < 2; which++) {
+    for (FileMetaData* f : c->inputs_[which]) {
+      f->being_compacted = false;
+    }
+  }
+  compactions_in_progress_.erase(std::find(compactions_in_progress_.begin(),
+                                           compactions_in_progress_.end(), c));
+  c->vset_ = nullptr;
+}
+
 // Finds the largest key in a vector of files. Returns true if files is not
 // empty.
 bool FindLargestKey(const InternalKeyComparator& icmp,
@@ -1457,13 +1810,6 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
     current_->GetOverlappingInputs(level + 2, &all_start, &all_limit,
                                    &c->grandparents_);
   }
-
-  // Update the place where we will do the next compaction for this level.
-  // We update this immediately instead of waiting for the VersionEdit
-  // to be applied so that if the compaction fails, we will try a different
-  // key range next time.
-  compact_pointer_[level] = largest.Encode().ToString();
-  c->edit_.SetCompactPointer(level, largest);
 }
 
 Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
@@ -1492,40 +1838,53 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   }
 
   Compaction* c = new Compaction(options_, level);
-  c->input_version_ = current_;
-  c->input_version_->Ref();
   c->inputs_[0] = inputs;
-  SetupOtherInputs(c);
+  c = FinishPickCompaction(c);
+  assert(c != nullptr);
   return c;
 }
 
 Compaction::Compaction(const Options* options, int level)
-    : level_(level),
+    : vset_(nullptr),
+      level_(level),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
-      input_version_(nullptr),
-      grandparent_index_(0),
-      seen_key_(false),
-      overlapped_bytes_(0) {
-  for (int i = 0; i < config::kNumLevels; i++) {
-    level_ptrs_[i] = 0;
-  }
-}
+      input_version_(nullptr) {}
 
 Compaction::~Compaction() {
+  if (vset_ != nullptr) {
+    vset_->UnregisterCompaction(this);
+  }
   if (input_version_ != nullptr) {
     input_version_->Unref();
   }
 }
 
-/*жϵǰĲǷԼƶ*/
+bool Compaction::OverlapsUserRange(const Comparator* ucmp,
+                                   const Slice& smallest,
+                                   const Slice& largest) const {
+  assert(vset_ != nullptr);
+  return ucmp->Compare(smallest, largest_.user_key()) <= 0 &&
+         ucmp->Compare(largest, smallest_.user_key()) >= 0;
+}
+
+bool Compaction::IsBottommostLevel() const {
+  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+    if (!input_version_->files_[lvl].empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*判断当前的操作是否可以简单移动*/
 bool Compaction::IsTrivialMove() const {
   const VersionSet* vset = input_version_->vset_;
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
   // a very expensive merge later on.
-  // ǰļһûļΪȷƶصδĺϲ
-  // ڽмƶʱǰļ游ļص࣬ܵδҪаĺϲ
-  // ǰһ֮ص٣ںϲʱҪעǰһ֮Ĺϵ游ĹϵԽСҲ游һصһľ
+  // 当前层有文件而下一层没有文件，因为这确保了移动不会引入重叠，并简化了未来的合并流程
+  // 如果在进行简单移动时，当前层的文件与祖父层的文件重叠过多，这可能导致在未来需要进行昂贵的合并操作
+  // 如果当前层与下一层之间的重叠较少，则在合并时主要关注当前层和下一层之间的关系，而与祖父层的关系相对较小。也就是让祖父层和下一层重叠多是一个很糟的决定
 
   return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
           TotalFileSize(grandparents_) <=
@@ -1540,13 +1899,21 @@ void Compaction::AddInputDeletions(VersionEdit* edit) {
   }
 }
 
-bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
+Compaction::Cursor::Cursor()
+    : grandparent_index(0), seen_key(false), overlapped_bytes(0) {
+  for (int i = 0; i < config::kNumLevels; i++) {
+    level_ptrs[i] = 0;
+  }
+}
+
+bool Compaction::IsBaseLevelForKey(const Slice& user_key,
+                                   Cursor* cursor) const {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
   for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
-    while (level_ptrs_[lvl] < files.size()) {
-      FileMetaData* f = files[level_ptrs_[lvl]];
+    while (cursor->level_ptrs[lvl] < files.size()) {
+      FileMetaData* f = files[cursor->level_ptrs[lvl]];
       if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
         // We've advanced far enough
         if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
@@ -1555,37 +1922,90 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
         }
         break;
       }
-      level_ptrs_[lvl]++;
+      cursor->level_ptrs[lvl]++;
     }
   }
   return true;
 }
 
-bool Compaction::ShouldStopBefore(const Slice& internal_key) {
+bool Compaction::ShouldStopBefore(const Slice& internal_key,
+                                  Cursor* cursor) const {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
   const InternalKeyComparator* icmp = &vset->icmp_;
-  while (grandparent_index_ < grandparents_.size() &&
+  while (cursor->grandparent_index < grandparents_.size() &&
          icmp->Compare(internal_key,
-                       grandparents_[grandparent_index_]->largest.Encode()) >
-             0) {
-    if (seen_key_) {
-      overlapped_bytes_ += grandparents_[grandparent_index_]->file_size;
+                       grandparents_[cursor->grandparent_index]
+                           ->largest.Encode()) > 0) {
+    if (cursor->seen_key) {
+      cursor->overlapped_bytes +=
+          grandparents_[cursor->grandparent_index]->file_size;
     }
-    grandparent_index_++;
+    cursor->grandparent_index++;
   }
-  seen_key_ = true;
+  cursor->seen_key = true;
 
-  if (overlapped_bytes_ > MaxGrandParentOverlapBytes(vset->options_)) {
+  if (cursor->overlapped_bytes > MaxGrandParentOverlapBytes(vset->options_)) {
     // Too much overlap for current output; start new output
-    overlapped_bytes_ = 0;
+    cursor->overlapped_bytes = 0;
     return true;
   } else {
     return false;
   }
 }
 
+void Compaction::GetSubcompactionBoundaries(
+    int n, std::vector<std::string>* boundaries) const {
+  boundaries->clear();
+  if (n <= 1) {
+    return;
+  }
+
+  // Weigh each input file at its largest key.  Files in level-0 may
+  // overlap each other, but any user key is a valid place to split, as
+  // long as all entries for one user key end up in the same range.
+  std::vector<FileMetaData*> files;
+  int64_t total_bytes = 0;
+  for (int which = 0; which < 2; which++) {
+    for (FileMetaData* f : inputs_[which]) {
+      files.push_back(f);
+      total_bytes += f->file_size;
+    }
+  }
+  const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+  std::sort(files.begin(), files.end(),
+            [user_cmp](FileMetaData* a, FileMetaData* b) {
+              return user_cmp->Compare(a->largest.user_key(),
+                                       b->largest.user_key()) < 0;
+            });
+
+  // The largest key of the last file cannot start a non-empty range.
+  int64_t bytes = 0;
+  for (size_t i = 0; i + 1 < files.size(); i++) {
+    bytes += files[i]->file_size;
+    const int64_t limit =
+        total_bytes * static_cast<int64_t>(boundaries->size() + 1) / n;
+    if (bytes < limit) {
+      continue;
+    }
+    // Entries for the boundary key belong to the range it starts, so a
+    // boundary may only be used once.
+    Slice key = files[i]->largest.user_key();
+    if (boundaries->empty() || user_cmp->Compare(key, boundaries->back()) > 0) {
+      boundaries->push_back(key.ToString());
+      if (boundaries->size() + 1 == static_cast<size_t>(n)) {
+        break;
+      }
+    }
+  }
+}
+
 void Compaction::ReleaseInputs() {
+  // The input files may be freed along with input_version_, so they are
+  // no longer marked as being compacted from here on.
+  if (vset_ != nullptr) {
+    vset_->UnregisterCompaction(this);
+  }
   if (input_version_ != nullptr) {
     input_version_->Unref();
     input_version_ = nullptr;
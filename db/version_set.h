@@ -64,6 +64,14 @@ class Version {
     int seek_file_level;
   };
 
+  // One of the keys looked up by MultiGet().
+  struct GetRequest {
+    const LookupKey* key;
+    std::string* value;
+    Status* status;
+    bool done;  // Set once *value and *status hold the result
+  };
+
   // Append to *iters a sequence of iterators that will
   // yield the contents of this Version when merged together.
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
@@ -75,6 +83,14 @@ class Version {
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
              GetStats* stats);
 
+  // Look up each of the n requests that is not done yet as if by Get(),
+  // and mark it done.  The requests must be sorted by user key.  Keys
+  // that fall into the same table are looked up together by a single
+  // TableCache::MultiGet() call.  Fills *stats.
+  // REQUIRES: lock is not held
+  void MultiGet(const ReadOptions&, GetRequest* requests, int n,
+                GetStats* stats);
+
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
   // REQUIRES: lock is held
@@ -113,7 +129,7 @@ class Version {
 
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
-  /*˵ǰ汾ļͳϢ״̬*/
+  /*包含了当前版本的所有文件，统计信息和相关状态*/
  private:
   friend class Compaction;
   friend class VersionSet;
@@ -128,7 +144,11 @@ class Version {
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1) {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      level_score_[level] = -1;
+    }
+  }
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
@@ -145,15 +165,18 @@ class Version {
   void ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
                           bool (*func)(void*, int, FileMetaData*));
 
-  /*ÿ汾˫ü*/
+  /*每个版本，双向链表，引用计数*/
   VersionSet* vset_;  // VersionSet to which this Version belongs
   Version* next_;     // Next version in linked list
   Version* prev_;     // Previous version in linked list
   int refs_;          // Number of live refs to this version
 
-  // List of files per level ÿ㼶ļԪ
+  // List of files per level 每个层级的文件元数据
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // Blob files that tables of this version may refer to, by number
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
+
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
@@ -163,6 +186,11 @@ class Version {
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Compaction score of every level, also computed by Finalize().  Used
+  // to find work for additional compactions while the most urgent level
+  // is busy with compactions that are already in progress.
+  double level_score_[config::kNumLevels];
 };
 
 class VersionSet {
@@ -206,6 +234,9 @@ class VersionSet {
   // Return the number of Table files at the specified level.
   int NumLevelFiles(int level) const;
 
+  // Returns true iff the current version has blob files.
+  bool HasBlobFiles() const { return !current_->blob_files_.empty(); }
+
   // Return the combined file size of all files at the specified level.
   int64_t NumLevelBytes(int level) const;
 
@@ -229,18 +260,32 @@ class VersionSet {
   uint64_t PrevLogNumber() const { return prev_log_number_; }
 
   // Pick level and inputs for a new compaction.
-  // Returns nullptr if there is no compaction to be done.
+  // Returns nullptr if there is no compaction to be done, or if every
+  // candidate would conflict with a compaction that is in progress.
   // Otherwise returns a pointer to a heap-allocated object that
-  // describes the compaction.  Caller should delete the result.
+  // describes the compaction.  The compaction counts as in progress
+  // until the caller deletes the result.
   Compaction* PickCompaction();
 
   // Return a compaction object for compacting the range [begin,end] in
   // the specified level.  Returns nullptr if there is nothing in that
   // level that overlaps the specified range.  Caller should delete
   // the result.
+  // REQUIRES: no other compaction is in progress.
   Compaction* CompactRange(int level, const InternalKey* begin,
                            const InternalKey* end);
 
+  // Returns true iff a compaction in progress reads from or writes to
+  // "level" somewhere in the user key range
+  // [smallest_user_key,largest_user_key].
+  bool RangeBeingCompacted(int level, const Slice& smallest_user_key,
+                           const Slice& largest_user_key) const;
+
+  // Return the number of compactions that are in progress.
+  int NumCompactionsInProgress() const {
+    return static_cast<int>(compactions_in_progress_.size());
+  }
+
   // Return the maximum overlapping data (in bytes) at next level for any
   // file at a level >= 1.
   int64_t MaxNextLevelOverlappingBytes();
@@ -259,6 +304,14 @@ class VersionSet {
   // May also mutate some internal state.
   void AddLiveFiles(std::set<uint64_t>* live);
 
+  // Add all blob files listed in any live version to *live.
+  void AddLiveBlobFiles(std::set<uint64_t>* live);
+
+  // Add to *files the blob files of the current version in which the
+  // fraction of garbage bytes is at least
+  // Options::blob_garbage_collection_ratio.
+  void GetBlobFilesToCollect(std::set<uint64_t>* files);
+
   // Return the approximate offset in the database of the data for
   // "key" as of version "v".
   uint64_t ApproximateOffsetOf(Version* v, const InternalKey& key);
@@ -289,6 +342,19 @@ class VersionSet {
 
   void SetupOtherInputs(Compaction* c);
 
+  // Turns "c", whose level inputs hold the seed file(s), into a complete
+  // compaction of current_ and registers it as in progress.  Deletes "c"
+  // and returns nullptr if it would conflict with a compaction that is
+  // already in progress.
+  Compaction* FinishPickCompaction(Compaction* c);
+
+  // Pick a compaction that reduces the size of "level", or nullptr.
+  Compaction* PickSizeCompaction(int level);
+
+  bool ConflictsWithCompactionsInProgress(const Compaction* c);
+  void RegisterCompaction(Compaction* c);
+  void UnregisterCompaction(Compaction* c);
+
   // Save current contents to *log
   Status WriteSnapshot(log::Writer* log);
 
@@ -314,6 +380,9 @@ class VersionSet {
   // Per-level key at which the next compaction at that level should start.
   // Either an empty string, or a valid InternalKey.
   std::string compact_pointer_[config::kNumLevels];
+
+  // Compactions that have been picked but not yet deleted.
+  std::vector<Compaction*> compactions_in_progress_;
 };
 
 // A Compaction encapsulates information about a compaction.
@@ -342,17 +411,50 @@ class Compaction {
   // moving a single input file to the next level (no merging or splitting)
   bool IsTrivialMove() const;
 
+  // Returns true iff no level below "level+1" holds any data, so the
+  // output of the compaction ends up at the bottom of the DB.
+  bool IsBottommostLevel() const;
+
   // Add all inputs to this compaction as delete operations to *edit.
   void AddInputDeletions(VersionEdit* edit);
 
+  // Position of a pass over the compaction inputs in increasing key
+  // order, as needed by IsBaseLevelForKey() and ShouldStopBefore().
+  // Subcompactions that process disjoint key ranges in parallel each
+  // keep a Cursor of their own.
+  struct Cursor {
+    Cursor();
+
+    // State used to check for number of overlapping grandparent files
+    // (parent == level_ + 1, grandparent == level_ + 2)
+    size_t grandparent_index;  // Index in grandparents_
+    bool seen_key;             // Some output key has been seen
+    int64_t overlapped_bytes;  // Bytes of overlap between current output
+                               // and grandparent files
+
+    // level_ptrs holds indices into input_version_->levels_: our state
+    // is that we are positioned at one of the file ranges for each
+    // higher level than the ones involved in this compaction (i.e. for
+    // all L >= level_ + 2).
+    // 输入版本的文件列表中为每个级别保存指向当前状态的索引
+    size_t level_ptrs[config::kNumLevels];
+  };
+
   // Returns true if the information we have available guarantees that
   // the compaction is producing data in "level+1" for which no data exists
   // in levels greater than "level+1".
-  bool IsBaseLevelForKey(const Slice& user_key);
+  bool IsBaseLevelForKey(const Slice& user_key, Cursor* cursor) const;
 
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
-  bool ShouldStopBefore(const Slice& internal_key);
+  bool ShouldStopBefore(const Slice& internal_key, Cursor* cursor) const;
+
+  // Store in *boundaries at most n-1 user keys, in increasing order, that
+  // split the key range of the inputs into ranges of roughly equal input
+  // size.  Each boundary starts a new range.  Boundaries are only placed
+  // at input file boundaries.
+  void GetSubcompactionBoundaries(int n,
+                                  std::vector<std::string>* boundaries) const;
 
   // Release the input version for the compaction, once the compaction
   // is successful.
@@ -364,31 +466,28 @@ class Compaction {
 
   Compaction(const Options* options, int level);
 
-  int level_; //ڽѹļ
-  uint64_t max_output_file_size_; // ļС
-  Version* input_version_; // ָǰѹ汾
-  VersionEdit edit_; // ѹı༭ݣҪӺɾļ
+  // Returns true iff the user key range covered by the inputs intersects
+  // [smallest,largest].  REQUIRES: the compaction is registered.
+  bool OverlapsUserRange(const Comparator* ucmp, const Slice& smallest,
+                         const Slice& largest) const;
+
+  VersionSet* vset_;  // Set while registered as in progress with a VersionSet
+  int level_; //正在进行压缩的级别
+  uint64_t max_output_file_size_; // 最大输出文件大小限制
+  Version* input_version_; // 指向当前压缩的输入版本
+  VersionEdit edit_; // 保存压缩操作所作的编辑内容，包含需要添加和删除的文件
 
   // Each compaction reads inputs from "level_" and "level_+1"
-  // һ洢ǰһ洢һ
+  // 一个存储当前级别，一个存储下一个几倍
   std::vector<FileMetaData*> inputs_[2];  // The two sets of inputs
 
-  // State used to check for number of overlapping grandparent files
-  // (parent == level_ + 1, grandparent == level_ + 2)
+  // Range covered by all inputs.  Filled in when the compaction is
+  // registered as in progress.
+  InternalKey smallest_;
+  InternalKey largest_;
+
+  // Files in level_ + 2 that overlap this compaction
   std::vector<FileMetaData*> grandparents_;
-  size_t grandparent_index_;  // Index in grandparent_starts_
-  bool seen_key_;             // Some output key has been seen
-  int64_t overlapped_bytes_;  // Bytes of overlap between current output
-                              // and grandparent files
-
-  // State for implementing IsBaseLevelForKey
-
-  // level_ptrs_ holds indices into input_version_->levels_: our state
-  // is that we are positioned at one of the file ranges for each
-  // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
-  // 汾ļбΪÿ𱣴ָǰ״̬
-  size_t level_ptrs_[config::kNumLevels];
 };
 
 }  // namespace leveldb
@@ -37,7 +37,11 @@ class WriteBatchInternal {
   }
   static void SetContents(WriteBatch* batch, const Slice& contents);
 
-  static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
+  // Apply the batch to memtable.  If "concurrently" is true, other
+  // threads may be inserting into memtable at the same time (see
+  // MemTable::AddConcurrently()).
+  static Status InsertInto(const WriteBatch* batch, MemTable* memtable,
+                           bool concurrently = false);
 
   static void Append(WriteBatch* dst, const WriteBatch* src);
 };
@@ -37,6 +37,10 @@ static std::string PrintContents(WriteBatch* b) {
         state.append(")");
         count++;
         break;
+      case kTypeBlobIndex:
+        // Write batches never hold blob indexes
+        state.append("UnexpectedBlobIndex()");
+        break;
     }
     state.append("@");
     state.append(NumberToString(ikey.sequence));
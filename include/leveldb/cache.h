@@ -19,19 +19,50 @@
 #define STORAGE_LEVELDB_INCLUDE_CACHE_H_
 
 #include <cstdint>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/slice.h"
 
 namespace leveldb {
 
-    // cacheĻӿ
+    // cache的缓存接口
 class LEVELDB_EXPORT Cache;
 
 // Create a new cache with a fixed size capacity.  This implementation
 // of Cache uses a least-recently-used eviction policy.
 LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity);
 
+// Like NewLRUCache(capacity), but reserves up to "high_pri_pool_ratio" of
+// the capacity for high-priority entries (see Cache::Priority).  Entries
+// of either priority may use the whole capacity while there is room.  A
+// ratio of 0 means no high-priority pool: entries of both priorities are
+// evicted together, in plain LRU order.
+LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio);
+
+// Like NewLRUCache(capacity, high_pri_pool_ratio), but splits the cache into
+// 2^num_shard_bits shards, each with its own lock and an equal share of the
+// capacity.  More shards mean less lock contention between threads, fewer
+// shards an eviction order closer to true LRU.  If "num_shard_bits" is
+// negative, the shard count is picked from the capacity and the number of
+// hardware threads, which is also what the other overloads do.
+LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio,
+                                  int num_shard_bits);
+
+// Create a new cache with a fixed size capacity that uses the CLOCK
+// eviction policy.  Lookups and releases do not take any lock, so it
+// scales better than NewLRUCache() with many concurrent readers.  Entries
+// that are read once, as in a sequential scan, are evicted before entries
+// that were hit again, so a scan does not flush the working set.
+//
+// The cache holds its entries in fixed-size tables, sized for entries with
+// a charge of about "estimated_entry_charge" (by default 4KB, the default
+// block size).  When entries are smaller, the cache evicts once the tables
+// are full, before reaching its capacity.  Cache::Priority is ignored.
+LEVELDB_EXPORT Cache* NewClockCache(size_t capacity);
+LEVELDB_EXPORT Cache* NewClockCache(size_t capacity,
+                                    size_t estimated_entry_charge);
+
 class LEVELDB_EXPORT Cache {
  public:
   Cache() = default;
@@ -40,24 +71,47 @@ class LEVELDB_EXPORT Cache {
   Cache& operator=(const Cache&) = delete;
 
   // Destroys all existing entries by calling the "deleter"
-  // function that was passed to the constructor. صٻ
+  // function that was passed to the constructor. 回调函数销毁缓存的内容
   virtual ~Cache();
 
-  // Opaque handle to an entry stored in the cache. ָcacheеһ
+  // Opaque handle to an entry stored in the cache. 指向cache中的一个缓存项
   struct Handle {};
 
+  // When the cache is full, low-priority entries are evicted before
+  // high-priority ones, unless the high-priority entries use more than the
+  // share of the capacity reserved for them.
+  enum class Priority { kLow, kHigh };
+
+  // Counters of a single shard of a cache; see GetShardStats().
+  struct ShardStats {
+    uint64_t hits = 0;        // Lookups that found an entry
+    uint64_t misses = 0;      // Lookups that did not
+    uint64_t inserts = 0;     // Calls to Insert()
+    uint64_t evictions = 0;   // Entries removed to stay within capacity
+    size_t usage = 0;         // Combined charge of the entries in the shard
+    size_t pinned_usage = 0;  // Part of usage held by unreleased handles
+  };
+
   // Insert a mapping from key->value into the cache and assign it
   // the specified charge against the total cache capacity.
   //
   // Returns a handle that corresponds to the mapping.  The caller
   // must call this->Release(handle) when the returned mapping is no
-  // longer needed. ü
+  // longer needed. 有引用计数
   //
   // When the inserted entry is no longer needed, the key and
   // value will be passed to "deleter".
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) = 0;
 
+  // Like Insert(), but gives the entry the specified eviction priority.
+  // The default implementation ignores the priority.
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority) {
+    return Insert(key, value, charge, deleter);
+  }
+
   // If the cache has no mapping for "key", returns nullptr.
   //
   // Else return a handle that corresponds to the mapping.  The caller
@@ -97,6 +151,13 @@ class LEVELDB_EXPORT Cache {
   // Return an estimate of the combined charges of all elements stored in the
   // cache.
   virtual size_t TotalCharge() const = 0;
+
+  // Replace the contents of "*stats" with the statistics of each shard of
+  // the cache, one element per shard.  The counters accumulate from the
+  // creation of the cache.  Uneven counters across shards point at hot keys.
+  // The default implementation reports a single shard whose usage is
+  // TotalCharge(), with all other fields zero.
+  virtual void GetShardStats(std::vector<ShardStats>* stats) const;
 };
 
 }  // namespace leveldb
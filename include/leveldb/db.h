@@ -7,6 +7,8 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <string>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
@@ -87,6 +89,16 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options, const Slice& key,
                      std::string* value) = 0;
 
+  // Look up all of "keys" as if by Get(), against one consistent view of
+  // the database.  Resizes *values and *statuses to keys.size() and
+  // stores the result of looking up keys[i] in (*values)[i] and
+  // (*statuses)[i].  This is considerably cheaper than calling Get() for
+  // each key when many keys are read at once.
+  virtual void MultiGet(const ReadOptions& options,
+                        const std::vector<Slice>& keys,
+                        std::vector<std::string>* values,
+                        std::vector<Status>* statuses);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -121,6 +133,9 @@ class LEVELDB_EXPORT DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.block-cache-stats" - returns a multi-line string with the
+  //     hits, misses, inserts, evictions and usage of each shard of the
+  //     block cache.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -144,6 +159,10 @@ class LEVELDB_EXPORT DB {
   // end==nullptr is treated as a key after all keys in the database.
   // Therefore the following call will compact the entire database:
   //    db->CompactRange(nullptr, nullptr);
+  //
+  // If the database has blob files (Options::min_blob_size), this also
+  // drops the values that overwritten and deleted keys leave behind in
+  // them, and copies values out of blob files that are mostly garbage.
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
 };
 
@@ -197,6 +197,15 @@ class LEVELDB_EXPORT Env {
   // serialized.
   virtual void Schedule(void (*function)(void* arg), void* arg) = 0;
 
+  // Like Schedule(), for short work that must not wait behind long work
+  // added with Schedule() (e.g. a memtable flush behind a level
+  // compaction).  Such work runs before any work added with Schedule()
+  // that has not started yet, and has a thread to itself when every
+  // other thread is busy.
+  //
+  // The default implementation calls Schedule().
+  virtual void ScheduleHighPriority(void (*function)(void* arg), void* arg);
+
   // Start a new thread, invoking "function(arg)" within the new thread.
   // When "function(arg)" returns, the thread will be destroyed.
   virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
@@ -219,7 +228,7 @@ class LEVELDB_EXPORT Env {
 };
 
 // A file abstraction for reading sequentially through a file
-/*˳ȡļʺϱ*/
+/*顺序读取文件，适合遍历*/
 class LEVELDB_EXPORT SequentialFile {
  public:
   SequentialFile() = default;
@@ -250,7 +259,7 @@ class LEVELDB_EXPORT SequentialFile {
 };
 
 // A file abstraction for randomly reading the contents of a file.
-/*֧ʣļƫʼȡݣ*/
+/*支持随机访问，从文件的任意偏移量开始读取数据，允许并发访问*/
 class LEVELDB_EXPORT RandomAccessFile {
  public:
   RandomAccessFile() = default;
@@ -275,7 +284,7 @@ class LEVELDB_EXPORT RandomAccessFile {
 
 // A file abstraction for sequential writing.  The implementation
 // must provide buffering since callers may append small fragments
-// at a time to the file. ˳дļֶд벢ṩ
+// at a time to the file. 顺序写入文件，允许分段写入并提供缓冲
 class LEVELDB_EXPORT WritableFile {
  public:
   WritableFile() = default;
@@ -292,7 +301,7 @@ class LEVELDB_EXPORT WritableFile {
 };
 
 // An interface for writing log messages.
-/*¼־Ϣ*/
+/*记录日志信息*/
 class LEVELDB_EXPORT Logger {
  public:
   Logger() = default;
@@ -306,7 +315,7 @@ class LEVELDB_EXPORT Logger {
   virtual void Logv(const char* format, std::va_list ap) = 0;
 };
 
-// Identifies a locked file.ļȷ̻߳ļİȫ
+// Identifies a locked file.文件锁定，确保多线程环境中文件的安全访问
 class LEVELDB_EXPORT FileLock {
  public:
   FileLock() = default;
@@ -387,6 +396,9 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   void Schedule(void (*f)(void*), void* a) override {
     return target_->Schedule(f, a);
   }
+  void ScheduleHighPriority(void (*f)(void*), void* a) override {
+    return target_->ScheduleHighPriority(f, a);
+  }
   void StartThread(void (*f)(void*), void* a) override {
     return target_->StartThread(f, a);
   }
@@ -26,15 +26,15 @@ class Slice;
 
 class LEVELDB_EXPORT FilterPolicy {
  public:
-  // ֤ȷԴ
+  // 虚析构函数，保证派生类正确清理资源
   virtual ~FilterPolicy();
 
   // Return the name of this policy.  Note that if the filter encoding
   // changes in an incompatible way, the name returned by this method
   // must be changed.  Otherwise, old incompatible filters may be
   // passed to methods of this type.
-  // ع˲Եƣı뷽ʽݵı仯ҲҪ
-  // ɵĲݵĹĴݵ
+  // 返回过滤策略的名称，如果过滤器的编码方式发生不兼容的变化，该名称也需要更改
+  // 否则旧的不兼容的过滤器被错误的传递到方法中
   virtual const char* Name() const = 0;
 
   // keys[0,n-1] contains a list of keys (potentially with duplicates)
@@ -43,7 +43,7 @@ class LEVELDB_EXPORT FilterPolicy {
   //
   // Warning: do not change the initial contents of *dst.  Instead,
   // append the newly constructed filter to *dst.
-  // ݸļбɹӵdstС
+  // 根据给定的键列表生成过滤器并附加到dst中。
   virtual void CreateFilter(const Slice* keys, int n,
                             std::string* dst) const = 0;
 
@@ -52,8 +52,19 @@ class LEVELDB_EXPORT FilterPolicy {
   // the key was in the list of keys passed to CreateFilter().
   // This method may return true or false if the key was not on the
   // list, but it should aim to return false with a high probability.
-  // ļǷڹ
+  // 看给定的键是否可能在过滤器中
   virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const = 0;
+
+  // If true, each table holds a single "full" filter over all of its
+  // keys instead of one filter per 2KB of data blocks.  A full filter is
+  // checked before the index of the table is searched, so lookups of
+  // missing keys skip the index as well, and it spends its bits over
+  // every key of the table at once.  The whole set of keys of a table is
+  // buffered until the table is finished.
+  //
+  // Tables built with either kind of filter can be read whatever this
+  // returns.
+  virtual bool UseFullFilter() const { return false; }
 };
 
 // Return a new filter policy that uses a bloom filter with approximately
@@ -70,10 +81,30 @@ class LEVELDB_EXPORT FilterPolicy {
 // ignores trailing spaces, it would be incorrect to use a
 // FilterPolicy (like NewBloomFilterPolicy) that does not ignore
 // trailing spaces in keys.
-// һµĲ¡Ĳԣûֱӵúȡʵ
-// ¡߼ FilterPolicy ౾ֱءȡΪȫֺʹģ黯ڽ˲Եչ
+// 返回一个新的布隆过滤器的策略，用户可以直接调用函数来获取实例
+// 创建布隆过滤器的逻辑与 FilterPolicy 类本身并不直接相关。将其提取为全局函数可以使其更模块化，便于将来对其他过滤策略的扩展。
 LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Like NewBloomFilterPolicy(bits_per_key), but builds a full filter per
+// table (see FilterPolicy::UseFullFilter) if "use_full_filter" is true.
+LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key,
+                                                        bool use_full_filter);
+
+// Return a new filter policy that uses a bloom filter in which all of the
+// bits of a key fall within one 64-byte cache line, so that a lookup costs
+// at most one cache miss.  Its false positive rate is close to that of
+// NewBloomFilterPolicy() for the same bits_per_key, but a filter is never
+// smaller than 64 bytes, so it is best combined with full filters, whose
+// size also makes cache misses frequent.
+//
+// Its filters have their own name, so that tables built with the filter
+// of NewBloomFilterPolicy() are read as having no filter rather than
+// misinterpreted.  The same note on custom comparators applies.
+LEVELDB_EXPORT const FilterPolicy* NewCacheLocalBloomFilterPolicy(
+    int bits_per_key);
+LEVELDB_EXPORT const FilterPolicy* NewCacheLocalBloomFilterPolicy(
+    int bits_per_key, bool use_full_filter);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
@@ -7,6 +7,7 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <vector>
 
 #include "leveldb/export.h"
 
@@ -17,6 +18,8 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class PersistentCache;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -29,6 +32,37 @@ enum CompressionType {
   kNoCompression = 0x0,
   kSnappyCompression = 0x1,
   kZstdCompression = 0x2,
+  kLZ4Compression = 0x3,
+  // Compresses harder than kLZ4Compression, at the same decompression
+  // speed.  Uses lz4hc_compression_level.
+  kLZ4HCCompression = 0x4,
+};
+
+// The layout of the table files a DB writes.  Tables of either format
+// can be read regardless of the format the DB currently writes.
+enum TableFormat {
+  // Blocks with an index, filters and optional compression.  Read through
+  // the block cache.
+  kBlockBasedTable = 0x0,
+  // Uncompressed records followed by a sparse index and a hash index on
+  // user keys.  Meant for tables that are memory-mapped (see
+  // Env::NewRandomAccessFile): keys and values are read in place without
+  // copying or caching.  Tables that are not mapped are read into memory
+  // whole when opened.
+  kPlainTable = 0x1,
+};
+
+// The checksum stored in the trailer of each block of a table and in the
+// header of each log record.  Tables and logs with either checksum can be
+// read regardless of the one the DB currently writes.
+enum ChecksumType {
+  // NOTE: do not change the values of existing entries, as these are
+  // part of the persistent format on disk.
+  kCRC32c = 0x0,
+  // The low 32 bits of XXH3.  Several times faster to verify than crc32c
+  // on large blocks.  Tables that use it cannot be read by versions of
+  // leveldb that predate it.
+  kXXH3 = 0x1,
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -83,6 +117,38 @@ struct LEVELDB_EXPORT Options {
   // the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // Maximum number of level compactions that may run concurrently.
+  // Compactions that run at the same time never share input files and
+  // never write overlapping key ranges into the same level.  Memtable
+  // flushes are scheduled separately, with Env::ScheduleHighPriority(),
+  // and do not count against this limit, so a flush never waits behind a
+  // long level compaction.
+  //
+  // The actual parallelism is also bounded by the number of background
+  // threads provided by Env::Schedule().
+  int max_background_compactions = 1;
+
+  // Maximum number of key ranges a single compaction is split into.
+  // The ranges are merged and written to their own output files on
+  // separate threads, and the results are installed together.  Large
+  // level-0 compactions finish sooner this way, at the cost of
+  // producing more, smaller output files.
+  int max_subcompactions = 1;
+
+  // If true, the writers of a group commit insert their own batches into
+  // the memtable in parallel once the group has been appended to the log,
+  // instead of the group leader applying the whole group by itself.  The
+  // group's writes become visible only after every writer has finished.
+  // This helps workloads with many concurrent writers.
+  bool allow_concurrent_memtable_write = false;
+
+  // If true, a group commit hands the log over to the next group as soon
+  // as its own log record is written, and applies itself to the memtable
+  // while the next group is being logged.  Groups are still applied and
+  // made visible in log order.  This raises throughput when many threads
+  // issue small writes.
+  bool enable_pipelined_write = false;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -95,6 +161,41 @@ struct LEVELDB_EXPORT Options {
   // If null, leveldb will automatically create and use an 8MB internal cache.
   Cache* block_cache = nullptr;
 
+  // If non-null, blocks that miss block_cache are looked up in this cache,
+  // which holds them compressed, as they are stored in the file.  A hit
+  // costs a decompression instead of a read, and a compressed block takes
+  // a fraction of the memory of the uncompressed one, so this cache holds
+  // more of the working set than block_cache would with the same memory.
+  // Uncompressed blocks and blocks of memory-mapped tables are not added.
+  Cache* block_cache_compressed = nullptr;
+
+  // If non-null, the entries that point lookups find in each table are
+  // kept in this cache, keyed by table and user key.  A Get() that hits it
+  // skips the table cache, the block cache and block parsing.  All the
+  // versions of a key held by a table are cached together, so reads at a
+  // snapshot are served from the cache as well.
+  Cache* row_cache = nullptr;
+
+  // If non-null, blocks that miss block_cache are looked up in this
+  // second-tier cache before they are read from the table file, and are
+  // added to it once read by reads with ReadOptions::fill_cache set.
+  // Useful when table files live on storage that is much slower than a
+  // local disk.  See NewFilePersistentCache().
+  PersistentCache* persistent_cache = nullptr;
+
+  // If true, the index and filter blocks of each table are kept in
+  // block_cache and charged against its capacity, instead of being held
+  // outside of it for as long as the table is open.  They are inserted
+  // with high priority, so that a cache created with a high priority pool
+  // (see NewLRUCache) evicts data blocks before them.  Has no effect when
+  // tables are memory-mapped.
+  bool cache_index_and_filter_blocks = false;
+
+  // If true and cache_index_and_filter_blocks is set, the index and filter
+  // blocks of level-0 tables are pinned in block_cache while the table is
+  // open.  Level-0 tables are consulted by nearly every read.
+  bool pin_l0_filter_and_index_blocks_in_cache = false;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -106,6 +207,41 @@ struct LEVELDB_EXPORT Options {
   // leave this parameter alone.
   int block_restart_interval = 16;
 
+  // If true, each data block gets a small hash table, placed after its
+  // restart array, that maps user keys to the restart interval holding
+  // them.  Point lookups then go straight to that interval instead of
+  // binary searching the restart array.  Costs about one byte per key
+  // per block.  A flag in the block trailer marks such blocks, so tables
+  // written without this option keep their format; tables written with
+  // it cannot be read by versions of leveldb that predate it.  Only use
+  // this for tables written by a DB, whose keys are internal keys.
+  // This parameter can be changed dynamically.
+  bool data_block_hash_index = false;
+
+  // Number of keys per hash table bucket when data_block_hash_index is
+  // set.  Lower values mean fewer collisions and larger blocks.
+  double data_block_hash_table_util_ratio = 0.75;
+
+  // If true, data blocks store the first eight bytes of the user key of
+  // each restart point in a fixed-width array after the restart array.
+  // Seeks then search that array, and decode the entry at a restart point
+  // only when its prefix ties with the target's, so they touch fewer
+  // cache lines of the block.  Costs eight bytes per restart point.  Like
+  // data_block_hash_index, this changes the block format, and is only
+  // for tables written by a DB; the DB ignores it unless the comparator
+  // is BytewiseComparator().
+  // This parameter can be changed dynamically.
+  bool data_block_restart_prefixes = false;
+
+  // If non-zero, the index of each table is split into partitions of
+  // roughly this many bytes.  The partitions are stored as ordinary blocks
+  // and read through the block cache on demand, and only a small top-level
+  // index with one entry per partition stays in memory while the table is
+  // open.  This bounds memory use when max_file_size is large.
+  //
+  // Default: 0 (one index block per table, held in memory)
+  size_t index_partition_size = 0;
+
   // Leveldb will write up to this amount of bytes to a file before
   // switching to a new one.
   // Most clients should leave this parameter alone.  However if your
@@ -116,6 +252,12 @@ struct LEVELDB_EXPORT Options {
   // initially populating a large database.
   size_t max_file_size = 2 * 1024 * 1024;
 
+  // Number of bytes that compactions read ahead in their input files.
+  // Compaction inputs are read from start to end, so they are read in
+  // pieces of this size instead of block by block.  0 disables it.
+  // See ReadOptions::readahead_size.
+  size_t compaction_readahead_size = 2 * 1024 * 1024;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
@@ -136,6 +278,74 @@ struct LEVELDB_EXPORT Options {
   // Currently only the range [-5,22] is supported. Default is 1.
   int zstd_compression_level = 1;
 
+  // Compression level for LZ4HC, in the range [1,12].
+  int lz4hc_compression_level = 9;
+
+  // If non-empty, the compression of tables written to each level: tables
+  // written to level L use compression_per_level[L], or the last entry
+  // for levels past the end.  Flushed memtables count as level 0.  For
+  // example {kNoCompression, kNoCompression, kLZ4Compression} keeps
+  // flushes and compactions into level 1 cheap and compresses the deeper
+  // levels, where most of the data lives.  Overrides compression.
+  std::vector<CompressionType> compression_per_level;
+
+  // If non-zero, tables that compactions write to the bottommost level,
+  // below which the DB holds no data, are compressed with zstd at this
+  // compression level, whatever compression_per_level says.  That level
+  // holds most of the data, and is rewritten less often than the others.
+  int bottommost_zstd_compression_level = 0;
+
+  // If greater than 1, tables being built compress their data blocks on a
+  // pool of this many background threads, while the caller goes on adding
+  // keys.  The pool is shared by every table built in the process, and
+  // grows to the largest value any of them asks for.  Blocks are still
+  // written in key order.  Worth it for the slower
+  // compressions, such as kZstdCompression at high levels, which otherwise
+  // bound how fast compactions write.
+  int compression_parallel_threads = 1;
+
+  // If non-zero, the data blocks of each table compressed with
+  // kZstdCompression share a zstd dictionary of up to this many bytes,
+  // which helps when blocks are too small to compress well on their own
+  // (e.g. many small JSON values).  Each table trains its own dictionary
+  // on its first data blocks and stores it in the table.  Tables with a
+  // dictionary cannot be read by versions of leveldb that predate it.
+  //
+  // Default: 0 (no dictionary).  16KB is a good starting point.
+  size_t zstd_max_dictionary_size = 0;
+
+  // Bytes of data blocks, before compression, that each zstd dictionary is
+  // trained on.  They are held in memory until then.  More samples give a
+  // better dictionary; zstd suggests about 100 times the dictionary size.
+  size_t zstd_dictionary_training_bytes = 1024 * 1024;
+
+  // Format of the table files the DB writes.  With kPlainTable,
+  // block_size, block_restart_interval, compression, checksum,
+  // filter_policy and the block caches do not apply to new tables.
+  //
+  // Default: kBlockBasedTable
+  TableFormat table_format = kBlockBasedTable;
+
+  // Checksum of the blocks of new tables, which reads verify when
+  // paranoid_checks or ReadOptions::verify_checksums is set.  Records
+  // written to the log use it too; the MANIFEST always uses crc32c.
+  //
+  // Default: kCRC32c
+  ChecksumType checksum = kCRC32c;
+
+  // If non-zero, values of at least this many bytes are written to
+  // separate blob files when the memtable is flushed, and tables hold
+  // only a reference to them, so compactions no longer rewrite them at
+  // every level.  Reading such a value costs one more file read.
+  //
+  // Default: 0 (values are stored in the tables)
+  size_t min_blob_size = 0;
+
+  // A compaction copies the values it reaches out of blob files in which
+  // at least this fraction of bytes belong to overwritten or deleted
+  // values, so that those files can be deleted.
+  double blob_garbage_collection_ratio = 0.5;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
@@ -146,6 +356,18 @@ struct LEVELDB_EXPORT Options {
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
+
+  // If non-null, the filters of new tables also hold the prefix that this
+  // transform extracts from each key, so that iterators with
+  // ReadOptions::prefix_same_as_start set can skip every table whose
+  // filter rules out the prefix of the seek target, without reading any
+  // of its blocks.  Only full filters (see FilterPolicy::UseFullFilter)
+  // are consulted for prefixes.  The transform must be compatible with
+  // the comparator: keys with the same prefix must be adjacent.
+  //
+  // The filters of tables built without this transform, or with one of
+  // another name, are ignored until compactions rewrite those tables.
+  const SliceTransform* prefix_extractor = nullptr;
 };
 
 // Options that control read operations
@@ -163,6 +385,22 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If true, and Options::prefix_extractor is set, an iterator positioned
+  // by Seek() only yields keys with the same prefix as the seek target,
+  // and becomes invalid past them in either direction.  Tables whose
+  // filters show that they hold no key with that prefix are then not
+  // read at all.  Has no effect on SeekToFirst() and SeekToLast(), or
+  // on targets that have no prefix.
+  bool prefix_same_as_start = false;
+
+  // If non-zero, iterators read ahead in table files that they scan
+  // sequentially.  Each read of a data block that directly follows the
+  // previous one doubles the amount read ahead, starting from 8KB, up to
+  // this many bytes.  Iterators that do not fill the cache are taken to
+  // be bulk scans and read this many bytes ahead from the start.  Has no
+  // effect on memory-mapped table files.
+  size_t readahead_size = 256 * 1024;
 };
 
 // Options that control write operations
@@ -0,0 +1,68 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PersistentCache is a second tier behind the block cache that keeps
+// copies of table data on fast local storage, such as an SSD, for tables
+// whose files live on slower storage.  Reads that miss the block cache
+// are served from the persistent cache when it has the data, and are
+// added to it when it does not, unless ReadOptions::fill_cache is off.  Unlike the block cache, its contents
+// survive a restart of the process.
+//
+// A PersistentCache has internal synchronization and may be safely
+// accessed concurrently from multiple threads.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+#define STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+class PersistentCache;
+
+// Create a persistent cache that stores up to "capacity" bytes in files
+// under the directory "path", which is created if missing.  Data is
+// appended to segment files of a few megabytes, and whole segments are
+// dropped oldest first once the cache is full.  Entries found in the
+// segments of an earlier run are indexed again when the cache is
+// created; a segment whose tail is damaged keeps its intact prefix.
+//
+// The cache keys data by table file number, size and footer checksum, so
+// a cache directory should serve a single database.
+//
+// On success, stores a pointer to the new cache in *result and returns OK.
+// The caller should delete the cache when it is no longer needed.
+LEVELDB_EXPORT Status NewFilePersistentCache(Env* env, const std::string& path,
+                                             uint64_t capacity,
+                                             PersistentCache** result);
+
+class LEVELDB_EXPORT PersistentCache {
+ public:
+  PersistentCache() = default;
+
+  PersistentCache(const PersistentCache&) = delete;
+  PersistentCache& operator=(const PersistentCache&) = delete;
+
+  virtual ~PersistentCache();
+
+  // Store a copy of "data" under "key".  Data stored under a key never
+  // changes, so an existing entry for "key" may be kept instead.  The
+  // entry may be dropped at any time to make room for others.
+  virtual Status Insert(const Slice& key, const Slice& data) = 0;
+
+  // If the cache holds an entry for "key", stores a copy of its data in
+  // *data and returns OK.  Returns a NotFound status if it does not, and
+  // a Corruption status if the stored copy is damaged.
+  virtual Status Lookup(const Slice& key, std::string* data) = 0;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
@@ -0,0 +1,63 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A SliceTransform maps keys to a shorter key, such as a prefix, that
+// groups keys which are usually read together.  See
+// Options::prefix_extractor.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include <cstddef>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+// A SliceTransform implementation must be thread-safe since leveldb may
+// invoke its methods concurrently from multiple threads.
+class LEVELDB_EXPORT SliceTransform {
+ public:
+  virtual ~SliceTransform();
+
+  // The name of the transform.  It is stored with the filters that
+  // include the transformed keys, so it must change whenever Transform()
+  // changes in a way that maps some key differently.
+  //
+  // Names starting with "leveldb." are reserved and should not be used
+  // by any clients of this package.
+  virtual const char* Name() const = 0;
+
+  // Returns the prefix of "key", which must be a prefix of "key" itself,
+  // so that all keys with the same prefix are adjacent in the bytewise
+  // order.  REQUIRES: InDomain(key).
+  virtual Slice Transform(const Slice& key) const = 0;
+
+  // Returns true iff "key" has a prefix.  Keys that do not are left out
+  // of prefix filters, and seeks to them are not bounded by a prefix.
+  virtual bool InDomain(const Slice& key) const = 0;
+};
+
+// Return a new transform that maps each key of at least "prefix_len"
+// bytes to its first "prefix_len" bytes.  Shorter keys have no prefix.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewFixedPrefixTransform(
+    size_t prefix_len);
+
+// Return a new transform that maps each key to the bytes before, and
+// including, its "count"-th occurrence of "delimiter".  Keys with fewer
+// occurrences have no prefix.  E.g. with delimiter '/' and count 2, the
+// prefix of "tenant/entity/ts" is "tenant/entity/".
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewDelimitedPrefixTransform(
+    char delimiter, int count);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
@@ -7,18 +7,20 @@
 
 #include <cstdint>
 
+#include "leveldb/cache.h"
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 
 namespace leveldb {
 
-class Block; // ݿ
-class BlockHandle; // blockϢ
-class Footer; // ļײϢ
-struct Options; // Ϣ
-class RandomAccessFile; // ļ
-struct ReadOptions; // ȡѡգǷȡ
-class TableCache; // sstableصԪ(cache)(file)
+class Block; // 数据块
+class BlockHandle; // 处理和block相关信息
+class FilterBlockReader;
+class Footer; // 文件底部信息
+struct Options; // 配置信息
+class RandomAccessFile; // 随机访问文件
+struct ReadOptions; // 读取选项，比如快照，是否读取缓存等
+class TableCache; // 缓存sstable相关的元数据(cache)和数据(file)
 
 // A Table is a sorted map from strings to strings.  Tables are
 // immutable and persistent.  A Table may be safely accessed from
@@ -38,9 +40,9 @@ class LEVELDB_EXPORT Table {
   //
   // *file must remain live while this Table is in use.
   /*
-  Դ򿪴洢fileǰfile_sizeֽڵı
-  ȡҪԪ
-  *tableΪ´򿪵ı
+  尝试打开存储在file的前file_size字节的表，
+  读取必要的元数据以允许检验检索数据
+  *table为新打开的表
   */
   static Status Open(const Options& options, RandomAccessFile* file,
                      uint64_t file_size, Table** table);
@@ -54,8 +56,8 @@ class LEVELDB_EXPORT Table {
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
   /*
-  һµĵڱݡ
-  Чģ߱ʹ֮ǰһ Seek 
+  返回一个新的迭代器，用于遍历表的内容。
+  迭代器最初是无效的，调用者必须在使用之前调用其中一个 Seek 方法。
   */
   Iterator* NewIterator(const ReadOptions&) const;
 
@@ -65,29 +67,69 @@ class LEVELDB_EXPORT Table {
   // bytes, and so includes effects like compression of the underlying data.
   // E.g., the approximate offset of the last key in the table will
   // be close to the file length.
-  /*һļпʼĽֽƫƫ˵ײݵѹ*/
+  /*给定一个键，返回数据在文件中开始的近似字节偏移量。这个偏移量考虑了底层数据的压缩*/
   uint64_t ApproximateOffsetOf(const Slice& key) const;
 
+  // Returns false if the full filter of the table shows that it does not
+  // hold "key".  Tables without a full filter may hold any key.
+  bool KeyMayMatch(const Slice& key) const;
+
  private:
   friend class TableCache;
-  struct Rep; // ڲʵֽṹ壬װtableľʵϸ
+  struct Rep; // 内部实现结构体，封装table的具体实现细节
 
-  static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  // Like the public Open(), keeping the blocks of the table in
+  // options.persistent_cache, unless "persistent_cache_key_prefix" is
+  // empty, under keys that start with it and a checksum of the footer.
+  static Status Open(const Options& options, RandomAccessFile* file,
+                     uint64_t file_size,
+                     const Slice& persistent_cache_key_prefix, Table** table);
 
-  /*˽й캯һָ Rep ṹָ룬ʼ rep_ Ա*/
+  static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  // Like BlockReader(), reading through the readahead buffer of one
+  // iterator.  See ReadOptions::readahead_size.
+  static Iterator* ReadaheadBlockReader(void*, const ReadOptions&,
+                                        const Slice&);
+  // Like BlockReader(), for the partitions of a partitioned index.
+  static Iterator* IndexPartitionReader(void*, const ReadOptions&,
+                                        const Slice&);
+
+  // Returns an iterator over the index, mapping keys to data block handles.
+  // For a partitioned index this is itself a two-level iterator that
+  // reads index partitions through the block cache.
+  Iterator* NewIndexIterator(const ReadOptions&) const;
+
+  /*私有构造函数，接收一个指向 Rep 结构体的指针，初始化 rep_ 成员*/
   explicit Table(Rep* rep) : rep_(rep) {}
 
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
   // that key is not present.
-  // ڱвҸĿҵˣ handle_result 
+  // 在表中查找给定键的条目。如果找到了，将调用 handle_result 函数处理结果
   Status InternalGet(const ReadOptions&, const Slice& key, void* arg,
                      void (*handle_result)(void* arg, const Slice& k,
                                            const Slice& v));
 
-  // ȡԪݺ͹غ
-  void ReadMeta(const Footer& footer);
-  void ReadFilter(const Slice& filter_handle_value);
+  // Like InternalGet() for each of the n keys keys[0..n-1], which must be
+  // sorted, calling (*handle_result)(args[i], ...) for keys[i].  Keys
+  // that fall into the same data block share a single read of the block.
+  Status InternalMultiGet(const ReadOptions&, int n, const Slice* keys,
+                          void* const* args,
+                          void (*handle_result)(void* arg, const Slice& k,
+                                                const Slice& v));
+
+  // 读取元数据和过滤器的相关函数
+  Status ReadMeta(const Footer& footer);
+  void ReadFilter(const Slice& filter_handle_value, bool full_filter);
+
+  // Returns the filter of the table, or nullptr if it has none.  If the
+  // filter lives in the block cache, stores in *cache_handle the handle
+  // that the caller must release once done with the filter.
+  FilterBlockReader* GetFilter(Cache::Handle** cache_handle) const;
+
+  // Holds on to the index and filter blocks in the block cache for as
+  // long as the table is open, so that they are never evicted.
+  void PinMetaBlocks();
 
   Rep* const rep_;
 };
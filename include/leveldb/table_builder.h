@@ -82,7 +82,16 @@ class LEVELDB_EXPORT TableBuilder {
  private:
   bool ok() const { return status().ok(); }
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
+  void CompressAndWriteBlock(const Slice& raw, const void* zstd_dictionary,
+                             BlockHandle* handle);
   void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+  void AddIndexEntry(const Slice& next_key);
+  void FlushIndexPartition();
+  void WriteDataBlock(const Slice& raw, const Slice& contents,
+                      CompressionType type);
+  void WriteBufferedBlocks();
+  void SubmitDataBlock(const Slice& raw);
+  void WriteCompressedBlocks(size_t max_pending);
 
   struct Rep;
   Rep* rep_;
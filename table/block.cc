@@ -6,6 +6,10 @@
 
 #include "table/block.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 #include <algorithm>
 #include <cstdint>
 #include <vector>
@@ -13,29 +17,55 @@
 #include "leveldb/comparator.h"
 #include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 #include "util/logging.h"
 
 namespace leveldb {
 
-inline uint32_t Block::NumRestarts() const {
-  assert(size_ >= sizeof(uint32_t));
-  return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
-}
-
 Block::Block(const BlockContents& contents)
     : data_(contents.data.data()),
       size_(contents.data.size()),
+      num_restarts_(0),
+      restart_prefixes_(nullptr),
+      hash_index_(nullptr),
+      num_buckets_(0),
       owned_(contents.heap_allocated) {
   if (size_ < sizeof(uint32_t)) {
     size_ = 0;  // Error marker
-  } else {
-    size_t max_restarts_allowed = (size_ - sizeof(uint32_t)) / sizeof(uint32_t);
-    if (NumRestarts() > max_restarts_allowed) {
-      // The size is too small for NumRestarts()
+    return;
+  }
+  num_restarts_ = DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+  size_t limit = size_ - sizeof(uint32_t);  // End of the restart array
+  if ((num_restarts_ & kBlockHashIndexFlag) != 0) {
+    num_restarts_ &= ~kBlockHashIndexFlag;
+    if (limit < sizeof(uint32_t)) {
       size_ = 0;
-    } else {
-      restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
+      return;
+    }
+    num_buckets_ = DecodeFixed32(data_ + limit - sizeof(uint32_t));
+    limit -= sizeof(uint32_t);
+    if (num_buckets_ == 0 || num_buckets_ > limit) {
+      size_ = 0;
+      return;
+    }
+    limit -= num_buckets_;
+    hash_index_ = data_ + limit;
+  }
+  if ((num_restarts_ & kBlockRestartPrefixFlag) != 0) {
+    num_restarts_ &= ~kBlockRestartPrefixFlag;
+    if (num_restarts_ > limit / sizeof(uint64_t)) {
+      size_ = 0;
+      return;
     }
+    limit -= num_restarts_ * sizeof(uint64_t);
+    restart_prefixes_ = data_ + limit;
+  }
+  size_t max_restarts_allowed = limit / sizeof(uint32_t);
+  if (num_restarts_ > max_restarts_allowed) {
+    // The size is too small for num_restarts_
+    size_ = 0;
+  } else {
+    restart_offset_ = limit - num_restarts_ * sizeof(uint32_t);
   }
 }
 
@@ -74,12 +104,48 @@ static inline const char* DecodeEntry(const char* p, const char* limit,
   return p;
 }
 
+// Block::Iter::Seek scans at most this many restart key prefixes.
+static const uint32_t kMaxPrefixScan = 64;
+
+// Counts the "n" restart key prefixes at "p" that are less than "target",
+// into *less, and those that are greater, into *greater.
+static inline void CountPrefixes(const char* p, uint32_t n, uint64_t target,
+                                 uint32_t* less, uint32_t* greater) {
+  uint32_t i = 0;
+  uint32_t lt = 0, gt = 0;
+#if defined(__AVX2__)
+  // Four prefixes at a time.  The comparisons are signed, so flip the top
+  // bits to compare as unsigned.
+  const __m256i flip = _mm256_set1_epi64x(static_cast<int64_t>(1ull << 63));
+  const __m256i t =
+      _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(target)), flip);
+  for (; i + 4 <= n; i += 4) {
+    const __m256i v = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 8 * i)), flip);
+    lt += __builtin_popcount(
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(t, v))));
+    gt += __builtin_popcount(
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, t))));
+  }
+#endif
+  for (; i < n; i++) {
+    const uint64_t prefix = DecodeFixed64(p + 8 * i);
+    lt += prefix < target;
+    gt += prefix > target;
+  }
+  *less = lt;
+  *greater = gt;
+}
+
 class Block::Iter : public Iterator {
  private:
   const Comparator* const comparator_;
   const char* const data_;       // underlying block contents
   uint32_t const restarts_;      // Offset of restart array (list of fixed32)
   uint32_t const num_restarts_;  // Number of uint32_t entries in restart array
+  const char* const restart_prefixes_;  // See Block::restart_prefixes_
+  const char* const hash_index_;        // See Block::hash_index_
+  uint32_t const num_buckets_;
 
   // current_ is offset in data_ of current entry.  >= restarts_ if !Valid
   uint32_t current_;
@@ -114,11 +180,15 @@ class Block::Iter : public Iterator {
 
  public:
   Iter(const Comparator* comparator, const char* data, uint32_t restarts,
-       uint32_t num_restarts)
+       uint32_t num_restarts, const char* restart_prefixes,
+       const char* hash_index, uint32_t num_buckets)
       : comparator_(comparator),
         data_(data),
         restarts_(restarts),
         num_restarts_(num_restarts),
+        restart_prefixes_(restart_prefixes),
+        hash_index_(hash_index),
+        num_buckets_(num_buckets),
         current_(restarts_),
         restart_index_(num_restarts_) {
     assert(num_restarts_ > 0);
@@ -162,6 +232,10 @@ class Block::Iter : public Iterator {
   }
 
   void Seek(const Slice& target) override {
+    if (hash_index_ != nullptr && SeekWithHashIndex(target)) {
+      return;
+    }
+
     // Binary search in restart array to find the last restart point
     // with a key < target
     uint32_t left = 0;
@@ -184,6 +258,10 @@ class Block::Iter : public Iterator {
       }
     }
 
+    if (restart_prefixes_ != nullptr && left < right) {
+      NarrowWithPrefixes(target, &left, &right);
+    }
+
     while (left < right) {
       uint32_t mid = (left + right + 1) / 2;
       uint32_t region_offset = GetRestartPoint(mid);
@@ -239,6 +317,66 @@ class Block::Iter : public Iterator {
   }
 
  private:
+  // Narrows the search for the last restart point with a key < "target"
+  // from [*left, *right] down to the restart points whose key prefix ties
+  // with target's, without decoding any entries.
+  void NarrowWithPrefixes(const Slice& target, uint32_t* left,
+                          uint32_t* right) {
+    const uint64_t target_prefix = RestartKeyPrefix(target);
+    // Binary search down to a run short enough to scan
+    while (*right - *left > kMaxPrefixScan) {
+      const uint32_t mid = (*left + *right + 1) / 2;
+      const uint64_t prefix =
+          DecodeFixed64(restart_prefixes_ + mid * sizeof(uint64_t));
+      if (prefix < target_prefix) {
+        *left = mid;
+      } else if (prefix > target_prefix) {
+        *right = mid - 1;
+      } else {
+        break;
+      }
+    }
+    // Prefixes are sorted, so the restart points after *left with a
+    // smaller prefix come first, and those with a greater one last
+    uint32_t less, greater;
+    CountPrefixes(restart_prefixes_ + (*left + 1) * sizeof(uint64_t),
+                  *right - *left, target_prefix, &less, &greater);
+    *right -= greater;
+    *left += less;
+  }
+
+  // Tries to seek to "target" through the hash index.  Returns false if
+  // the index cannot place "target", leaving the position unspecified.
+  bool SeekWithHashIndex(const Slice& target) {
+    if (target.size() < 8) {
+      return false;
+    }
+    const Slice user_key(target.data(), target.size() - 8);
+    const uint32_t h = Hash(user_key.data(), user_key.size(), kHashIndexSeed);
+    const uint8_t restart =
+        static_cast<uint8_t>(hash_index_[h % num_buckets_]);
+    if (restart == kHashIndexNoEntry || restart == kHashIndexCollision ||
+        restart >= num_restarts_) {
+      return false;
+    }
+
+    // All the entries of a user key in the block are in the interval its
+    // bucket names, so every entry before that interval is < target
+    SeekToRestartPoint(restart);
+    while (true) {
+      if (!ParseNextKey()) {
+        return !status_.ok();
+      }
+      if (Compare(key_, target) >= 0) {
+        break;
+      }
+    }
+    // Other user keys in the same bucket land in the wrong interval, but
+    // their search ends on a different user key
+    return key_.size() >= 8 &&
+           Slice(key_.data(), key_.size() - 8) == user_key;
+  }
+
   void CorruptionError() {
     current_ = restarts_;
     restart_index_ = num_restarts_;
@@ -281,11 +419,11 @@ Iterator* Block::NewIterator(const Comparator* comparator) {
   if (size_ < sizeof(uint32_t)) {
     return NewErrorIterator(Status::Corruption("bad block contents"));
   }
-  const uint32_t num_restarts = NumRestarts();
-  if (num_restarts == 0) {
+  if (num_restarts_ == 0) {
     return NewEmptyIterator();
   } else {
-    return new Iter(comparator, data_, restart_offset_, num_restarts);
+    return new Iter(comparator, data_, restart_offset_, num_restarts_,
+                    restart_prefixes_, hash_index_, num_buckets_);
   }
 }
 
@@ -31,12 +31,14 @@ class Block {
  private:
   class Iter;
 
-  uint32_t NumRestarts() const;
-
   const char* data_;
   size_t size_;
   uint32_t restart_offset_;  // Offset in data_ of restart array
-  bool owned_;               // Block owns data_[]
+  uint32_t num_restarts_;
+  const char* restart_prefixes_;  // One fixed64 per restart, or nullptr
+  const char* hash_index_;  // Buckets of the hash index, or nullptr
+  uint32_t num_buckets_;
+  bool owned_;              // Block owns data_[]
 };
 
 }  // namespace leveldb
@@ -25,6 +25,9 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// Data blocks may extend the trailer with restart key prefixes and a hash
+// index, which table/format.h describes, and flag them in num_restarts.
 
 #include "table/block_builder.h"
 
@@ -33,12 +36,18 @@
 
 #include "leveldb/comparator.h"
 #include "leveldb/options.h"
+#include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 
 namespace leveldb {
 
-BlockBuilder::BlockBuilder(const Options* options)
-    : options_(options), restarts_(), counter_(0), finished_(false) {
+BlockBuilder::BlockBuilder(const Options* options, bool data_block)
+    : options_(options),
+      restarts_(),
+      counter_(0),
+      finished_(false),
+      data_block_(data_block) {
   assert(options->block_restart_interval >= 1);
   restarts_.push_back(0);  // First restart point is at offset 0
 }
@@ -50,12 +59,30 @@ void BlockBuilder::Reset() {
   counter_ = 0;
   finished_ = false;
   last_key_.clear();
+  hash_entries_.clear();
+  restart_prefixes_.clear();
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const {
   return (buffer_.size() +                       // Raw data buffer
           restarts_.size() * sizeof(uint32_t) +  // Restart array
-          sizeof(uint32_t));                     // Restart array length
+          sizeof(uint32_t) +                     // Restart array length
+          restart_prefixes_.size() * sizeof(uint64_t) +
+          HashIndexSizeEstimate());
+}
+
+size_t BlockBuilder::HashIndexSizeEstimate() const {
+  if (hash_entries_.empty()) {
+    return 0;
+  }
+  return NumHashBuckets() + sizeof(uint32_t);
+}
+
+uint32_t BlockBuilder::NumHashBuckets() const {
+  const double ratio = options_->data_block_hash_table_util_ratio;
+  return static_cast<uint32_t>(hash_entries_.size() /
+                               (ratio > 0 ? ratio : 0.75)) +
+         1;
 }
 
 Slice BlockBuilder::Finish() {
@@ -63,7 +90,30 @@ Slice BlockBuilder::Finish() {
   for (size_t i = 0; i < restarts_.size(); i++) {
     PutFixed32(&buffer_, restarts_[i]);
   }
-  PutFixed32(&buffer_, restarts_.size());
+  uint32_t num_restarts = restarts_.size();
+  if (!restart_prefixes_.empty() &&
+      restart_prefixes_.size() == restarts_.size()) {
+    for (uint64_t prefix : restart_prefixes_) {
+      PutFixed64(&buffer_, prefix);
+    }
+    num_restarts |= kBlockRestartPrefixFlag;
+  }
+  if (!hash_entries_.empty() && restarts_.size() <= kMaxHashIndexRestarts) {
+    const uint32_t num_buckets = NumHashBuckets();
+    std::string buckets(num_buckets, static_cast<char>(kHashIndexNoEntry));
+    for (const auto& entry : hash_entries_) {
+      char& bucket = buckets[entry.first % num_buckets];
+      if (static_cast<uint8_t>(bucket) == kHashIndexNoEntry) {
+        bucket = static_cast<char>(entry.second);
+      } else if (static_cast<uint8_t>(bucket) != entry.second) {
+        bucket = static_cast<char>(kHashIndexCollision);
+      }
+    }
+    buffer_.append(buckets);
+    PutFixed32(&buffer_, num_buckets);
+    num_restarts |= kBlockHashIndexFlag;
+  }
+  PutFixed32(&buffer_, num_restarts);
   finished_ = true;
   return Slice(buffer_);
 }
@@ -87,6 +137,11 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
     counter_ = 0;
   }
   const size_t non_shared = key.size() - shared;
+  if (counter_ == 0 && data_block_ && options_->data_block_restart_prefixes &&
+      restart_prefixes_.size() + 1 == restarts_.size()) {
+    // A restart point, in a block that has had the option since it began
+    restart_prefixes_.push_back(RestartKeyPrefix(key));
+  }
 
   // Add "<shared><non_shared><value_size>" to buffer_
   PutVarint32(&buffer_, shared);
@@ -102,6 +157,17 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
   last_key_.append(key.data() + shared, non_shared);
   assert(Slice(last_key_) == key);
   counter_++;
+
+  if (data_block_ && options_->data_block_hash_index && key.size() >= 8) {
+    // Keys share a user key with the previous one in the same interval
+    // most often because they are older versions of it
+    const uint32_t restart = restarts_.size() - 1;
+    const uint32_t h = Hash(key.data(), key.size() - 8, kHashIndexSeed);
+    if (hash_entries_.empty() || hash_entries_.back().first != h ||
+        hash_entries_.back().second != restart) {
+      hash_entries_.emplace_back(h, restart);
+    }
+  }
 }
 
 }  // namespace leveldb
@@ -6,6 +6,8 @@
 #define STORAGE_LEVELDB_TABLE_BLOCK_BUILDER_H_
 
 #include <cstdint>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "leveldb/slice.h"
@@ -16,7 +18,10 @@ struct Options;
 
 class BlockBuilder {
  public:
-  explicit BlockBuilder(const Options* options);
+  // Data blocks get a hash index when options->data_block_hash_index is
+  // set, and restart key prefixes when options->data_block_restart_prefixes
+  // is set; their keys must then be internal keys.
+  explicit BlockBuilder(const Options* options, bool data_block = false);
 
   BlockBuilder(const BlockBuilder&) = delete;
   BlockBuilder& operator=(const BlockBuilder&) = delete;
@@ -41,12 +46,20 @@ class BlockBuilder {
   bool empty() const { return buffer_.empty(); }
 
  private:
+  size_t HashIndexSizeEstimate() const;
+  uint32_t NumHashBuckets() const;
+
   const Options* options_;
   std::string buffer_;              // Destination buffer
   std::vector<uint32_t> restarts_;  // Restart points
   int counter_;                     // Number of entries emitted since restart
   bool finished_;                   // Has Finish() been called?
   std::string last_key_;
+
+  const bool data_block_;
+  // Hash and restart interval of each user key, for the hash index
+  std::vector<std::pair<uint32_t, uint32_t>> hash_entries_;
+  std::vector<uint64_t> restart_prefixes_;  // Of each restart point, if any
 };
 
 }  // namespace leveldb
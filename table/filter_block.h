@@ -18,15 +18,15 @@
 #include "util/hash.h"
 
 /*
-ļleveldbеĹ࣬ʵݿĹܣ粼¡
-ĹͨͶȡŻLevelDBĲܡ
-FilterBlockBuilderฺ𴴽
-FilterBlockReaderฺʹùжĳǷضݿС
-ͨЧùLevelDBܹٲҪĴ̶ȡݷЧʡ
+该文件定义了leveldb中的过滤器块的相关类，用于实现数据块的过滤器功能，比如布隆过滤器。
+核心功能是通过构建和读取过滤器块来优化LevelDB的查找性能。
+FilterBlockBuilder类负责创建过滤器，
+FilterBlockReader类负责使用过滤器来判断某个键是否可能在特定数据块中。
+通过有效利用过滤器，LevelDB能够减少不必要的磁盘读取，提高数据访问效率。
 */
 namespace leveldb {
 
-/*࣬Ĳԡûֱӵʵ*/
+/*抽象基类，负责定义过滤器的策略。它并没有直接的实现*/
 class FilterPolicy;
 
 // A FilterBlockBuilder is used to construct all of the filters for a
@@ -35,10 +35,13 @@ class FilterPolicy;
 //
 // The sequence of calls to FilterBlockBuilder must match the regexp:
 //      (StartBlock AddKey*)* Finish
-/*һfilterPolicyָ룬ָ*/
+//
+// If "full_filter" is true, the block is instead a single filter over
+// all of the keys, as produced by the policy, and StartBlock() is a no-op.
+/*接受一个filterPolicy指针，指定过滤器策略*/
 class FilterBlockBuilder {
  public:
-  explicit FilterBlockBuilder(const FilterPolicy*);
+  explicit FilterBlockBuilder(const FilterPolicy*, bool full_filter = false);
 
   FilterBlockBuilder(const FilterBlockBuilder&) = delete;
   FilterBlockBuilder& operator=(const FilterBlockBuilder&) = delete;
@@ -50,32 +53,44 @@ class FilterBlockBuilder {
  private:
   void GenerateFilter();
 
-  const FilterPolicy* policy_; // ԡ
-  std::string keys_;             // չƽļݡ
-  std::vector<size_t> start_;    // ÿ keys_ еʼ
-  std::string result_;           // ǰĹݡ
-  std::vector<Slice> tmp_keys_;  // policy_->CreateFilter() argument ʱ洢
-  std::vector<uint32_t> filter_offsets_; // ĸݡ
+  const FilterPolicy* policy_; // 过滤器策略。
+  const bool full_filter_;
+  std::string keys_;             // 已展平的键内容。
+  std::vector<size_t> start_;    // 每个键在 keys_ 中的起始索引。
+  std::string result_;           // 当前计算的过滤器数据。
+  std::vector<Slice> tmp_keys_;  // policy_->CreateFilter() argument 临时存储
+  std::vector<uint32_t> filter_offsets_; // 计算过滤器的辅助数据。
 };
 
-/* FilterPolicy ָ͹ݵƬʼȡ*/
+/*接收 FilterPolicy 指针和过滤器数据的切片，初始化读取器*/
 class FilterBlockReader {
  public:
   // REQUIRES: "contents" and *policy must stay live while *this is live.
-  FilterBlockReader(const FilterPolicy* policy, const Slice& contents);
+  FilterBlockReader(const FilterPolicy* policy, const Slice& contents,
+                    bool full_filter = false);
+
+  // Whether this is a full filter, built with full_filter set.
+  bool IsFullFilter() const { return full_filter_; }
+
+  // Returns false only if "key" is in none of the data blocks.
+  // REQUIRES: IsFullFilter()
+  bool KeyMayMatch(const Slice& key);
+
   /*
-  ļǷƥָƫݿ顣
-   trueʾܴڸÿУ
-  ȷÿвڸü
+  检查给定的键是否可能匹配指定偏移量的数据块。
+  如果返回 true，表示键可能存在于该块中，
+  否则可以确定该块中不存在该键。
   */
   bool KeyMayMatch(uint64_t block_offset, const Slice& key);
 
  private:
   const FilterPolicy* policy_;
+  const bool full_filter_;
+  Slice full_filter_contents_;  // The whole filter if full_filter_
   const char* data_;    // Pointer to filter data (at block-start)
   const char* offset_;  // Pointer to beginning of offset array (at block-end)
-  size_t num_;          // ƫеĿ
-  size_t base_lg_;      //  (see kFilterBaseLg in .cc file)
+  size_t num_;          // 偏移数组中的条目数。
+  size_t base_lg_;      // 编码参数 (see kFilterBaseLg in .cc file)
 };
 
 }  // namespace leveldb
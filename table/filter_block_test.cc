@@ -119,4 +119,36 @@ TEST_F(FilterBlockTest, MultiChunk) {
   ASSERT_TRUE(!reader.KeyMayMatch(9000, "bar"));
 }
 
+TEST_F(FilterBlockTest, EmptyFullFilter) {
+  FilterBlockBuilder builder(&policy_, true);
+  Slice block = builder.Finish();
+  ASSERT_EQ("", EscapeString(block));
+  FilterBlockReader reader(&policy_, block, true);
+  ASSERT_TRUE(reader.IsFullFilter());
+  ASSERT_TRUE(!reader.KeyMayMatch("foo"));
+}
+
+TEST_F(FilterBlockTest, FullFilter) {
+  FilterBlockBuilder builder(&policy_, true);
+  builder.StartBlock(0);
+  builder.AddKey("foo");
+  builder.AddKey("bar");
+  builder.StartBlock(3100);
+  builder.AddKey("box");
+  builder.StartBlock(9000);
+  builder.AddKey("hello");
+  Slice block = builder.Finish();
+
+  // A single filter covers every key, whatever block it is in
+  FilterBlockReader reader(&policy_, block, true);
+  ASSERT_TRUE(reader.IsFullFilter());
+  for (const char* key : {"foo", "bar", "box", "hello"}) {
+    ASSERT_TRUE(reader.KeyMayMatch(key));
+    ASSERT_TRUE(reader.KeyMayMatch(0, key));
+    ASSERT_TRUE(reader.KeyMayMatch(9000, key));
+  }
+  ASSERT_TRUE(!reader.KeyMayMatch("missing"));
+  ASSERT_TRUE(!reader.KeyMayMatch(3100, "other"));
+}
+
 }  // namespace leveldb
@@ -4,12 +4,15 @@
 
 #include "table/format.h"
 
+#include <cstring>
+
 #include "leveldb/env.h"
 #include "leveldb/options.h"
 #include "port/port.h"
 #include "table/block.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/xxh3.h"
 
 namespace leveldb {
 
@@ -33,7 +36,10 @@ void Footer::EncodeTo(std::string* dst) const {
   const size_t original_size = dst->size();
   metaindex_handle_.EncodeTo(dst);
   index_handle_.EncodeTo(dst);
-  dst->resize(2 * BlockHandle::kMaxEncodedLength);  // Padding
+  // Handles only fill the padding in files of more than 2^56 bytes
+  assert(dst->size() < original_size + 2 * BlockHandle::kMaxEncodedLength);
+  dst->resize(original_size + 2 * BlockHandle::kMaxEncodedLength);  // Padding
+  (*dst)[dst->size() - 1] = static_cast<char>(checksum_type_);
   PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber & 0xffffffffu));
   PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber >> 32));
   assert(dst->size() == original_size + kEncodedLength);
@@ -54,6 +60,12 @@ Status Footer::DecodeFrom(Slice* input) {
     return Status::Corruption("not an sstable (bad magic number)");
   }
 
+  const uint8_t checksum_type = static_cast<uint8_t>(magic_ptr[-1]);
+  if (checksum_type > kXXH3) {
+    return Status::NotSupported("unknown table checksum type");
+  }
+  checksum_type_ = static_cast<ChecksumType>(checksum_type);
+
   Status result = metaindex_handle_.DecodeFrom(input);
   if (result.ok()) {
     result = index_handle_.DecodeFrom(input);
@@ -66,8 +78,25 @@ Status Footer::DecodeFrom(Slice* input) {
   return result;
 }
 
-Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result) {
+uint32_t BlockChecksum(const char* data, size_t n, char type) {
+  if (static_cast<uint8_t>(type) & kBlockChecksumXXH3Flag) {
+    // Fold the type byte in by multiplying with a large odd constant, as
+    // XXH3 cannot be extended the way crc32c is
+    return static_cast<uint32_t>(xxh3::Value(data, n)) ^
+           (static_cast<uint8_t>(type) * 0x6b9083d9u);
+  }
+  uint32_t crc = crc32c::Value(data, n);
+  crc = crc32c::Extend(crc, &type, 1);  // Extend crc to cover block type
+  return crc32c::Mask(crc);
+}
+
+// Returns whether the trailer after data[0,n-1] holds the right checksum.
+static bool BlockChecksumMatches(const char* data, size_t n) {
+  return DecodeFixed32(data + n + 1) == BlockChecksum(data, n, data[n]);
+}
+
+Status ReadRawBlock(RandomAccessFile* file, const ReadOptions& options,
+                    const BlockHandle& handle, BlockContents* result) {
   result->data = Slice();
   result->cachable = false;
   result->heap_allocated = false;
@@ -87,78 +116,141 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
     return Status::Corruption("truncated block read");
   }
 
-  // Check the crc of the type and the block contents
+  // Check the checksum of the type and the block contents
   const char* data = contents.data();  // Pointer to where Read put the data
-  if (options.verify_checksums) {
-    const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
-    const uint32_t actual = crc32c::Value(data, n + 1);
-    if (actual != crc) {
-      delete[] buf;
-      s = Status::Corruption("block checksum mismatch");
-      return s;
-    }
+  if (options.verify_checksums && !BlockChecksumMatches(data, n)) {
+    delete[] buf;
+    s = Status::Corruption("block checksum mismatch");
+    return s;
   }
 
-  switch (data[n]) {
-    case kNoCompression:
-      if (data != buf) {
-        // File implementation gave us pointer to some other data.
-        // Use it directly under the assumption that it will be live
-        // while the file is open.
-        delete[] buf;
-        result->data = Slice(data, n);
-        result->heap_allocated = false;
-        result->cachable = false;  // Do not double-cache
-      } else {
-        result->data = Slice(buf, n);
-        result->heap_allocated = true;
-        result->cachable = true;
-      }
+  if (data != buf) {
+    // File implementation gave us pointer to some other data.
+    // Use it directly under the assumption that it will be live
+    // while the file is open.
+    delete[] buf;
+    result->data = Slice(data, n + 1);
+    result->heap_allocated = false;
+    result->cachable = false;  // Do not double-cache
+  } else {
+    result->data = Slice(buf, n + 1);
+    result->heap_allocated = true;
+    result->cachable = true;
+  }
+  return Status::OK();
+}
+
+Status ParseStoredBlock(const Slice& stored, const ReadOptions& options,
+                        BlockContents* result) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  if (stored.size() < kBlockTrailerSize) {
+    return Status::Corruption("truncated block read");
+  }
+  const size_t n = stored.size() - kBlockTrailerSize;
+  if (options.verify_checksums && !BlockChecksumMatches(stored.data(), n)) {
+    return Status::Corruption("block checksum mismatch");
+  }
+  char* buf = new char[n + 1];
+  std::memcpy(buf, stored.data(), n + 1);
+  result->data = Slice(buf, n + 1);
+  result->heap_allocated = true;
+  result->cachable = true;
+  return Status::OK();
+}
 
-      // Ok
+Status UncompressBlock(const Slice& raw, BlockContents* result,
+                       const void* zstd_dictionary) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  if (raw.empty()) {
+    return Status::Corruption("bad block type");
+  }
+  const char* data = raw.data();
+  const size_t n = raw.size() - 1;
+
+  char* ubuf;
+  size_t ulength = 0;
+  switch (BlockCompressionType(data[n])) {
+    case kNoCompression:
+      ubuf = new char[n];
+      std::memcpy(ubuf, data, n);
+      ulength = n;
       break;
     case kSnappyCompression: {
-      size_t ulength = 0;
       if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
-        delete[] buf;
         return Status::Corruption("corrupted snappy compressed block length");
       }
-      char* ubuf = new char[ulength];
+      ubuf = new char[ulength];
       if (!port::Snappy_Uncompress(data, n, ubuf)) {
-        delete[] buf;
         delete[] ubuf;
         return Status::Corruption("corrupted snappy compressed block contents");
       }
-      delete[] buf;
-      result->data = Slice(ubuf, ulength);
-      result->heap_allocated = true;
-      result->cachable = true;
       break;
     }
     case kZstdCompression: {
-      size_t ulength = 0;
       if (!port::Zstd_GetUncompressedLength(data, n, &ulength)) {
-        delete[] buf;
         return Status::Corruption("corrupted zstd compressed block length");
       }
-      char* ubuf = new char[ulength];
-      if (!port::Zstd_Uncompress(data, n, ubuf)) {
-        delete[] buf;
+      ubuf = new char[ulength];
+      // Blocks compressed without the dictionary decompress with it too
+      if (zstd_dictionary != nullptr
+              ? !port::Zstd_UncompressWithDictionary(zstd_dictionary, data, n,
+                                                     ubuf)
+              : !port::Zstd_Uncompress(data, n, ubuf)) {
         delete[] ubuf;
         return Status::Corruption("corrupted zstd compressed block contents");
       }
-      delete[] buf;
-      result->data = Slice(ubuf, ulength);
-      result->heap_allocated = true;
-      result->cachable = true;
+      break;
+    }
+    case kLZ4Compression:
+    case kLZ4HCCompression: {
+      uint32_t length;
+      const char* p = GetVarint32Ptr(data, data + n, &length);
+      if (p == nullptr) {
+        return Status::Corruption("corrupted lz4 compressed block length");
+      }
+      ulength = length;
+      ubuf = new char[ulength];
+      if (!port::Lz4_Uncompress(p, data + n - p, ubuf, ulength)) {
+        delete[] ubuf;
+        return Status::Corruption("corrupted lz4 compressed block contents");
+      }
       break;
     }
     default:
-      delete[] buf;
       return Status::Corruption("bad block type");
   }
-
+  result->data = Slice(ubuf, ulength);
+  result->heap_allocated = true;
+  result->cachable = true;
   return Status::OK();
 }
 
+Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
+                 const BlockHandle& handle, BlockContents* result,
+                 const void* zstd_dictionary) {
+  BlockContents raw;
+  Status s = ReadRawBlock(file, options, handle, &raw);
+  if (!s.ok()) {
+    *result = raw;
+    return s;
+  }
+
+  const size_t n = raw.data.size() - 1;
+  if (BlockCompressionType(raw.data[n]) == kNoCompression) {
+    // Ok; the contents are used in place
+    *result = raw;
+    result->data = Slice(raw.data.data(), n);
+    return s;
+  }
+  s = UncompressBlock(raw.data, result, zstd_dictionary);
+  if (raw.heap_allocated) {
+    delete[] raw.data.data();
+  }
+  return s;
+}
+
 }  // namespace leveldb
@@ -49,7 +49,9 @@ class Footer {
  public:
   // Encoded length of a Footer.  Note that the serialization of a
   // Footer will always occupy exactly this many bytes.  It consists
-  // of two block handles and a magic number.
+  // of two block handles and a magic number.  The last byte of the
+  // padding after the handles holds the checksum type of the blocks,
+  // which is zero (crc32c) in tables that predate it.
   enum { kEncodedLength = 2 * BlockHandle::kMaxEncodedLength + 8 };
 
   Footer() = default;
@@ -62,12 +64,17 @@ class Footer {
   const BlockHandle& index_handle() const { return index_handle_; }
   void set_index_handle(const BlockHandle& h) { index_handle_ = h; }
 
+  // The checksum of the blocks of the table
+  ChecksumType checksum_type() const { return checksum_type_; }
+  void set_checksum_type(ChecksumType t) { checksum_type_ = t; }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(Slice* input);
 
  private:
   BlockHandle metaindex_handle_;
   BlockHandle index_handle_;
+  ChecksumType checksum_type_ = kCRC32c;
 };
 
 // kTableMagicNumber was picked by running
@@ -78,6 +85,55 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// Blocks checksummed with kXXH3 have this bit set in the type byte of
+// their trailer, so that each block can be verified on its own.  The
+// other bits hold the CompressionType.
+static const uint8_t kBlockChecksumXXH3Flag = 0x80;
+
+// Returns the compression type in the trailer type byte "type".
+inline CompressionType BlockCompressionType(char type) {
+  return static_cast<CompressionType>(static_cast<uint8_t>(type) &
+                                      ~kBlockChecksumXXH3Flag);
+}
+
+// Returns the checksum stored in the trailer of a block whose contents
+// are data[0,n-1] and whose trailer type byte is "type".  The checksum
+// covers the type byte too.
+uint32_t BlockChecksum(const char* data, size_t n, char type);
+
+// Data blocks with a hash index have this bit set in their restart count.
+// The hash index follows the restart array: one byte per bucket holding
+// the restart interval of the keys in it, then the bucket count as a
+// fixed32.  Buckets can only name the first kMaxHashIndexRestarts
+// intervals.
+static const uint32_t kBlockHashIndexFlag = 1u << 31;
+static const uint8_t kHashIndexNoEntry = 255;
+static const uint8_t kHashIndexCollision = 254;
+static const uint32_t kMaxHashIndexRestarts = 254;
+static const uint32_t kHashIndexSeed = 0x5be0cd19;
+
+// Data blocks with restart key prefixes have this bit set in their restart
+// count.  The prefixes follow the restart array, ahead of any hash index:
+// one fixed64 per restart point holding RestartKeyPrefix() of its key.
+static const uint32_t kBlockRestartPrefixFlag = 1u << 30;
+
+// Returns the first eight bytes of the user key of "internal_key" as a
+// big-endian number, padded with zeros.  Comparing prefixes as numbers
+// orders keys as a bytewise comparator does, except that keys whose
+// prefixes are equal may still differ.
+inline uint64_t RestartKeyPrefix(const Slice& internal_key) {
+  const size_t n = internal_key.size() >= 8 ? internal_key.size() - 8
+                                            : internal_key.size();
+  uint64_t prefix = 0;
+  for (size_t i = 0; i < 8; i++) {
+    prefix <<= 8;
+    if (i < n) {
+      prefix |= static_cast<uint8_t>(internal_key[i]);
+    }
+  }
+  return prefix;
+}
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
@@ -86,8 +142,30 @@ struct BlockContents {
 
 // Read the block identified by "handle" from "file".  On failure
 // return non-OK.  On success fill *result and return OK.
+//
+// "zstd_dictionary" is the table's zstd dictionary as digested by
+// port::Zstd_NewUncompressionDictionary, or null if it has none.
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result);
+                 const BlockHandle& handle, BlockContents* result,
+                 const void* zstd_dictionary = nullptr);
+
+// Like ReadBlock, but leaves the block as it is stored in the file: on
+// success result->data holds the (possibly compressed) block contents
+// followed by the one-byte trailer type (see BlockCompressionType).
+Status ReadRawBlock(RandomAccessFile* file, const ReadOptions& options,
+                    const BlockHandle& handle, BlockContents* result);
+
+// Like ReadRawBlock, for a block whose contents and trailer, as stored in
+// the file, have already been read into "stored".  result->data is a heap
+// allocated copy.
+Status ParseStoredBlock(const Slice& stored, const ReadOptions& options,
+                        BlockContents* result);
+
+// Uncompress "raw", laid out as returned by ReadRawBlock, into a heap
+// allocated *result.  "raw" is not modified.  "zstd_dictionary" is as
+// for ReadBlock.
+Status UncompressBlock(const Slice& raw, BlockContents* result,
+                       const void* zstd_dictionary = nullptr);
 
 // Implementation details follow.  Clients should ignore,
 
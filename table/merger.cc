@@ -4,6 +4,8 @@
 
 #include "table/merger.h"
 
+#include <vector>
+
 #include "leveldb/comparator.h"
 #include "leveldb/iterator.h"
 #include "table/iterator_wrapper.h"
@@ -18,10 +20,14 @@ class MergingIterator : public Iterator {
         children_(new IteratorWrapper[n]),
         n_(n),
         current_(nullptr),
-        direction_(kForward) {
+        direction_(kForward),
+        use_heap_(n >= kMinChildrenForHeap) {
     for (int i = 0; i < n; i++) {
       children_[i].Set(children[i]);
     }
+    if (use_heap_) {
+      heap_.reserve(n);
+    }
   }
 
   ~MergingIterator() override { delete[] children_; }
@@ -32,24 +38,24 @@ class MergingIterator : public Iterator {
     for (int i = 0; i < n_; i++) {
       children_[i].SeekToFirst();
     }
-    FindSmallest();
     direction_ = kForward;
+    FindSmallest();
   }
 
   void SeekToLast() override {
     for (int i = 0; i < n_; i++) {
       children_[i].SeekToLast();
     }
-    FindLargest();
     direction_ = kReverse;
+    FindLargest();
   }
 
   void Seek(const Slice& target) override {
     for (int i = 0; i < n_; i++) {
       children_[i].Seek(target);
     }
-    FindSmallest();
     direction_ = kForward;
+    FindSmallest();
   }
 
   void Next() override {
@@ -72,10 +78,16 @@ class MergingIterator : public Iterator {
         }
       }
       direction_ = kForward;
+      current_->Next();
+      FindSmallest();
+    } else {
+      current_->Next();
+      if (use_heap_) {
+        ReplaceTop();
+      } else {
+        FindSmallest();
+      }
     }
-
-    current_->Next();
-    FindSmallest();
   }
 
   void Prev() override {
@@ -101,10 +113,16 @@ class MergingIterator : public Iterator {
         }
       }
       direction_ = kReverse;
+      current_->Prev();
+      FindLargest();
+    } else {
+      current_->Prev();
+      if (use_heap_) {
+        ReplaceTop();
+      } else {
+        FindLargest();
+      }
     }
-
-    current_->Prev();
-    FindLargest();
   }
 
   Slice key() const override {
@@ -132,20 +150,42 @@ class MergingIterator : public Iterator {
   // Which direction is the iterator moving?
   enum Direction { kForward, kReverse };
 
+  // With this many children or more, the valid children are kept in a
+  // heap so that advancing costs O(log n) comparisons instead of O(n).
+  // A handful of children, as for a typical point in time of a DB, is
+  // cheaper to scan.
+  static const int kMinChildrenForHeap = 8;
+
+  // Set current_ to the child with the smallest (largest) key, scanning
+  // all children.  In heap mode, rebuilds the heap instead.
   void FindSmallest();
   void FindLargest();
 
-  // We might want to use a heap in case there are lots of children.
-  // For now we use a simple array since we expect a very small number
-  // of children in leveldb.
+  // Heap mode helpers.  The heap is ordered by the current direction:
+  // the top is the smallest child when moving forward and the largest
+  // child when moving in reverse.  Ties go to the child with the lower
+  // index when moving forward and the higher index in reverse, just like
+  // in the linear scans.
+  bool HeapBefore(IteratorWrapper* a, IteratorWrapper* b) const;
+  void BuildHeap();
+  void SiftDown(size_t i);
+  // Restore the heap after current_, the top, was advanced.
+  void ReplaceTop();
+
   const Comparator* comparator_;
   IteratorWrapper* children_;
   int n_;
   IteratorWrapper* current_;
   Direction direction_;
+  const bool use_heap_;
+  std::vector<IteratorWrapper*> heap_;  // Valid children, in heap mode
 };
 
 void MergingIterator::FindSmallest() {
+  if (use_heap_) {
+    BuildHeap();
+    return;
+  }
   IteratorWrapper* smallest = nullptr;
   for (int i = 0; i < n_; i++) {
     IteratorWrapper* child = &children_[i];
@@ -161,6 +201,10 @@ void MergingIterator::FindSmallest() {
 }
 
 void MergingIterator::FindLargest() {
+  if (use_heap_) {
+    BuildHeap();
+    return;
+  }
   IteratorWrapper* largest = nullptr;
   for (int i = n_ - 1; i >= 0; i--) {
     IteratorWrapper* child = &children_[i];
@@ -174,6 +218,61 @@ void MergingIterator::FindLargest() {
   }
   current_ = largest;
 }
+
+bool MergingIterator::HeapBefore(IteratorWrapper* a,
+                                 IteratorWrapper* b) const {
+  const int r = comparator_->Compare(a->key(), b->key());
+  if (direction_ == kForward) {
+    return r < 0 || (r == 0 && a < b);
+  } else {
+    return r > 0 || (r == 0 && a > b);
+  }
+}
+
+void MergingIterator::BuildHeap() {
+  heap_.clear();
+  for (int i = 0; i < n_; i++) {
+    if (children_[i].Valid()) {
+      heap_.push_back(&children_[i]);
+    }
+  }
+  for (size_t i = heap_.size() / 2; i > 0; i--) {
+    SiftDown(i - 1);
+  }
+  current_ = heap_.empty() ? nullptr : heap_[0];
+}
+
+void MergingIterator::SiftDown(size_t i) {
+  const size_t size = heap_.size();
+  IteratorWrapper* item = heap_[i];
+  while (true) {
+    size_t child = 2 * i + 1;
+    if (child >= size) {
+      break;
+    }
+    if (child + 1 < size && HeapBefore(heap_[child + 1], heap_[child])) {
+      child++;
+    }
+    if (!HeapBefore(heap_[child], item)) {
+      break;
+    }
+    heap_[i] = heap_[child];
+    i = child;
+  }
+  heap_[i] = item;
+}
+
+void MergingIterator::ReplaceTop() {
+  assert(!heap_.empty() && heap_[0] == current_);
+  if (!current_->Valid()) {
+    heap_[0] = heap_.back();
+    heap_.pop_back();
+  }
+  if (!heap_.empty()) {
+    SiftDown(0);
+  }
+  current_ = heap_.empty() ? nullptr : heap_[0];
+}
 }  // namespace
 
 Iterator* NewMergingIterator(const Comparator* comparator, Iterator** children,
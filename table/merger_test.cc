@@ -0,0 +1,167 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "table/merger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+// An iterator over a sorted vector of keys.  The value of each entry is
+// the name of the child it came from.
+class VectorIterator : public Iterator {
+ public:
+  VectorIterator(const std::vector<std::string>& keys, const std::string& name)
+      : keys_(keys), name_(name), index_(keys.size()) {}
+
+  bool Valid() const override { return index_ < keys_.size(); }
+  void SeekToFirst() override { index_ = 0; }
+  void SeekToLast() override {
+    index_ = keys_.empty() ? keys_.size() : keys_.size() - 1;
+  }
+  void Seek(const Slice& target) override {
+    index_ = std::lower_bound(keys_.begin(), keys_.end(), target.ToString()) -
+             keys_.begin();
+  }
+  void Next() override {
+    assert(Valid());
+    index_++;
+  }
+  void Prev() override {
+    assert(Valid());
+    index_ = (index_ == 0) ? keys_.size() : index_ - 1;
+  }
+  Slice key() const override { return keys_[index_]; }
+  Slice value() const override { return name_; }
+  Status status() const override { return Status::OK(); }
+
+ private:
+  const std::vector<std::string> keys_;
+  const std::string name_;
+  size_t index_;
+};
+
+class MergerTest : public testing::Test {
+ public:
+  // Spread "num_keys" distinct keys over "n" children at random.
+  void Build(int n, int num_keys, Random* rnd) {
+    std::vector<std::vector<std::string>> child_keys(n);
+    model_.clear();
+    for (int i = 0; i < num_keys; i++) {
+      char buf[20];
+      std::snprintf(buf, sizeof(buf), "%06d", 2 * i);
+      const int c = rnd->Uniform(n);
+      child_keys[c].push_back(buf);
+      model_.push_back(std::make_pair(buf, std::to_string(c)));
+    }
+    std::vector<Iterator*> children;
+    for (int c = 0; c < n; c++) {
+      children.push_back(new VectorIterator(child_keys[c], std::to_string(c)));
+    }
+    iter_ = NewMergingIterator(BytewiseComparator(), children.data(), n);
+  }
+
+  ~MergerTest() override { delete iter_; }
+
+  // Check that iter_ is positioned at model_[pos], or is not valid if
+  // pos is out of range.
+  void Check(int pos) {
+    if (pos < 0 || pos >= static_cast<int>(model_.size())) {
+      ASSERT_FALSE(iter_->Valid());
+    } else {
+      ASSERT_TRUE(iter_->Valid());
+      ASSERT_EQ(model_[pos].first, iter_->key().ToString());
+      ASSERT_EQ(model_[pos].second, iter_->value().ToString());
+    }
+  }
+
+  std::vector<std::pair<std::string, std::string>> model_;
+  Iterator* iter_ = nullptr;
+};
+
+TEST_F(MergerTest, Empty) {
+  Random rnd(301);
+  Build(0, 0, &rnd);
+  iter_->SeekToFirst();
+  ASSERT_FALSE(iter_->Valid());
+}
+
+TEST_F(MergerTest, Randomized) {
+  Random rnd(301);
+  // Fan-ins on both sides of the switch from a linear scan to a heap.
+  for (int n : {2, 4, 7, 8, 9, 16, 64}) {
+    for (int num_keys : {0, 1, 10, 500}) {
+      delete iter_;
+      Build(n, num_keys, &rnd);
+      const int size = static_cast<int>(model_.size());
+      int pos = -1;
+      for (int step = 0; step < 2000; step++) {
+        if (pos < 0 || pos >= size) {
+          // Reposition an iterator that ran off either end
+          switch (rnd.Uniform(3)) {
+            case 0:
+              iter_->SeekToFirst();
+              pos = 0;
+              break;
+            case 1:
+              iter_->SeekToLast();
+              pos = size - 1;
+              break;
+            default: {
+              const int k = rnd.Uniform(2 * num_keys + 2);
+              char buf[20];
+              std::snprintf(buf, sizeof(buf), "%06d", k);
+              iter_->Seek(buf);
+              pos = (k + 1) / 2;
+              break;
+            }
+          }
+        } else if (rnd.OneIn(2)) {
+          iter_->Next();
+          pos++;
+        } else {
+          iter_->Prev();
+          pos--;
+        }
+        ASSERT_NO_FATAL_FAILURE(Check(pos))
+            << "n=" << n << " keys=" << num_keys << " step=" << step;
+      }
+    }
+  }
+}
+
+TEST_F(MergerTest, DuplicateKeys) {
+  // Every child holds the same keys.  Moving forward, equal keys come
+  // from the children in order.
+  for (int n : {3, 16}) {
+    std::vector<Iterator*> children;
+    std::vector<std::string> keys = {"a", "b", "c"};
+    for (int c = 0; c < n; c++) {
+      children.push_back(new VectorIterator(keys, std::to_string(c)));
+    }
+    Iterator* iter =
+        NewMergingIterator(BytewiseComparator(), children.data(), n);
+    iter->SeekToFirst();
+    for (const std::string& key : keys) {
+      for (int c = 0; c < n; c++) {
+        ASSERT_TRUE(iter->Valid());
+        ASSERT_EQ(key, iter->key().ToString());
+        ASSERT_EQ(std::to_string(c), iter->value().ToString());
+        iter->Next();
+      }
+    }
+    ASSERT_FALSE(iter->Valid());
+    delete iter;
+  }
+}
+
+}  // namespace leveldb
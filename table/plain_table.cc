@@ -0,0 +1,371 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "table/plain_table.h"
+
+#include <cassert>
+
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "table/format.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+static const uint32_t kPlainTableHashSeed = 0x5a3c9e71;
+
+// Offsets of footer fields
+static const size_t kIndexOffsetField = 0;
+static const size_t kNumIndexField = 8;
+static const size_t kBucketsOffsetField = 12;
+static const size_t kNumBucketsField = 20;
+static const size_t kCrcField = 24;
+static const size_t kMagicField = Footer::kEncodedLength - 8;
+
+// The part of "key" covered by the hash index.
+static Slice HashedKey(const Slice& key) {
+  return key.size() >= 8 ? Slice(key.data(), key.size() - 8) : key;
+}
+
+static uint32_t HashKey(const Slice& key) {
+  Slice hashed = HashedKey(key);
+  return Hash(hashed.data(), hashed.size(), kPlainTableHashSeed);
+}
+
+PlainTableBuilder::PlainTableBuilder(const Options& options,
+                                     WritableFile* file)
+    : options_(options),
+      file_(file),
+      offset_(0),
+      num_entries_(0),
+      crc_(0) {}
+
+void PlainTableBuilder::Append(const Slice& data) {
+  if (!status_.ok()) return;
+  status_ = file_->Append(data);
+  if (status_.ok()) {
+    crc_ = crc32c::Extend(crc_, data.data(), data.size());
+    offset_ += data.size();
+  }
+}
+
+void PlainTableBuilder::Add(const Slice& key, const Slice& value) {
+  if (!status_.ok()) return;
+
+  record_.clear();
+  PutVarint32(&record_, key.size());
+  PutVarint32(&record_, value.size());
+  if (offset_ + record_.size() + key.size() + value.size() >=
+      kPlainTableCollision) {
+    // Offsets in the index and the buckets are 32 bits
+    status_ = Status::InvalidArgument("plain table exceeds 4GB");
+    return;
+  }
+  const uint32_t offset = static_cast<uint32_t>(offset_);
+
+  if (num_entries_ % kPlainTableIndexInterval == 0) {
+    index_.push_back(offset);
+  }
+  Slice hashed = HashedKey(key);
+  if (num_entries_ == 0 || hashed != Slice(last_user_key_)) {
+    hashes_.emplace_back(HashKey(key), offset);
+    last_user_key_.assign(hashed.data(), hashed.size());
+  }
+  num_entries_++;
+
+  record_.append(key.data(), key.size());
+  record_.append(value.data(), value.size());
+  Append(record_);
+}
+
+Status PlainTableBuilder::Finish() {
+  const uint64_t index_offset = offset_;
+  std::string buf;
+  for (uint32_t offset : index_) {
+    PutFixed32(&buf, offset);
+  }
+  Append(buf);
+
+  // Aim for the same load factor as the data block hash index
+  const uint64_t buckets_offset = offset_;
+  const uint32_t num_buckets = static_cast<uint32_t>(hashes_.size() / 0.75) + 1;
+  std::vector<uint32_t> buckets(num_buckets, kPlainTableNoEntry);
+  for (const auto& entry : hashes_) {
+    uint32_t& bucket = buckets[entry.first % num_buckets];
+    bucket = (bucket == kPlainTableNoEntry) ? entry.second
+                                            : kPlainTableCollision;
+  }
+  buf.clear();
+  for (uint32_t bucket : buckets) {
+    PutFixed32(&buf, bucket);
+  }
+  Append(buf);
+
+  buf.clear();
+  PutFixed64(&buf, index_offset);
+  PutFixed32(&buf, static_cast<uint32_t>(index_.size()));
+  PutFixed64(&buf, buckets_offset);
+  PutFixed32(&buf, num_buckets);
+  PutFixed32(&buf, crc32c::Mask(crc_));
+  buf.resize(kMagicField);
+  PutFixed64(&buf, kPlainTableMagicNumber);
+  assert(buf.size() == Footer::kEncodedLength);
+  Append(buf);
+  return status_;
+}
+
+class PlainTable::Iter : public Iterator {
+ public:
+  explicit Iter(const PlainTable* table)
+      : table_(table), offset_(table->records_size_), next_(0) {}
+
+  bool Valid() const override { return offset_ < table_->records_size_; }
+  Slice key() const override {
+    assert(Valid());
+    return key_;
+  }
+  Slice value() const override {
+    assert(Valid());
+    return value_;
+  }
+  Status status() const override { return status_; }
+
+  void SeekToFirst() override { ParseAt(0); }
+
+  void SeekToLast() override {
+    if (table_->num_index_ == 0) {
+      ParseAt(table_->records_size_);
+      return;
+    }
+    ParseAt(table_->IndexEntry(table_->num_index_ - 1));
+    while (Valid() && next_ < table_->records_size_) {
+      ParseAt(next_);
+    }
+  }
+
+  void Seek(const Slice& target) override {
+    ParseAt(table_->SeekOffset(target, &status_));
+  }
+
+  void Next() override {
+    assert(Valid());
+    ParseAt(next_);
+  }
+
+  void Prev() override {
+    assert(Valid());
+    const uint32_t original = offset_;
+    if (original == 0) {
+      // No more entries
+      offset_ = table_->records_size_;
+      return;
+    }
+
+    // Scan forward from the last indexed record before the current one
+    uint32_t left = 0;
+    uint32_t right = table_->num_index_ - 1;
+    while (left < right) {
+      uint32_t mid = (left + right + 1) / 2;
+      if (table_->IndexEntry(mid) < original) {
+        left = mid;
+      } else {
+        right = mid - 1;
+      }
+    }
+    ParseAt(table_->IndexEntry(left));
+    while (Valid() && next_ < original) {
+      ParseAt(next_);
+    }
+  }
+
+ private:
+  void ParseAt(uint32_t offset) {
+    offset_ = offset;
+    if (offset_ >= table_->records_size_) {
+      offset_ = table_->records_size_;
+      return;
+    }
+    next_ = table_->DecodeRecord(offset_, &key_, &value_);
+    if (next_ == 0) {
+      status_ = Status::Corruption("bad entry in plain table");
+      offset_ = table_->records_size_;
+    }
+  }
+
+  const PlainTable* const table_;
+  Status status_;
+  uint32_t offset_;  // Offset of the current record; records_size_ if !Valid()
+  uint32_t next_;    // Offset of the record after the current one
+  Slice key_;
+  Slice value_;
+};
+
+Status PlainTable::Open(const Options& options, RandomAccessFile* file,
+                        uint64_t size, const Slice& footer,
+                        PlainTable** table) {
+  *table = nullptr;
+  assert(footer.size() == Footer::kEncodedLength);
+  const char* f = footer.data();
+  const uint64_t index_offset = DecodeFixed64(f + kIndexOffsetField);
+  const uint32_t num_index = DecodeFixed32(f + kNumIndexField);
+  const uint64_t buckets_offset = DecodeFixed64(f + kBucketsOffsetField);
+  const uint32_t num_buckets = DecodeFixed32(f + kNumBucketsField);
+  const uint64_t data_size = size - Footer::kEncodedLength;
+  if (index_offset >= kPlainTableCollision ||
+      buckets_offset != index_offset + 4ull * num_index ||
+      buckets_offset + 4ull * num_buckets != data_size) {
+    return Status::Corruption("bad plain table footer");
+  }
+
+  // Files that are memory-mapped hand out their own memory, so the buffer
+  // is only kept for files that copy into it
+  char* buf = new char[data_size];
+  Slice contents;
+  Status s = file->Read(0, data_size, &contents, buf);
+  if (s.ok() && contents.size() != data_size) {
+    s = Status::Corruption("truncated plain table read");
+  }
+  if (s.ok() && options.paranoid_checks) {
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(f + kCrcField));
+    if (crc32c::Value(contents.data(), contents.size()) != crc) {
+      s = Status::Corruption("plain table checksum mismatch");
+    }
+  }
+  if (!s.ok()) {
+    delete[] buf;
+    return s;
+  }
+  if (contents.data() != buf) {
+    delete[] buf;
+    buf = nullptr;
+  }
+
+  PlainTable* t = new PlainTable;
+  t->comparator_ = options.comparator;
+  t->data_ = contents.data();
+  t->owned_ = buf;
+  t->records_size_ = static_cast<uint32_t>(index_offset);
+  t->index_ = t->data_ + index_offset;
+  t->num_index_ = num_index;
+  t->buckets_ = t->data_ + buckets_offset;
+  t->num_buckets_ = num_buckets;
+  *table = t;
+  return Status::OK();
+}
+
+PlainTable::~PlainTable() { delete[] owned_; }
+
+uint32_t PlainTable::IndexEntry(uint32_t i) const {
+  assert(i < num_index_);
+  return DecodeFixed32(index_ + 4 * i);
+}
+
+uint32_t PlainTable::DecodeRecord(uint32_t offset, Slice* key,
+                                  Slice* value) const {
+  const char* p = data_ + offset;
+  const char* limit = data_ + records_size_;
+  uint32_t key_length, value_length;
+  if ((p = GetVarint32Ptr(p, limit, &key_length)) == nullptr) return 0;
+  if ((p = GetVarint32Ptr(p, limit, &value_length)) == nullptr) return 0;
+  if (static_cast<uint64_t>(limit - p) <
+      static_cast<uint64_t>(key_length) + value_length) {
+    return 0;
+  }
+  *key = Slice(p, key_length);
+  *value = Slice(p + key_length, value_length);
+  return static_cast<uint32_t>(p + key_length + value_length - data_);
+}
+
+uint32_t PlainTable::SeekOffset(const Slice& target, Status* status) const {
+  Slice key, value;
+  uint32_t offset = 0;
+  if (num_index_ > 0) {
+    // Binary search for the last indexed record with a key < target
+    uint32_t left = 0;
+    uint32_t right = num_index_ - 1;
+    while (left < right) {
+      uint32_t mid = (left + right + 1) / 2;
+      if (DecodeRecord(IndexEntry(mid), &key, &value) == 0) {
+        *status = Status::Corruption("bad entry in plain table");
+        return records_size_;
+      }
+      if (comparator_->Compare(key, target) < 0) {
+        left = mid;
+      } else {
+        right = mid - 1;
+      }
+    }
+    offset = IndexEntry(left);
+  }
+
+  // Linear search for the first key >= target
+  while (offset < records_size_) {
+    uint32_t next = DecodeRecord(offset, &key, &value);
+    if (next == 0) {
+      *status = Status::Corruption("bad entry in plain table");
+      return records_size_;
+    }
+    if (comparator_->Compare(key, target) >= 0) {
+      break;
+    }
+    offset = next;
+  }
+  return offset;
+}
+
+Iterator* PlainTable::NewIterator() const { return new Iter(this); }
+
+Status PlainTable::Get(const Slice& k, void* arg,
+                       void (*handle_result)(void*, const Slice&,
+                                             const Slice&)) const {
+  Status s;
+  Slice key, value;
+  uint32_t offset;
+  const uint32_t bucket =
+      num_buckets_ == 0
+          ? kPlainTableCollision
+          : DecodeFixed32(buckets_ + 4 * (HashKey(k) % num_buckets_));
+  if (bucket == kPlainTableNoEntry) {
+    // No entry has the user key of k
+    return s;
+  } else if (bucket == kPlainTableCollision) {
+    offset = SeekOffset(k, &s);
+  } else {
+    // The first record of some user key with the hash of k
+    offset = bucket;
+    if (offset >= records_size_ || DecodeRecord(offset, &key, &value) == 0) {
+      return Status::Corruption("bad plain table hash index");
+    }
+    if (HashedKey(key) != HashedKey(k)) {
+      return s;
+    }
+    while (offset < records_size_) {
+      uint32_t next = DecodeRecord(offset, &key, &value);
+      if (next == 0) {
+        return Status::Corruption("bad entry in plain table");
+      }
+      if (comparator_->Compare(key, k) >= 0) {
+        break;
+      }
+      offset = next;
+    }
+  }
+
+  if (s.ok() && offset < records_size_) {
+    if (DecodeRecord(offset, &key, &value) == 0) {
+      return Status::Corruption("bad entry in plain table");
+    }
+    (*handle_result)(arg, key, value);
+  }
+  return s;
+}
+
+uint64_t PlainTable::ApproximateOffsetOf(const Slice& key) const {
+  Status ignored;
+  return SeekOffset(key, &ignored);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,138 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Plain tables (Options::table_format == kPlainTable) store their entries
+// as unaligned records that are read in place from a memory-mapped file:
+//
+//    records: one per entry, in key order
+//       key_length: varint32
+//       value_length: varint32
+//       key: uint8[key_length]
+//       value: uint8[value_length]
+//    index: fixed32[num_index]     offset of every kPlainTableIndexInterval'th
+//                                  record, for binary search
+//    buckets: fixed32[num_buckets] hash of user key -> offset of the first
+//                                  record of that user key, or one of
+//                                  kPlainTableNoEntry, kPlainTableCollision
+//    footer: (Footer::kEncodedLength bytes)
+//       index_offset: fixed64
+//       num_index: fixed32
+//       buckets_offset: fixed64
+//       num_buckets: fixed32
+//       crc: fixed32               masked crc32c of everything before footer
+//       padding
+//       magic: fixed64             kPlainTableMagicNumber
+//
+// The footer has the length of a block-based table footer, so Table::Open
+// tells the formats apart by the magic number of a single read.  Keys are
+// expected to be internal keys: the hash index covers all but their last
+// eight bytes.
+
+#ifndef STORAGE_LEVELDB_TABLE_PLAIN_TABLE_H_
+#define STORAGE_LEVELDB_TABLE_PLAIN_TABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class RandomAccessFile;
+class WritableFile;
+
+// kPlainTableMagicNumber was picked by running
+//    echo http://code.google.com/p/leveldb/plain | sha1sum
+// and taking the leading 64 bits.
+static const uint64_t kPlainTableMagicNumber = 0x7e97ae3eb1de0adaull;
+
+static const uint32_t kPlainTableIndexInterval = 16;
+static const uint32_t kPlainTableNoEntry = 0xffffffffu;
+static const uint32_t kPlainTableCollision = 0xfffffffeu;
+
+class PlainTableBuilder {
+ public:
+  PlainTableBuilder(const Options& options, WritableFile* file);
+
+  PlainTableBuilder(const PlainTableBuilder&) = delete;
+  PlainTableBuilder& operator=(const PlainTableBuilder&) = delete;
+
+  // Same contracts as the TableBuilder methods of the same names.
+  void Add(const Slice& key, const Slice& value);
+  Status status() const { return status_; }
+  Status Finish();
+  uint64_t NumEntries() const { return num_entries_; }
+  uint64_t FileSize() const { return offset_; }
+
+ private:
+  void Append(const Slice& data);
+
+  const Options options_;
+  WritableFile* const file_;
+  Status status_;
+  uint64_t offset_;
+  uint64_t num_entries_;
+  uint32_t crc_;  // Of everything written so far
+  std::string last_user_key_;
+  std::string record_;  // Scratch space for one record
+  std::vector<uint32_t> index_;
+  // Hash and offset of the first record of each user key
+  std::vector<std::pair<uint32_t, uint32_t>> hashes_;
+};
+
+class PlainTable {
+ public:
+  // Opens the plain table in "file", whose footer is "footer".  The file
+  // must stay live for as long as the returned table.
+  static Status Open(const Options& options, RandomAccessFile* file,
+                     uint64_t size, const Slice& footer, PlainTable** table);
+
+  PlainTable(const PlainTable&) = delete;
+  PlainTable& operator=(const PlainTable&) = delete;
+
+  ~PlainTable();
+
+  // The returned iterator's keys and values point into the table.
+  Iterator* NewIterator() const;
+
+  // Same contract as Table::InternalGet.  Uses the hash index to skip
+  // tables that do not hold the user key of "k".
+  Status Get(const Slice& k, void* arg,
+             void (*handle_result)(void*, const Slice&, const Slice&)) const;
+
+  uint64_t ApproximateOffsetOf(const Slice& key) const;
+
+ private:
+  class Iter;
+
+  PlainTable() = default;
+
+  // Decodes the record at "offset".  Returns the offset of the next
+  // record, or 0 if the record is damaged.
+  uint32_t DecodeRecord(uint32_t offset, Slice* key, Slice* value) const;
+
+  // Returns the offset of the first record with a key >= "target", or
+  // records_size_ if there is none.  Stores damage in *status.
+  uint32_t SeekOffset(const Slice& target, Status* status) const;
+
+  uint32_t IndexEntry(uint32_t i) const;
+
+  const Comparator* comparator_;
+  const char* data_;  // The whole file
+  char* owned_;       // Non-null if data_ was read into memory
+  uint32_t records_size_;
+  const char* index_;
+  uint32_t num_index_;
+  const char* buckets_;
+  uint32_t num_buckets_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_TABLE_PLAIN_TABLE_H_
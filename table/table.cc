@@ -4,46 +4,503 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/persistent_cache.h"
+#include "port/port.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
+#include "table/plain_table.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/crc32c.h"
 
 namespace leveldb {
 
+// The file of a table, along with where its blocks are kept in
+// Options::persistent_cache, if anywhere.
+struct BlockSource {
+  RandomAccessFile* file;
+  PersistentCache* persistent_cache;  // Null if blocks are not kept there
+  Slice persistent_cache_key_prefix;
+};
+
 struct Table::Rep { 
-    // TableݶͨTable::Rep͵ֶrep_
+    // Table的所有数据都通过Table::Rep类型的字段rep_保存
   ~Rep() {
-    delete filter;
-    delete[] filter_data;
-    delete index_block;
+    if (filter_cache_handle != nullptr) {
+      options.block_cache->Release(filter_cache_handle);
+    } else {
+      delete filter;
+      delete[] filter_data;
+    }
+    if (index_cache_handle != nullptr) {
+      options.block_cache->Release(index_cache_handle);
+    } else {
+      delete index_block;
+    }
+    delete plain;
+    if (zstd_dictionary != nullptr) {
+      port::Zstd_DeleteUncompressionDictionary(zstd_dictionary);
+    }
+  }
+
+  // The blocks of the table, read through "f", which is "file" or a
+  // readahead buffer in front of it
+  BlockSource Blocks(RandomAccessFile* f) const {
+    return BlockSource{f,
+                       persistent_cache_key_prefix.empty()
+                           ? nullptr
+                           : options.persistent_cache,
+                       persistent_cache_key_prefix};
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
+  // Identifies the table in options.persistent_cache; empty if its blocks
+  // are not kept there
+  std::string persistent_cache_key_prefix;
+  uint64_t file_size;
   uint64_t cache_id;
+  uint64_t compressed_cache_id;  // Id in options.block_cache_compressed
   FilterBlockReader* filter;
   const char* filter_data;
 
+  // With Options::cache_index_and_filter_blocks the index and filter
+  // blocks are kept in the block cache and looked up there on each use;
+  // index_block and filter are then null.  Pinned blocks are held through
+  // the cache handles below instead.
+  BlockHandle filter_handle;
+  bool filter_in_cache;
+  bool full_filter;  // Whether the cached filter is a full filter
+  Cache::Handle* filter_cache_handle;
+  Cache::Handle* index_cache_handle;
+
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
+  BlockHandle index_handle;
   Block* index_block;
+  // True if index_block is a top-level index over index partitions
+  bool index_partitioned;
+  // The digested zstd dictionary of the data blocks, if they have one
+  void* zstd_dictionary;
+
+  // Non-null if the file is a plain table, in which case none of the
+  // block-based state above is used.
+  PlainTable* plain;
+};
+
+// Reads table blocks ahead of an iterator that scans them in order.  Each
+// read that starts where the previous one ended doubles the size of the
+// next read from the file, up to a limit; any other read starts over.
+// Data is copied out of the readahead buffer, since blocks read into the
+// caller's scratch space may outlive it.
+class ReadaheadFile : public RandomAccessFile {
+ public:
+  ReadaheadFile(RandomAccessFile* file, uint64_t file_size,
+                size_t initial_size, size_t max_size)
+      : file_(file),
+        file_size_(file_size),
+        initial_size_(initial_size),
+        max_size_(max_size),
+        readahead_size_(initial_size),
+        passthrough_(false),
+        next_offset_(kNoOffset),
+        buffer_capacity_(0),
+        buffer_offset_(0),
+        buffer_size_(0) {}
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    if (offset >= buffer_offset_ &&
+        offset + n <= buffer_offset_ + buffer_size_) {
+      std::memcpy(scratch, buffer_.get() + (offset - buffer_offset_), n);
+      *result = Slice(scratch, n);
+      Advance(offset, n);
+      return Status::OK();
+    }
+
+    const bool sequential = (offset == next_offset_);
+    Advance(offset, n);
+    // Files may refuse reads past their end
+    const uint64_t remaining = file_size_ - std::min(offset, file_size_);
+    const size_t readahead_size =
+        static_cast<size_t>(std::min<uint64_t>(readahead_size_, remaining));
+    if (passthrough_ || !sequential || readahead_size <= n) {
+      Status s = file_->Read(offset, n, result, scratch);
+      if (s.ok() && result->data() != scratch) {
+        // The file hands out its own memory (e.g. an mmap), which is
+        // cheaper than anything read ahead here
+        passthrough_ = true;
+      }
+      return s;
+    }
+
+    if (buffer_capacity_ < readahead_size) {
+      // Grow with the window rather than paying for max_size_ up front
+      buffer_.reset(new char[readahead_size]);
+      buffer_capacity_ = readahead_size;
+    }
+    Slice data;
+    Status s = file_->Read(offset, readahead_size, &data, buffer_.get());
+    buffer_offset_ = offset;
+    buffer_size_ = 0;
+    if (!s.ok()) {
+      return s;
+    }
+    if (data.data() != buffer_.get()) {
+      passthrough_ = true;
+      buffer_.reset();
+      buffer_capacity_ = 0;
+      return file_->Read(offset, n, result, scratch);
+    }
+    buffer_size_ = data.size();
+    readahead_size_ = std::min(readahead_size_ * 2, max_size_);
+    n = std::min<size_t>(n, buffer_size_);
+    std::memcpy(scratch, buffer_.get(), n);
+    *result = Slice(scratch, n);
+    return s;
+  }
+
+ private:
+  // No read ends here, so the first read is never taken as sequential
+  static const uint64_t kNoOffset = ~static_cast<uint64_t>(0);
+
+  void Advance(uint64_t offset, size_t n) const {
+    if (offset != next_offset_) {
+      readahead_size_ = initial_size_;
+    }
+    next_offset_ = offset + n;
+  }
+
+  RandomAccessFile* const file_;
+  const uint64_t file_size_;
+  const size_t initial_size_;
+  const size_t max_size_;
+  // An iterator only reads from one thread at a time
+  mutable size_t readahead_size_;  // Size of the next sequential read
+  mutable bool passthrough_;
+  mutable uint64_t next_offset_;  // Where the next sequential read starts
+  mutable std::unique_ptr<char[]> buffer_;
+  mutable size_t buffer_capacity_;
+  mutable uint64_t buffer_offset_;
+  mutable size_t buffer_size_;
 };
 
+// What Table::ReadaheadBlockReader needs for one iterator.
+struct ReadaheadState {
+  ReadaheadState(const Table* t, RandomAccessFile* file, uint64_t file_size,
+                 size_t initial_size, size_t max_size)
+      : table(t), file(file, file_size, initial_size, max_size) {}
+
+  const Table* table;
+  ReadaheadFile file;
+};
+
+static void DeleteReadaheadState(void* arg, void* ignored) {
+  delete reinterpret_cast<ReadaheadState*>(arg);
+}
+
+// Size of the first read ahead of an iterator that fills the cache
+static const size_t kInitialReadaheadSize = 8 * 1024;
+
+static void DeleteBlock(void* arg, void* ignored) {
+  delete reinterpret_cast<Block*>(arg);
+}
+
+static void DeleteCachedBlock(const Slice& key, void* value) {
+  Block* block = reinterpret_cast<Block*>(value);
+  delete block;
+}
+
+static void ReleaseBlock(void* arg, void* h) {
+  Cache* cache = reinterpret_cast<Cache*>(arg);
+  Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
+  cache->Release(handle);
+}
+
+// A filter block held in the block cache, along with the data it owns.
+struct CachedFilter {
+  ~CachedFilter() {
+    delete reader;
+    delete[] data;
+  }
+
+  FilterBlockReader* reader;
+  const char* data;  // Null if the block was not heap allocated
+};
+
+static void DeleteCachedFilter(const Slice& key, void* value) {
+  delete reinterpret_cast<CachedFilter*>(value);
+}
+
+// Block cache keys are the table's cache id followed by the block offset.
+static void EncodeCacheKey(uint64_t cache_id, const BlockHandle& handle,
+                           char* buf) {
+  EncodeFixed64(buf, cache_id);
+  EncodeFixed64(buf + 8, handle.offset());
+}
+
+// A block held in the compressed block cache: the block as it is stored
+// in the file, followed by its compression type.
+struct CompressedBlock {
+  ~CompressedBlock() { delete[] data.data(); }
+
+  Slice data;
+};
+
+static void DeleteCompressedBlock(const Slice& key, void* value) {
+  delete reinterpret_cast<CompressedBlock*>(value);
+}
+
+// Reads the block at "handle" as ReadRawBlock() does, from
+// source.persistent_cache if it holds the block.  Blocks read from the file
+// are added to it if options.fill_cache is set, keyed by their handle, so
+// that compactions and scans that skip the block cache skip it too.
+static Status ReadRawTableBlock(const BlockSource& source,
+                                const ReadOptions& options,
+                                const BlockHandle& handle,
+                                BlockContents* result) {
+  if (source.persistent_cache == nullptr) {
+    return ReadRawBlock(source.file, options, handle, result);
+  }
+  std::string key = source.persistent_cache_key_prefix.ToString();
+  PutFixed64(&key, handle.offset());
+  PutFixed64(&key, handle.size());
+  const size_t stored_size =
+      static_cast<size_t>(handle.size()) + kBlockTrailerSize;
+  std::string stored;
+  if (source.persistent_cache->Lookup(key, &stored).ok() &&
+      stored.size() == stored_size) {
+    return ParseStoredBlock(stored, options, result);
+  }
+
+  stored.resize(stored_size);
+  Slice contents;
+  Status s = source.file->Read(handle.offset(), stored_size, &contents,
+                               &stored[0]);
+  if (s.ok() && contents.size() != stored_size) {
+    s = Status::Corruption("truncated block read");
+  }
+  if (s.ok()) {
+    s = ParseStoredBlock(contents, options, result);
+  }
+  if (s.ok() && options.fill_cache) {
+    source.persistent_cache->Insert(key, contents);
+  }
+  return s;
+}
+
+// Like ReadBlock(), reading through ReadRawTableBlock().
+static Status ReadTableBlock(const BlockSource& source,
+                             const ReadOptions& options,
+                             const BlockHandle& handle, BlockContents* result,
+                             const void* zstd_dictionary = nullptr) {
+  BlockContents raw;
+  Status s = ReadRawTableBlock(source, options, handle, &raw);
+  if (!s.ok()) {
+    return s;
+  }
+  const size_t n = raw.data.size() - 1;
+  if (BlockCompressionType(raw.data[n]) == kNoCompression) {
+    *result = raw;
+    result->data = Slice(raw.data.data(), n);
+    return s;
+  }
+  s = UncompressBlock(raw.data, result, zstd_dictionary);
+  if (raw.heap_allocated) {
+    delete[] raw.data.data();
+  }
+  return s;
+}
+
+// Reads the block at "handle" into *contents, trying "compressed_cache"
+// first if it is non-null.  Compressed blocks that have to be read from
+// the file are added to it.
+static Status ReadBlockThroughCompressedCache(
+    Cache* compressed_cache, uint64_t compressed_cache_id,
+    const BlockSource& source, const void* zstd_dictionary,
+    const ReadOptions& options, const BlockHandle& handle,
+    BlockContents* contents) {
+  if (compressed_cache == nullptr) {
+    return ReadTableBlock(source, options, handle, contents, zstd_dictionary);
+  }
+
+  char cache_key_buffer[16];
+  EncodeCacheKey(compressed_cache_id, handle, cache_key_buffer);
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  Cache::Handle* cache_handle = compressed_cache->Lookup(key);
+  if (cache_handle != nullptr) {
+    CompressedBlock* block = reinterpret_cast<CompressedBlock*>(
+        compressed_cache->Value(cache_handle));
+    Status s = UncompressBlock(block->data, contents, zstd_dictionary);
+    compressed_cache->Release(cache_handle);
+    return s;
+  }
+
+  BlockContents raw;
+  Status s = ReadRawTableBlock(source, options, handle, &raw);
+  if (!s.ok()) {
+    return s;
+  }
+  const size_t n = raw.data.size() - 1;
+  if (BlockCompressionType(raw.data[n]) == kNoCompression) {
+    // Nothing to save by caching it compressed
+    *contents = raw;
+    contents->data = Slice(raw.data.data(), n);
+    return s;
+  }
+  s = UncompressBlock(raw.data, contents, zstd_dictionary);
+  if (s.ok() && raw.cachable && options.fill_cache) {
+    CompressedBlock* block = new CompressedBlock;
+    block->data = raw.data;
+    compressed_cache->Release(compressed_cache->Insert(
+        key, block, raw.data.size(), &DeleteCompressedBlock));
+  } else if (raw.heap_allocated) {
+    delete[] raw.data.data();
+  }
+  return s;
+}
+
+// Reads the block at "handle", going through "block_cache" if it is
+// non-null, and through "compressed_cache" on a miss.  On success stores
+// the block in *block, and in *cache_handle the handle to release once
+// done with it, or nullptr if the caller owns *block.
+static Status ReadBlockThroughCache(Cache* block_cache, uint64_t cache_id,
+                                    Cache* compressed_cache,
+                                    uint64_t compressed_cache_id,
+                                    const BlockSource& source,
+                                    const void* zstd_dictionary,
+                                    const ReadOptions& options,
+                                    const BlockHandle& handle,
+                                    Cache::Priority priority, Block** block,
+                                    Cache::Handle** cache_handle) {
+  *block = nullptr;
+  *cache_handle = nullptr;
+  BlockContents contents;
+  if (block_cache == nullptr) {
+    Status s = ReadBlockThroughCompressedCache(
+        compressed_cache, compressed_cache_id, source, zstd_dictionary, options,
+        handle, &contents);
+    if (s.ok()) {
+      *block = new Block(contents);
+    }
+    return s;
+  }
+
+  char cache_key_buffer[16];
+  EncodeCacheKey(cache_id, handle, cache_key_buffer);
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  *cache_handle = block_cache->Lookup(key);
+  if (*cache_handle != nullptr) {
+    *block = reinterpret_cast<Block*>(block_cache->Value(*cache_handle));
+    return Status::OK();
+  }
+  Status s = ReadBlockThroughCompressedCache(compressed_cache,
+                                             compressed_cache_id, source,
+                                             zstd_dictionary, options, handle,
+                                             &contents);
+  if (s.ok()) {
+    *block = new Block(contents);
+    if (contents.cachable && options.fill_cache) {
+      *cache_handle = block_cache->Insert(key, *block, (*block)->size(),
+                                          &DeleteCachedBlock, priority);
+    }
+  }
+  return s;
+}
+
+// Returns an iterator over the block that "index_value" points to.
+static Iterator* NewBlockIterator(Cache* block_cache, uint64_t cache_id,
+                                  Cache* compressed_cache,
+                                  uint64_t compressed_cache_id,
+                                  const BlockSource& source,
+                                  const void* zstd_dictionary,
+                                  const Comparator* comparator,
+                                  const ReadOptions& options,
+                                  const Slice& index_value,
+                                  Cache::Priority priority) {
+  Block* block = nullptr;
+  Cache::Handle* cache_handle = nullptr;
+
+  BlockHandle handle;
+  Slice input = index_value;
+  Status s = handle.DecodeFrom(&input);
+  // We intentionally allow extra stuff in index_value so that we
+  // can add more features in the future.
+
+  if (s.ok()) {
+    s = ReadBlockThroughCache(block_cache, cache_id, compressed_cache,
+                              compressed_cache_id, source, zstd_dictionary,
+                              options, handle, priority, &block,
+                              &cache_handle);
+  }
+
+  Iterator* iter;
+  if (block != nullptr) {
+    iter = block->NewIterator(comparator);
+    if (cache_handle == nullptr) {
+      iter->RegisterCleanup(&DeleteBlock, block, nullptr);
+    } else {
+      iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+    }
+  } else {
+    iter = NewErrorIterator(s);
+  }
+  return iter;
+}
+
+// Looks up the filter block at "handle" in "block_cache", reading it back
+// in if it has been evicted.  Returns the handle of the cached filter, or
+// nullptr if the filter could not be read.
+static Cache::Handle* LookupFilter(Cache* block_cache, uint64_t cache_id,
+                                   const BlockSource& source,
+                                   const FilterPolicy* policy,
+                                   bool full_filter, bool verify_checksums,
+                                   const BlockHandle& handle) {
+  char cache_key_buffer[16];
+  EncodeCacheKey(cache_id, handle, cache_key_buffer);
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  Cache::Handle* cache_handle = block_cache->Lookup(key);
+  if (cache_handle == nullptr) {
+    ReadOptions opt;
+    opt.verify_checksums = verify_checksums;
+    BlockContents block;
+    if (!ReadTableBlock(source, opt, handle, &block).ok()) {
+      return nullptr;
+    }
+    CachedFilter* filter = new CachedFilter;
+    filter->data = block.heap_allocated ? block.data.data() : nullptr;
+    filter->reader = new FilterBlockReader(policy, block.data, full_filter);
+    cache_handle = block_cache->Insert(key, filter, block.data.size(),
+                                       &DeleteCachedFilter,
+                                       Cache::Priority::kHigh);
+  }
+  return cache_handle;
+}
+
 /*
-* ȡsstableеfooterfilter blockindex blockݵڴ
-* Ϊtableһcache_id
-* ͨTableȡDataBlockʱ
-* ƴcache_idBlockoffsetƴΪBlockCachekey
+* 读取sstable中的footer，加载其filter block和index block的数据到内存
+* 为table分配一个cache_id
+* 在通过Table读取其中DataBlock的数据时，
+* 会拼接cache_id与Block的offset拼接作为BlockCache的key。
 */
 Status Table::Open(const Options& options, RandomAccessFile* file,
                    uint64_t size, Table** table) {
+  return Open(options, file, size, Slice(), table);
+}
+
+Status Table::Open(const Options& options, RandomAccessFile* file,
+                   uint64_t size, const Slice& persistent_cache_key_prefix,
+                   Table** table) {
   *table = nullptr;
   if (size < Footer::kEncodedLength) {
     return Status::Corruption("file is too short to be an sstable");
@@ -54,6 +511,33 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
   Status s = file->Read(size - Footer::kEncodedLength, Footer::kEncodedLength,
                         &footer_input, footer_space);
   if (!s.ok()) return s;
+  const Slice footer_data = footer_input;
+
+  if (DecodeFixed64(footer_input.data() + Footer::kEncodedLength - 8) ==
+      kPlainTableMagicNumber) {
+    PlainTable* plain;
+    s = PlainTable::Open(options, file, size, footer_input, &plain);
+    if (s.ok()) {
+      Rep* rep = new Table::Rep;
+      rep->options = options;
+      rep->file = file;
+      rep->file_size = size;
+      rep->cache_id = 0;
+      rep->compressed_cache_id = 0;
+      rep->filter_data = nullptr;
+      rep->filter = nullptr;
+      rep->filter_in_cache = false;
+      rep->full_filter = false;
+      rep->filter_cache_handle = nullptr;
+      rep->index_cache_handle = nullptr;
+      rep->index_block = nullptr;
+      rep->index_partitioned = false;
+      rep->zstd_dictionary = nullptr;
+      rep->plain = plain;
+      *table = new Table(rep);
+    }
+    return s;
+  }
 
   Footer footer;
   s = footer.DecodeFrom(&footer_input);
@@ -65,7 +549,17 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
   if (options.paranoid_checks) {
     opt.verify_checksums = true;
   }
-  s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+  std::string key_prefix;
+  if (!persistent_cache_key_prefix.empty()) {
+    key_prefix = persistent_cache_key_prefix.ToString();
+    PutFixed32(&key_prefix,
+               crc32c::Value(footer_data.data(), footer_data.size()));
+  }
+  const BlockSource source{
+      file, key_prefix.empty() ? nullptr : options.persistent_cache,
+      key_prefix};
+  s = ReadTableBlock(source, opt, footer.index_handle(),
+                     &index_block_contents);
 
   if (s.ok()) {
     // We've successfully read the footer and the index block: we're
@@ -74,53 +568,122 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     Rep* rep = new Table::Rep;
     rep->options = options;
     rep->file = file;
+    rep->persistent_cache_key_prefix = key_prefix;
+    rep->file_size = size;
     rep->metaindex_handle = footer.metaindex_handle();
+    rep->index_handle = footer.index_handle();
     rep->index_block = index_block;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+    rep->compressed_cache_id = (options.block_cache_compressed
+                                    ? options.block_cache_compressed->NewId()
+                                    : 0);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->filter_in_cache = false;
+    rep->full_filter = false;
+    rep->filter_cache_handle = nullptr;
+    rep->index_cache_handle = nullptr;
+    rep->index_partitioned = false;
+    rep->zstd_dictionary = nullptr;
+    rep->plain = nullptr;
+    if (options.cache_index_and_filter_blocks &&
+        options.block_cache != nullptr && index_block_contents.cachable) {
+      // Charge the index to the block cache and look it up there from now on
+      char cache_key_buffer[16];
+      EncodeCacheKey(rep->cache_id, rep->index_handle, cache_key_buffer);
+      options.block_cache->Release(options.block_cache->Insert(
+          Slice(cache_key_buffer, sizeof(cache_key_buffer)), index_block,
+          index_block->size(), &DeleteCachedBlock, Cache::Priority::kHigh));
+      rep->index_block = nullptr;
+    }
     *table = new Table(rep);
-    (*table)->ReadMeta(footer);
+    s = (*table)->ReadMeta(footer);
+    if (!s.ok()) {
+      delete *table;
+      *table = nullptr;
+    }
   }
 
   return s;
 }
 /*
-* ȡsstableԪݣsstablefooterҵfilter block
+* 读取sstable元数据，根据sstable的footer找到filter block
 */
-void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
+Status Table::ReadMeta(const Footer& footer) {
+  // An empty metaindex block holds nothing but its single restart point
+  // and the restart count.
+  if (footer.metaindex_handle().size() <= 2 * sizeof(uint32_t)) {
+    return Status::OK();
   }
 
-  // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-  // it is an empty block.
   ReadOptions opt;
   if (rep_->options.paranoid_checks) {
     opt.verify_checksums = true;
   }
   BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
-    // Do not propagate errors since meta info is not needed for operation
-    return;
+  Status s = ReadTableBlock(rep_->Blocks(rep_->file), opt,
+                            footer.metaindex_handle(), &contents);
+  if (!s.ok()) {
+    // The filter is optional, but whether the index is partitioned is
+    // not, so the table cannot be used without its metaindex.
+    return s;
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  if (rep_->options.filter_policy != nullptr) {
+    // Tables built with either kind of filter can be read
+    for (bool full_filter : {true, false}) {
+      std::string key = full_filter ? "fullfilter." : "filter.";
+      key.append(rep_->options.filter_policy->Name());
+      iter->Seek(key);
+      if (iter->Valid() && iter->key() == Slice(key)) {
+        ReadFilter(iter->value(), full_filter);
+        break;
+      }
+    }
+  }
+  iter->Seek("index.partitioned");
+  if (iter->Valid() && iter->key() == Slice("index.partitioned")) {
+    rep_->index_partitioned = true;
+  }
+  iter->Seek("zstd.dictionary");
+  if (iter->Valid() && iter->key() == Slice("zstd.dictionary")) {
+    // The data blocks cannot be read without it
+    Slice v = iter->value();
+    BlockHandle dictionary_handle;
+    BlockContents dictionary;
+    s = dictionary_handle.DecodeFrom(&v);
+    if (s.ok()) {
+      s = ReadTableBlock(rep_->Blocks(rep_->file), opt, dictionary_handle,
+                         &dictionary);
+    }
+    if (s.ok()) {
+      rep_->zstd_dictionary = port::Zstd_NewUncompressionDictionary(
+          dictionary.data.data(), dictionary.data.size());
+      if (dictionary.heap_allocated) {
+        delete[] dictionary.data.data();
+      }
+      if (rep_->zstd_dictionary == nullptr) {
+        s = Status::NotSupported("zstd dictionaries are not supported");
+      }
+    }
+    if (!s.ok()) {
+      delete iter;
+      delete meta;
+      return s;
+    }
   }
+  s = iter->status();
   delete iter;
   delete meta;
+  return s;
 }
 
 /*
-* filterصṹrep_
+* 将filter加载到结构体rep_中
 */
-void Table::ReadFilter(const Slice& filter_handle_value) {
+void Table::ReadFilter(const Slice& filter_handle_value, bool full_filter) {
   Slice v = filter_handle_value;
   BlockHandle filter_handle;
   if (!filter_handle.DecodeFrom(&v).ok()) {
@@ -134,123 +697,226 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
     opt.verify_checksums = true;
   }
   BlockContents block;
-  if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
+  if (!ReadTableBlock(rep_->Blocks(rep_->file), opt, filter_handle, &block)
+           .ok()) {
+    return;
+  }
+  if (block.heap_allocated && rep_->options.cache_index_and_filter_blocks &&
+      rep_->options.block_cache != nullptr) {
+    // Charge the filter to the block cache and look it up there from now on
+    Cache* cache = rep_->options.block_cache;
+    CachedFilter* filter = new CachedFilter;
+    filter->data = block.data.data();
+    filter->reader = new FilterBlockReader(rep_->options.filter_policy,
+                                           block.data, full_filter);
+    char cache_key_buffer[16];
+    EncodeCacheKey(rep_->cache_id, filter_handle, cache_key_buffer);
+    cache->Release(cache->Insert(
+        Slice(cache_key_buffer, sizeof(cache_key_buffer)), filter,
+        block.data.size(), &DeleteCachedFilter, Cache::Priority::kHigh));
+    rep_->filter_handle = filter_handle;
+    rep_->filter_in_cache = true;
+    rep_->full_filter = full_filter;
     return;
   }
   if (block.heap_allocated) {
     rep_->filter_data = block.data.data();  // Will need to delete later
   }
-  rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
+  rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data,
+                                       full_filter);
 }
 
-Table::~Table() { delete rep_; }
-
-static void DeleteBlock(void* arg, void* ignored) {
-  delete reinterpret_cast<Block*>(arg);
+FilterBlockReader* Table::GetFilter(Cache::Handle** cache_handle) const {
+  *cache_handle = nullptr;
+  if (!rep_->filter_in_cache) {
+    return rep_->filter;
+  }
+  Cache* cache = rep_->options.block_cache;
+  *cache_handle = LookupFilter(
+      cache, rep_->cache_id, rep_->Blocks(rep_->file),
+      rep_->options.filter_policy, rep_->full_filter,
+      rep_->options.paranoid_checks, rep_->filter_handle);
+  if (*cache_handle == nullptr) {
+    return nullptr;  // Without its filter the table is still readable
+  }
+  return reinterpret_cast<CachedFilter*>(cache->Value(*cache_handle))->reader;
 }
 
-static void DeleteCachedBlock(const Slice& key, void* value) {
-  Block* block = reinterpret_cast<Block*>(value);
-  delete block;
+void Table::PinMetaBlocks() {
+  Rep* r = rep_;
+  if (r->plain != nullptr) {
+    return;  // Plain tables keep nothing in the block cache
+  }
+  if (r->index_block == nullptr) {
+    ReadOptions opt;
+    opt.verify_checksums = r->options.paranoid_checks;
+    Block* block;
+    Cache::Handle* cache_handle;
+    if (ReadBlockThroughCache(r->options.block_cache, r->cache_id,
+                              r->options.block_cache_compressed,
+                              r->compressed_cache_id, r->Blocks(r->file),
+                              r->zstd_dictionary, opt, r->index_handle,
+                              Cache::Priority::kHigh, &block, &cache_handle)
+            .ok()) {
+      r->index_block = block;
+      r->index_cache_handle = cache_handle;
+    }
+  }
+  if (r->filter_in_cache) {
+    Cache::Handle* cache_handle = LookupFilter(
+        r->options.block_cache, r->cache_id, r->Blocks(r->file),
+        r->options.filter_policy, r->full_filter, r->options.paranoid_checks,
+        r->filter_handle);
+    if (cache_handle != nullptr) {
+      r->filter = reinterpret_cast<CachedFilter*>(
+                      r->options.block_cache->Value(cache_handle))
+                      ->reader;
+      r->filter_cache_handle = cache_handle;
+      r->filter_in_cache = false;
+    }
+  }
 }
 
-static void ReleaseBlock(void* arg, void* h) {
-  Cache* cache = reinterpret_cast<Cache*>(arg);
-  Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
-  cache->Release(handle);
-}
+Table::~Table() { delete rep_; }
 
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 /*
-* IndexBlockв鵽valueֵתΪӦDataBlockIterator
+* 将在IndexBlock中查到的value值转为相应DataBlock的Iterator
 */
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
-  Cache* block_cache = table->rep_->options.block_cache;
-  Block* block = nullptr;
-  Cache::Handle* cache_handle = nullptr;
+  Rep* r = table->rep_;
+  return NewBlockIterator(r->options.block_cache, r->cache_id,
+                          r->options.block_cache_compressed,
+                          r->compressed_cache_id, r->Blocks(r->file),
+                          r->zstd_dictionary, r->options.comparator, options,
+                          index_value, Cache::Priority::kLow);
+}
 
-  BlockHandle handle;
-  Slice input = index_value;
-  Status s = handle.DecodeFrom(&input);
-  // We intentionally allow extra stuff in index_value so that we
-  // can add more features in the future.
+Iterator* Table::ReadaheadBlockReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  Rep* r = state->table->rep_;
+  return NewBlockIterator(r->options.block_cache, r->cache_id,
+                          r->options.block_cache_compressed,
+                          r->compressed_cache_id, r->Blocks(&state->file),
+                          r->zstd_dictionary, r->options.comparator, options,
+                          index_value, Cache::Priority::kLow);
+}
 
-  if (s.ok()) {
-    BlockContents contents;
-    if (block_cache != nullptr) {
-      char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
-      EncodeFixed64(cache_key_buffer + 8, handle.offset());
-      Slice key(cache_key_buffer, sizeof(cache_key_buffer));
-      cache_handle = block_cache->Lookup(key);
-      if (cache_handle != nullptr) {
-        block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
-      } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
-        if (s.ok()) {
-          block = new Block(contents);
-          if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(key, block, block->size(),
-                                               &DeleteCachedBlock);
-          }
-        }
-      }
-    } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
-      if (s.ok()) {
-        block = new Block(contents);
-      }
-    }
-  }
+Iterator* Table::IndexPartitionReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  Table* table = reinterpret_cast<Table*>(arg);
+  Rep* r = table->rep_;
+  return NewBlockIterator(r->options.block_cache, r->cache_id,
+                          r->options.block_cache_compressed,
+                          r->compressed_cache_id, r->Blocks(r->file),
+                          r->zstd_dictionary, r->options.comparator, options,
+                          index_value,
+                          r->options.cache_index_and_filter_blocks
+                              ? Cache::Priority::kHigh
+                              : Cache::Priority::kLow);
+}
 
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const {
   Iterator* iter;
-  if (block != nullptr) {
-    iter = block->NewIterator(table->rep_->options.comparator);
-    if (cache_handle == nullptr) {
-      iter->RegisterCleanup(&DeleteBlock, block, nullptr);
-    } else {
-      iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
-    }
+  if (rep_->index_block != nullptr) {
+    iter = rep_->index_block->NewIterator(rep_->options.comparator);
   } else {
-    iter = NewErrorIterator(s);
+    // The index lives in the block cache, and is always put back there
+    ReadOptions index_options = options;
+    index_options.fill_cache = true;
+    std::string handle_encoding;
+    rep_->index_handle.EncodeTo(&handle_encoding);
+    iter = NewBlockIterator(rep_->options.block_cache, rep_->cache_id,
+                            rep_->options.block_cache_compressed,
+                            rep_->compressed_cache_id,
+                            rep_->Blocks(rep_->file), rep_->zstd_dictionary,
+                            rep_->options.comparator, index_options,
+                            handle_encoding, Cache::Priority::kHigh);
+  }
+  if (rep_->index_partitioned) {
+    iter = NewTwoLevelIterator(iter, &Table::IndexPartitionReader,
+                               const_cast<Table*>(this), options);
   }
   return iter;
 }
 
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-  return NewTwoLevelIterator(
-      rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+  if (rep_->plain != nullptr) {
+    return rep_->plain->NewIterator();
+  }
+  if (options.readahead_size == 0) {
+    return NewTwoLevelIterator(NewIndexIterator(options), &Table::BlockReader,
+                               const_cast<Table*>(this), options);
+  }
+  const size_t initial_size =
+      options.fill_cache
+          ? std::min(kInitialReadaheadSize, options.readahead_size)
+          : options.readahead_size;
+  ReadaheadState* state =
+      new ReadaheadState(this, rep_->file, rep_->file_size, initial_size,
+                         options.readahead_size);
+  Iterator* iter = NewTwoLevelIterator(
+      NewIndexIterator(options), &Table::ReadaheadBlockReader, state, options);
+  iter->RegisterCleanup(&DeleteReadaheadState, state, nullptr);
+  return iter;
+}
+
+bool Table::KeyMayMatch(const Slice& key) const {
+  if (rep_->plain != nullptr) {
+    return true;
+  }
+  Cache::Handle* filter_cache_handle;
+  FilterBlockReader* filter = GetFilter(&filter_cache_handle);
+  const bool may_match = filter == nullptr || !filter->IsFullFilter() ||
+                         filter->KeyMayMatch(key);
+  if (filter_cache_handle != nullptr) {
+    rep_->options.block_cache->Release(filter_cache_handle);
+  }
+  return may_match;
 }
 
-/*SSTableͨkeyvalue*/
+/*在SSTable中通过key查找value*/
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                           void (*handle_result)(void*, const Slice&,
                                                 const Slice&)) {
+  if (rep_->plain != nullptr) {
+    return rep_->plain->Get(k, arg, handle_result);
+  }
+  Cache::Handle* filter_cache_handle;
+  FilterBlockReader* filter = GetFilter(&filter_cache_handle); /*获取过滤器*/
+  if (filter != nullptr && filter->IsFullFilter() && !filter->KeyMayMatch(k)) {
+    // Not found, without searching the index
+    if (filter_cache_handle != nullptr) {
+      rep_->options.block_cache->Release(filter_cache_handle);
+    }
+    return Status::OK();
+  }
+
   Status s;
-  // ȡindexblockiterator
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
-  iiter->Seek(k); /*Ĳ*/
+  // 获取indexblock的iterator
+  Iterator* iiter = NewIndexIterator(options);
+  iiter->Seek(k); /*键的查找*/
   if (iiter->Valid()) {
-    Slice handle_value = iiter->value(); /*ȡֵ*/
-    FilterBlockReader* filter = rep_->filter; /*ȡ*/
+    Slice handle_value = iiter->value(); /*获取与键关联的值*/
     BlockHandle handle;
-    if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
+    if (filter != nullptr && !filter->IsFullFilter() &&
+        handle.DecodeFrom(&handle_value).ok() &&
         !filter->KeyMayMatch(handle.offset(), k)) {
-      // ΪҼܲƥ
+      // 过滤器为空且键可能不匹配
         // not found
     } else {
-      /*˳ҵvalueӦݿеĵ*/
+      /*过滤器顺利找到，根据value查找相应的数据块中的迭代器*/
       Iterator* block_iter = BlockReader(this, options, iiter->value());
-      block_iter->Seek(k); // ݿвkey
+      block_iter->Seek(k); // 在数据块中查找key
       if (block_iter->Valid()) {
-          // ҵʱhandle_result 
+          // 找到时采用handle_result 处理结果
         (*handle_result)(arg, block_iter->key(), block_iter->value());
       }
-      // ״̬
+      // 更新状态
       s = block_iter->status();
       delete block_iter;
     }
@@ -259,12 +925,77 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
     s = iiter->status();
   }
   delete iiter;
+  if (filter_cache_handle != nullptr) {
+    rep_->options.block_cache->Release(filter_cache_handle);
+  }
+  return s;
+}
+
+Status Table::InternalMultiGet(const ReadOptions& options, int n,
+                               const Slice* keys, void* const* args,
+                               void (*handle_result)(void*, const Slice&,
+                                                     const Slice&)) {
+  Status s;
+  if (rep_->plain != nullptr) {
+    for (int i = 0; i < n && s.ok(); i++) {
+      s = rep_->plain->Get(keys[i], args[i], handle_result);
+    }
+    return s;
+  }
+  const Comparator* cmp = rep_->options.comparator;
+  Cache::Handle* filter_cache_handle;
+  FilterBlockReader* filter = GetFilter(&filter_cache_handle);
+  Iterator* iiter = NewIndexIterator(options);
+  Iterator* block_iter = nullptr;
+  for (int i = 0; i < n && s.ok(); i++) {
+    const Slice& k = keys[i];
+    if (filter != nullptr && filter->IsFullFilter() &&
+        !filter->KeyMayMatch(k)) {
+      continue;  // Not found, without searching the index
+    }
+    // Since the keys are sorted, a key that is not past the index entry
+    // of the previous key falls into the same data block.
+    if (!iiter->Valid() || cmp->Compare(k, iiter->key()) > 0) {
+      iiter->Seek(k);
+      delete block_iter;
+      block_iter = nullptr;
+      if (!iiter->Valid()) {
+        break;  // All remaining keys are past the last block
+      }
+    }
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    if (filter != nullptr && !filter->IsFullFilter() &&
+        handle.DecodeFrom(&handle_value).ok() &&
+        !filter->KeyMayMatch(handle.offset(), k)) {
+      // Not found
+    } else {
+      if (block_iter == nullptr) {
+        block_iter = BlockReader(this, options, iiter->value());
+      }
+      block_iter->Seek(k);
+      if (block_iter->Valid()) {
+        (*handle_result)(args[i], block_iter->key(), block_iter->value());
+      }
+      s = block_iter->status();
+    }
+  }
+  delete block_iter;
+  if (s.ok()) {
+    s = iiter->status();
+  }
+  delete iiter;
+  if (filter_cache_handle != nullptr) {
+    rep_->options.block_cache->Release(filter_cache_handle);
+  }
   return s;
 }
 
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  if (rep_->plain != nullptr) {
+    return rep_->plain->ApproximateOffsetOf(key);
+  }
+  Iterator* index_iter = NewIndexIterator(ReadOptions());
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
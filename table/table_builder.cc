@@ -5,33 +5,315 @@
 #include "leveldb/table_builder.h"
 
 #include <cassert>
+#include <deque>
+#include <vector>
 
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "port/port.h"
+#include "table/block.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
+#include "table/plain_table.h"
 #include "util/coding.h"
-#include "util/crc32c.h"
+#include "util/mutexlock.h"
+#include "util/no_destructor.h"
 
 namespace leveldb {
 
+// Compresses "raw" as options.compression says, using *compressed as
+// scratch space, and returns the type of compression to store the block
+// with.  Sets *contents to the block as stored: either *compressed or
+// "raw", if compression is unavailable or does not pay off.  Safe to call
+// from several threads at once.
+static CompressionType CompressBlock(const Options& options,
+                                     const void* zstd_dictionary,
+                                     const Slice& raw, std::string* compressed,
+                                     Slice* contents) {
+  CompressionType type = options.compression;
+  // TODO(postrelease): Support more compression options: zlib?
+  switch (type) {
+    case kNoCompression:
+      *contents = raw;
+      break;
+
+    case kSnappyCompression: {
+      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        *contents = *compressed;
+      } else {
+        // Snappy not supported, or compressed less than 12.5%, so just
+        // store uncompressed form
+        *contents = raw;
+        type = kNoCompression;
+      }
+      break;
+    }
+
+    case kZstdCompression: {
+      if ((zstd_dictionary != nullptr
+               ? port::Zstd_CompressWithDictionary(zstd_dictionary, raw.data(),
+                                                   raw.size(), compressed)
+               : port::Zstd_Compress(options.zstd_compression_level,
+                                     raw.data(), raw.size(), compressed)) &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        *contents = *compressed;
+      } else {
+        // Zstd not supported, or compressed less than 12.5%, so just
+        // store uncompressed form
+        *contents = raw;
+        type = kNoCompression;
+      }
+      break;
+    }
+
+    case kLZ4Compression:
+    case kLZ4HCCompression: {
+      if ((type == kLZ4Compression
+               ? port::Lz4_Compress(raw.data(), raw.size(), compressed)
+               : port::Lz4hc_Compress(options.lz4hc_compression_level,
+                                      raw.data(), raw.size(), compressed)) &&
+          compressed->size() < raw.size() - (raw.size() / 8u)) {
+        // LZ4 does not record the uncompressed length, so it comes first
+        char header[5];
+        char* end = EncodeVarint32(header, raw.size());
+        compressed->insert(0, header, end - header);
+        *contents = *compressed;
+      } else {
+        // LZ4 not supported, or compressed less than 12.5%, so just
+        // store uncompressed form
+        *contents = raw;
+        type = kNoCompression;
+      }
+      break;
+    }
+  }
+  return type;
+}
+
+class BlockCompressor;
+
+// A data block queued for compression.
+struct CompressionJob {
+  std::string raw;
+  std::string compressed;
+  const void* zstd_dictionary;
+  bool cancelled;  // Before a thread started on it
+  bool done;
+  // Set once done
+  Slice contents;  // The block as stored: raw or compressed
+  CompressionType type;
+};
+
+// The threads that compress data blocks for
+// Options::compression_parallel_threads.  One pool serves every table
+// being built in the process, so that concurrent compactions, or several
+// DBs, do not each start threads of their own.  It grows to the largest
+// compression_parallel_threads asked for, and its threads live as long as
+// the process.
+class CompressionPool {
+ public:
+  // Returns the pool shared by the process.
+  static CompressionPool* Default() {
+    static NoDestructor<CompressionPool> singleton;
+    return singleton.get();
+  }
+
+  CompressionPool() : work_cv_(&mu_), threads_(0) {}
+
+  CompressionPool(const CompressionPool&) = delete;
+  CompressionPool& operator=(const CompressionPool&) = delete;
+
+  // Starts threads with "env" until the pool has at least "threads".
+  void Reserve(Env* env, int threads) {
+    MutexLock l(&mu_);
+    for (; threads_ < threads; threads_++) {
+      env->StartThread(&CompressionPool::ThreadMain, this);
+    }
+  }
+
+  // Queues "job" of "owner" for compression.  The pool calls
+  // owner->Compress(job) on one of its threads.
+  void Submit(BlockCompressor* owner, CompressionJob* job) {
+    MutexLock l(&mu_);
+    queue_.push_back(Task{owner, job});
+    work_cv_.Signal();
+  }
+
+  // Removes the jobs of "owner" that no thread has started on, and marks
+  // them cancelled.
+  void CancelAll(BlockCompressor* owner) {
+    MutexLock l(&mu_);
+    auto it = queue_.begin();
+    while (it != queue_.end()) {
+      if (it->owner == owner) {
+        it->job->cancelled = true;
+        it = queue_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+ private:
+  struct Task {
+    BlockCompressor* owner;
+    CompressionJob* job;
+  };
+
+  static void ThreadMain(void* arg) {
+    reinterpret_cast<CompressionPool*>(arg)->Work();
+  }
+
+  void Work();
+
+  port::Mutex mu_;
+  port::CondVar work_cv_ GUARDED_BY(mu_);  // Signalled for new jobs
+  std::deque<Task> queue_ GUARDED_BY(mu_);  // Oldest first
+  int threads_ GUARDED_BY(mu_);
+};
+
+// Compresses the data blocks of one table on the CompressionPool.  Blocks
+// are handed back in the order they were submitted, so that they can be
+// written in key order.
+class BlockCompressor {
+ public:
+  typedef CompressionJob Job;
+
+  BlockCompressor(const Options& options, int threads)
+      : options_(options), done_cv_(&mu_) {
+    CompressionPool::Default()->Reserve(options.env, threads);
+  }
+
+  BlockCompressor(const BlockCompressor&) = delete;
+  BlockCompressor& operator=(const BlockCompressor&) = delete;
+
+  // Waits for the blocks being compressed.  Blocks still queued are
+  // dropped.
+  ~BlockCompressor() {
+    CompressionPool::Default()->CancelAll(this);
+    MutexLock l(&mu_);
+    for (Job* job : jobs_) {
+      while (!job->cancelled && !job->done) {
+        done_cv_.Wait();
+      }
+      delete job;
+    }
+  }
+
+  // Queues the block in *raw for compression, taking its contents.
+  void Submit(std::string* raw, const void* zstd_dictionary) {
+    Job* job = new Job;
+    job->raw.swap(*raw);
+    job->zstd_dictionary = zstd_dictionary;
+    job->cancelled = false;
+    job->done = false;
+    {
+      MutexLock l(&mu_);
+      jobs_.push_back(job);
+    }
+    CompressionPool::Default()->Submit(this, job);
+  }
+
+  // Removes and returns the oldest block submitted if it is compressed,
+  // waiting for that if "wait" is set.  Returns nullptr if there is no
+  // such block.  The caller owns the result.
+  Job* TakeFinished(bool wait) {
+    MutexLock l(&mu_);
+    if (wait) {
+      while (!jobs_.empty() && !jobs_.front()->done) {
+        done_cv_.Wait();
+      }
+    }
+    if (jobs_.empty() || !jobs_.front()->done) {
+      return nullptr;
+    }
+    Job* job = jobs_.front();
+    jobs_.pop_front();
+    return job;
+  }
+
+  // Number of blocks submitted and not yet taken back.
+  size_t NumPending() {
+    MutexLock l(&mu_);
+    return jobs_.size();
+  }
+
+  // REQUIRES: NumPending() == 0
+  void SetOptions(const Options& options) {
+    MutexLock l(&mu_);
+    assert(jobs_.empty());
+    options_ = options;
+  }
+
+  // Called by the pool, on one of its threads, for a job queued with
+  // Submit().  *this is not touched once the job is marked done.
+  void Compress(Job* job) {
+    // options_ only changes while no blocks are queued
+    job->type = CompressBlock(options_, job->zstd_dictionary, job->raw,
+                              &job->compressed, &job->contents);
+    MutexLock l(&mu_);
+    job->done = true;
+    done_cv_.SignalAll();
+  }
+
+ private:
+  Options options_;
+  port::Mutex mu_;
+  port::CondVar done_cv_ GUARDED_BY(mu_);  // Signalled for finished blocks
+  std::deque<Job*> jobs_ GUARDED_BY(mu_);  // In the order submitted
+};
+
+void CompressionPool::Work() {
+  mu_.Lock();
+  while (true) {
+    while (queue_.empty()) {
+      work_cv_.Wait();
+    }
+    Task task = queue_.front();
+    queue_.pop_front();
+    mu_.Unlock();
+    task.owner->Compress(task.job);
+    mu_.Lock();
+  }
+}
+
+// With parallel compression, the builder waits for blocks to be
+// compressed once it has this many per thread queued.
+static const int kMaxPendingBlocksPerThread = 2;
+
 struct TableBuilder::Rep {
   Rep(const Options& opt, WritableFile* f)
       : options(opt),
         index_block_options(opt),
         file(f),
         offset(0),
-        data_block(&options),
+        data_block(&options, /*data_block=*/true),
         index_block(&index_block_options),
+        top_index_block(&index_block_options),
         num_entries(0),
         closed(false),
         filter_block(opt.filter_policy == nullptr
                          ? nullptr
-                         : new FilterBlockBuilder(opt.filter_policy)),
-        pending_index_entry(false) {
+                         : new FilterBlockBuilder(
+                               opt.filter_policy,
+                               opt.filter_policy->UseFullFilter())),
+        pending_index_entry(false),
+        plain(opt.table_format == kPlainTable ? new PlainTableBuilder(opt, f)
+                                              : nullptr),
+        buffering(opt.table_format != kPlainTable &&
+                  opt.compression == kZstdCompression &&
+                  opt.zstd_max_dictionary_size > 0),
+        zstd_dictionary(nullptr),
+        compressor(opt.table_format != kPlainTable &&
+                           opt.compression != kNoCompression &&
+                           opt.compression_parallel_threads > 1
+                       ? new BlockCompressor(opt,
+                                             opt.compression_parallel_threads)
+                       : nullptr) {
     index_block_options.block_restart_interval = 1;
   }
 
@@ -42,6 +324,9 @@ struct TableBuilder::Rep {
   Status status;
   BlockBuilder data_block;
   BlockBuilder index_block;
+  // With Options::index_partition_size, index_block holds the current
+  // index partition, and this block maps keys to the partitions written.
+  BlockBuilder top_index_block;
   std::string last_key;
   int64_t num_entries;
   bool closed;  // Either Finish() or Abandon() has been called.
@@ -55,11 +340,30 @@ struct TableBuilder::Rep {
   // entries in the first block and < all entries in subsequent
   // blocks.
   //
-  // Invariant: r->pending_index_entry is true only if data_block is empty.
+  // Invariant: r->pending_index_entry is true only if data_block is empty,
+  // unless blocks are compressed in parallel.
   bool pending_index_entry;
   BlockHandle pending_handle;  // Handle to add to index block
 
   std::string compressed_output;
+
+  // Non-null if building a plain table, which then gets all entries
+  PlainTableBuilder* plain;
+
+  // With Options::zstd_max_dictionary_size, data blocks are held back
+  // until there are enough of them to train the zstd dictionary that they
+  // are then compressed with.  Their index entries and filter keys are
+  // added when they are written.
+  bool buffering;
+  std::string buffered_blocks;  // Uncompressed, one after the other
+  std::vector<size_t> buffered_block_sizes;
+  std::string zstd_dictionary_data;
+  void* zstd_dictionary;  // Digested zstd_dictionary_data, if any
+
+  // With Options::compression_parallel_threads, data blocks are compressed
+  // here.  Like held back blocks, their index entries and filter keys are
+  // added when they are written.
+  BlockCompressor* compressor;
 };
 
 TableBuilder::TableBuilder(const Options& options, WritableFile* file)
@@ -71,7 +375,12 @@ TableBuilder::TableBuilder(const Options& options, WritableFile* file)
 
 TableBuilder::~TableBuilder() {
   assert(rep_->closed);  // Catch errors where caller forgot to call Finish()
+  delete rep_->compressor;
   delete rep_->filter_block;
+  delete rep_->plain;
+  if (rep_->zstd_dictionary != nullptr) {
+    port::Zstd_DeleteCompressionDictionary(rep_->zstd_dictionary);
+  }
   delete rep_;
 }
 
@@ -82,6 +391,19 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   if (options.comparator != rep_->options.comparator) {
     return Status::InvalidArgument("changing comparator while building table");
   }
+  if ((options.index_partition_size == 0) !=
+      (rep_->options.index_partition_size == 0)) {
+    return Status::InvalidArgument(
+        "changing index partitioning while building table");
+  }
+  if (options.table_format != rep_->options.table_format) {
+    return Status::InvalidArgument("changing table format while building table");
+  }
+  if (rep_->compressor != nullptr) {
+    // Blocks already queued are compressed with the old options
+    WriteCompressedBlocks(0);
+    rep_->compressor->SetOptions(options);
+  }
 
   // Note that any live BlockBuilders point to rep_->options and therefore
   // will automatically pick up the updated options.
@@ -95,24 +417,30 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   Rep* r = rep_;
   assert(!r->closed);
   if (!ok()) return;
-  if (r->num_entries > 0) {
+  // Index entries and filter keys of blocks held back or compressed in
+  // parallel are added as the blocks are written
+  const bool add_block_keys = !r->buffering && r->compressor == nullptr;
+  if (r->num_entries > 0 && add_block_keys) {
     assert(r->options.comparator->Compare(key, Slice(r->last_key)) > 0);
   }
-
-  if (r->pending_index_entry) {
-    assert(r->data_block.empty());
-    r->options.comparator->FindShortestSeparator(&r->last_key, key);
-    std::string handle_encoding;
-    r->pending_handle.EncodeTo(&handle_encoding);
-    r->index_block.Add(r->last_key, Slice(handle_encoding));
-    r->pending_index_entry = false;
+  if (r->plain != nullptr) {
+    r->last_key.assign(key.data(), key.size());
+    r->num_entries++;
+    r->plain->Add(key, value);
+    return;
   }
 
-  if (r->filter_block != nullptr) {
-    r->filter_block->AddKey(key);
+  if (add_block_keys) {
+    if (r->pending_index_entry) {
+      assert(r->data_block.empty());
+      AddIndexEntry(key);
+    }
+    if (r->filter_block != nullptr) {
+      r->filter_block->AddKey(key);
+    }
+    // Otherwise r->last_key stays the last key of the blocks written
+    r->last_key.assign(key.data(), key.size());
   }
-
-  r->last_key.assign(key.data(), key.size());
   r->num_entries++;
   r->data_block.Add(key, value);
 
@@ -122,11 +450,47 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   }
 }
 
+// Add the index entry of the last data block written, whose last key is
+// r->last_key, given the first key of the next data block.
+void TableBuilder::AddIndexEntry(const Slice& next_key) {
+  Rep* r = rep_;
+  r->options.comparator->FindShortestSeparator(&r->last_key, next_key);
+  std::string handle_encoding;
+  r->pending_handle.EncodeTo(&handle_encoding);
+  r->index_block.Add(r->last_key, Slice(handle_encoding));
+  r->pending_index_entry = false;
+
+  if (r->options.index_partition_size > 0 &&
+      r->index_block.CurrentSizeEstimate() >=
+          r->options.index_partition_size) {
+    FlushIndexPartition();
+    if (r->filter_block != nullptr) {
+      // The next data block now starts after the partition
+      r->filter_block->StartBlock(r->offset);
+    }
+  }
+}
+
 void TableBuilder::Flush() {
   Rep* r = rep_;
   assert(!r->closed);
   if (!ok()) return;
-  if (r->data_block.empty()) return;
+  if (r->plain != nullptr || r->data_block.empty()) return;
+  if (r->buffering) {
+    Slice raw = r->data_block.Finish();
+    r->buffered_blocks.append(raw.data(), raw.size());
+    r->buffered_block_sizes.push_back(raw.size());
+    r->data_block.Reset();
+    if (r->buffered_blocks.size() >= r->options.zstd_dictionary_training_bytes) {
+      WriteBufferedBlocks();
+    }
+    return;
+  }
+  if (r->compressor != nullptr) {
+    SubmitDataBlock(r->data_block.Finish());
+    r->data_block.Reset();
+    return;
+  }
   assert(!r->pending_index_entry);
   WriteBlock(&r->data_block, &r->pending_handle);
   if (ok()) {
@@ -142,51 +506,25 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
   // File format contains a sequence of blocks where each block has:
   //    block_data: uint8[n]
   //    type: uint8
-  //    crc: uint32
+  //    checksum: uint32
   assert(ok());
   Rep* r = rep_;
-  Slice raw = block->Finish();
+  // Only data blocks use the dictionary
+  CompressAndWriteBlock(
+      block->Finish(),
+      block == &r->data_block ? r->zstd_dictionary : nullptr, handle);
+  block->Reset();
+}
 
+void TableBuilder::CompressAndWriteBlock(const Slice& raw,
+                                         const void* zstd_dictionary,
+                                         BlockHandle* handle) {
+  Rep* r = rep_;
   Slice block_contents;
-  CompressionType type = r->options.compression;
-  // TODO(postrelease): Support more compression options: zlib?
-  switch (type) {
-    case kNoCompression:
-      block_contents = raw;
-      break;
-
-    case kSnappyCompression: {
-      std::string* compressed = &r->compressed_output;
-      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-          compressed->size() < raw.size() - (raw.size() / 8u)) {
-        block_contents = *compressed;
-      } else {
-        // Snappy not supported, or compressed less than 12.5%, so just
-        // store uncompressed form
-        block_contents = raw;
-        type = kNoCompression;
-      }
-      break;
-    }
-
-    case kZstdCompression: {
-      std::string* compressed = &r->compressed_output;
-      if (port::Zstd_Compress(r->options.zstd_compression_level, raw.data(),
-                              raw.size(), compressed) &&
-          compressed->size() < raw.size() - (raw.size() / 8u)) {
-        block_contents = *compressed;
-      } else {
-        // Zstd not supported, or compressed less than 12.5%, so just
-        // store uncompressed form
-        block_contents = raw;
-        type = kNoCompression;
-      }
-      break;
-    }
-  }
+  CompressionType type = CompressBlock(r->options, zstd_dictionary, raw,
+                                       &r->compressed_output, &block_contents);
   WriteRawBlock(block_contents, type, handle);
   r->compressed_output.clear();
-  block->Reset();
 }
 
 void TableBuilder::WriteRawBlock(const Slice& block_contents,
@@ -198,9 +536,12 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
   if (r->status.ok()) {
     char trailer[kBlockTrailerSize];
     trailer[0] = type;
-    uint32_t crc = crc32c::Value(block_contents.data(), block_contents.size());
-    crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
-    EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+    if (r->options.checksum == kXXH3) {
+      trailer[0] |= kBlockChecksumXXH3Flag;
+    }
+    EncodeFixed32(trailer + 1, BlockChecksum(block_contents.data(),
+                                             block_contents.size(),
+                                             trailer[0]));
     r->status = r->file->Append(Slice(trailer, kBlockTrailerSize));
     if (r->status.ok()) {
       r->offset += block_contents.size() + kBlockTrailerSize;
@@ -208,15 +549,139 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
   }
 }
 
-Status TableBuilder::status() const { return rep_->status; }
+// Write out the current index partition and point the top-level index
+// at it.  r->last_key is the key of the partition's last entry, which is
+// >= every key the partition covers.
+void TableBuilder::FlushIndexPartition() {
+  Rep* r = rep_;
+  if (!ok() || r->index_block.empty()) return;
+  BlockHandle handle;
+  WriteBlock(&r->index_block, &handle);
+  if (ok()) {
+    std::string handle_encoding;
+    handle.EncodeTo(&handle_encoding);
+    r->top_index_block.Add(r->last_key, Slice(handle_encoding));
+  }
+}
+
+// Write out the data block "raw", stored as "contents" with compression
+// "type", along with its index entry and filter keys.  For data blocks that
+// are held back or compressed in parallel, once their turn has come.
+void TableBuilder::WriteDataBlock(const Slice& raw, const Slice& contents,
+                                  CompressionType type) {
+  Rep* r = rep_;
+  BlockContents block_contents;
+  block_contents.data = raw;
+  block_contents.cachable = false;
+  block_contents.heap_allocated = false;
+  Block block(block_contents);
+  Iterator* iter = block.NewIterator(r->options.comparator);
+  iter->SeekToFirst();
+  if (r->pending_index_entry) {
+    AddIndexEntry(iter->key());
+  }
+  if (r->filter_block != nullptr) {
+    for (; iter->Valid(); iter->Next()) {
+      r->filter_block->AddKey(iter->key());
+    }
+  }
+  iter->SeekToLast();
+  r->last_key.assign(iter->key().data(), iter->key().size());
+  delete iter;
+
+  WriteRawBlock(contents, type, &r->pending_handle);
+  if (ok()) {
+    r->pending_index_entry = true;
+    r->status = r->file->Flush();
+  }
+  if (r->filter_block != nullptr) {
+    r->filter_block->StartBlock(r->offset);
+  }
+}
+
+// Hand the data block "raw" to the compression threads, and write out the
+// blocks they are done with.
+void TableBuilder::SubmitDataBlock(const Slice& raw) {
+  Rep* r = rep_;
+  std::string block(raw.data(), raw.size());
+  r->compressor->Submit(&block, r->zstd_dictionary);
+  WriteCompressedBlocks(kMaxPendingBlocksPerThread *
+                        r->options.compression_parallel_threads);
+}
+
+// Write out the blocks compressed in parallel that are next in line,
+// waiting for them while more than "max_pending" are queued.
+void TableBuilder::WriteCompressedBlocks(size_t max_pending) {
+  Rep* r = rep_;
+  for (;;) {
+    const bool wait = r->compressor->NumPending() > max_pending;
+    BlockCompressor::Job* job = r->compressor->TakeFinished(wait);
+    if (job == nullptr) break;
+    if (ok()) {
+      WriteDataBlock(job->raw, job->contents, job->type);
+    }
+    delete job;
+  }
+}
+
+// Train the zstd dictionary on the buffered data blocks, then write them
+// out along with their index entries and filter keys.
+void TableBuilder::WriteBufferedBlocks() {
+  Rep* r = rep_;
+  assert(r->buffering && r->data_block.empty());
+  r->buffering = false;
+  if (port::Zstd_TrainDictionary(r->buffered_blocks, r->buffered_block_sizes,
+                                 r->options.zstd_max_dictionary_size,
+                                 &r->zstd_dictionary_data)) {
+    r->zstd_dictionary = port::Zstd_NewCompressionDictionary(
+        r->options.zstd_compression_level, r->zstd_dictionary_data.data(),
+        r->zstd_dictionary_data.size());
+  }
+  if (r->zstd_dictionary == nullptr) {
+    // Too few samples, most likely: do without
+    r->zstd_dictionary_data.clear();
+  }
+
+  const char* p = r->buffered_blocks.data();
+  for (size_t n : r->buffered_block_sizes) {
+    if (!ok()) break;
+    Slice raw(p, n);
+    p += n;
+    if (r->compressor != nullptr) {
+      SubmitDataBlock(raw);
+    } else {
+      Slice contents;
+      CompressionType type = CompressBlock(r->options, r->zstd_dictionary, raw,
+                                           &r->compressed_output, &contents);
+      WriteDataBlock(raw, contents, type);
+      r->compressed_output.clear();
+    }
+  }
+  std::string().swap(r->buffered_blocks);
+  std::vector<size_t>().swap(r->buffered_block_sizes);
+}
+
+Status TableBuilder::status() const {
+  return rep_->plain != nullptr ? rep_->plain->status() : rep_->status;
+}
 
 Status TableBuilder::Finish() {
   Rep* r = rep_;
   Flush();
   assert(!r->closed);
   r->closed = true;
+  if (r->plain != nullptr) {
+    return r->plain->Finish();
+  }
+  if (ok() && r->buffering) {
+    WriteBufferedBlocks();
+  }
+  if (r->compressor != nullptr) {
+    WriteCompressedBlocks(0);
+  }
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle,
+      dictionary_handle;
 
   // Write filter block
   if (ok() && r->filter_block != nullptr) {
@@ -224,17 +689,35 @@ Status TableBuilder::Finish() {
                   &filter_block_handle);
   }
 
+  // Write zstd dictionary block
+  if (ok() && r->zstd_dictionary != nullptr) {
+    WriteRawBlock(r->zstd_dictionary_data, kNoCompression, &dictionary_handle);
+  }
+
   // Write metaindex block
   if (ok()) {
     BlockBuilder meta_index_block(&r->options);
     if (r->filter_block != nullptr) {
-      // Add mapping from "filter.Name" to location of filter data
-      std::string key = "filter.";
+      // Add mapping from "filter.Name" (or "fullfilter.Name") to location
+      // of filter data
+      std::string key = r->options.filter_policy->UseFullFilter()
+                            ? "fullfilter."
+                            : "filter.";
       key.append(r->options.filter_policy->Name());
       std::string handle_encoding;
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    if (r->options.index_partition_size > 0) {
+      // Tells readers that the footer points at a top-level index
+      meta_index_block.Add("index.partitioned", Slice());
+    }
+    if (r->zstd_dictionary != nullptr) {
+      // Data blocks need it to be uncompressed
+      std::string handle_encoding;
+      dictionary_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add("zstd.dictionary", handle_encoding);
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -249,7 +732,16 @@ Status TableBuilder::Finish() {
       r->index_block.Add(r->last_key, Slice(handle_encoding));
       r->pending_index_entry = false;
     }
-    WriteBlock(&r->index_block, &index_block_handle);
+    if (r->options.index_partition_size > 0) {
+      FlushIndexPartition();
+    }
+  }
+  if (ok()) {
+    if (r->options.index_partition_size > 0) {
+      WriteBlock(&r->top_index_block, &index_block_handle);
+    } else {
+      WriteBlock(&r->index_block, &index_block_handle);
+    }
   }
 
   // Write footer
@@ -257,6 +749,7 @@ Status TableBuilder::Finish() {
     Footer footer;
     footer.set_metaindex_handle(metaindex_block_handle);
     footer.set_index_handle(index_block_handle);
+    footer.set_checksum_type(r->options.checksum);
     std::string footer_encoding;
     footer.EncodeTo(&footer_encoding);
     r->status = r->file->Append(footer_encoding);
@@ -275,6 +768,12 @@ void TableBuilder::Abandon() {
 
 uint64_t TableBuilder::NumEntries() const { return rep_->num_entries; }
 
-uint64_t TableBuilder::FileSize() const { return rep_->offset; }
+uint64_t TableBuilder::FileSize() const {
+  if (rep_->plain != nullptr) {
+    return rep_->plain->FileSize();
+  }
+  // Count buffered data blocks as if they were written uncompressed
+  return rep_->offset + rep_->buffered_blocks.size();
+}
 
 }  // namespace leveldb
@@ -4,8 +4,12 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "db/dbformat.h"
@@ -19,6 +23,7 @@
 #include "table/block.h"
 #include "table/block_builder.h"
 #include "table/format.h"
+#include "util/coding.h"
 #include "util/random.h"
 #include "util/testutil.h"
 
@@ -371,7 +376,16 @@ class DBConstructor : public Constructor {
   DB* db_;
 };
 
-enum TestType { TABLE_TEST, BLOCK_TEST, MEMTABLE_TEST, DB_TEST };
+enum TestType {
+  TABLE_TEST,
+  PARTITIONED_INDEX_TABLE_TEST,
+  PLAIN_TABLE_TEST,
+  PARALLEL_COMPRESSION_TABLE_TEST,
+  XXH3_TABLE_TEST,
+  BLOCK_TEST,
+  MEMTABLE_TEST,
+  DB_TEST
+};
 
 struct TestArgs {
   TestType type;
@@ -387,6 +401,20 @@ static const TestArgs kTestArgList[] = {
     {TABLE_TEST, true, 1},
     {TABLE_TEST, true, 1024},
 
+    // Index partitions of a few entries each
+    {PARTITIONED_INDEX_TABLE_TEST, false, 16},
+    {PARTITIONED_INDEX_TABLE_TEST, true, 16},
+
+    // Restart interval does not matter for plain tables
+    {PLAIN_TABLE_TEST, false, 16},
+    {PLAIN_TABLE_TEST, true, 16},
+
+    {PARALLEL_COMPRESSION_TABLE_TEST, false, 16},
+    {PARALLEL_COMPRESSION_TABLE_TEST, true, 16},
+
+    {XXH3_TABLE_TEST, false, 16},
+    {XXH3_TABLE_TEST, true, 16},
+
     {BLOCK_TEST, false, 16},
     {BLOCK_TEST, false, 1},
     {BLOCK_TEST, false, 1024},
@@ -424,6 +452,23 @@ class Harness : public testing::Test {
       case TABLE_TEST:
         constructor_ = new TableConstructor(options_.comparator);
         break;
+      case PARTITIONED_INDEX_TABLE_TEST:
+        options_.index_partition_size = 64;
+        constructor_ = new TableConstructor(options_.comparator);
+        break;
+      case PLAIN_TABLE_TEST:
+        options_.table_format = kPlainTable;
+        constructor_ = new TableConstructor(options_.comparator);
+        break;
+      case PARALLEL_COMPRESSION_TABLE_TEST:
+        options_.compression = kZstdCompression;
+        options_.compression_parallel_threads = 3;
+        constructor_ = new TableConstructor(options_.comparator);
+        break;
+      case XXH3_TABLE_TEST:
+        options_.checksum = kXXH3;
+        constructor_ = new TableConstructor(options_.comparator);
+        break;
       case BLOCK_TEST:
         constructor_ = new BlockConstructor(options_.comparator);
         break;
@@ -756,6 +801,145 @@ static bool Between(uint64_t val, uint64_t low, uint64_t high) {
   return result;
 }
 
+TEST(BlockTest, HashIndexSeek) {
+  InternalKeyComparator icmp(BytewiseComparator());
+  Options options;
+  options.comparator = &icmp;
+  options.block_restart_interval = 4;
+  options.data_block_hash_index = true;
+  BlockBuilder indexed(&options, /*data_block=*/true);
+  BlockBuilder plain(&options);
+
+  // Every even user key, with up to three versions that may span
+  // restart intervals
+  Random rnd(301);
+  for (int i = 0; i < 400; i += 2) {
+    char user_key[20];
+    std::snprintf(user_key, sizeof(user_key), "key%06d", i);
+    for (int v = 1 + rnd.Uniform(3); v > 0; v--) {
+      InternalKey ikey(user_key, 10 * v, kTypeValue);
+      indexed.Add(ikey.Encode(), "v");
+      plain.Add(ikey.Encode(), "v");
+    }
+  }
+  const std::string indexed_data = indexed.Finish().ToString();
+  const std::string plain_data = plain.Finish().ToString();
+  ASSERT_GT(indexed_data.size(), plain_data.size());
+  ASSERT_NE(0, DecodeFixed32(indexed_data.data() + indexed_data.size() - 4) &
+                   kBlockHashIndexFlag);
+
+  BlockContents contents;
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  contents.data = indexed_data;
+  Block indexed_block(contents);
+  contents.data = plain_data;
+  Block plain_block(contents);
+  Iterator* indexed_iter = indexed_block.NewIterator(&icmp);
+  Iterator* plain_iter = plain_block.NewIterator(&icmp);
+
+  // Seeks give the same result with and without the index, for present
+  // and absent keys and at every sequence number
+  const SequenceNumber kSeqs[] = {5, 15, 25, 35, kMaxSequenceNumber};
+  for (int i = 0; i < 402; i++) {
+    char user_key[20];
+    std::snprintf(user_key, sizeof(user_key), "key%06d", i);
+    for (SequenceNumber seq : kSeqs) {
+      InternalKey target(user_key, seq, kValueTypeForSeek);
+      indexed_iter->Seek(target.Encode());
+      plain_iter->Seek(target.Encode());
+      ASSERT_EQ(plain_iter->Valid(), indexed_iter->Valid()) << i;
+      if (plain_iter->Valid()) {
+        ASSERT_EQ(plain_iter->key().ToString(), indexed_iter->key().ToString());
+        indexed_iter->Next();
+        plain_iter->Next();
+        ASSERT_EQ(plain_iter->Valid(), indexed_iter->Valid());
+      }
+    }
+  }
+  ASSERT_LEVELDB_OK(indexed_iter->status());
+  delete indexed_iter;
+  delete plain_iter;
+
+  // Blocks with too many restart intervals for the index go without it
+  options.block_restart_interval = 1;
+  indexed.Reset();
+  for (int i = 0; i < 300; i++) {
+    char user_key[20];
+    std::snprintf(user_key, sizeof(user_key), "key%06d", i);
+    indexed.Add(InternalKey(user_key, 1, kTypeValue).Encode(), "v");
+  }
+  Slice large = indexed.Finish();
+  ASSERT_EQ(300, DecodeFixed32(large.data() + large.size() - 4));
+}
+
+TEST(BlockTest, RestartPrefixSeek) {
+  InternalKeyComparator icmp(BytewiseComparator());
+  Options options;
+  options.comparator = &icmp;
+  options.block_restart_interval = 2;
+  options.data_block_restart_prefixes = true;
+  BlockBuilder prefixed(&options, /*data_block=*/true);
+  BlockBuilder plain(&options);
+
+  // User keys that are shorter than a prefix, and longer ones whose
+  // prefixes tie across many restart points
+  std::vector<std::string> user_keys;
+  for (int i = 0; i < 300; i += 3) {
+    char buf[30];
+    std::snprintf(buf, sizeof(buf), "%c", 'a' + i / 30);
+    user_keys.push_back(buf);
+    std::snprintf(buf, sizeof(buf), "%c%c", 'a' + i / 30, 'a' + i % 30);
+    user_keys.push_back(buf);
+    std::snprintf(buf, sizeof(buf), "prefixed%06d", i);
+    user_keys.push_back(buf);
+  }
+  std::sort(user_keys.begin(), user_keys.end());
+  user_keys.erase(std::unique(user_keys.begin(), user_keys.end()),
+                  user_keys.end());
+  for (const std::string& user_key : user_keys) {
+    InternalKey ikey(user_key, 10, kTypeValue);
+    prefixed.Add(ikey.Encode(), "v");
+    plain.Add(ikey.Encode(), "v");
+  }
+  const std::string prefixed_data = prefixed.Finish().ToString();
+  const std::string plain_data = plain.Finish().ToString();
+  ASSERT_GT(prefixed_data.size(), plain_data.size());
+  ASSERT_NE(0, DecodeFixed32(prefixed_data.data() + prefixed_data.size() - 4) &
+                   kBlockRestartPrefixFlag);
+
+  BlockContents contents;
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  contents.data = prefixed_data;
+  Block prefixed_block(contents);
+  contents.data = plain_data;
+  Block plain_block(contents);
+  Iterator* prefixed_iter = prefixed_block.NewIterator(&icmp);
+  Iterator* plain_iter = plain_block.NewIterator(&icmp);
+
+  // Seeks give the same result with and without the prefixes, from fresh
+  // and from already positioned iterators
+  Random rnd(301);
+  for (int i = 0; i < 2000; i++) {
+    std::string user_key = user_keys[rnd.Uniform(user_keys.size())];
+    if (rnd.OneIn(2)) {
+      user_key.resize(rnd.Uniform(user_key.size() + 1));
+      user_key.push_back('a' + rnd.Uniform(26));
+    }
+    InternalKey target(user_key, rnd.OneIn(2) ? 5 : 15, kValueTypeForSeek);
+    prefixed_iter->Seek(target.Encode());
+    plain_iter->Seek(target.Encode());
+    ASSERT_EQ(plain_iter->Valid(), prefixed_iter->Valid()) << user_key;
+    if (plain_iter->Valid()) {
+      ASSERT_EQ(plain_iter->key().ToString(), prefixed_iter->key().ToString());
+    }
+  }
+  ASSERT_LEVELDB_OK(prefixed_iter->status());
+  delete prefixed_iter;
+  delete plain_iter;
+}
+
 TEST(TableTest, ApproximateOffsetOfPlain) {
   TableConstructor c(BytewiseComparator());
   c.Add("k01", "hello");
@@ -785,6 +969,147 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
 }
 
+TEST(TableTest, ApproximateOffsetOfPartitionedIndex) {
+  TableConstructor c(BytewiseComparator());
+  c.Add("k01", "hello");
+  c.Add("k02", "hello2");
+  c.Add("k03", std::string(10000, 'x'));
+  c.Add("k04", std::string(200000, 'x'));
+  c.Add("k05", std::string(300000, 'x'));
+  c.Add("k06", "hello3");
+  c.Add("k07", std::string(100000, 'x'));
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  options.index_partition_size = 1;  // One index entry per partition
+  c.Finish(options, &keys, &kvmap);
+
+  // Each partition adds a few bytes in front of the data block after it
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("abc"), 0, 0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k02"), 0, 0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k03"), 0, 100));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k04"), 10000, 11000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k05"), 210000, 211000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k07"), 510000, 511000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
+}
+
+// Returns the status of reading every entry of "contents" with checksums
+// verified.
+static Status ScanTable(const std::string& contents) {
+  StringSource source(contents);
+  Options options;
+  options.paranoid_checks = true;
+  Table* table;
+  Status s = Table::Open(options, &source, contents.size(), &table);
+  if (!s.ok()) {
+    return s;
+  }
+  ReadOptions read_options;
+  read_options.verify_checksums = true;
+  Iterator* iter = table->NewIterator(read_options);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+  }
+  s = iter->status();
+  delete iter;
+  delete table;
+  return s;
+}
+
+TEST(TableTest, ChecksumTypes) {
+  for (ChecksumType checksum : {kCRC32c, kXXH3}) {
+    Options options;
+    options.block_size = 1024;
+    options.checksum = checksum;
+    StringSink sink;
+    TableBuilder builder(options, &sink);
+    for (int i = 0; i < 1000; i++) {
+      char key[16];
+      std::snprintf(key, sizeof(key), "k%06d", i);
+      builder.Add(key, std::string(100, 'a' + i % 26));
+    }
+    ASSERT_LEVELDB_OK(builder.Finish());
+    std::string contents = sink.contents();
+
+    Slice footer_input(contents.data() + contents.size() -
+                           Footer::kEncodedLength,
+                       Footer::kEncodedLength);
+    Footer footer;
+    ASSERT_LEVELDB_OK(footer.DecodeFrom(&footer_input));
+    ASSERT_EQ(checksum, footer.checksum_type());
+    ASSERT_LEVELDB_OK(ScanTable(contents));
+
+    // Corrupt a byte of the first data block
+    contents[10] ^= 0x1;
+    ASSERT_TRUE(ScanTable(contents).IsCorruption());
+  }
+}
+
+TEST(TableTest, UnknownChecksumType) {
+  Options options;
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  builder.Add("k1", "v1");
+  ASSERT_LEVELDB_OK(builder.Finish());
+  std::string contents = sink.contents();
+  contents[contents.size() - 9] = 0x7f;
+  ASSERT_TRUE(ScanTable(contents).IsNotSupportedError());
+}
+
+// Counts the threads started through it.
+class ThreadCountingEnv : public EnvWrapper {
+ public:
+  ThreadCountingEnv() : EnvWrapper(Env::Default()), threads_started_(0) {}
+
+  void StartThread(void (*function)(void* arg), void* arg) override {
+    threads_started_++;
+    target()->StartThread(function, arg);
+  }
+
+  int threads_started() const { return threads_started_; }
+
+ private:
+  std::atomic<int> threads_started_;
+};
+
+TEST(TableTest, ParallelCompressionSharesThreads) {
+  ThreadCountingEnv env;
+  Options options;
+  options.env = &env;
+  options.block_size = 1024;
+  options.compression = kZstdCompression;
+  options.compression_parallel_threads = 4;
+
+  // Tables built at the same time compress on the same threads
+  const int kTables = 4;
+  StringSink sinks[kTables];
+  std::vector<TableBuilder*> builders;
+  for (int t = 0; t < kTables; t++) {
+    builders.push_back(new TableBuilder(options, &sinks[t]));
+  }
+  for (int i = 0; i < 1000; i++) {
+    char key[16];
+    std::snprintf(key, sizeof(key), "k%06d", i);
+    for (TableBuilder* builder : builders) {
+      builder->Add(key, std::string(100, 'a' + i % 26));
+    }
+  }
+  // Blocks of an abandoned table may still be queued
+  builders.back()->Abandon();
+  for (int t = 0; t < kTables - 1; t++) {
+    ASSERT_LEVELDB_OK(builders[t]->Finish());
+  }
+  for (TableBuilder* builder : builders) {
+    delete builder;
+  }
+  for (int t = 0; t < kTables - 1; t++) {
+    ASSERT_LEVELDB_OK(ScanTable(sinks[t].contents()));
+  }
+  ASSERT_LE(env.threads_started(), options.compression_parallel_threads);
+}
+
 static bool CompressionSupported(CompressionType type) {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
@@ -792,6 +1117,10 @@ static bool CompressionSupported(CompressionType type) {
     return port::Snappy_Compress(in.data(), in.size(), &out);
   } else if (type == kZstdCompression) {
     return port::Zstd_Compress(/*level=*/1, in.data(), in.size(), &out);
+  } else if (type == kLZ4Compression) {
+    return port::Lz4_Compress(in.data(), in.size(), &out);
+  } else if (type == kLZ4HCCompression) {
+    return port::Lz4hc_Compress(/*level=*/9, in.data(), in.size(), &out);
   }
   return false;
 }
@@ -801,7 +1130,8 @@ class CompressionTableTest
 
 INSTANTIATE_TEST_SUITE_P(CompressionTests, CompressionTableTest,
                          ::testing::Values(kSnappyCompression,
-                                           kZstdCompression));
+                                           kZstdCompression, kLZ4Compression,
+                                           kLZ4HCCompression));
 
 TEST_P(CompressionTableTest, ApproximateOffsetOfCompressed) {
   CompressionType type = ::testing::get<0>(GetParam());
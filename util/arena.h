@@ -11,6 +11,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "port/port.h"
+
 namespace leveldb {
 
 class Arena {
@@ -25,31 +27,40 @@ class Arena {
   // Return a pointer to a newly allocated memory block of "bytes" bytes.
   char* Allocate(size_t bytes);
 
-  // Allocate memory with the normal alignment guarantees provided by malloc. ֽڶ
+  // Allocate memory with the normal alignment guarantees provided by malloc. 字节对齐
   char* AllocateAligned(size_t bytes);
 
+  // Like Allocate() and AllocateAligned(), but several threads may call
+  // these at once.  They must not run concurrently with the unsynchronized
+  // variants above.
+  char* AllocateConcurrently(size_t bytes);
+  char* AllocateAlignedConcurrently(size_t bytes);
+
   // Returns an estimate of the total memory usage of data allocated
-  // by the arena. ʣڴ
+  // by the arena. 剩余可用内存
   size_t MemoryUsage() const {
     return memory_usage_.load(std::memory_order_relaxed);
   }
 
  private:
-  char* AllocateFallback(size_t bytes); // ޷ڴзڷڴ
-  char* AllocateNewBlock(size_t block_bytes); // ڴ
+  char* AllocateFallback(size_t bytes); // 处理无法在内存块中分配的情况，用于分配新内存块
+  char* AllocateNewBlock(size_t block_bytes); // 分配新内存块
 
   // Allocation state
-  char* alloc_ptr_; // ǰɷָ
-  size_t alloc_bytes_remaining_; // ǰʣֽ
+  char* alloc_ptr_; // 当前可分配指针
+  size_t alloc_bytes_remaining_; // 当前分配块的剩余字节
 
-  // Array of new[] allocated memory blocks Լڴ
+  // Array of new[] allocated memory blocks 以及分配内存块的数组
   std::vector<char*> blocks_;
 
   // Total memory usage of the arena.
-  // ԭӴ洢ڴ棬Ϊ˳Ӱ죬ʹõɢģ
+  // 利用原子存储可用内存，因为顺序不影响，因此使用的是松散模型
   // TODO(costan): This member is accessed via atomics, but the others are
   //               accessed without any locking. Is this OK?
   std::atomic<size_t> memory_usage_;
+
+  // Serializes the *Concurrently() allocations
+  port::Mutex mu_;
 };
 
 inline char* Arena::Allocate(size_t bytes) {
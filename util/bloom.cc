@@ -4,7 +4,12 @@
 
 #include "leveldb/filter_policy.h"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 #include "leveldb/slice.h"
+#include "util/coding.h"
 #include "util/hash.h"
 
 namespace leveldb {
@@ -17,19 +22,20 @@ static uint32_t BloomHash(const Slice& key) {
 class BloomFilterPolicy : public FilterPolicy {
  public:
   // 
-  explicit BloomFilterPolicy(int bits_per_key) : bits_per_key_(bits_per_key) {
+  BloomFilterPolicy(int bits_per_key, bool use_full_filter)
+      : bits_per_key_(bits_per_key), use_full_filter_(use_full_filter) {
     // We intentionally round down to reduce probing cost a little bit
-    // k̫ڴʹãټ
-    // k̫Сʡڴ棬Ӽ
+    // k太大，增加内存使用，减少假阳性率
+    // k太小，节省内存，但是增加假阳性率
     k_ = static_cast<size_t>(bits_per_key * 0.69);  // 0.69 =~ ln(2)
     if (k_ < 1) k_ = 1;
     if (k_ > 30) k_ = 30;
   }
 
-  // ز¡
+  // 返回布隆过滤器名称
   const char* Name() const override { return "leveldb.BuiltinBloomFilter2"; }
 
-  //һ飨keysnɵĲ¡洢 dst 
+  //接受一个键的数组（keys）、键的数量（n），并将生成的布隆过滤器结果存储在 dst 中
   void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
     // Compute bloom filter size (in both bits and bytes)
     size_t bits = n * bits_per_key_;
@@ -46,12 +52,12 @@ class BloomFilterPolicy : public FilterPolicy {
     for (int i = 0; i < n; i++) {
       // Use double-hashing to generate a sequence of hash values.
       // See analysis in [Kirsch,Mitzenmacher 2006].
-      uint32_t h = BloomHash(keys[i]); // ʹBloomhashϣ
+      uint32_t h = BloomHash(keys[i]); // 使用Bloomhash哈希
       const uint32_t delta = (h >> 17) | (h << 15);  
-      // Rotate right 17 bits Ϊ˫عϣںĹϣ
+      // Rotate right 17 bits 为双重哈希生成增量，用于后续的哈希计算
       for (size_t j = 0; j < k_; j++) {
         const uint32_t bitpos = h % bits;
-        array[bitpos / 8] |= (1 << (bitpos % 8)); // ĿλΪ1
+        array[bitpos / 8] |= (1 << (bitpos % 8)); // 将目标位设置为1
         h += delta;
       }
     }
@@ -61,7 +67,7 @@ class BloomFilterPolicy : public FilterPolicy {
     const size_t len = bloom_filter.size();
     if (len < 2) return false;
 
-    // 
+    // 找数据
     const char* array = bloom_filter.data();
     const size_t bits = (len - 1) * 8;
 
@@ -74,7 +80,7 @@ class BloomFilterPolicy : public FilterPolicy {
       return true;
     }
 
-    // ˫عϣȶ
+    // 双重哈希比对
     uint32_t h = BloomHash(key);
     const uint32_t delta = (h >> 17) | (h << 15);  // Rotate right 17 bits
     for (size_t j = 0; j < k; j++) {
@@ -85,14 +91,142 @@ class BloomFilterPolicy : public FilterPolicy {
     return true;
   }
 
+  bool UseFullFilter() const override { return use_full_filter_; }
+
  private:
-  size_t bits_per_key_; // ÿʹõı
-  size_t k_; // ϣ
+  size_t bits_per_key_; // 每个键使用的比特数
+  bool use_full_filter_;
+  size_t k_; // 哈希函数的数量
+};
+
+// A bloom filter that keeps all of the bits of a key within one 64-byte
+// cache line, so that probing a key touches a single line of memory
+// instead of up to k of them.  The price is a slightly higher false
+// positive rate for the same number of bits, and a filter is never
+// smaller than one line.
+class CacheLocalBloomFilterPolicy : public FilterPolicy {
+ public:
+  CacheLocalBloomFilterPolicy(int bits_per_key, bool use_full_filter)
+      : bits_per_key_(bits_per_key), use_full_filter_(use_full_filter) {
+    k_ = static_cast<size_t>(bits_per_key * 0.69);  // 0.69 =~ ln(2)
+    if (k_ < 1) k_ = 1;
+    if (k_ > 30) k_ = 30;
+  }
+
+  const char* Name() const override { return "leveldb.CacheLocalBloomFilter"; }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    // Round the filter up to a whole number of cache lines
+    size_t bytes = (n * bits_per_key_ + 7) / 8;
+    const size_t num_lines = (bytes + kLineBytes - 1) / kLineBytes;
+    bytes = (num_lines == 0 ? 1 : num_lines) * kLineBytes;
+
+    const size_t init_size = dst->size();
+    dst->resize(init_size + bytes, 0);
+    dst->push_back(static_cast<char>(k_));  // Remember # of probes in filter
+
+    char* array = &(*dst)[init_size];
+    for (int i = 0; i < n; i++) {
+      uint32_t h = BloomHash(keys[i]);
+      char* line = array + LineIndex(h, bytes / kLineBytes) * kLineBytes;
+      for (size_t j = 0; j < k_; j++) {
+        const uint32_t bitpos = NextProbe(&h);
+        line[bitpos / 8] |= (1 << (bitpos % 8));
+      }
+    }
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& bloom_filter) const override {
+    const size_t len = bloom_filter.size();
+    if (len < 2) return false;
+
+    const char* array = bloom_filter.data();
+    const size_t k = array[len - 1];
+    if (k > 30 || (len - 1) % kLineBytes != 0) {
+      // Reserved for potentially new encodings.  Consider it a match.
+      return true;
+    }
+
+    // Gather the probes into a mask of the line, then test the whole line
+    // against the mask at once.
+    uint32_t h = BloomHash(key);
+    const char* line = array + LineIndex(h, (len - 1) / kLineBytes) * kLineBytes;
+    alignas(32) uint64_t mask[kLineBytes / 8] = {0};
+    for (size_t j = 0; j < k; j++) {
+      const uint32_t bitpos = NextProbe(&h);
+      mask[bitpos / 64] |= uint64_t{1} << (bitpos % 64);
+    }
+    return LineContainsMask(line, mask);
+  }
+
+  bool UseFullFilter() const override { return use_full_filter_; }
+
+ private:
+  static constexpr size_t kLineBytes = 64;
+
+  // Maps "h" uniformly onto [0, num_lines) without a division.
+  static size_t LineIndex(uint32_t h, size_t num_lines) {
+    return static_cast<size_t>((uint64_t{h} * num_lines) >> 32);
+  }
+
+  // Returns the position within the line of the next probe.  The probes
+  // are taken from the high bits of a multiplicative remix of the hash,
+  // which the line index does not depend on.
+  static uint32_t NextProbe(uint32_t* h) {
+    *h *= 0x9e3779b9;
+    return *h >> 23;  // 9 bits: [0, 512)
+  }
+
+  // Returns true if every bit of "mask" is set in the 64 bytes at "line".
+  static bool LineContainsMask(const char* line, const uint64_t* mask) {
+#if defined(__AVX2__)
+    const __m256i* m = reinterpret_cast<const __m256i*>(mask);
+    const __m256i* l = reinterpret_cast<const __m256i*>(line);
+    const __m256i missing =
+        _mm256_or_si256(_mm256_andnot_si256(_mm256_loadu_si256(l), m[0]),
+                        _mm256_andnot_si256(_mm256_loadu_si256(l + 1), m[1]));
+    return _mm256_testz_si256(missing, missing);
+#elif defined(__SSE2__)
+    const __m128i* m = reinterpret_cast<const __m128i*>(mask);
+    const __m128i* l = reinterpret_cast<const __m128i*>(line);
+    __m128i missing = _mm_setzero_si128();
+    for (int i = 0; i < 4; i++) {
+      missing = _mm_or_si128(
+          missing, _mm_andnot_si128(_mm_loadu_si128(l + i), m[i]));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) ==
+           0xffff;
+#else
+    uint64_t missing = 0;
+    for (size_t i = 0; i < kLineBytes / 8; i++) {
+      missing |= mask[i] & ~DecodeFixed64(line + 8 * i);
+    }
+    return missing == 0;
+#endif
+  }
+
+  size_t bits_per_key_;
+  bool use_full_filter_;
+  size_t k_;
 };
 }  // namespace
 
 const FilterPolicy* NewBloomFilterPolicy(int bits_per_key) {
-  return new BloomFilterPolicy(bits_per_key);
+  return new BloomFilterPolicy(bits_per_key, false);
+}
+
+const FilterPolicy* NewBloomFilterPolicy(int bits_per_key,
+                                         bool use_full_filter) {
+  return new BloomFilterPolicy(bits_per_key, use_full_filter);
+}
+
+const FilterPolicy* NewCacheLocalBloomFilterPolicy(int bits_per_key) {
+  return new CacheLocalBloomFilterPolicy(bits_per_key, false);
+}
+
+const FilterPolicy* NewCacheLocalBloomFilterPolicy(int bits_per_key,
+                                                   bool use_full_filter) {
+  return new CacheLocalBloomFilterPolicy(bits_per_key, use_full_filter);
 }
 
 }  // namespace leveldb
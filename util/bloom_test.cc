@@ -19,7 +19,8 @@ static Slice Key(int i, char* buffer) {
 
 class BloomTest : public testing::Test {
  public:
-  BloomTest() : policy_(NewBloomFilterPolicy(10)) {}
+  BloomTest() : BloomTest(NewBloomFilterPolicy(10)) {}
+  explicit BloomTest(const FilterPolicy* policy) : policy_(policy) {}
 
   ~BloomTest() { delete policy_; }
 
@@ -43,6 +44,7 @@ class BloomTest : public testing::Test {
   }
 
   size_t FilterSize() const { return filter_.size(); }
+  const std::string& filter() const { return filter_; }
 
   void DumpFilter() {
     std::fprintf(stderr, "F(");
@@ -151,4 +153,84 @@ TEST_F(BloomTest, VaryingLengths) {
 
 // Different bits-per-byte
 
+class CacheLocalBloomTest : public BloomTest {
+ public:
+  CacheLocalBloomTest() : BloomTest(NewCacheLocalBloomFilterPolicy(10)) {}
+};
+
+TEST_F(CacheLocalBloomTest, EmptyFilter) {
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+}
+
+TEST_F(CacheLocalBloomTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+TEST_F(CacheLocalBloomTest, ProbesStayInOneLine) {
+  // A large filter over a single key sets bits in one 64-byte line only
+  for (int i = 0; i < 1000; i++) {
+    Add("hello");
+  }
+  Build();
+  ASSERT_EQ(0, (FilterSize() - 1) % 64);
+  int lines_used = 0;
+  for (size_t line = 0; line + 1 < FilterSize(); line += 64) {
+    if (filter().find_first_not_of('\0', line) < line + 64) {
+      lines_used++;
+    }
+  }
+  ASSERT_EQ(1, lines_used);
+  ASSERT_TRUE(Matches("hello"));
+}
+
+TEST_F(CacheLocalBloomTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+
+  // Count number of filters that significantly exceed the false positive rate
+  int mediocre_filters = 0;
+  int good_filters = 0;
+
+  for (int length = 1; length <= 10000; length = NextLength(length)) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    // Rounded up to whole cache lines
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 65))
+        << length;
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    // Check false positive rate
+    double rate = FalsePositiveRate();
+    if (kVerbose >= 1) {
+      std::fprintf(stderr,
+                   "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
+                   rate * 100.0, length, static_cast<int>(FilterSize()));
+    }
+    ASSERT_LE(rate, 0.02);  // Must not be over 2%
+    if (rate > 0.0125)
+      mediocre_filters++;  // Allowed, but not too often
+    else
+      good_filters++;
+  }
+  if (kVerbose >= 1) {
+    std::fprintf(stderr, "Filters: %d good, %d mediocre\n", good_filters,
+                 mediocre_filters);
+  }
+  ASSERT_LE(mediocre_filters, good_filters / 5);
+}
+
 }  // namespace leveldb
@@ -4,9 +4,11 @@
 
 #include "leveldb/cache.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <thread>
 
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -17,6 +19,11 @@ namespace leveldb {
 
 Cache::~Cache() {}
 
+void Cache::GetShardStats(std::vector<ShardStats>* stats) const {
+  stats->assign(1, ShardStats());
+  (*stats)[0].usage = TotalCharge();
+}
+
 namespace {
 
 // LRU cache implementation
@@ -34,23 +41,25 @@ namespace {
 //   removed the check, elements that would otherwise be on this list could be
 //   left as disconnected singleton lists.)
 // - LRU:  contains the items not currently referenced by clients, in LRU order
+//   There is one LRU list per priority; see Cache::Priority.
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
 // external reference.
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
-// Ľṹ
+// 缓存项的结构体
 struct LRUHandle {
   void* value;
   void (*deleter)(const Slice&, void* value);
-  LRUHandle* next_hash; // ϣhandleTableΪ˽ϣͻָ
-  LRUHandle* next; // ˫
+  LRUHandle* next_hash; // 哈希表handleTable为了解决哈希冲突采用拉链法的链指针
+  LRUHandle* next; // 双向链表
   LRUHandle* prev;
   size_t charge;  // TODO(opt): Only allow uint32_t?
   size_t key_length;
   bool in_cache;     // Whether entry is in the cache. 
-  uint32_t refs;     // References, including cache reference, if present.ü
+  bool high_priority;  // Whether entry was inserted with Priority::kHigh
+  uint32_t refs;     // References, including cache reference, if present.引用计数
   uint32_t hash;     // Hash of key(); used for fast sharding and comparisons
   char key_data[1];  // Beginning of key
 
@@ -68,7 +77,7 @@ struct LRUHandle {
 // table implementations in some of the compiler/runtime combinations
 // we have tested.  E.g., readrandom speeds up by ~5% over the g++
 // 4.4.3's builtin hashtable.
-// չϣ
+// 可扩展哈希表
 class HandleTable {
  public:
   HandleTable() : length_(0), elems_(0), list_(nullptr) { Resize(); }
@@ -78,8 +87,8 @@ class HandleTable {
     return *FindPointer(key, hash);
   }
 
-  // ptrΪʱ»Ϊͷͬʱelem++ǷҪռ
-  // ptrΪʱͷ巨
+  // ptr为空时，新缓存项作为头部，同时elem++检查是否需要扩充空间
+  // ptr不为空时，采用头插法
   LRUHandle* Insert(LRUHandle* h) {
     LRUHandle** ptr = FindPointer(h->key(), h->hash);
     LRUHandle* old = *ptr;
@@ -97,12 +106,12 @@ class HandleTable {
   }
 
   LRUHandle* Remove(const Slice& key, uint32_t hash) {
-      // *
-    LRUHandle** ptr = FindPointer(key, hash); // ptrΪǰַ
+      // 理解二重*的链表
+    LRUHandle** ptr = FindPointer(key, hash); // ptr为当前结点地址
     LRUHandle* result = *ptr;
     if (result != nullptr) {
-      // *ptrǵǰǰһ㣬ptrΪǰַ
-      // ǰڵǰһڵ next_hash ΪҪɾڵһڵ㡣
+      // *ptr就是当前结点的前一个结点，ptr为当前结点地址
+      // 将当前节点的前一个节点的 next_hash 更新为要删除节点的下一个节点。
       *ptr = result->next_hash; 
       --elems_;
     }
@@ -112,25 +121,25 @@ class HandleTable {
  private:
   // The table consists of an array of buckets where each bucket is
   // a linked list of cache entries that hash into the bucket.
-  uint32_t length_; // slot
-  uint32_t elems_; // Ѿʹõslot
-  LRUHandle** list_; // handleTablebucket
+  uint32_t length_; // slot的数量
+  uint32_t elems_; // 已经使用的slot数量
+  LRUHandle** list_; // handleTable的bucket数组
 
   // Return a pointer to slot that points to a cache entry that
   // matches key/hash.  If there is no such cache entry, return a
-  // pointer to the trailing slot in the corresponding linked list. ĲҲ
+  // pointer to the trailing slot in the corresponding linked list. 正常的查找操作
   LRUHandle** FindPointer(const Slice& key, uint32_t hash) {
     LRUHandle** ptr = &list_[hash & (length_ - 1)];
-    // ҪҵhashkeyͬλãȻ
-    // hashΪϣͻjeyΪ汾ͬĻ߻Ƶ
+    // 这里要求找到hash和key都相同的位置，然后建立链表
+    // hash是因为哈希冲突，jey则可能因为版本不同的缓存或者缓存项被频繁更新
     while (*ptr != nullptr && ((*ptr)->hash != hash || key != (*ptr)->key())) {
       ptr = &(*ptr)->next_hash;
     }
     return ptr;
   }
 
-  // ȷ¿ռ
-  // ɵĹϣ¼㸴ƵµĹϣ
+  // 确立新空间
+  // 将旧的哈希表数据重新计算复制到新的哈希表中
   void Resize() {
     uint32_t new_length = 4;
     while (new_length < elems_) {
@@ -142,10 +151,10 @@ class HandleTable {
     for (uint32_t i = 0; i < length_; i++) {
       LRUHandle* h = list_[i];
       while (h != nullptr) {
-        // һԪصַ
+        // 保存下一个元素地址
         LRUHandle* next = h->next_hash;
         uint32_t hash = h->hash;
-        // ȡģһλ
+        // 取模，找一个位置
         LRUHandle** ptr = &new_list[hash & (new_length - 1)];
         h->next_hash = *ptr;
         *ptr = h;
@@ -167,12 +176,17 @@ class LRUCache {
   ~LRUCache();
 
   // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetCapacity(size_t capacity, double high_pri_pool_ratio) {
+    capacity_ = capacity;
+    high_pri_pool_ = high_pri_pool_ratio > 0;
+    high_pri_capacity_ = static_cast<size_t>(capacity * high_pri_pool_ratio);
+  }
 
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
                         size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
@@ -181,50 +195,85 @@ class LRUCache {
     MutexLock l(&mutex_);
     return usage_;
   }
+  void GetStats(Cache::ShardStats* stats) const;
 
  private:
   void LRU_Remove(LRUHandle* e);
   void LRU_Append(LRUHandle* list, LRUHandle* e);
+  // The LRU list that "e" belongs on while it is not in use.  Without a
+  // high-priority pool, entries of both priorities share lru_.
+  LRUHandle* LRU_List(LRUHandle* e) {
+    return e->high_priority && high_pri_pool_ ? &high_pri_lru_ : &lru_;
+  }
+  // Oldest entry to evict when over capacity, or nullptr if all are in use
+  LRUHandle* EvictionCandidate() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void Ref(LRUHandle* e);
   void Unref(LRUHandle* e);
   bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  // Initialized before use. 
+  // Initialized before use. 容量
   size_t capacity_; 
+  // Whether high-priority entries have a pool of their own
+  bool high_pri_pool_;
+  // Usage above which high-priority entries are evicted first
+  size_t high_pri_capacity_;
 
   // mutex_ protects the following state.
   mutable port::Mutex mutex_;
-  size_t usage_ GUARDED_BY(mutex_); // ǰ
+  size_t usage_ GUARDED_BY(mutex_); // 当前用量
+  size_t high_pri_usage_ GUARDED_BY(mutex_);  // Part of usage_ at kHigh
+
+  // Counters reported by GetStats()
+  uint64_t hits_ GUARDED_BY(mutex_);
+  uint64_t misses_ GUARDED_BY(mutex_);
+  uint64_t inserts_ GUARDED_BY(mutex_);
+  uint64_t evictions_ GUARDED_BY(mutex_);
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
   // Entries have refs==1 and in_cache==true.
-  LRUHandle lru_ GUARDED_BY(mutex_); // lru
+  LRUHandle lru_ GUARDED_BY(mutex_); // lru链表
+
+  // Dummy head of the LRU list of high-priority entries.
+  LRUHandle high_pri_lru_ GUARDED_BY(mutex_);
 
   // Dummy head of in-use list.
   // Entries are in use by clients, and have refs >= 2 and in_cache==true.
-  LRUHandle in_use_ GUARDED_BY(mutex_); // in-use򱣴LRUCacheڱclientʹõLRUHandle
+  LRUHandle in_use_ GUARDED_BY(mutex_); // in-use链表，无序保存着在LRUCache中且正在被client使用的LRUHandle
 
-  HandleTable table_ GUARDED_BY(mutex_); // ϣʹõ˳򱣴浱ǰLRUCacheеĿǰûбûʹõLRUHandl
+  HandleTable table_ GUARDED_BY(mutex_); // 哈希表，按照最近使用的顺序保存当前在LRUCache中但是目前没有被用户使用的LRUHandl
 };
 
-LRUCache::LRUCache() : capacity_(0), usage_(0) {
+LRUCache::LRUCache()
+    : capacity_(0),
+      high_pri_pool_(false),
+      high_pri_capacity_(0),
+      usage_(0),
+      high_pri_usage_(0),
+      hits_(0),
+      misses_(0),
+      inserts_(0),
+      evictions_(0) {
   // Make empty circular linked lists.
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  high_pri_lru_.next = &high_pri_lru_;
+  high_pri_lru_.prev = &high_pri_lru_;
   in_use_.next = &in_use_;
   in_use_.prev = &in_use_;
 }
 
 LRUCache::~LRUCache() {
   assert(in_use_.next == &in_use_);  // Error if caller has an unreleased handle
-  for (LRUHandle* e = lru_.next; e != &lru_;) {
-    LRUHandle* next = e->next;
-    assert(e->in_cache);
-    e->in_cache = false;
-    assert(e->refs == 1);  // Invariant of lru_ list.
-    Unref(e);
-    e = next;
+  for (LRUHandle* list : {&lru_, &high_pri_lru_}) {
+    for (LRUHandle* e = list->next; e != list;) {
+      LRUHandle* next = e->next;
+      assert(e->in_cache);
+      e->in_cache = false;
+      assert(e->refs == 1);  // Invariant of lru_ list.
+      Unref(e);
+      e = next;
+    }
   }
 }
 
@@ -246,7 +295,7 @@ void LRUCache::Unref(LRUHandle* e) {
   } else if (e->in_cache && e->refs == 1) {
     // No longer in use; move to lru_ list.
     LRU_Remove(e);
-    LRU_Append(&lru_, e);
+    LRU_Append(LRU_List(e), e);
   }
 }
 
@@ -267,7 +316,10 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
   MutexLock l(&mutex_);
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != nullptr) {
+    hits_++;
     Ref(e);
+  } else {
+    misses_++;
   }
   return reinterpret_cast<Cache::Handle*>(e);
 }
@@ -280,8 +332,10 @@ void LRUCache::Release(Cache::Handle* handle) {
 Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
                                 size_t charge,
                                 void (*deleter)(const Slice& key,
-                                                void* value)) {
+                                                void* value),
+                                Cache::Priority priority) {
   MutexLock l(&mutex_);
+  inserts_++;
 
   LRUHandle* e =
       reinterpret_cast<LRUHandle*>(malloc(sizeof(LRUHandle) - 1 + key.size()));
@@ -291,6 +345,7 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
   e->key_length = key.size();
   e->hash = hash;
   e->in_cache = false;
+  e->high_priority = (priority == Cache::Priority::kHigh);
   e->refs = 1;  // for the returned handle.
   std::memcpy(e->key_data, key.data(), key.size());
 
@@ -299,14 +354,16 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
     e->in_cache = true;
     LRU_Append(&in_use_, e);
     usage_ += charge;
+    if (e->high_priority) high_pri_usage_ += charge;
     FinishErase(table_.Insert(e));
   } else {  // don't cache. (capacity_==0 is supported and turns off caching.)
     // next is read by key() in an assert, so it must be initialized
     e->next = nullptr;
   }
-  while (usage_ > capacity_ && lru_.next != &lru_) {
-    LRUHandle* old = lru_.next;
+  LRUHandle* old;
+  while (usage_ > capacity_ && (old = EvictionCandidate()) != nullptr) {
     assert(old->refs == 1);
+    evictions_++;
     bool erased = FinishErase(table_.Remove(old->key(), old->hash));
     if (!erased) {  // to avoid unused variable when compiled NDEBUG
       assert(erased);
@@ -316,6 +373,15 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
   return reinterpret_cast<Cache::Handle*>(e);
 }
 
+LRUHandle* LRUCache::EvictionCandidate() {
+  const bool have_low = (lru_.next != &lru_);
+  const bool have_high = (high_pri_lru_.next != &high_pri_lru_);
+  if (have_high && (!have_low || high_pri_usage_ > high_pri_capacity_)) {
+    return high_pri_lru_.next;
+  }
+  return have_low ? lru_.next : nullptr;
+}
+
 // If e != nullptr, finish removing *e from the cache; it has already been
 // removed from the hash table.  Return whether e != nullptr.
 bool LRUCache::FinishErase(LRUHandle* e) {
@@ -324,6 +390,7 @@ bool LRUCache::FinishErase(LRUHandle* e) {
     LRU_Remove(e);
     e->in_cache = false;
     usage_ -= e->charge;
+    if (e->high_priority) high_pri_usage_ -= e->charge;
     Unref(e);
   }
   return e != nullptr;
@@ -336,8 +403,8 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
 
 void LRUCache::Prune() {
   MutexLock l(&mutex_);
-  while (lru_.next != &lru_) {
-    LRUHandle* e = lru_.next;
+  LRUHandle* e;
+  while ((e = EvictionCandidate()) != nullptr) {
     assert(e->refs == 1);
     bool erased = FinishErase(table_.Remove(e->key(), e->hash));
     if (!erased) {  // to avoid unused variable when compiled NDEBUG
@@ -346,39 +413,85 @@ void LRUCache::Prune() {
   }
 }
 
-static const int kNumShardBits = 4;
-static const int kNumShards = 1 << kNumShardBits;
+void LRUCache::GetStats(Cache::ShardStats* stats) const {
+  MutexLock l(&mutex_);
+  stats->hits = hits_;
+  stats->misses = misses_;
+  stats->inserts = inserts_;
+  stats->evictions = evictions_;
+  stats->usage = usage_;
+  stats->pinned_usage = 0;
+  for (const LRUHandle* e = in_use_.next; e != &in_use_; e = e->next) {
+    stats->pinned_usage += e->charge;
+  }
+}
+
+// Largest supported number of shard bits
+static const int kMaxNumShardBits = 20;
+
+// The default number of shards gives each hardware thread about two shards,
+// so that threads rarely wait on the same shard, but never splits the cache
+// into shards smaller than kMinShardCapacity, where the eviction order
+// would stray too far from LRU.
+static const int kMaxDefaultNumShardBits = 6;
+static const size_t kMinShardCapacity = 512 * 1024;
+
+static int DefaultNumShardBits(size_t capacity) {
+  const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  int bits = 0;
+  while (bits < kMaxDefaultNumShardBits && (1u << bits) < 2 * threads &&
+         (capacity >> (bits + 1)) >= kMinShardCapacity) {
+    bits++;
+  }
+  return bits;
+}
 
 class ShardedLRUCache : public Cache {
  private:
-  // ʵַƬLRU
-  LRUCache shard_[kNumShards];
-  port::Mutex id_mutex_; // ԹԴķʣȷ̰߳ȫ
-  uint64_t last_id_; // Ψһʶ
+  // 实现分片的LRU缓存
+  const int num_shard_bits_;
+  LRUCache* const shard_;
+  port::Mutex id_mutex_; // 保护对共享资源的访问，确保线程安全
+  uint64_t last_id_; // 管理缓存项的唯一标识
 
   static inline uint32_t HashSlice(const Slice& s) {
-    // Ĺϣֵ
+    // 计算给定对象的哈希值
     return Hash(s.data(), s.size(), 0);
   }
 
-  // Ƭ
-  static uint32_t Shard(uint32_t hash) { 
-      return hash >> (32 - kNumShardBits); 
+  // 分片
+  uint32_t Shard(uint32_t hash) const {
+    return num_shard_bits_ == 0 ? 0 : hash >> (32 - num_shard_bits_);
   }
 
+  int NumShards() const { return 1 << num_shard_bits_; }
+
  public:
-  explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
-      // ȡÿƬ
-    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
-    for (int s = 0; s < kNumShards; s++) {
-      shard_[s].SetCapacity(per_shard); // LRUCache
+  ShardedLRUCache(size_t capacity, double high_pri_pool_ratio,
+                  int num_shard_bits)
+      : num_shard_bits_(num_shard_bits < 0
+                            ? DefaultNumShardBits(capacity)
+                            : std::min(num_shard_bits, kMaxNumShardBits)),
+        shard_(new LRUCache[1 << num_shard_bits_]),
+        last_id_(0) {
+    // 向上取整，计算每个分片容量
+    const size_t per_shard = (capacity + (NumShards() - 1)) / NumShards();
+    for (int s = 0; s < NumShards(); s++) {
+      // 设置LRUCache的容量
+      shard_[s].SetCapacity(per_shard, high_pri_pool_ratio);
     }
   }
-  ~ShardedLRUCache() override {}
+  ~ShardedLRUCache() override { delete[] shard_; }
   Handle* Insert(const Slice& key, void* value, size_t charge,
                  void (*deleter)(const Slice& key, void* value)) override {
+    return Insert(key, value, charge, deleter, Priority::kLow);
+  }
+  Handle* Insert(const Slice& key, void* value, size_t charge,
+                 void (*deleter)(const Slice& key, void* value),
+                 Priority priority) override {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      priority);
   }
   Handle* Lookup(const Slice& key) override {
     const uint32_t hash = HashSlice(key);
@@ -400,21 +513,41 @@ class ShardedLRUCache : public Cache {
     return ++(last_id_);
   }
   void Prune() override {
-    for (int s = 0; s < kNumShards; s++) {
+    for (int s = 0; s < NumShards(); s++) {
       shard_[s].Prune();
     }
   }
   size_t TotalCharge() const override {
     size_t total = 0;
-    for (int s = 0; s < kNumShards; s++) {
+    for (int s = 0; s < NumShards(); s++) {
       total += shard_[s].TotalCharge();
     }
     return total;
   }
+  void GetShardStats(std::vector<ShardStats>* stats) const override {
+    stats->resize(NumShards());
+    for (int s = 0; s < NumShards(); s++) {
+      shard_[s].GetStats(&(*stats)[s]);
+    }
+  }
 };
 
 }  // end anonymous namespace
 
-Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity); }
+// Share of an LRU cache reserved for high-priority entries by default
+static const double kDefaultHighPriPoolRatio = 0.5;
+
+Cache* NewLRUCache(size_t capacity) {
+  return new ShardedLRUCache(capacity, kDefaultHighPriPoolRatio, -1);
+}
+
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio) {
+  return new ShardedLRUCache(capacity, high_pri_pool_ratio, -1);
+}
+
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio,
+                   int num_shard_bits) {
+  return new ShardedLRUCache(capacity, high_pri_pool_ratio, num_shard_bits);
+}
 
 }  // namespace leveldb
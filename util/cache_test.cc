@@ -150,6 +150,68 @@ TEST_F(CacheTest, EvictionPolicy) {
   cache_->Release(h);
 }
 
+TEST_F(CacheTest, HighPriorityEntriesOutliveLowPriority) {
+  // A few high-priority entries, well within their share of the cache
+  for (int i = 0; i < 100; i++) {
+    cache_->Release(cache_->Insert(EncodeKey(i), EncodeValue(i + 1), 1,
+                                   &CacheTest::Deleter,
+                                   Cache::Priority::kHigh));
+  }
+  // survive a stream of low-priority entries many times the capacity.
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    Insert(1000 + i, 2000 + i);
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(i + 1, Lookup(i));
+  }
+  ASSERT_EQ(-1, Lookup(1000));
+
+  // High-priority entries beyond their share are evicted first, so they
+  // cannot crowd out the low-priority ones.
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    cache_->Release(cache_->Insert(EncodeKey(10000 + i), EncodeValue(i), 1,
+                                   &CacheTest::Deleter,
+                                   Cache::Priority::kHigh));
+  }
+  int low_left = 0;
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    if (Lookup(1000 + i) != -1) low_left++;
+  }
+  ASSERT_GE(low_left, kCacheSize / 4);
+}
+
+TEST_F(CacheTest, HighPriorityEntriesWithoutReservedPool) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0.0, 0);
+  for (int i = 0; i < kCacheSize; i++) {
+    if (i % 2 == 0) {
+      cache_->Release(cache_->Insert(EncodeKey(i), EncodeValue(i + 1), 1,
+                                     &CacheTest::Deleter,
+                                     Cache::Priority::kHigh));
+    } else {
+      Insert(i, i + 1);
+    }
+  }
+  // Entries of both priorities are evicted oldest first
+  for (int i = 0; i < kCacheSize / 2; i++) {
+    Insert(1000 + i, 2000 + i);
+  }
+  for (int i = 0; i < kCacheSize / 2; i++) {
+    ASSERT_EQ(-1, Lookup(i));
+  }
+  for (int i = kCacheSize / 2; i < kCacheSize; i++) {
+    ASSERT_EQ(i + 1, Lookup(i));
+  }
+
+  // and high-priority entries do not hold on to the cache
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    Insert(3000 + i, 4000 + i);
+  }
+  for (int i = 0; i < kCacheSize; i++) {
+    ASSERT_EQ(-1, Lookup(i));
+  }
+}
+
 TEST_F(CacheTest, UseExceedsCacheSize) {
   // Overfill the cache, keeping handles on all inserted entries.
   std::vector<Cache::Handle*> h;
@@ -221,4 +283,70 @@ TEST_F(CacheTest, ZeroSizeCache) {
   ASSERT_EQ(-1, Lookup(1));
 }
 
+TEST_F(CacheTest, SingleShard) {
+  delete cache_;
+  cache_ = NewLRUCache(10, 0.5, 0);
+
+  // With one shard, the least recently used entry of the whole cache goes
+  for (int i = 0; i < 10; i++) {
+    Insert(i, i + 100);
+  }
+  ASSERT_EQ(100, Lookup(0));
+  Insert(10, 110);
+  ASSERT_EQ(100, Lookup(0));
+  ASSERT_EQ(-1, Lookup(1));
+  ASSERT_EQ(102, Lookup(2));
+
+  std::vector<Cache::ShardStats> stats;
+  cache_->GetShardStats(&stats);
+  ASSERT_EQ(1, stats.size());
+  ASSERT_EQ(1, stats[0].evictions);
+}
+
+TEST_F(CacheTest, ShardStats) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0.5, 2);
+
+  for (int i = 0; i < 100; i++) {
+    Insert(i, i + 1000);
+  }
+  for (int i = 0; i < 150; i++) {
+    Lookup(i);
+  }
+  Cache::Handle* h = cache_->Lookup(EncodeKey(5));
+
+  std::vector<Cache::ShardStats> stats;
+  cache_->GetShardStats(&stats);
+  ASSERT_EQ(4, stats.size());
+  Cache::ShardStats total;
+  for (const Cache::ShardStats& st : stats) {
+    ASSERT_GT(st.inserts, 0);  // Keys are spread over every shard
+    total.hits += st.hits;
+    total.misses += st.misses;
+    total.inserts += st.inserts;
+    total.evictions += st.evictions;
+    total.usage += st.usage;
+    total.pinned_usage += st.pinned_usage;
+  }
+  ASSERT_EQ(101, total.hits);
+  ASSERT_EQ(50, total.misses);
+  ASSERT_EQ(100, total.inserts);
+  ASSERT_EQ(0, total.evictions);
+  ASSERT_EQ(100, total.usage);
+  ASSERT_EQ(1, total.pinned_usage);
+  cache_->Release(h);
+
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    Insert(1000 + i, i);
+  }
+  cache_->GetShardStats(&stats);
+  total = Cache::ShardStats();
+  for (const Cache::ShardStats& st : stats) {
+    total.evictions += st.evictions;
+    total.pinned_usage += st.pinned_usage;
+  }
+  ASSERT_GE(total.evictions, static_cast<uint64_t>(kCacheSize));
+  ASSERT_EQ(0, total.pinned_usage);
+}
+
 }  // namespace leveldb
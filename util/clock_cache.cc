@@ -0,0 +1,510 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#include "leveldb/cache.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+
+// Largest CLOCK countdown, given to entries on a hit
+static const uint64_t kMaxCount = 3;
+
+// Share of the slots of a table that may hold entries
+static const double kLoadFactor = 0.7;
+
+// CLOCK cache implementation
+//
+// Each shard keeps its entries in a fixed-size open-addressing table of
+// slots, sized from the capacity and the expected charge of an entry.
+// Every slot has one atomic word holding its state, its reference count
+// and its CLOCK countdown, which lets Lookup() and Release() run without
+// taking any lock: a lookup pins a slot by bumping its reference count
+// and then checks that the slot holds a visible entry.  Only Insert(),
+// Erase() and Prune() take the shard mutex, which serializes them with
+// each other and with the CLOCK hand.
+//
+// Slot states:
+// - Empty: holds no entry.
+// - Construction: owned by exactly one thread, which is filling in or
+//   tearing down the entry.  Nobody else reads the slot's fields.
+// - Visible: holds an entry that lookups may return.
+// - Invisible: holds an entry that has been erased or replaced but is
+//   still referenced.  It is freed by whoever drops the last reference.
+//
+// Lookups bump the reference count of a slot whatever its state, and undo
+// the increment if the state was not Visible, so every state change keeps
+// the reference count intact.  A slot is only taken over (Visible or
+// Invisible -> Construction) when its reference count is zero.
+//
+// Scan resistance: entries are inserted with a countdown of zero and a
+// hit raises it to the maximum.  The CLOCK hand decrements the countdown
+// of each unreferenced entry it passes and evicts entries already at
+// zero, so entries read only once, as in a scan, are the first to go,
+// while entries that were hit survive several turns of the hand.
+
+struct ClockSlot {
+  // Layout of "meta".
+  static constexpr uint64_t kRefOne = 1;
+  static constexpr uint64_t kRefMask = (uint64_t{1} << 30) - 1;
+  static constexpr int kCountShift = 30;
+  static constexpr uint64_t kCountMask = uint64_t{3} << kCountShift;
+  static constexpr int kStateShift = 32;
+  static constexpr uint64_t kStateMask = uint64_t{3} << kStateShift;
+
+  enum State : uint64_t {
+    kEmpty = 0,
+    kConstruction = 1,
+    kVisible = 2,
+    kInvisible = 3
+  };
+
+  static uint64_t Refs(uint64_t meta) { return meta & kRefMask; }
+  static uint64_t Count(uint64_t meta) {
+    return (meta & kCountMask) >> kCountShift;
+  }
+  static State StateOf(uint64_t meta) {
+    return static_cast<State>((meta & kStateMask) >> kStateShift);
+  }
+  static uint64_t StateBits(State state) {
+    return static_cast<uint64_t>(state) << kStateShift;
+  }
+
+  Slice key() const { return Slice(key_data, key_length); }
+
+  std::atomic<uint64_t> meta{0};
+  // Number of entries that had to probe past this slot to find their own.
+  // Lookups stop at the first slot that no entry probed past.
+  std::atomic<uint32_t> displacements{0};
+
+  // Owned by the thread that holds the slot in Construction state, and
+  // read-only while the slot is Visible or Invisible.
+  bool detached = false;  // Not part of any table; see ClockShard::Insert
+  uint32_t hash = 0;
+  void* value = nullptr;
+  void (*deleter)(const Slice&, void* value) = nullptr;
+  size_t charge = 0;
+  size_t key_length = 0;
+  char* key_data = nullptr;  // Points to inline_key for short keys
+  char inline_key[16];
+};
+
+// A single shard of sharded cache.
+class ClockShard {
+ public:
+  ClockShard() : capacity_(0), mask_(0), max_occupancy_(0), slots_(nullptr) {}
+  ~ClockShard();
+
+  ClockShard(const ClockShard&) = delete;
+  ClockShard& operator=(const ClockShard&) = delete;
+
+  // Separate from constructor so caller can easily make an array of shards
+  void Init(size_t capacity, size_t num_slots);
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
+                        size_t charge,
+                        void (*deleter)(const Slice& key, void* value));
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+  void Prune();
+  size_t TotalCharge() const { return usage_.load(std::memory_order_relaxed); }
+  void GetStats(Cache::ShardStats* stats) const;
+
+ private:
+  // Drops a reference to "s", freeing the entry if it was the last
+  // reference to an erased one.
+  void Unref(ClockSlot* s);
+
+  // Takes over the unreferenced entry in "s", currently in "state", and
+  // frees it.  Returns false if the slot is in use or changed state.
+  bool TryFree(ClockSlot* s, ClockSlot::State state);
+
+  // Frees the entry of "s", which the caller holds in Construction state.
+  void FreeSlot(ClockSlot* s);
+
+  // Hides the visible entry in "s" from lookups and frees it if it is
+  // not in use.
+  void MakeInvisible(ClockSlot* s) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns the visible entry for "key", or nullptr.
+  ClockSlot* FindVisible(const Slice& key, uint32_t hash)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Moves the CLOCK hand until "charge" more fits in the shard and a slot
+  // is free, or until every entry has been given its chances.
+  void EvictFor(size_t charge) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  size_t capacity_;
+  size_t mask_;           // Number of slots - 1
+  size_t max_occupancy_;  // Entries allowed before the table is too full
+
+  std::atomic<size_t> usage_{0};
+  std::atomic<size_t> occupancy_{0};  // Slots not Empty
+
+  // Counters reported by GetStats()
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> inserts_{0};
+  std::atomic<uint64_t> evictions_{0};
+
+  mutable port::Mutex mutex_;
+  size_t clock_hand_ GUARDED_BY(mutex_) = 0;
+
+  ClockSlot* slots_;
+};
+
+ClockShard::~ClockShard() {
+  for (size_t i = 0; slots_ != nullptr && i <= mask_; i++) {
+    ClockSlot* s = &slots_[i];
+    const uint64_t meta = s->meta.load(std::memory_order_acquire);
+    // Error if caller has an unreleased handle
+    assert(ClockSlot::Refs(meta) == 0);
+    if (ClockSlot::StateOf(meta) != ClockSlot::kEmpty) {
+      (*s->deleter)(s->key(), s->value);
+      if (s->key_data != s->inline_key) delete[] s->key_data;
+    }
+  }
+  delete[] slots_;
+}
+
+void ClockShard::Init(size_t capacity, size_t num_slots) {
+  capacity_ = capacity;
+  mask_ = num_slots - 1;
+  max_occupancy_ = static_cast<size_t>(num_slots * kLoadFactor);
+  slots_ = new ClockSlot[num_slots];
+}
+
+Cache::Handle* ClockShard::Lookup(const Slice& key, uint32_t hash) {
+  size_t index = hash & mask_;
+  for (size_t probes = 0; probes <= mask_; probes++) {
+    ClockSlot* s = &slots_[index];
+    if (ClockSlot::StateOf(s->meta.load(std::memory_order_acquire)) ==
+        ClockSlot::kVisible) {
+      const uint64_t old =
+          s->meta.fetch_add(ClockSlot::kRefOne, std::memory_order_acq_rel);
+      if (ClockSlot::StateOf(old) == ClockSlot::kVisible && s->hash == hash &&
+          s->key() == key) {
+        // A hit gives the entry the most turns of the CLOCK hand
+        s->meta.fetch_or(ClockSlot::kCountMask, std::memory_order_relaxed);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return reinterpret_cast<Cache::Handle*>(s);
+      }
+      Unref(s);
+    }
+    if (s->displacements.load(std::memory_order_acquire) == 0) {
+      break;
+    }
+    index = (index + 1) & mask_;
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+void ClockShard::Release(Cache::Handle* handle) {
+  Unref(reinterpret_cast<ClockSlot*>(handle));
+}
+
+void ClockShard::Unref(ClockSlot* s) {
+  const uint64_t old =
+      s->meta.fetch_sub(ClockSlot::kRefOne, std::memory_order_acq_rel);
+  assert(ClockSlot::Refs(old) > 0);
+  if (ClockSlot::Refs(old) == 1 &&
+      ClockSlot::StateOf(old) == ClockSlot::kInvisible) {
+    // Last reference to an erased entry
+    TryFree(s, ClockSlot::kInvisible);
+  }
+}
+
+bool ClockShard::TryFree(ClockSlot* s, ClockSlot::State state) {
+  uint64_t meta = s->meta.load(std::memory_order_acquire);
+  while (ClockSlot::StateOf(meta) == state && ClockSlot::Refs(meta) == 0) {
+    if (s->meta.compare_exchange_weak(
+            meta, ClockSlot::StateBits(ClockSlot::kConstruction),
+            std::memory_order_acq_rel)) {
+      FreeSlot(s);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockShard::FreeSlot(ClockSlot* s) {
+  (*s->deleter)(s->key(), s->value);
+  if (s->key_data != s->inline_key) delete[] s->key_data;
+  if (s->detached) {
+    delete s;
+    return;
+  }
+  usage_.fetch_sub(s->charge, std::memory_order_relaxed);
+
+  // Entries are never moved, so the slots probed past on insertion are
+  // exactly those from the home slot up to this one.
+  for (size_t index = s->hash & mask_; &slots_[index] != s;
+       index = (index + 1) & mask_) {
+    slots_[index].displacements.fetch_sub(1, std::memory_order_release);
+  }
+  // Keep any references taken by concurrent lookups in the meantime
+  s->meta.fetch_sub(ClockSlot::StateBits(ClockSlot::kConstruction),
+                    std::memory_order_release);
+  occupancy_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ClockShard::MakeInvisible(ClockSlot* s) {
+  // Visible -> Invisible, keeping the reference count and countdown
+  const uint64_t old = s->meta.fetch_add(
+      ClockSlot::StateBits(ClockSlot::kInvisible) -
+          ClockSlot::StateBits(ClockSlot::kVisible),
+      std::memory_order_acq_rel);
+  assert(ClockSlot::StateOf(old) == ClockSlot::kVisible);
+  if (ClockSlot::Refs(old) == 0) {
+    TryFree(s, ClockSlot::kInvisible);
+  }
+}
+
+ClockSlot* ClockShard::FindVisible(const Slice& key, uint32_t hash) {
+  // Visible entries only change state under mutex_, so their fields can be
+  // read without taking a reference.
+  size_t index = hash & mask_;
+  for (size_t probes = 0; probes <= mask_; probes++) {
+    ClockSlot* s = &slots_[index];
+    if (ClockSlot::StateOf(s->meta.load(std::memory_order_acquire)) ==
+            ClockSlot::kVisible &&
+        s->hash == hash && s->key() == key) {
+      return s;
+    }
+    if (s->displacements.load(std::memory_order_acquire) == 0) {
+      break;
+    }
+    index = (index + 1) & mask_;
+  }
+  return nullptr;
+}
+
+void ClockShard::EvictFor(size_t charge) {
+  // Every entry reaches a countdown of zero within kMaxCount + 1 turns
+  const size_t max_steps = (kMaxCount + 1) * (mask_ + 1);
+  for (size_t step = 0; step < max_steps; step++) {
+    if (usage_.load(std::memory_order_relaxed) + charge <= capacity_ &&
+        occupancy_.load(std::memory_order_relaxed) < max_occupancy_) {
+      return;
+    }
+    ClockSlot* s = &slots_[clock_hand_];
+    clock_hand_ = (clock_hand_ + 1) & mask_;
+    uint64_t meta = s->meta.load(std::memory_order_acquire);
+    if (ClockSlot::StateOf(meta) != ClockSlot::kVisible ||
+        ClockSlot::Refs(meta) != 0) {
+      continue;  // Empty, in use, or already on its way out
+    }
+    if (ClockSlot::Count(meta) > 0) {
+      // Lookups only ever raise the countdown, so losing a race here just
+      // gives the entry another turn.
+      s->meta.compare_exchange_strong(
+          meta, meta - (uint64_t{1} << ClockSlot::kCountShift),
+          std::memory_order_acq_rel);
+    } else if (TryFree(s, ClockSlot::kVisible)) {
+      evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+Cache::Handle* ClockShard::Insert(const Slice& key, uint32_t hash, void* value,
+                                  size_t charge,
+                                  void (*deleter)(const Slice& key,
+                                                  void* value)) {
+  inserts_.fetch_add(1, std::memory_order_relaxed);
+  ClockSlot* s = nullptr;
+  if (capacity_ > 0) {  // capacity_==0 is supported and turns off caching
+    MutexLock l(&mutex_);
+    ClockSlot* old = FindVisible(key, hash);
+    if (old != nullptr) {
+      MakeInvisible(old);
+    }
+    EvictFor(charge);
+
+    // Claim the first empty slot on the probe sequence
+    size_t index = hash & mask_;
+    size_t probes = 0;
+    for (; probes <= mask_; probes++) {
+      uint64_t expected = 0;  // Empty, and not pinned by any lookup
+      if (slots_[index].meta.compare_exchange_strong(
+              expected, ClockSlot::StateBits(ClockSlot::kConstruction),
+              std::memory_order_acq_rel)) {
+        s = &slots_[index];
+        break;
+      }
+      slots_[index].displacements.fetch_add(1, std::memory_order_release);
+      index = (index + 1) & mask_;
+    }
+    if (s == nullptr) {
+      // The table is full of entries in use; undo the displacements
+      for (index = hash & mask_; probes > 0; probes--) {
+        slots_[index].displacements.fetch_sub(1, std::memory_order_release);
+        index = (index + 1) & mask_;
+      }
+    } else {
+      occupancy_.fetch_add(1, std::memory_order_relaxed);
+      usage_.fetch_add(charge, std::memory_order_relaxed);
+    }
+  }
+  if (s == nullptr) {
+    // Hand out an entry that is not in the cache, and is freed on release
+    s = new ClockSlot;
+    s->detached = true;
+    s->meta.store(ClockSlot::StateBits(ClockSlot::kConstruction),
+                  std::memory_order_relaxed);
+  }
+
+  s->hash = hash;
+  s->value = value;
+  s->deleter = deleter;
+  s->charge = charge;
+  s->key_length = key.size();
+  s->key_data =
+      key.size() <= sizeof(s->inline_key) ? s->inline_key : new char[key.size()];
+  std::memcpy(s->key_data, key.data(), key.size());
+
+  // Construction -> Visible (or Invisible if detached) with a reference for
+  // the returned handle.  A new entry starts with a countdown of zero.
+  const ClockSlot::State state =
+      s->detached ? ClockSlot::kInvisible : ClockSlot::kVisible;
+  s->meta.fetch_add(ClockSlot::StateBits(state) -
+                        ClockSlot::StateBits(ClockSlot::kConstruction) +
+                        ClockSlot::kRefOne,
+                    std::memory_order_acq_rel);
+  return reinterpret_cast<Cache::Handle*>(s);
+}
+
+void ClockShard::Erase(const Slice& key, uint32_t hash) {
+  MutexLock l(&mutex_);
+  ClockSlot* s = FindVisible(key, hash);
+  if (s != nullptr) {
+    MakeInvisible(s);
+  }
+}
+
+void ClockShard::Prune() {
+  MutexLock l(&mutex_);
+  for (size_t i = 0; i <= mask_; i++) {
+    TryFree(&slots_[i], ClockSlot::kVisible);
+  }
+}
+
+void ClockShard::GetStats(Cache::ShardStats* stats) const {
+  stats->hits = hits_.load(std::memory_order_relaxed);
+  stats->misses = misses_.load(std::memory_order_relaxed);
+  stats->inserts = inserts_.load(std::memory_order_relaxed);
+  stats->evictions = evictions_.load(std::memory_order_relaxed);
+  stats->usage = usage_.load(std::memory_order_relaxed);
+  stats->pinned_usage = 0;
+  // Visible entries keep their fields while mutex_ is held
+  MutexLock l(&mutex_);
+  for (size_t i = 0; i <= mask_; i++) {
+    const uint64_t meta = slots_[i].meta.load(std::memory_order_acquire);
+    if (ClockSlot::StateOf(meta) == ClockSlot::kVisible &&
+        ClockSlot::Refs(meta) > 0) {
+      stats->pinned_usage += slots_[i].charge;
+    }
+  }
+}
+
+static const int kNumShardBits = 4;
+static const int kNumShards = 1 << kNumShardBits;
+
+class ShardedClockCache : public Cache {
+ private:
+  ClockShard shard_[kNumShards];
+  port::Mutex id_mutex_;
+  uint64_t last_id_;
+
+  static inline uint32_t HashSlice(const Slice& s) {
+    return Hash(s.data(), s.size(), 0);
+  }
+
+  static uint32_t Shard(uint32_t hash) { return hash >> (32 - kNumShardBits); }
+
+ public:
+  ShardedClockCache(size_t capacity, size_t estimated_entry_charge)
+      : last_id_(0) {
+    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+    if (estimated_entry_charge == 0) estimated_entry_charge = 1;
+    // Room for the expected number of entries at the table's load factor
+    const size_t min_slots = static_cast<size_t>(
+        per_shard / estimated_entry_charge / kLoadFactor) + 1;
+    size_t num_slots = 16;
+    while (num_slots < min_slots) {
+      num_slots *= 2;
+    }
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].Init(per_shard, num_slots);
+    }
+  }
+  ~ShardedClockCache() override {}
+  Handle* Insert(const Slice& key, void* value, size_t charge,
+                 void (*deleter)(const Slice& key, void* value)) override {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+  }
+  Handle* Lookup(const Slice& key) override {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Lookup(key, hash);
+  }
+  void Release(Handle* handle) override {
+    ClockSlot* s = reinterpret_cast<ClockSlot*>(handle);
+    shard_[Shard(s->hash)].Release(handle);
+  }
+  void Erase(const Slice& key) override {
+    const uint32_t hash = HashSlice(key);
+    shard_[Shard(hash)].Erase(key, hash);
+  }
+  void* Value(Handle* handle) override {
+    return reinterpret_cast<ClockSlot*>(handle)->value;
+  }
+  uint64_t NewId() override {
+    MutexLock l(&id_mutex_);
+    return ++(last_id_);
+  }
+  void Prune() override {
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].Prune();
+    }
+  }
+  size_t TotalCharge() const override {
+    size_t total = 0;
+    for (int s = 0; s < kNumShards; s++) {
+      total += shard_[s].TotalCharge();
+    }
+    return total;
+  }
+  void GetShardStats(std::vector<ShardStats>* stats) const override {
+    stats->resize(kNumShards);
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].GetStats(&(*stats)[s]);
+    }
+  }
+};
+
+}  // end anonymous namespace
+
+// Expected charge of a block cache entry with the default Options
+static const size_t kDefaultEstimatedEntryCharge = 4 * 1024;
+
+Cache* NewClockCache(size_t capacity) {
+  return new ShardedClockCache(capacity, kDefaultEstimatedEntryCharge);
+}
+
+Cache* NewClockCache(size_t capacity, size_t estimated_entry_charge) {
+  return new ShardedClockCache(capacity, estimated_entry_charge);
+}
+
+}  // namespace leveldb
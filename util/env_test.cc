@@ -137,6 +137,52 @@ TEST_F(EnvTest, RunMany) {
   ASSERT_TRUE(callback4.run);
 }
 
+TEST_F(EnvTest, HighPriorityRunsWhileAllThreadsBusy) {
+  struct RunState {
+    port::Mutex mu;
+    port::CondVar cvar{&mu};
+    bool release = false;
+    int finished = 0;
+    bool high_priority_run = false;
+
+    static void Block(void* arg) {
+      RunState* state = reinterpret_cast<RunState*>(arg);
+      MutexLock l(&state->mu);
+      while (!state->release) {
+        state->cvar.Wait();
+      }
+      state->finished++;
+      state->cvar.SignalAll();
+    }
+
+    static void RunHighPriority(void* arg) {
+      RunState* state = reinterpret_cast<RunState*>(arg);
+      MutexLock l(&state->mu);
+      state->high_priority_run = true;
+      state->cvar.SignalAll();
+    }
+  };
+
+  // More blocked work than there are background threads
+  const int kBlocked = 64;
+  RunState state;
+  for (int i = 0; i < kBlocked; i++) {
+    env_->Schedule(&RunState::Block, &state);
+  }
+  env_->ScheduleHighPriority(&RunState::RunHighPriority, &state);
+
+  MutexLock l(&state.mu);
+  while (!state.high_priority_run) {
+    state.cvar.Wait();
+  }
+  ASSERT_EQ(0, state.finished);
+  state.release = true;
+  state.cvar.SignalAll();
+  while (state.finished != kBlocked) {
+    state.cvar.Wait();
+  }
+}
+
 struct State {
   port::Mutex mu;
   port::CondVar cvar{&mu};
@@ -22,6 +22,7 @@
 #include <queue>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "leveldb/env.h"
@@ -615,6 +616,10 @@ class WindowsEnv : public Env {
   void Schedule(void (*background_work_function)(void* background_work_arg),
                 void* background_work_arg) override;
 
+  void ScheduleHighPriority(
+      void (*background_work_function)(void* background_work_arg),
+      void* background_work_arg) override;
+
   void StartThread(void (*thread_main)(void* thread_main_arg),
                    void* thread_main_arg) override {
     std::thread new_thread(thread_main, thread_main_arg);
@@ -671,11 +676,21 @@ class WindowsEnv : public Env {
 
  private:
   void BackgroundThreadMain();
+  void HighPriorityThreadMain();
 
   static void BackgroundThreadEntryPoint(WindowsEnv* env) {
     env->BackgroundThreadMain();
   }
 
+  static void HighPriorityThreadEntryPoint(WindowsEnv* env) {
+    env->HighPriorityThreadMain();
+  }
+
+  // Removes and returns the next work item, high-priority ones first.
+  // REQUIRES: One of the work queues is non-empty.
+  std::pair<void (*)(void*), void*> PopWork()
+      EXCLUSIVE_LOCKS_REQUIRED(background_work_mutex_);
+
   // Stores the work item data in a Schedule() call.
   //
   // Instances are constructed on the thread calling Schedule() and used on the
@@ -692,20 +707,40 @@ class WindowsEnv : public Env {
 
   port::Mutex background_work_mutex_;
   port::CondVar background_work_cv_ GUARDED_BY(background_work_mutex_);
-  bool started_background_thread_ GUARDED_BY(background_work_mutex_);
+  int background_threads_ GUARDED_BY(background_work_mutex_);
+  int idle_background_threads_ GUARDED_BY(background_work_mutex_);
 
   std::queue<BackgroundWorkItem> background_work_queue_
       GUARDED_BY(background_work_mutex_);
 
+  // ScheduleHighPriority() work.  Every background thread takes from this
+  // queue first, and one more thread, started on first use, takes only
+  // from it.
+  port::CondVar high_priority_work_cv_ GUARDED_BY(background_work_mutex_);
+  bool high_priority_thread_started_ GUARDED_BY(background_work_mutex_);
+  std::queue<BackgroundWorkItem> high_priority_work_queue_
+      GUARDED_BY(background_work_mutex_);
+
   Limiter mmap_limiter_;  // Thread-safe.
 };
 
 // Return the maximum number of concurrent mmaps.
 int MaxMmaps() { return g_mmap_limit; }
 
+// Return the maximum number of threads that run Schedule()d work.
+//
+// Threads are started on demand, so a process that never runs more than
+// one background job at a time only ever starts one thread.
+int MaxBackgroundThreads() {
+  return std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
 WindowsEnv::WindowsEnv()
     : background_work_cv_(&background_work_mutex_),
-      started_background_thread_(false),
+      background_threads_(0),
+      idle_background_threads_(0),
+      high_priority_work_cv_(&background_work_mutex_),
+      high_priority_thread_started_(false),
       mmap_limiter_(MaxMmaps()) {}
 
 void WindowsEnv::Schedule(
@@ -713,38 +748,90 @@ void WindowsEnv::Schedule(
     void* background_work_arg) {
   background_work_mutex_.Lock();
 
-  // Start the background thread, if we haven't done so already.
-  if (!started_background_thread_) {
-    started_background_thread_ = true;
+  background_work_queue_.emplace(background_work_function, background_work_arg);
+
+  // Start another background thread if every existing one is busy, so
+  // that independent work items (e.g. two level compactions) do not have
+  // to wait for each other.
+  if (background_work_queue_.size() + high_priority_work_queue_.size() >
+          static_cast<size_t>(idle_background_threads_) &&
+      background_threads_ < MaxBackgroundThreads()) {
+    ++background_threads_;
     std::thread background_thread(WindowsEnv::BackgroundThreadEntryPoint, this);
     background_thread.detach();
   }
 
-  // If the queue is empty, the background thread may be waiting for work.
-  if (background_work_queue_.empty()) {
-    background_work_cv_.Signal();
+  // An idle background thread may be waiting for work.
+  background_work_cv_.Signal();
+  background_work_mutex_.Unlock();
+}
+
+void WindowsEnv::ScheduleHighPriority(
+    void (*background_work_function)(void* background_work_arg),
+    void* background_work_arg) {
+  background_work_mutex_.Lock();
+
+  high_priority_work_queue_.emplace(background_work_function,
+                                    background_work_arg);
+
+  // The high-priority thread is started in addition to the ones that run
+  // Schedule()d work, so that this work never waits for those to finish.
+  if (!high_priority_thread_started_) {
+    high_priority_thread_started_ = true;
+    std::thread high_priority_thread(
+        WindowsEnv::HighPriorityThreadEntryPoint, this);
+    high_priority_thread.detach();
   }
 
-  background_work_queue_.emplace(background_work_function, background_work_arg);
+  // Whichever of the high-priority thread or an idle background thread
+  // wakes up first runs the work.
+  high_priority_work_cv_.Signal();
+  background_work_cv_.Signal();
   background_work_mutex_.Unlock();
 }
 
+std::pair<void (*)(void*), void*> WindowsEnv::PopWork() {
+  std::queue<BackgroundWorkItem>* queue = high_priority_work_queue_.empty()
+                                              ? &background_work_queue_
+                                              : &high_priority_work_queue_;
+  assert(!queue->empty());
+  std::pair<void (*)(void*), void*> work(queue->front().function,
+                                         queue->front().arg);
+  queue->pop();
+  return work;
+}
+
 void WindowsEnv::BackgroundThreadMain() {
   while (true) {
     background_work_mutex_.Lock();
 
     // Wait until there is work to be done.
-    while (background_work_queue_.empty()) {
+    ++idle_background_threads_;
+    while (background_work_queue_.empty() &&
+           high_priority_work_queue_.empty()) {
       background_work_cv_.Wait();
     }
+    --idle_background_threads_;
+
+    std::pair<void (*)(void*), void*> work = PopWork();
+
+    background_work_mutex_.Unlock();
+    work.first(work.second);
+  }
+}
+
+void WindowsEnv::HighPriorityThreadMain() {
+  while (true) {
+    background_work_mutex_.Lock();
+
+    while (high_priority_work_queue_.empty()) {
+      high_priority_work_cv_.Wait();
+    }
 
-    assert(!background_work_queue_.empty());
-    auto background_work_function = background_work_queue_.front().function;
-    void* background_work_arg = background_work_queue_.front().arg;
-    background_work_queue_.pop();
+    std::pair<void (*)(void*), void*> work = PopWork();
 
     background_work_mutex_.Unlock();
-    background_work_function(background_work_arg);
+    work.first(work.second);
   }
 }
 
@@ -0,0 +1,356 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/persistent_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/logging.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+PersistentCache::~PersistentCache() {}
+
+namespace {
+
+// Each segment file is a sequence of records:
+//    crc: fixed32        (masked crc32c of everything after it)
+//    key_length: fixed32
+//    data_length: fixed32
+//    key: uint8[key_length]
+//    data: uint8[data_length]
+static const size_t kRecordHeaderSize = 12;
+
+// Bounds on the size of a segment.  Inserts are buffered in memory until
+// a segment is full, so that the device only sees large sequential writes.
+static const uint64_t kMinSegmentSize = 4 * 1024;
+static const uint64_t kMaxSegmentSize = 4 * 1024 * 1024;
+
+static std::string SegmentFileName(const std::string& path, uint64_t number) {
+  char buf[100];
+  std::snprintf(buf, sizeof(buf), "/%06llu.pcache",
+                static_cast<unsigned long long>(number));
+  return path + buf;
+}
+
+// If "fname" names a segment file, stores its number in *number.
+static bool ParseSegmentFileName(const std::string& fname, uint64_t* number) {
+  Slice rest(fname);
+  return ConsumeDecimalNumber(&rest, number) && rest == Slice(".pcache");
+}
+
+static void AppendRecord(std::string* dst, const Slice& key,
+                         const Slice& data) {
+  const size_t start = dst->size();
+  PutFixed32(dst, 0);  // Filled in below
+  PutFixed32(dst, static_cast<uint32_t>(key.size()));
+  PutFixed32(dst, static_cast<uint32_t>(data.size()));
+  dst->append(key.data(), key.size());
+  dst->append(data.data(), data.size());
+  const uint32_t crc =
+      crc32c::Value(dst->data() + start + 4, dst->size() - start - 4);
+  EncodeFixed32(&(*dst)[start], crc32c::Mask(crc));
+}
+
+// Parses the record at the start of "input".  On success stores its key
+// and data, advances "input" past the record and returns true.
+static bool ParseRecord(Slice* input, Slice* key, Slice* data) {
+  if (input->size() < kRecordHeaderSize) {
+    return false;
+  }
+  const char* p = input->data();
+  const uint64_t key_length = DecodeFixed32(p + 4);
+  const uint64_t data_length = DecodeFixed32(p + 8);
+  const uint64_t length = kRecordHeaderSize + key_length + data_length;
+  if (length > input->size()) {
+    return false;
+  }
+  const uint32_t crc = crc32c::Unmask(DecodeFixed32(p));
+  if (crc32c::Value(p + 4, length - 4) != crc) {
+    return false;
+  }
+  *key = Slice(p + kRecordHeaderSize, key_length);
+  *data = Slice(p + kRecordHeaderSize + key_length, data_length);
+  input->remove_prefix(length);
+  return true;
+}
+
+// Stores in *data the data of "record", after checking that it is intact
+// and stored under "key".
+static Status ReadRecord(Slice record, const Slice& key, std::string* data) {
+  Slice found_key, found_data;
+  if (!ParseRecord(&record, &found_key, &found_data)) {
+    return Status::Corruption("damaged persistent cache record");
+  }
+  if (found_key != key) {
+    return Status::Corruption("persistent cache record has the wrong key");
+  }
+  data->assign(found_data.data(), found_data.size());
+  return Status::OK();
+}
+
+class FilePersistentCache : public PersistentCache {
+ public:
+  FilePersistentCache(Env* env, const std::string& path, uint64_t capacity)
+      : env_(env),
+        path_(path),
+        capacity_(capacity),
+        segment_size_(std::max(kMinSegmentSize,
+                               std::min(kMaxSegmentSize, capacity / 8))),
+        active_number_(0),
+        total_size_(0) {}
+
+  ~FilePersistentCache() override;
+
+  // Indexes the segments left behind by an earlier run.
+  Status Recover();
+
+  Status Insert(const Slice& key, const Slice& data) override;
+  Status Lookup(const Slice& key, std::string* data) override;
+
+ private:
+  // A segment file that has been written out.
+  struct Segment {
+    uint64_t number;
+    uint64_t size;
+    RandomAccessFile* file;
+    int refs;        // Lookups reading the file, plus one while live
+    std::vector<std::string> keys;  // Keys that pointed here when written
+  };
+
+  // Where the record for a key is stored.
+  struct Location {
+    uint64_t segment;  // active_number_ while still in the buffer
+    uint64_t offset;   // Start of the record
+    uint64_t length;   // Length of the whole record
+  };
+
+  // Writes the buffered segment out to its file.
+  Status SealActiveSegment() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Drops the oldest segments until the cache fits its capacity.
+  void EvictOverCapacity() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  void Unref(Segment* segment) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  Env* const env_;
+  const std::string path_;
+  const uint64_t capacity_;
+  const uint64_t segment_size_;
+
+  port::Mutex mutex_;
+  std::unordered_map<std::string, Location> index_ GUARDED_BY(mutex_);
+  std::map<uint64_t, Segment*> segments_ GUARDED_BY(mutex_);  // Oldest first
+  uint64_t active_number_ GUARDED_BY(mutex_);
+  std::string active_ GUARDED_BY(mutex_);  // Records of the active segment
+  std::vector<std::string> active_keys_ GUARDED_BY(mutex_);
+  uint64_t total_size_ GUARDED_BY(mutex_);  // Segments plus active_
+};
+
+FilePersistentCache::~FilePersistentCache() {
+  MutexLock l(&mutex_);
+  // Keep what has been buffered for the next run
+  if (!active_.empty()) {
+    SealActiveSegment();
+  }
+  for (const auto& kv : segments_) {
+    assert(kv.second->refs == 1);
+    delete kv.second->file;
+    delete kv.second;
+  }
+}
+
+Status FilePersistentCache::Recover() {
+  MutexLock l(&mutex_);
+  env_->CreateDir(path_);  // Ignore error, since the directory may exist
+  std::vector<std::string> filenames;
+  Status s = env_->GetChildren(path_, &filenames);
+  if (!s.ok()) {
+    return s;
+  }
+  std::vector<uint64_t> numbers;
+  for (const std::string& fname : filenames) {
+    uint64_t number;
+    if (ParseSegmentFileName(fname, &number)) {
+      numbers.push_back(number);
+    }
+  }
+  std::sort(numbers.begin(), numbers.end());
+
+  for (uint64_t number : numbers) {
+    const std::string fname = SegmentFileName(path_, number);
+    std::string contents;
+    RandomAccessFile* file = nullptr;
+    s = ReadFileToString(env_, fname, &contents);
+    if (s.ok()) {
+      s = env_->NewRandomAccessFile(fname, &file);
+    }
+    if (!s.ok()) {
+      // Unreadable segments are simply not part of the cache
+      env_->RemoveFile(fname);
+      continue;
+    }
+    Segment* segment = new Segment;
+    segment->number = number;
+    segment->size = contents.size();
+    segment->file = file;
+    segment->refs = 1;
+    // Stop at the first damaged record, since its length can't be trusted
+    Slice input(contents), key, data;
+    while (true) {
+      const uint64_t offset = contents.size() - input.size();
+      if (!ParseRecord(&input, &key, &data)) {
+        break;
+      }
+      Location& loc = index_[key.ToString()];
+      loc.segment = number;
+      loc.offset = offset;
+      loc.length = contents.size() - input.size() - offset;
+      segment->keys.push_back(key.ToString());
+    }
+    segments_[number] = segment;
+    total_size_ += segment->size;
+  }
+  active_number_ = numbers.empty() ? 1 : numbers.back() + 1;
+  EvictOverCapacity();
+  return Status::OK();
+}
+
+Status FilePersistentCache::Insert(const Slice& key, const Slice& data) {
+  MutexLock l(&mutex_);
+  if (kRecordHeaderSize + key.size() + data.size() > segment_size_ ||
+      index_.count(key.ToString()) != 0) {
+    return Status::OK();  // Too large to cache, or already cached
+  }
+  Location loc;
+  loc.segment = active_number_;
+  loc.offset = active_.size();
+  AppendRecord(&active_, key, data);
+  loc.length = active_.size() - loc.offset;
+  index_[key.ToString()] = loc;
+  active_keys_.push_back(key.ToString());
+  total_size_ += loc.length;
+
+  Status s;
+  if (active_.size() >= segment_size_) {
+    s = SealActiveSegment();
+  }
+  EvictOverCapacity();
+  return s;
+}
+
+Status FilePersistentCache::SealActiveSegment() {
+  const uint64_t number = active_number_++;
+  const std::string fname = SegmentFileName(path_, number);
+  std::vector<std::string> keys;
+  keys.swap(active_keys_);
+  std::string records;
+  records.swap(active_);
+
+  RandomAccessFile* file = nullptr;
+  Status s = WriteStringToFile(env_, records, fname);
+  if (s.ok()) {
+    s = env_->NewRandomAccessFile(fname, &file);
+  }
+  if (!s.ok()) {
+    // Forget the records of the lost segment
+    for (const std::string& key : keys) {
+      auto it = index_.find(key);
+      if (it != index_.end() && it->second.segment == number) {
+        index_.erase(it);
+      }
+    }
+    total_size_ -= records.size();
+    env_->RemoveFile(fname);
+    return s;
+  }
+  Segment* segment = new Segment;
+  segment->number = number;
+  segment->size = records.size();
+  segment->file = file;
+  segment->refs = 1;
+  segment->keys.swap(keys);
+  segments_[number] = segment;
+  return s;
+}
+
+void FilePersistentCache::EvictOverCapacity() {
+  while (total_size_ > capacity_ && !segments_.empty()) {
+    Segment* segment = segments_.begin()->second;
+    segments_.erase(segments_.begin());
+    for (const std::string& key : segment->keys) {
+      auto it = index_.find(key);
+      if (it != index_.end() && it->second.segment == segment->number) {
+        index_.erase(it);
+      }
+    }
+    total_size_ -= segment->size;
+    Unref(segment);
+  }
+}
+
+void FilePersistentCache::Unref(Segment* segment) {
+  assert(segment->refs > 0);
+  if (--segment->refs == 0) {
+    // Evicted, and no lookup is reading it any more
+    delete segment->file;
+    env_->RemoveFile(SegmentFileName(path_, segment->number));
+    delete segment;
+  }
+}
+
+Status FilePersistentCache::Lookup(const Slice& key, std::string* data) {
+  MutexLock l(&mutex_);
+  auto it = index_.find(key.ToString());
+  if (it == index_.end()) {
+    return Status::NotFound(Slice());
+  }
+  const Location loc = it->second;
+  if (loc.segment == active_number_) {
+    return ReadRecord(Slice(active_.data() + loc.offset, loc.length), key,
+                      data);
+  }
+
+  // Read the file without holding the lock; the reference keeps the
+  // segment from being deleted meanwhile.
+  Segment* segment = segments_[loc.segment];
+  segment->refs++;
+  mutex_.Unlock();
+  std::string scratch(loc.length, '\0');
+  Slice record;
+  Status s = segment->file->Read(loc.offset, loc.length, &record, &scratch[0]);
+  if (s.ok()) {
+    s = ReadRecord(record, key, data);
+  }
+  mutex_.Lock();
+  Unref(segment);
+  return s;
+}
+
+}  // namespace
+
+Status NewFilePersistentCache(Env* env, const std::string& path,
+                              uint64_t capacity, PersistentCache** result) {
+  *result = nullptr;
+  FilePersistentCache* cache = new FilePersistentCache(env, path, capacity);
+  Status s = cache->Recover();
+  if (s.ok()) {
+    *result = cache;
+  } else {
+    delete cache;
+  }
+  return s;
+}
+
+}  // namespace leveldb
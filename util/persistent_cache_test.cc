@@ -0,0 +1,172 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/persistent_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "leveldb/env.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+static std::string Key(int i) {
+  char buf[100];
+  std::snprintf(buf, sizeof(buf), "key%06d", i);
+  return std::string(buf);
+}
+
+// A value of 1000 bytes that depends on "i"
+static std::string Value(int i) { return std::string(1000, 'a' + (i % 26)); }
+
+class PersistentCacheTest : public testing::Test {
+ public:
+  PersistentCacheTest() : env_(Env::Default()), cache_(nullptr) {
+    EXPECT_LEVELDB_OK(env_->GetTestDirectory(&path_));
+    path_ += "/persistent_cache_test";
+    Destroy();
+  }
+
+  ~PersistentCacheTest() {
+    delete cache_;
+    Destroy();
+  }
+
+  void Destroy() {
+    std::vector<std::string> files;
+    env_->GetChildren(path_, &files);
+    for (const std::string& f : files) {
+      env_->RemoveFile(path_ + "/" + f);
+    }
+    env_->RemoveDir(path_);
+  }
+
+  void Open(uint64_t capacity) {
+    delete cache_;
+    cache_ = nullptr;
+    ASSERT_LEVELDB_OK(NewFilePersistentCache(env_, path_, capacity, &cache_));
+  }
+
+  void Insert(int i) { ASSERT_LEVELDB_OK(cache_->Insert(Key(i), Value(i))); }
+
+  // Returns "ok", "missing" or "bad"
+  std::string Check(int i) {
+    std::string data;
+    Status s = cache_->Lookup(Key(i), &data);
+    if (s.IsNotFound()) return "missing";
+    if (!s.ok()) return "bad";
+    return data == Value(i) ? "ok" : "bad";
+  }
+
+  std::vector<std::string> SegmentFiles() {
+    std::vector<std::string> files, result;
+    env_->GetChildren(path_, &files);
+    for (const std::string& f : files) {
+      if (f.size() > 7 && f.compare(f.size() - 7, 7, ".pcache") == 0) {
+        result.push_back(path_ + "/" + f);
+      }
+    }
+    return result;
+  }
+
+  uint64_t TotalFileSize() {
+    uint64_t total = 0;
+    for (const std::string& f : SegmentFiles()) {
+      uint64_t size;
+      EXPECT_LEVELDB_OK(env_->GetFileSize(f, &size));
+      total += size;
+    }
+    return total;
+  }
+
+  Env* env_;
+  std::string path_;
+  PersistentCache* cache_;
+};
+
+TEST_F(PersistentCacheTest, InsertAndLookup) {
+  Open(1 << 20);
+  ASSERT_EQ("missing", Check(1));
+  Insert(1);
+  Insert(2);
+  ASSERT_EQ("ok", Check(1));
+  ASSERT_EQ("ok", Check(2));
+  ASSERT_EQ("missing", Check(3));
+
+  // Enough to write out several segments
+  for (int i = 3; i < 500; i++) {
+    Insert(i);
+  }
+  ASSERT_GT(SegmentFiles().size(), 1);
+  for (int i = 1; i < 500; i++) {
+    ASSERT_EQ("ok", Check(i)) << i;
+  }
+}
+
+TEST_F(PersistentCacheTest, SurvivesRestart) {
+  Open(1 << 20);
+  for (int i = 0; i < 300; i++) {
+    Insert(i);
+  }
+  Open(1 << 20);
+  for (int i = 0; i < 300; i++) {
+    ASSERT_EQ("ok", Check(i)) << i;
+  }
+  ASSERT_EQ("missing", Check(300));
+}
+
+TEST_F(PersistentCacheTest, EvictsOldestSegments) {
+  const uint64_t kCapacity = 64 * 1024;
+  Open(kCapacity);
+  for (int i = 0; i < 1000; i++) {
+    Insert(i);
+  }
+  ASSERT_LE(TotalFileSize(), kCapacity);
+  ASSERT_EQ("missing", Check(0));
+  ASSERT_EQ("ok", Check(999));
+
+  // Holds when the cache is reopened with a smaller capacity, too
+  Open(kCapacity / 4);
+  ASSERT_LE(TotalFileSize(), kCapacity / 4);
+  ASSERT_EQ("ok", Check(999));
+}
+
+TEST_F(PersistentCacheTest, DamagedSegmentKeepsPrefix) {
+  Open(1 << 20);
+  for (int i = 0; i < 100; i++) {
+    Insert(i);
+  }
+  delete cache_;
+  cache_ = nullptr;
+
+  // Damage the middle of the only segment
+  std::vector<std::string> files = SegmentFiles();
+  ASSERT_EQ(1, files.size());
+  std::string contents;
+  ASSERT_LEVELDB_OK(ReadFileToString(env_, files[0], &contents));
+  const size_t middle = contents.size() / 2;
+  contents[middle] ^= 0x80;
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, contents, files[0]));
+
+  Open(1 << 20);
+  int ok = 0, missing = 0;
+  for (int i = 0; i < 100; i++) {
+    const std::string r = Check(i);
+    ASSERT_NE("bad", r) << i;
+    if (r == "ok") {
+      ok++;
+      ASSERT_EQ(0, missing) << "entry " << i << " after a damaged one";
+    } else {
+      missing++;
+    }
+  }
+  ASSERT_GT(ok, 0);
+  ASSERT_GT(missing, 0);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,257 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A portable scalar implementation of XXH3_64bits() from
+// https://github.com/Cyan4973/xxHash, which the compiler vectorizes well.
+
+#include "util/xxh3.h"
+
+#include "util/coding.h"
+
+namespace leveldb {
+namespace xxh3 {
+
+namespace {
+
+const uint32_t kPrime32_1 = 0x9E3779B1U;
+const uint32_t kPrime32_2 = 0x85EBCA77U;
+const uint32_t kPrime32_3 = 0xC2B2AE3DU;
+const uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+const uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+const uint64_t kPrimeMx1 = 0x165667919E3779F9ULL;
+const uint64_t kPrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+const size_t kSecretSize = 192;
+const uint8_t kSecret[kSecretSize] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c,
+    0xf7, 0x21, 0xad, 0x1c, 0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f, 0xcb, 0x79, 0xe6, 0x4e,
+    0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6,
+    0x81, 0x3a, 0x26, 0x4c, 0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3, 0x71, 0x64, 0x48, 0x97,
+    0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7,
+    0xc7, 0x0b, 0x4f, 0x1d, 0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64, 0xea, 0xc5, 0xac, 0x83,
+    0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26,
+    0x29, 0xd4, 0x68, 0x9e, 0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce, 0x45, 0xcb, 0x3a, 0x8f,
+    0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+// Long inputs are consumed in 64-byte stripes, one per 8 bytes of secret
+const size_t kStripeLen = 64;
+const size_t kSecretConsumeRate = 8;
+const size_t kAccumulators = kStripeLen / sizeof(uint64_t);
+
+inline uint64_t Load64(const uint8_t* p) {
+  return DecodeFixed64(reinterpret_cast<const char*>(p));
+}
+
+inline uint32_t Load32(const uint8_t* p) {
+  return DecodeFixed32(reinterpret_cast<const char*>(p));
+}
+
+inline uint64_t Rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint32_t Swap32(uint32_t x) {
+  return ((x << 24) & 0xff000000) | ((x << 8) & 0x00ff0000) |
+         ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff);
+}
+
+inline uint64_t Swap64(uint64_t x) {
+  return (static_cast<uint64_t>(Swap32(static_cast<uint32_t>(x))) << 32) |
+         Swap32(static_cast<uint32_t>(x >> 32));
+}
+
+// Returns the xor of the high and low halves of the 128-bit product.
+inline uint64_t Mul128Fold64(uint64_t lhs, uint64_t rhs) {
+#if defined(__SIZEOF_INT128__)
+  const __uint128_t product = static_cast<__uint128_t>(lhs) * rhs;
+  return static_cast<uint64_t>(product) ^
+         static_cast<uint64_t>(product >> 64);
+#else
+  const uint64_t lo_lo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+  const uint64_t hi_lo = (lhs >> 32) * (rhs & 0xFFFFFFFF);
+  const uint64_t lo_hi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+  const uint64_t hi_hi = (lhs >> 32) * (rhs >> 32);
+  const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+  const uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+  const uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+  return lower ^ upper;
+#endif
+}
+
+inline uint64_t XXH64Avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= kPrime64_2;
+  h ^= h >> 29;
+  h *= kPrime64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+inline uint64_t Avalanche(uint64_t h) {
+  h ^= h >> 37;
+  h *= kPrimeMx1;
+  h ^= h >> 32;
+  return h;
+}
+
+inline uint64_t Rrmxmx(uint64_t h, uint64_t len) {
+  h ^= Rotl64(h, 49) ^ Rotl64(h, 24);
+  h *= kPrimeMx2;
+  h ^= (h >> 35) + len;
+  h *= kPrimeMx2;
+  h ^= h >> 28;
+  return h;
+}
+
+uint64_t Len1To3(const uint8_t* input, size_t len) {
+  const uint32_t c1 = input[0];
+  const uint32_t c2 = input[len >> 1];
+  const uint32_t c3 = input[len - 1];
+  const uint32_t combined = (c1 << 16) | (c2 << 24) | c3 |
+                            (static_cast<uint32_t>(len) << 8);
+  const uint64_t bitflip = Load32(kSecret) ^ Load32(kSecret + 4);
+  return XXH64Avalanche(combined ^ bitflip);
+}
+
+uint64_t Len4To8(const uint8_t* input, size_t len) {
+  const uint32_t input1 = Load32(input);
+  const uint32_t input2 = Load32(input + len - 4);
+  const uint64_t bitflip = Load64(kSecret + 8) ^ Load64(kSecret + 16);
+  const uint64_t input64 = input2 + (static_cast<uint64_t>(input1) << 32);
+  return Rrmxmx(input64 ^ bitflip, len);
+}
+
+uint64_t Len9To16(const uint8_t* input, size_t len) {
+  const uint64_t bitflip1 = Load64(kSecret + 24) ^ Load64(kSecret + 32);
+  const uint64_t bitflip2 = Load64(kSecret + 40) ^ Load64(kSecret + 48);
+  const uint64_t input_lo = Load64(input) ^ bitflip1;
+  const uint64_t input_hi = Load64(input + len - 8) ^ bitflip2;
+  const uint64_t acc =
+      len + Swap64(input_lo) + input_hi + Mul128Fold64(input_lo, input_hi);
+  return Avalanche(acc);
+}
+
+inline uint64_t Mix16B(const uint8_t* input, const uint8_t* secret) {
+  return Mul128Fold64(Load64(input) ^ Load64(secret),
+                      Load64(input + 8) ^ Load64(secret + 8));
+}
+
+uint64_t Len17To128(const uint8_t* input, size_t len) {
+  uint64_t acc = len * kPrime64_1;
+  if (len > 32) {
+    if (len > 64) {
+      if (len > 96) {
+        acc += Mix16B(input + 48, kSecret + 96);
+        acc += Mix16B(input + len - 64, kSecret + 112);
+      }
+      acc += Mix16B(input + 32, kSecret + 64);
+      acc += Mix16B(input + len - 48, kSecret + 80);
+    }
+    acc += Mix16B(input + 16, kSecret + 32);
+    acc += Mix16B(input + len - 32, kSecret + 48);
+  }
+  acc += Mix16B(input, kSecret);
+  acc += Mix16B(input + len - 16, kSecret + 16);
+  return Avalanche(acc);
+}
+
+uint64_t Len129To240(const uint8_t* input, size_t len) {
+  // The smallest secret the reference allows, which the offsets are
+  // relative to
+  const size_t kSecretSizeMin = 136;
+  uint64_t acc = len * kPrime64_1;
+  for (size_t i = 0; i < 8; i++) {
+    acc += Mix16B(input + 16 * i, kSecret + 16 * i);
+  }
+  acc = Avalanche(acc);
+  uint64_t acc_end = Mix16B(input + len - 16, kSecret + kSecretSizeMin - 17);
+  const size_t rounds = len / 16;
+  for (size_t i = 8; i < rounds; i++) {
+    acc_end += Mix16B(input + 16 * i, kSecret + 16 * (i - 8) + 3);
+  }
+  return Avalanche(acc + acc_end);
+}
+
+inline void Accumulate512(uint64_t* acc, const uint8_t* input,
+                          const uint8_t* secret) {
+  for (size_t i = 0; i < kAccumulators; i++) {
+    const uint64_t data_val = Load64(input + 8 * i);
+    const uint64_t data_key = data_val ^ Load64(secret + 8 * i);
+    acc[i ^ 1] += data_val;
+    acc[i] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+  }
+}
+
+inline void Accumulate(uint64_t* acc, const uint8_t* input,
+                       const uint8_t* secret, size_t stripes) {
+  for (size_t n = 0; n < stripes; n++) {
+    Accumulate512(acc, input + n * kStripeLen,
+                  secret + n * kSecretConsumeRate);
+  }
+}
+
+inline void ScrambleAcc(uint64_t* acc, const uint8_t* secret) {
+  for (size_t i = 0; i < kAccumulators; i++) {
+    uint64_t a = acc[i];
+    a ^= a >> 47;
+    a ^= Load64(secret + 8 * i);
+    a *= kPrime32_1;
+    acc[i] = a;
+  }
+}
+
+uint64_t HashLong(const uint8_t* input, size_t len) {
+  uint64_t acc[kAccumulators] = {kPrime32_3, kPrime64_1, kPrime64_2,
+                                 kPrime64_3, kPrime64_4, kPrime32_2,
+                                 kPrime64_5, kPrime32_1};
+  const size_t stripes_per_block =
+      (kSecretSize - kStripeLen) / kSecretConsumeRate;
+  const size_t block_len = kStripeLen * stripes_per_block;
+  const size_t blocks = (len - 1) / block_len;
+  for (size_t n = 0; n < blocks; n++) {
+    Accumulate(acc, input + n * block_len, kSecret, stripes_per_block);
+    ScrambleAcc(acc, kSecret + kSecretSize - kStripeLen);
+  }
+
+  // The last partial block, then the last stripe, which may overlap it
+  const size_t stripes = ((len - 1) - block_len * blocks) / kStripeLen;
+  Accumulate(acc, input + blocks * block_len, kSecret, stripes);
+  Accumulate512(acc, input + len - kStripeLen,
+                kSecret + kSecretSize - kStripeLen - 7);
+
+  uint64_t result = len * kPrime64_1;
+  const uint8_t* secret = kSecret + 11;
+  for (size_t i = 0; i < 4; i++) {
+    result += Mul128Fold64(acc[2 * i] ^ Load64(secret + 16 * i),
+                           acc[2 * i + 1] ^ Load64(secret + 16 * i + 8));
+  }
+  return Avalanche(result);
+}
+
+}  // namespace
+
+uint64_t Value(const char* data, size_t n) {
+  const uint8_t* input = reinterpret_cast<const uint8_t*>(data);
+  if (n <= 16) {
+    if (n > 8) return Len9To16(input, n);
+    if (n >= 4) return Len4To8(input, n);
+    if (n > 0) return Len1To3(input, n);
+    return XXH64Avalanche(Load64(kSecret + 56) ^ Load64(kSecret + 64));
+  }
+  if (n <= 128) return Len17To128(input, n);
+  if (n <= 240) return Len129To240(input, n);
+  return HashLong(input, n);
+}
+
+}  // namespace xxh3
+}  // namespace leveldb
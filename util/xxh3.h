@@ -0,0 +1,25 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// XXH3, the 64-bit hash of the xxHash family, with seed 0 and the default
+// secret.  Much faster than crc32c on large inputs, so it is offered as a
+// block checksum (see Options::checksum).
+
+#ifndef STORAGE_LEVELDB_UTIL_XXH3_H_
+#define STORAGE_LEVELDB_UTIL_XXH3_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace leveldb {
+namespace xxh3 {
+
+// Return the XXH3 64-bit hash of data[0,n-1].  Matches XXH3_64bits() of
+// the reference implementation.
+uint64_t Value(const char* data, size_t n);
+
+}  // namespace xxh3
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_XXH3_H_
@@ -0,0 +1,40 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/xxh3.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+namespace xxh3 {
+
+TEST(XXH3, StandardResults) {
+  // From the reference implementation, covering each input length class.
+  ASSERT_EQ(0x2d06800538d394c2ull, Value("", 0));
+  ASSERT_EQ(0xe6c632b61e964e1full, Value("a", 1));
+  ASSERT_EQ(0x78af5f94892f3950ull, Value("abc", 3));
+  ASSERT_EQ(0x5ced9a40b7d4c5c8ull, Value("leveldb", 7));
+  ASSERT_EQ(0x64439946d8fa212dull, Value("0123456789abcdef", 16));
+  ASSERT_EQ(0x14e7f30f1b135675ull, Value(std::string(100, 'u').data(), 100));
+  ASSERT_EQ(0x60573185d3eccfc2ull, Value(std::string(150, 'w').data(), 150));
+  ASSERT_EQ(0xa5d1b4607dc83554ull, Value(std::string(300, 'x').data(), 300));
+  ASSERT_EQ(0xf5495ed4fa3cd9bfull,
+            Value(std::string(2000, 'y').data(), 2000));
+}
+
+TEST(XXH3, Values) { ASSERT_NE(Value("a", 1), Value("foo", 3)); }
+
+TEST(XXH3, Unaligned) {
+  std::string data(1100, '\0');
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<char>(i * 7);
+  }
+  std::string copy = data.substr(1);
+  ASSERT_EQ(Value(data.data() + 1, 1024), Value(copy.data(), 1024));
+}
+
+}  // namespace xxh3
+}  // namespace leveldb